@@ -4,6 +4,8 @@ plugins {
     alias(libs.plugins.kotlin.compose)
 }
 
+val benchmarkBuild = project.hasProperty("quickjsBenchmark")
+
 android {
     namespace = "com.quickjs.android"
     compileSdk = 35
@@ -16,6 +18,10 @@ android {
         versionName = "1.0"
 
         testInstrumentationRunner = "androidx.test.runner.AndroidJUnitRunner"
+        if (!benchmarkBuild) {
+            // Debug runs only smoke-test the benchmarks; their results are flagged DEBUGGABLE_
+            testInstrumentationRunnerArguments["androidx.benchmark.suppressErrors"] = "DEBUGGABLE,EMULATOR"
+        }
         
         ndk {
             abiFilters += listOf("arm64-v8a", "armeabi-v7a", "x86_64")
@@ -37,6 +43,22 @@ android {
                 "proguard-rules.pro"
             )
         }
+        // Release code (optimized native build) that instrumentation can install
+        create("benchmark") {
+            initWith(getByName("release"))
+            signingConfig = signingConfigs.getByName("debug")
+            matchingFallbacks += listOf("release")
+        }
+    }
+    
+    // ./gradlew connectedBenchmarkAndroidTest -PquickjsBenchmark runs the benchmarks on release code
+    testBuildType = if (benchmarkBuild) "benchmark" else "debug"
+    
+    // microbench.js and the other upstream QuickJS tests, for the benchmark runner
+    sourceSets {
+        getByName("androidTest") {
+            assets.srcDir("src/main/cpp/quickjs/quickjs-2025-04-26/tests")
+        }
     }
     compileOptions {
         sourceCompatibility = JavaVersion.VERSION_11
@@ -84,6 +106,7 @@ dependencies {
     androidTestImplementation(libs.androidx.ui.test.junit4)
     androidTestImplementation(libs.okhttp.mockwebserver)
     androidTestImplementation(libs.kotlinx.coroutines.test)
+    androidTestImplementation(libs.androidx.benchmark.junit4)
     
     debugImplementation(libs.androidx.ui.tooling)
     debugImplementation(libs.androidx.ui.test.manifest)
@@ -0,0 +1,115 @@
+package com.quickjs.android
+
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import androidx.test.platform.app.InstrumentationRegistry
+import org.junit.After
+import org.junit.Assert.assertEquals
+import org.junit.Before
+import org.junit.Test
+import org.junit.runner.RunWith
+import kotlin.concurrent.thread
+
+/**
+ * executeBatch() and invokeBatch() through the real JNI path
+ * A failing entry only fails itself, except a timeout or cancellation, which fails the rest too.
+ */
+@RunWith(AndroidJUnit4::class)
+class BatchTest {
+
+    private val context = InstrumentationRegistry.getInstrumentation().targetContext
+    private lateinit var bridge: QuickJSBridge
+
+    @Before
+    fun setup() {
+        bridge = QuickJSBridge(context)
+        check(bridge.initialize()) { "QuickJS failed to initialize" }
+    }
+
+    @After
+    fun teardown() {
+        bridge.cleanup()
+    }
+
+    private fun kinds(results: List<JsResult>) = results.map { (it as? JsResult.Failure)?.kind }
+
+    @Test
+    fun scriptsShareGlobalsInOrder() {
+        assertEquals(
+            listOf(JsResult.Success(JsUndefined), JsResult.Success(2), JsResult.Success("x2")),
+            bridge.executeBatch(listOf("var n = 1;", "++n", "'x' + n"))
+        )
+        assertEquals(
+            listOf(JsResult.Success(3), JsResult.Success(7), JsResult.Success(5)),
+            bridge.invokeBatch("(a, b) => a + (b || 0)", listOf(listOf(1, 2), listOf(3, 4), 5))
+        )
+    }
+
+    @Test
+    fun failingEntriesLeaveTheOthersRunning() {
+        val results = bridge.executeBatch(
+            listOf(
+                "throw new RangeError('bad')",
+                "var cycle = {}; cycle.self = cycle; cycle",
+                "Promise.reject(new Error('no'))",
+                "'after'"
+            )
+        )
+        assertEquals(
+            listOf(JsResult.ErrorKind.SCRIPT, JsResult.ErrorKind.HOST, JsResult.ErrorKind.REJECTION, null),
+            kinds(results)
+        )
+        val thrown = results[0] as JsResult.Failure
+        assertEquals("RangeError", thrown.name)
+        assertEquals("bad", thrown.message)
+        assertEquals("Cannot encode a cyclic result", (results[1] as JsResult.Failure).message)
+        assertEquals(JsResult.Success("after"), results[3])
+    }
+
+    @Test
+    fun timeoutMidBatchFailsTheRest() {
+        val results = bridge.executeBatch(listOf("1", "for (;;) {}", "2"), timeoutMs = 200)
+        assertEquals(JsResult.Success(1), results[0])
+        assertEquals(listOf(null, JsResult.ErrorKind.TIMEOUT, JsResult.ErrorKind.TIMEOUT), kinds(results))
+        assertEquals("Execution timed out", (results[1] as JsResult.Failure).message)
+        assertEquals(listOf(JsResult.Success(2)), bridge.executeBatch(listOf("1 + 1")))
+    }
+
+    @Test
+    fun cancelledBatchFailsEveryRemainingEntry() {
+        val token = JsCancellationToken()
+        token.cancel()
+        assertEquals(
+            List(3) { JsResult.ErrorKind.CANCELLED },
+            kinds(bridge.executeBatch(listOf("1", "2", "3"), cancellation = token))
+        )
+
+        val running = JsCancellationToken()
+        val canceller = thread {
+            Thread.sleep(200)
+            running.cancel()
+        }
+        val results = bridge.invokeBatch(
+            "(n) => { if (n === 1) for (;;) {} return n; }",
+            listOf(0, 1, 2),
+            timeoutMs = 30_000,
+            cancellation = running
+        )
+        canceller.join()
+        assertEquals(listOf(null, JsResult.ErrorKind.CANCELLED, JsResult.ErrorKind.CANCELLED), kinds(results))
+        assertEquals("Execution cancelled", (results[1] as JsResult.Failure).message)
+    }
+
+    @Test
+    fun invalidInvocationsFailEveryEntry() {
+        val notFunction = bridge.invokeBatch("42", listOf(1, 2))
+        assertEquals(List(2) { JsResult.ErrorKind.SCRIPT }, kinds(notFunction))
+        assertEquals("Batch target is not a function", (notFunction[0] as JsResult.Failure).message)
+
+        // NaN has no JSON form, so the arguments never reach the engine
+        assertEquals(
+            List(2) { JsResult.ErrorKind.HOST },
+            kinds(bridge.invokeBatch("(x) => x", listOf(1.0, Double.NaN)))
+        )
+        assertEquals(emptyList<JsResult>(), bridge.invokeBatch("(x) => x", emptyList()))
+    }
+}
@@ -0,0 +1,105 @@
+package com.quickjs.android
+
+import androidx.benchmark.junit4.BenchmarkRule
+import androidx.benchmark.junit4.measureRepeated
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import androidx.test.platform.app.InstrumentationRegistry
+import okhttp3.mockwebserver.Dispatcher
+import okhttp3.mockwebserver.MockResponse
+import okhttp3.mockwebserver.MockWebServer
+import okhttp3.mockwebserver.RecordedRequest
+import org.junit.After
+import org.junit.Assert.assertEquals
+import org.junit.Before
+import org.junit.Rule
+import org.junit.Test
+import org.junit.runner.RunWith
+
+/**
+ * Benchmarks of the bridge through the real JNI path
+ * Results (ns/op and JVM allocations/op) are written by androidx.benchmark as JSON to the
+ * additional test output directory; run with -PquickjsBenchmark for release numbers
+ */
+@RunWith(AndroidJUnit4::class)
+class BridgeBenchmark {
+
+    @get:Rule
+    val benchmarkRule = BenchmarkRule()
+
+    private val context = InstrumentationRegistry.getInstrumentation().targetContext
+    private lateinit var bridge: QuickJSBridge
+
+    @Before
+    fun setup() {
+        bridge = QuickJSBridge(context)
+        check(bridge.initialize()) { "QuickJS failed to initialize" }
+    }
+
+    @After
+    fun teardown() {
+        bridge.cleanup()
+    }
+
+    @Test
+    fun initializeAndCleanup() {
+        benchmarkRule.measureRepeated {
+            bridge.cleanup()
+            bridge.initialize()
+        }
+    }
+
+    @Test
+    fun resetContext() {
+        benchmarkRule.measureRepeated {
+            bridge.resetQuickJSContext()
+        }
+    }
+
+    @Test
+    fun evalExpression() {
+        benchmarkRule.measureRepeated {
+            bridge.runJavaScript("1 + 2")
+        }
+    }
+
+    @Test
+    fun evalFunctionCall() {
+        bridge.runJavaScript("function fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }")
+        benchmarkRule.measureRepeated {
+            bridge.runJavaScript("fib(15)")
+        }
+    }
+
+    @Test
+    fun evaluateTypedResult() {
+        benchmarkRule.measureRepeated {
+            bridge.evaluateJavaScript("({ id: 1, tags: ['a', 'b'], ratio: 0.5 })")
+        }
+    }
+
+    @Test
+    fun executeBytecode() {
+        val bytecode = checkNotNull(bridge.compileJavaScriptToBytecode("[1, 2, 3].map(x => x * 2).join(',')"))
+        benchmarkRule.measureRepeated {
+            bridge.executeCompiledBytecode(bytecode)
+        }
+    }
+
+    @Test
+    fun fetchRoundTrip() {
+        val server = MockWebServer()
+        server.dispatcher = object : Dispatcher() {
+            override fun dispatch(request: RecordedRequest) = MockResponse().setBody("{\"ok\":true}")
+        }
+        server.start()
+        try {
+            val url = server.url("/data").toString()
+            assertEquals("true", bridge.runJavaScript("fetch('$url').then(r => r.json()).then(d => d.ok)"))
+            benchmarkRule.measureRepeated {
+                bridge.runJavaScript("fetch('$url').then(r => r.json()).then(d => d.ok)")
+            }
+        } finally {
+            server.shutdown()
+        }
+    }
+}
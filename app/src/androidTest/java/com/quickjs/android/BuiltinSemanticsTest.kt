@@ -0,0 +1,206 @@
+package com.quickjs.android
+
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import androidx.test.platform.app.InstrumentationRegistry
+import org.junit.After
+import org.junit.Assert.assertEquals
+import org.junit.Before
+import org.junit.Test
+import org.junit.runner.RunWith
+
+/**
+ * Edge cases of the built-ins with native fast paths, pinned to what the spec (and V8) give
+ * Each script runs in a fresh context of the default engine and returns a string.
+ */
+@RunWith(AndroidJUnit4::class)
+class BuiltinSemanticsTest {
+
+    private val context = InstrumentationRegistry.getInstrumentation().targetContext
+    private lateinit var bridge: QuickJSBridge
+
+    @Before
+    fun setup() {
+        bridge = QuickJSBridge(context)
+        check(bridge.initialize()) { "QuickJS failed to initialize" }
+    }
+
+    @After
+    fun teardown() {
+        bridge.cleanup()
+    }
+
+    private fun assertScript(expected: String, script: String) {
+        bridge.resetQuickJSContext()
+        assertEquals(script, expected, bridge.runJavaScript(script))
+    }
+
+    @Test
+    fun typedArraySetWithinOneArray() {
+        assertScript(
+            "1,2,1,2,3,4,5,6",
+            "var b = new Uint8Array([1, 2, 3, 4, 5, 6, 7, 8]); b.set(b.subarray(0, 6), 2); b.join()"
+        )
+        assertScript(
+            "3,4,5,6,7,8,7,8",
+            "var b = new Uint8Array([1, 2, 3, 4, 5, 6, 7, 8]); b.set(b.subarray(2), 0); b.join()"
+        )
+    }
+
+    @Test
+    fun typedArraySetOverlappingAcrossTypes() {
+        // Destination after the source: a forward copy would read bytes it already wrote
+        assertScript(
+            "1,2,3,4,1,0,2,0,3,0,4,0,13,14,15,16",
+            "var u8 = new Uint8Array(16).map((x, i) => i + 1);" +
+                "new Uint16Array(u8.buffer, 4, 4).set(u8.subarray(0, 4)); u8.join()"
+        )
+        // Destination before the source
+        assertScript(
+            "5,0,6,0,7,0,8,0,9,10,11,12,13,14,15,16",
+            "var u8 = new Uint8Array(16).map((x, i) => i + 1);" +
+                "new Uint16Array(u8.buffer, 0, 4).set(u8.subarray(4, 8)); u8.join()"
+        )
+        assertScript(
+            "-1,-2,-1,-1,-2,-1,3,0",
+            "var i8 = new Int8Array([-1, -2, 3, 4, 5, 6, 7, 8]);" +
+                "new Int16Array(i8.buffer, 2, 3).set(i8.subarray(0, 3)); i8.join()"
+        )
+        assertScript(
+            "1.5,2.5,3.5,4.5",
+            "var f = new Float64Array([1.5, 2.5, 3.5, 4.5]); new Float32Array(f.buffer, 0, 4).set(f);" +
+                "Array.from(new Float32Array(f.buffer, 0, 4)).join()"
+        )
+    }
+
+    @Test
+    fun typedArraySortOrdersZerosAndNaN() {
+        assertScript(
+            "true,true,true,true",
+            "var a = new Float64Array(100).map((x, i) => (i * 37) % 100 - 50); a[5] = NaN; a[7] = -0; a[8] = 0;" +
+                "a.sort(); var sorted = true; for (var i = 1; i < 99; i++) sorted = sorted && a[i - 1] <= a[i];" +
+                "[sorted, isNaN(a[99]), Object.is(a[a.indexOf(0)], -0), Object.is(a[a.indexOf(0) + 1], 0)].join()"
+        )
+        assertScript(
+            "-80,-79,-77,-75,-73",
+            "var a = new Int32Array(80).map((x, i) => (i * 7919) % 160 - 80); a.sort();" +
+                "Array.from(a.subarray(0, 5)).join()"
+        )
+    }
+
+    @Test
+    fun arraySortIsStableWithComparators() {
+        assertScript(
+            "true,0,2",
+            "var a = []; for (var i = 0; i < 300; i++) a.push({k: (i * 7) % 3, i: i});" +
+                "a.sort((x, y) => x.k - y.k); var stable = true;" +
+                "for (var i = 1; i < a.length; i++) if (a[i - 1].k === a[i].k) stable = stable && a[i - 1].i < a[i].i;" +
+                "stable + ',' + a[0].k + ',' + a[299].k"
+        )
+        // Equal numbers keep their order under a recognized numeric comparator
+        assertScript(
+            "0,-0,-0,0,1",
+            "var a = [0, -0, 1, -0, 0]; a.sort((x, y) => x - y);" +
+                "a.map((x) => Object.is(x, -0) ? '-0' : String(x)).join()"
+        )
+    }
+
+    @Test
+    fun arraySortOfNumbersAndStrings() {
+        assertScript("-5,1,2.5,9,10,100", "[10, 9, 1, 100, -5, 2.5].sort((a, b) => a - b).join()")
+        assertScript("100,10,9,2.5,1,-5", "[10, 9, 1, 100, -5, 2.5].sort((a, b) => b - a).join()")
+        // Without a comparator numbers sort as strings
+        assertScript("-5,1,10,100,2.5,9", "[10, 9, 1, 100, -5, 2.5].sort().join()")
+        assertScript(
+            "true,-500,499",
+            "var a = []; for (var i = 0; i < 1000; i++) a.push((i * 7919) % 1000 - 500); a.sort((x, y) => x - y);" +
+                "var ok = true; for (var i = 1; i < 1000; i++) ok = ok && a[i - 1] <= a[i]; ok + ',' + a[0] + ',' + a[999]"
+        )
+        assertScript(
+            "s0,s1,s10,s100",
+            "var a = []; for (var i = 0; i < 1000; i++) a.push('s' + (i * 7919) % 1000); a.sort(); a.slice(0, 4).join()"
+        )
+        // Strings compare by UTF-16 code units, so a surrogate pair sorts before U+FF61
+        assertScript(
+            "0:NaN,1:66,1:97,2:97,1:98,2:55357,1:65377",
+            "['b', 'a', '\\uD83D\\uDE00', '\\uFF61', 'B', '', 'aa'].sort()" +
+                ".map((s) => s.length + ':' + s.charCodeAt(0)).join()"
+        )
+    }
+
+    @Test
+    fun arraySortMovesUndefinedAndHolesToTheEnd() {
+        assertScript(
+            "6,1|2|3|||,true,false,false",
+            "var a = [3, , undefined, 1, , 2]; a.sort(); [a.length, a.join('|'), 3 in a, 4 in a, 5 in a].join()"
+        )
+        // The comparator never sees undefined or holes
+        assertScript(
+            "6,3|2|1|||,true,false,false",
+            "var a = [3, , undefined, 1, , 2]; a.sort((x, y) => y - x);" +
+                "[a.length, a.join('|'), 3 in a, 4 in a, 5 in a].join()"
+        )
+    }
+
+    @Test
+    fun mapForEachSeesEntriesAddedAndSkipsDeleted() {
+        // A key deleted and set again moves to the end and is visited again
+        assertScript(
+            "1,3,1|3,1",
+            "var m = new Map([[1, 'a'], [2, 'b'], [3, 'c']]); var seen = [];" +
+                "m.forEach((v, k) => { seen.push(k); if (k === 1 && seen.length === 1) { m.delete(2); m.delete(1); m.set(1, 'again'); } });" +
+                "seen.join() + '|' + Array.from(m.keys()).join()"
+        )
+        assertScript(
+            "1,2,3,4",
+            "var s = new Set([1]); var seen = []; s.forEach((v) => { seen.push(v); if (v < 4) s.add(v + 1); }); seen.join()"
+        )
+        assertScript(
+            "b,2|c,3|a,4",
+            "var m = new Map([['a', 1], ['b', 2], ['c', 3]]); m.delete('a'); m.set('a', 4); Array.from(m).join('|')"
+        )
+    }
+
+    @Test
+    fun mapIteratorsSurviveMutation() {
+        assertScript(
+            "1,2,1,2,1,2",
+            "var m = new Map([[1, 'a'], [2, 'b']]); var seen = [];" +
+                "for (var [k] of m) { seen.push(k); if (seen.length < 5) { m.delete(k); m.set(k, 'x'); } } seen.join()"
+        )
+        // Cleared while an iterator is live: the iterator goes on with what is added after
+        assertScript(
+            "1,4,5,true",
+            "var s = new Set([1, 2, 3]); var it = s.values(); var out = [it.next().value]; s.clear(); s.add(4); s.add(5);" +
+                "out.push(it.next().value, it.next().value, it.next().done); out.join()"
+        )
+        assertScript(
+            "500,500",
+            "var m = new Map(); for (var i = 0; i < 1000; i++) m.set(i, i); var seen = 0;" +
+                "for (var [k] of m) { seen++; if (k < 1000) m.delete(k + 1); } seen + ',' + m.size"
+        )
+        // Deleted entries are compacted away under a live iterator without it losing its place
+        assertScript(
+            "3,2",
+            "var m = new Map([[1, 1], [2, 2], [3, 3]]); var it = m.keys(); it.next(); m.delete(2);" +
+                "for (var i = 0; i < 200; i++) { m.set('t' + i, i); m.delete('t' + i); } Array.from(it).join() + ',' + m.size"
+        )
+        assertScript(
+            "999,new,3",
+            "var m = new Map(); for (var i = 0; i < 1000; i++) m.set(i, i); var it = m.keys(); it.next();" +
+                "for (var i = 1; i < 999; i++) m.delete(i); m.set('new', 0); Array.from(it).join() + ',' + m.size"
+        )
+    }
+
+    @Test
+    fun mapKeysCompareBySameValueZero() {
+        assertScript(
+            "n,z,true,true,true",
+            "var m = new Map([[NaN, 'n'], [0, 'z']]);" +
+                "[m.get(NaN), m.get(-0), m.has(+0), new Set([-0]).has(0), Object.is(Array.from(new Set([-0]))[0], 0)].join()"
+        )
+        assertScript(
+            "2,false",
+            "var w = new WeakMap(); var k = {}; w.set(k, 1); w.delete(k); w.set(k, 2); w.get(k) + ',' + w.has({})"
+        )
+    }
+}
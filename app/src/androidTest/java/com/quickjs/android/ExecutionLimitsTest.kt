@@ -0,0 +1,78 @@
+package com.quickjs.android
+
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import androidx.test.platform.app.InstrumentationRegistry
+import org.junit.After
+import org.junit.Assert.assertEquals
+import org.junit.Assert.assertTrue
+import org.junit.Before
+import org.junit.Test
+import org.junit.runner.RunWith
+import kotlin.concurrent.thread
+
+/**
+ * Timeouts and cancellation of pooled executions through the real JNI path
+ * A stopped script fails with its own error and leaves the engine usable for the next call.
+ */
+@RunWith(AndroidJUnit4::class)
+class ExecutionLimitsTest {
+
+    private val context = InstrumentationRegistry.getInstrumentation().targetContext
+    private lateinit var bridge: QuickJSBridge
+
+    @Before
+    fun setup() {
+        bridge = QuickJSBridge(context)
+        check(bridge.initialize()) { "QuickJS failed to initialize" }
+    }
+
+    @After
+    fun teardown() {
+        bridge.cleanup()
+    }
+
+    @Test
+    fun loopStopsAtTimeout() {
+        val start = System.nanoTime()
+        assertEquals("Error: Execution timed out", bridge.runPooledJavaScript("for (;;) {}", timeoutMs = 200))
+        assertTrue((System.nanoTime() - start) / 1_000_000 < 5_000)
+        assertEquals("2", bridge.runPooledJavaScript("1 + 1"))
+    }
+
+    @Test
+    fun timeoutCoversAwaiting() {
+        assertEquals(
+            "Error: Execution timed out",
+            bridge.runPooledJavaScript("new Promise((resolve) => setTimeout(resolve, 60000))", timeoutMs = 200)
+        )
+        val result = bridge.evaluatePooledJavaScript("for (;;) {}", timeoutMs = 200)
+        assertEquals(JsResult.ErrorKind.TIMEOUT, (result as JsResult.Failure).kind)
+    }
+
+    @Test
+    fun cancelledBeforeStartFails() {
+        val token = JsCancellationToken()
+        token.cancel()
+        assertEquals(
+            "Error: Execution cancelled",
+            bridge.runPooledJavaScript("'ran'", cancellation = token)
+        )
+        val result = bridge.evaluatePooledJavaScript("'ran'", cancellation = token)
+        assertEquals(JsResult.ErrorKind.CANCELLED, (result as JsResult.Failure).kind)
+    }
+
+    @Test
+    fun cancelledFromAnotherThreadWhileRunning() {
+        val token = JsCancellationToken()
+        val canceller = thread {
+            Thread.sleep(200)
+            token.cancel()
+        }
+        assertEquals(
+            "Error: Execution cancelled",
+            bridge.runPooledJavaScript("for (;;) {}", timeoutMs = 30_000, cancellation = token)
+        )
+        canceller.join()
+        assertEquals("2", bridge.runPooledJavaScript("1 + 1"))
+    }
+}
@@ -0,0 +1,97 @@
+package com.quickjs.android
+
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import androidx.test.platform.app.InstrumentationRegistry
+import org.junit.After
+import org.junit.Assert.assertEquals
+import org.junit.Assert.assertFalse
+import org.junit.Assert.assertNotNull
+import org.junit.Assert.assertNull
+import org.junit.Assert.assertTrue
+import org.junit.Before
+import org.junit.Test
+import org.junit.runner.RunWith
+
+/**
+ * Hibernation through the real JNI path, on the default engine of runJavaScript()
+ * A hibernated engine reports no memory usage until its next execution restores it.
+ */
+@RunWith(AndroidJUnit4::class)
+class HibernationTest {
+
+    private val context = InstrumentationRegistry.getInstrumentation().targetContext
+    private lateinit var bridge: QuickJSBridge
+
+    @Before
+    fun setup() {
+        bridge = QuickJSBridge(context)
+        check(bridge.initialize()) { "QuickJS failed to initialize" }
+    }
+
+    @After
+    fun teardown() {
+        bridge.cleanup()
+    }
+
+    @Test
+    fun plainDataGlobalsRoundTrip() {
+        bridge.runJavaScript(
+            "var count = 41; var config = {name: 'x', nested: {list: [1, 2]}}; config.self = config;" +
+                "var pair = [config, config]; var date = new Date(1234); var bytes = new Uint8Array([1, 2, 3]);" +
+                "Object.defineProperty(globalThis, 'fixed', {value: 7});"
+        )
+        assertTrue(bridge.hibernate())
+        assertNull(bridge.getEngineMemoryUsage())
+
+        assertEquals(
+            "41,x,1|2,true,true,1234,true,3,7,false",
+            bridge.runJavaScript(
+                "[count, config.name, config.nested.list.join('|'), config.self === config, pair[1] === config," +
+                    "date.getTime(), bytes instanceof Uint8Array, bytes[2], fixed," +
+                    "Object.getOwnPropertyDescriptor(globalThis, 'fixed').writable].join()"
+            )
+        )
+        assertNotNull(bridge.getEngineMemoryUsage())
+    }
+
+    @Test
+    fun engineHoldingFunctionKeepsRunning() {
+        bridge.runJavaScript("var count = 1; function next() { return ++count; }")
+        assertFalse(bridge.hibernate())
+        assertNotNull(bridge.getEngineMemoryUsage())
+        assertEquals("2", bridge.runJavaScript("String(next())"))
+    }
+
+    @Test
+    fun unsavableGlobalsKeepEngineRunning() {
+        for (script in listOf(
+            "let hidden = 1;",
+            "var map = new Map([[1, 'a']]);",
+            "var point = new (class Point { constructor() { this.x = 1; } })();",
+            "var holder = {callback: () => 1};",
+            "Array.prototype.sum = function() { return 1; };",
+            "console.log = function() {};",
+            "delete globalThis.setTimeout;",
+        )) {
+            bridge.resetQuickJSContext()
+            bridge.runJavaScript(script)
+            assertFalse(script, bridge.hibernate())
+            assertNotNull(script, bridge.getEngineMemoryUsage())
+        }
+    }
+
+    @Test
+    fun forcedHibernationDropsFunctions() {
+        bridge.runJavaScript("var count = 5; function next() { return ++count; }")
+        assertTrue(bridge.hibernate(force = true))
+        assertEquals("5 undefined", bridge.runJavaScript("count + ' ' + typeof next"))
+    }
+
+    @Test
+    fun idleSweepLeavesDefaultEngineRunning() {
+        bridge.runJavaScript("var count = 1;")
+        bridge.hibernateEngines()
+        assertNotNull(bridge.getEngineMemoryUsage())
+        assertEquals("1", bridge.runJavaScript("String(count)"))
+    }
+}
@@ -0,0 +1,138 @@
+package com.quickjs.android
+
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import androidx.test.platform.app.InstrumentationRegistry
+import com.quickjs.android.QuickJSBridge.HostType
+import org.junit.After
+import org.junit.Assert.assertEquals
+import org.junit.Assert.assertFalse
+import org.junit.Assert.assertTrue
+import org.junit.Before
+import org.junit.Test
+import org.junit.runner.RunWith
+import java.nio.ByteBuffer
+
+/**
+ * Host functions from registerHostFunction() called by scripts on the default engine
+ * Conversion errors and Java exceptions surface as JavaScript errors that scripts can catch.
+ */
+@RunWith(AndroidJUnit4::class)
+class HostFunctionsTest {
+
+    class Receiver {
+        var recorded = 0
+
+        fun add(a: Int, b: Int): Int = a + b
+
+        fun record(value: Int) {
+            recorded = value
+        }
+
+        fun fail(message: String?): String = throw IllegalStateException(message)
+
+        fun sum(bytes: ByteBuffer?): Int {
+            if (bytes == null) {
+                return -1
+            }
+            var total = 0
+            while (bytes.hasRemaining()) {
+                total += bytes.get().toInt() and 0xff
+            }
+            return total
+        }
+
+        // Position is ignored; the result is copied from 0 to the limit
+        fun bytes(count: Int): ByteBuffer? {
+            val buffer = ByteBuffer.allocateDirect(8)
+            for (i in 0 until 8) {
+                buffer.put(i.toByte())
+            }
+            buffer.position(5)
+            buffer.limit(count)
+            return buffer
+        }
+
+        fun heapBytes(count: Int): ByteBuffer? = ByteBuffer.allocate(count)
+    }
+
+    private val context = InstrumentationRegistry.getInstrumentation().targetContext
+    private lateinit var bridge: QuickJSBridge
+    private val receiver = Receiver()
+
+    @Before
+    fun setup() {
+        bridge = QuickJSBridge(context)
+        check(bridge.initialize()) { "QuickJS failed to initialize" }
+        check(bridge.registerHostFunction("hostAdd", receiver, "add", HostType.INT, HostType.INT, HostType.INT))
+        check(bridge.registerHostFunction("hostRecord", receiver, "record", HostType.VOID, HostType.INT))
+        check(bridge.registerHostFunction("hostFail", receiver, "fail", HostType.STRING, HostType.STRING))
+        check(bridge.registerHostFunction("hostSum", receiver, "sum", HostType.INT, HostType.BYTE_BUFFER))
+        check(bridge.registerHostFunction("hostBytes", receiver, "bytes", HostType.BYTE_BUFFER, HostType.INT))
+        check(bridge.registerHostFunction("hostHeapBytes", receiver, "heapBytes", HostType.BYTE_BUFFER, HostType.INT))
+        bridge.resetQuickJSContext()
+    }
+
+    @After
+    fun teardown() {
+        bridge.cleanup()
+    }
+
+    private fun assertScript(expected: String, script: String) {
+        assertEquals(script, expected, bridge.runJavaScript(script))
+    }
+
+    @Test
+    fun argumentsAndResultsConvert() {
+        assertScript("5,2", "[hostAdd(2, 3), hostAdd(2)].join()")  // A missing argument converts from undefined
+        assertScript("undefined", "String(hostRecord(7))")
+        assertEquals(7, receiver.recorded)
+    }
+
+    @Test
+    fun javaExceptionBecomesCatchableError() {
+        assertScript(
+            "InternalError|hostFail: java.lang.IllegalStateException: boom",
+            "try { hostFail('boom'); 'no error' } catch (e) { e.name + '|' + e.message }"
+        )
+        assertScript("2", "try { hostFail('again') } catch (e) {} String(hostAdd(1, 1))")
+    }
+
+    @Test
+    fun byteBufferArgumentsViewTheBytes() {
+        assertScript(
+            "6,6,6,-1,-1",
+            "var bytes = new Uint8Array([9, 1, 2, 3]).subarray(1); [hostSum(bytes), hostSum(bytes.buffer.slice(1))," +
+                "hostSum(new Uint16Array([6])), hostSum(null), hostSum()].join()"
+        )
+        assertScript(
+            "TypeError|hostSum: argument 1 must be an ArrayBuffer or typed array",
+            "try { hostSum([1, 2, 3]); 'no error' } catch (e) { e.name + '|' + e.message }"
+        )
+    }
+
+    @Test
+    fun byteBufferResultsAreCopiedToTheLimit() {
+        assertScript(
+            "true,0|1|2,0",
+            "var b = hostBytes(3); [b instanceof ArrayBuffer, new Uint8Array(b).join('|'), hostBytes(0).byteLength].join()"
+        )
+        assertScript(
+            "TypeError|hostHeapBytes: returned a ByteBuffer that is not direct",
+            "try { hostHeapBytes(4); 'no error' } catch (e) { e.name + '|' + e.message }"
+        )
+    }
+
+    @Test
+    fun invalidRegistrationsAreRefused() {
+        assertFalse(bridge.registerHostFunction("hostMissing", receiver, "missing", HostType.INT))
+        assertFalse(bridge.registerHostFunction("hostVoidParameter", receiver, "record", HostType.VOID, HostType.VOID))
+        // add() takes two ints, not two doubles
+        assertFalse(
+            bridge.registerHostFunction("hostAddDoubles", receiver, "add", HostType.DOUBLE, HostType.DOUBLE, HostType.DOUBLE)
+        )
+        assertScript("undefined,undefined", "[typeof hostMissing, typeof hostAddDoubles].join()")
+        // Registering a name again replaces its function
+        assertTrue(bridge.registerHostFunction("hostAdd", receiver, "add", HostType.INT, HostType.INT, HostType.INT))
+        assertScript("3", "String(hostAdd(1, 2))")
+    }
+}
@@ -0,0 +1,60 @@
+package com.quickjs.android
+
+import android.util.Log
+import androidx.test.ext.junit.runners.AndroidJUnit4
+import androidx.test.platform.app.InstrumentationRegistry
+import org.json.JSONObject
+import org.junit.After
+import org.junit.Assert.assertFalse
+import org.junit.Assert.assertTrue
+import org.junit.Before
+import org.junit.Test
+import org.junit.runner.RunWith
+import java.io.File
+
+/**
+ * Runs QuickJS's tests/microbench.js through the native microbench runner
+ * The report is written as microbench.json to the additional test output directory.
+ * Pass -e microbench.filters empty_loop,prop_ to run a subset of the cases.
+ */
+@RunWith(AndroidJUnit4::class)
+class MicrobenchTest {
+
+    private val instrumentation = InstrumentationRegistry.getInstrumentation()
+    private lateinit var bridge: QuickJSBridge
+
+    @Before
+    fun setup() {
+        bridge = QuickJSBridge(instrumentation.targetContext)
+        check(bridge.initialize()) { "QuickJS failed to initialize" }
+        // Cases log their own progress; keep the console ring out of the measurements
+        bridge.setConsoleLevel(QuickJSBridge.ConsoleLevel.OFF)
+    }
+
+    @After
+    fun teardown() {
+        bridge.cleanup()
+    }
+
+    @Test
+    fun microbench() {
+        val source = instrumentation.context.assets.open("microbench.js").bufferedReader().use { it.readText() }
+        val filters = InstrumentationRegistry.getArguments().getString("microbench.filters")
+            ?.split(',')?.filter { it.isNotBlank() } ?: emptyList()
+
+        val report = JSONObject(bridge.runMicrobench(source, filters))
+        assertFalse(report.optString("error"), report.has("error"))
+        val benchmarks = report.getJSONArray("benchmarks")
+        assertTrue(benchmarks.length() > 0)
+        for (i in 0 until benchmarks.length()) {
+            val benchmark = benchmarks.getJSONObject(i)
+            assertTrue(benchmark.getString("name"), benchmark.getDouble("nsPerOp") > 0)
+        }
+
+        val outputDir = InstrumentationRegistry.getArguments().getString("additionalTestOutputDir")
+            ?.let { File(it) } ?: instrumentation.targetContext.getExternalFilesDir(null)
+        val output = File(outputDir, "microbench.json")
+        output.writeText(report.toString(2))
+        Log.i("MicrobenchTest", "Wrote ${benchmarks.length()} results to $output")
+    }
+}
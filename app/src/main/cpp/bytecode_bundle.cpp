@@ -0,0 +1,249 @@
+#include "bytecode_bundle.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logging.h"
+
+namespace {
+
+const size_t HEADER_SIZE = 32;
+const size_t HEADER_SIZE_V1 = 24;
+const size_t INDEX_ENTRY_SIZE = 16;
+const size_t BLOB_ALIGNMENT = 8;
+
+uint32_t readU32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));  // Android targets are little endian
+    return v;
+}
+
+void appendU32(std::vector<uint8_t> &out, uint32_t v) {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(&v);
+    out.insert(out.end(), p, p + sizeof(v));
+}
+
+void alignTo(std::vector<uint8_t> &out, size_t alignment) {
+    while (out.size() % alignment != 0) {
+        out.push_back(0);
+    }
+}
+
+} // namespace
+
+bool BytecodeBundle::write(const std::string &path, std::vector<Script> scripts,
+                           const std::vector<uint8_t> &atomTable) {
+    std::sort(scripts.begin(), scripts.end(),
+              [](const Script &a, const Script &b) { return a.id < b.id; });
+    for (size_t i = 1; i < scripts.size(); i++) {
+        if (scripts[i].id == scripts[i - 1].id) {
+            LOGE("Duplicate script id in bundle: %s", scripts[i].id.c_str());
+            return false;
+        }
+    }
+
+    // Lay out ids and blobs first so the index can reference them
+    size_t idsOffset = HEADER_SIZE + scripts.size() * INDEX_ENTRY_SIZE;
+    std::vector<uint8_t> payload;
+    std::vector<uint32_t> idOffsets, blobOffsets;
+    for (const Script &script : scripts) {
+        idOffsets.push_back(static_cast<uint32_t>(idsOffset + payload.size()));
+        payload.insert(payload.end(), script.id.begin(), script.id.end());
+    }
+    uint32_t atomTableOffset = static_cast<uint32_t>(idsOffset + payload.size());
+    payload.insert(payload.end(), atomTable.begin(), atomTable.end());
+    for (const Script &script : scripts) {
+        alignTo(payload, BLOB_ALIGNMENT);
+        blobOffsets.push_back(static_cast<uint32_t>(idsOffset + payload.size()));
+        payload.insert(payload.end(), script.bytecode.begin(), script.bytecode.end());
+    }
+
+    size_t totalSize = idsOffset + payload.size();
+    if (totalSize > UINT32_MAX) {
+        LOGE("Bundle too large: %zu bytes", totalSize);
+        return false;
+    }
+
+    std::vector<uint8_t> out;
+    out.reserve(totalSize);
+    appendU32(out, MAGIC);
+    appendU32(out, VERSION);
+    appendU32(out, static_cast<uint32_t>(scripts.size()));
+    appendU32(out, static_cast<uint32_t>(HEADER_SIZE));
+    appendU32(out, static_cast<uint32_t>(totalSize));
+    appendU32(out, 0);  // Reserved
+    appendU32(out, atomTable.empty() ? 0 : atomTableOffset);
+    appendU32(out, static_cast<uint32_t>(atomTable.size()));
+    for (size_t i = 0; i < scripts.size(); i++) {
+        appendU32(out, idOffsets[i]);
+        appendU32(out, static_cast<uint32_t>(scripts[i].id.size()));
+        appendU32(out, blobOffsets[i]);
+        appendU32(out, static_cast<uint32_t>(scripts[i].bytecode.size()));
+    }
+    out.insert(out.end(), payload.begin(), payload.end());
+
+    // Write to a temporary file and rename so readers never map a partial bundle
+    std::string tmpPath = path + ".tmp";
+    FILE *file = fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        LOGE("Failed to create bundle file: %s", tmpPath.c_str());
+        return false;
+    }
+    bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        LOGE("Failed to write bundle file: %s", path.c_str());
+        unlink(tmpPath.c_str());
+        return false;
+    }
+
+    LOGI("Wrote bytecode bundle %s: %zu scripts, %zu bytes (%zu of shared atoms)",
+         path.c_str(), scripts.size(), out.size(), atomTable.size());
+    return true;
+}
+
+BytecodeBundle *BytecodeBundle::openFile(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOGE("Failed to open bundle file: %s", path.c_str());
+        return nullptr;
+    }
+
+    struct stat st;
+    BytecodeBundle *bundle = nullptr;
+    if (fstat(fd, &st) == 0) {
+        bundle = openFd(fd, 0, st.st_size);
+    }
+    close(fd);
+    return bundle;
+}
+
+BytecodeBundle *BytecodeBundle::openFd(int fd, int64_t offset, int64_t length) {
+    if (offset < 0 || length < static_cast<int64_t>(HEADER_SIZE_V1)) {
+        LOGE("Invalid bundle range: offset %lld, length %lld",
+             static_cast<long long>(offset), static_cast<long long>(length));
+        return nullptr;
+    }
+
+    // mmap offsets must be page aligned; assets usually are not
+    int64_t pageSize = sysconf(_SC_PAGESIZE);
+    int64_t alignedOffset = offset & ~(pageSize - 1);
+    size_t delta = static_cast<size_t>(offset - alignedOffset);
+    size_t mappingLength = static_cast<size_t>(length) + delta;
+
+    void *mapping = mmap(nullptr, mappingLength, PROT_READ, MAP_PRIVATE, fd, alignedOffset);
+    if (mapping == MAP_FAILED) {
+        LOGE("Failed to map bundle: %s", strerror(errno));
+        return nullptr;
+    }
+
+    BytecodeBundle *bundle = new BytecodeBundle(mapping, mappingLength,
+        static_cast<const uint8_t *>(mapping) + delta, static_cast<size_t>(length));
+    if (!bundle->validate()) {
+        delete bundle;
+        return nullptr;
+    }
+    return bundle;
+}
+
+BytecodeBundle::BytecodeBundle(void *mapping, size_t mappingLength, const uint8_t *base, size_t length)
+    : mapping(mapping), mappingLength(mappingLength), base(base), length(length),
+      entryCount(readU32(base + 8)), indexOffset(readU32(base + 12)),
+      atomTableOffset(0), atomTableLength(0) {
+    if (readU32(base + 4) >= 2 && length >= HEADER_SIZE) {
+        atomTableOffset = readU32(base + 24);
+        atomTableLength = readU32(base + 28);
+    }
+}
+
+BytecodeBundle::~BytecodeBundle() {
+    munmap(mapping, mappingLength);
+}
+
+bool BytecodeBundle::validate() const {
+    if (readU32(base) != MAGIC) {
+        LOGE("Not a bytecode bundle");
+        return false;
+    }
+    if (readU32(base + 4) != VERSION && readU32(base + 4) != 1) {
+        LOGE("Unsupported bundle version %u", readU32(base + 4));
+        return false;
+    }
+    if (readU32(base + 4) == VERSION && length < HEADER_SIZE) {
+        LOGE("Truncated bundle header");
+        return false;
+    }
+    if (readU32(base + 16) > length) {
+        LOGE("Truncated bundle: %u bytes expected, %zu mapped", readU32(base + 16), length);
+        return false;
+    }
+    if (indexOffset > length || (length - indexOffset) / INDEX_ENTRY_SIZE < entryCount) {
+        LOGE("Corrupt bundle index");
+        return false;
+    }
+    if (static_cast<uint64_t>(atomTableOffset) + atomTableLength > length) {
+        LOGE("Corrupt bundle atom table");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < entryCount; i++) {
+        const uint8_t *entry = base + indexOffset + i * INDEX_ENTRY_SIZE;
+        uint64_t idEnd = static_cast<uint64_t>(readU32(entry)) + readU32(entry + 4);
+        uint64_t blobEnd = static_cast<uint64_t>(readU32(entry + 8)) + readU32(entry + 12);
+        if (idEnd > length || blobEnd > length) {
+            LOGE("Corrupt bundle entry %u", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BytecodeBundle::find(const std::string &id, const uint8_t **data, size_t *dataLength) const {
+    // Binary search over the sorted index
+    uint32_t lo = 0, hi = entryCount;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const uint8_t *entry = base + indexOffset + mid * INDEX_ENTRY_SIZE;
+        size_t idLength = readU32(entry + 4);
+        int cmp = memcmp(base + readU32(entry), id.data(), std::min(idLength, id.size()));
+        if (cmp == 0) {
+            cmp = idLength < id.size() ? -1 : (idLength > id.size() ? 1 : 0);
+        }
+        if (cmp == 0) {
+            *data = base + readU32(entry + 8);
+            *dataLength = readU32(entry + 12);
+            return true;
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> BytecodeBundle::scriptIds() const {
+    std::vector<std::string> ids;
+    ids.reserve(entryCount);
+    for (uint32_t i = 0; i < entryCount; i++) {
+        const uint8_t *entry = base + indexOffset + i * INDEX_ENTRY_SIZE;
+        ids.emplace_back(reinterpret_cast<const char *>(base + readU32(entry)), readU32(entry + 4));
+    }
+    return ids;
+}
+
+bool BytecodeBundle::atomTable(const uint8_t **data, size_t *dataLength) const {
+    if (atomTableLength == 0) {
+        return false;
+    }
+    *data = base + atomTableOffset;
+    *dataLength = atomTableLength;
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef QUICKJS_ANDROID_BYTECODE_BUNDLE_H
+#define QUICKJS_ANDROID_BYTECODE_BUNDLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Versioned bundle of serialized QuickJS bytecode, read through mmap
+//
+// Layout (all integers little endian, blobs 8-byte aligned):
+//   header    magic "QJSB", version, entry count, index offset, file size,
+//             reserved, atom table offset, atom table length
+//   index     entry count * {id offset, id length, blob offset, blob length},
+//             sorted by script id for binary search
+//   ids       script id bytes (not NUL terminated)
+//   atoms     JS_WriteAtomTable() output shared by every blob, if any
+//   blobs     JS_WriteObjectWithAtomTable(..., JS_WRITE_OBJ_BYTECODE) output
+//             per script or ES module, or JS_WriteObject() output without
+//             an atom table
+//
+// Offsets are relative to the start of the bundle, so a bundle can be
+// mapped from any file offset (e.g. an uncompressed APK asset). Version 1
+// bundles have a 24-byte header and no atom table, and are still read.
+class BytecodeBundle {
+public:
+    static constexpr uint32_t MAGIC = 0x424a5351;  // "QJSB"
+    static constexpr uint32_t VERSION = 2;
+
+    struct Script {
+        std::string id;
+        std::vector<uint8_t> bytecode;
+    };
+
+    // Write a bundle containing the given scripts to path
+    // atomTable is the table the scripts were written against, or empty
+    static bool write(const std::string &path, std::vector<Script> scripts,
+                      const std::vector<uint8_t> &atomTable = {});
+
+    // Map a bundle file from app storage
+    static BytecodeBundle *openFile(const std::string &path);
+
+    // Map a bundle from length bytes at offset in fd; fd may be closed afterwards
+    static BytecodeBundle *openFd(int fd, int64_t offset, int64_t length);
+
+    ~BytecodeBundle();
+
+    BytecodeBundle(const BytecodeBundle &) = delete;
+    BytecodeBundle &operator=(const BytecodeBundle &) = delete;
+
+    // Locate a script's bytecode inside the mapping; returns false if not found
+    bool find(const std::string &id, const uint8_t **data, size_t *length) const;
+
+    std::vector<std::string> scriptIds() const;
+
+    // Locate the atom table shared by the scripts; returns false if they have none
+    bool atomTable(const uint8_t **data, size_t *length) const;
+
+    size_t size() const {
+        return length;
+    }
+
+private:
+    BytecodeBundle(void *mapping, size_t mappingLength, const uint8_t *base, size_t length);
+
+    bool validate() const;
+
+    void *mapping;          // Page-aligned start of the mapping
+    size_t mappingLength;
+    const uint8_t *base;    // Start of the bundle inside the mapping
+    size_t length;
+    uint32_t entryCount;
+    uint32_t indexOffset;
+    uint32_t atomTableOffset;
+    uint32_t atomTableLength;
+};
+
+#endif // QUICKJS_ANDROID_BYTECODE_BUNDLE_H
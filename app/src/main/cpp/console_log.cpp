@@ -0,0 +1,90 @@
+#include "console_log.h"
+
+#include <cstring>
+
+static_assert((ConsoleLog::CAPACITY & (ConsoleLog::CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+ConsoleLog::ConsoleLog() : enqueuePos(0), dequeuePos(0), minLevel(LEVEL_INFO), dropped(0) {
+    for (size_t i = 0; i < CAPACITY; i++) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+// A slot is free for the producer at pos when its sequence equals pos, and
+// holds a record for the consumer at pos when its sequence equals pos + 1
+ConsoleLog::Slot *ConsoleLog::reserve(size_t *pos) {
+    size_t current = enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot *slot = &slots[current & (CAPACITY - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(current);
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(current, current + 1, std::memory_order_relaxed)) {
+                *pos = current;
+                return slot;
+            }
+        } else if (diff < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;  // Full
+        } else {
+            current = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void ConsoleLog::publish(Slot *slot, size_t pos) {
+    slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool ConsoleLog::append(int level, int engineId, int64_t timestampMs, const char *message, size_t length) {
+    size_t pos;
+    Slot *slot = reserve(&pos);
+    if (!slot) {
+        return false;
+    }
+
+    Record &record = slot->record;
+    record.level = level;
+    record.engineId = engineId;
+    record.timestampMs = timestampMs;
+    if (length > MESSAGE_CAPACITY - 1) {
+        // Cut before the UTF-8 sequence that straddles the limit
+        length = MESSAGE_CAPACITY - 1;
+        while (length > 0 && (static_cast<unsigned char>(message[length]) & 0xC0) == 0x80) {
+            length--;
+        }
+    }
+    record.length = static_cast<uint32_t>(length);
+    memcpy(record.message, message, record.length);
+    record.message[record.length] = '\0';
+
+    publish(slot, pos);
+    return true;
+}
+
+size_t ConsoleLog::drain(Record *out, size_t max) {
+    size_t count = 0;
+    while (count < max) {
+        size_t current = dequeuePos.load(std::memory_order_relaxed);
+        Slot *slot = &slots[current & (CAPACITY - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(current + 1);
+        if (diff < 0) {
+            break;  // Empty, or the next record is still being written
+        }
+        if (diff > 0 || !dequeuePos.compare_exchange_weak(current, current + 1, std::memory_order_relaxed)) {
+            continue;  // Another drain took it
+        }
+
+        Record &record = slot->record;
+        out[count].level = record.level;
+        out[count].engineId = record.engineId;
+        out[count].timestampMs = record.timestampMs;
+        out[count].length = record.length;
+        memcpy(out[count].message, record.message, record.length + 1);
+        count++;
+
+        slot->sequence.store(current + CAPACITY, std::memory_order_release);
+    }
+    return count;
+}
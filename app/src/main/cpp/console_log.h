@@ -0,0 +1,73 @@
+#ifndef QUICKJS_ANDROID_CONSOLE_LOG_H
+#define QUICKJS_ANDROID_CONSOLE_LOG_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded lock-free ring of console records, shared by all engines
+//
+// Engines append from their own threads and Kotlin drains in batches; the
+// ring is a Vyukov bounded MPMC queue, so neither side ever blocks. When the
+// ring is full new records are dropped and counted rather than overwriting
+// records a drain may be reading.
+class ConsoleLog {
+public:
+    enum Level {
+        LEVEL_DEBUG = 0,
+        LEVEL_INFO = 1,   // console.log and console.info
+        LEVEL_WARN = 2,
+        LEVEL_ERROR = 3,
+        LEVEL_OFF = 4,
+    };
+
+    static constexpr size_t CAPACITY = 1024;         // Records, a power of two
+    static constexpr size_t MESSAGE_CAPACITY = 480;  // Bytes per message, including the NUL
+
+    struct Record {
+        int level;
+        int engineId;
+        int64_t timestampMs;  // Wall clock
+        uint32_t length;
+        char message[MESSAGE_CAPACITY];
+    };
+
+    ConsoleLog();
+
+    // Whether records at level are kept; checked before any formatting
+    bool isEnabled(int level) const {
+        return level >= minLevel.load(std::memory_order_relaxed);
+    }
+
+    void setMinLevel(int level) {
+        minLevel.store(level, std::memory_order_relaxed);
+    }
+
+    // Append a record, truncating the message to fit
+    // Returns false (and counts a drop) when the ring is full
+    bool append(int level, int engineId, int64_t timestampMs, const char *message, size_t length);
+
+    // Copy up to max records into out, oldest first; returns the number copied
+    size_t drain(Record *out, size_t max);
+
+    uint64_t droppedCount() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        Record record;
+    };
+
+    Slot *reserve(size_t *pos);
+    void publish(Slot *slot, size_t pos);
+
+    Slot slots[CAPACITY];
+    alignas(64) std::atomic<size_t> enqueuePos;
+    alignas(64) std::atomic<size_t> dequeuePos;
+    std::atomic<int> minLevel;
+    std::atomic<uint64_t> dropped;
+};
+
+#endif // QUICKJS_ANDROID_CONSOLE_LOG_H
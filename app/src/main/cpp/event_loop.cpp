@@ -0,0 +1,80 @@
+#include "event_loop.h"
+
+#include <future>
+
+#include "logging.h"
+
+EventLoop::EventLoop() : looper(nullptr), running(false) {
+}
+
+EventLoop::~EventLoop() {
+    stop();
+}
+
+bool EventLoop::start(JavaVM *vm) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running.load()) {
+        return true;
+    }
+
+    std::promise<ALooper *> ready;
+    std::future<ALooper *> readyLooper = ready.get_future();
+    running.store(true);
+    thread = std::thread([this, vm, &ready] {
+        ALooper *threadLooper = ALooper_prepare(0);
+        ALooper_acquire(threadLooper);
+        ready.set_value(threadLooper);
+        run(vm);
+        ALooper_release(threadLooper);
+    });
+    looper = readyLooper.get();
+    LOGI("Event loop started");
+    return true;
+}
+
+void EventLoop::stop() {
+    std::thread loopThread;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running.load()) {
+            return;
+        }
+        running.store(false);
+        ALooper_wake(looper);
+        looper = nullptr;
+        loopThread = std::move(thread);
+    }
+    loopThread.join();
+    LOGI("Event loop stopped");
+}
+
+bool EventLoop::addFd(int fd, ALooper_callbackFunc callback, void *data) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!looper) {
+        return false;
+    }
+    return ALooper_addFd(looper, fd, ALOOPER_POLL_CALLBACK, ALOOPER_EVENT_INPUT, callback, data) == 1;
+}
+
+void EventLoop::removeFd(int fd) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (looper) {
+        ALooper_removeFd(looper, fd);
+    }
+}
+
+void EventLoop::run(JavaVM *vm) {
+    // Callbacks deliver results to Kotlin, so the thread stays attached
+    JNIEnv *env = nullptr;
+    if (vm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+        LOGE("Event loop failed to attach to the JVM");
+    }
+
+    while (running.load()) {
+        ALooper_pollOnce(-1, nullptr, nullptr, nullptr);
+    }
+
+    if (env) {
+        vm->DetachCurrentThread();
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef QUICKJS_ANDROID_EVENT_LOOP_H
+#define QUICKJS_ANDROID_EVENT_LOOP_H
+
+#include <android/looper.h>
+#include <jni.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// Native thread running an ALooper, attached to the JVM
+//
+// Engines waiting on promises for async executions register their wake fd
+// here instead of parking a thread each; the loop sleeps in epoll until one
+// of them becomes readable and then runs its callback on the loop thread.
+class EventLoop {
+public:
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    // Start the loop thread; returns once its looper is ready
+    bool start(JavaVM *vm);
+
+    // Stop and join the loop thread; registered fds are dropped
+    void stop();
+
+    bool isRunning() const {
+        return running.load();
+    }
+
+    // Watch fd for input; callback runs on the loop thread with data
+    // Callable from any thread
+    bool addFd(int fd, ALooper_callbackFunc callback, void *data);
+
+    // Stop watching fd; callable from any thread, including its callback
+    void removeFd(int fd);
+
+private:
+    void run(JavaVM *vm);
+
+    std::mutex mutex;
+    std::thread thread;
+    ALooper *looper;
+    std::atomic<bool> running;
+};
+
+#endif // QUICKJS_ANDROID_EVENT_LOOP_H
@@ -0,0 +1,37 @@
+#include "execution_counters.h"
+
+ExecutionCounters::ExecutionCounters() : foldedAllocations(0), foldedBytes(0), foldedGcRuns(0) {
+    for (auto &value : values) {
+        value.store(0, std::memory_order_relaxed);
+    }
+}
+
+void ExecutionCounters::addAll(const ExecutionCounters &other) {
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        add(static_cast<Field>(i), other.values[i].load(std::memory_order_relaxed));
+    }
+}
+
+void ExecutionCounters::foldRuntime(JSRuntime *rt) {
+    uint64_t allocations = JS_GetMallocCallCount(rt);
+    uint64_t bytes = JS_GetMallocCallBytes(rt);
+    uint64_t gcRuns = JS_GetGCCount(rt);
+    add(ALLOCATIONS, static_cast<int64_t>(allocations - foldedAllocations));
+    add(ALLOCATED_BYTES, static_cast<int64_t>(bytes - foldedBytes));
+    add(GC_RUNS, static_cast<int64_t>(gcRuns - foldedGcRuns));
+    foldedAllocations = allocations;
+    foldedBytes = bytes;
+    foldedGcRuns = gcRuns;
+}
+
+void ExecutionCounters::startRuntime(JSRuntime *rt) {
+    foldedAllocations = JS_GetMallocCallCount(rt);
+    foldedBytes = JS_GetMallocCallBytes(rt);
+    foldedGcRuns = JS_GetGCCount(rt);
+}
+
+void ExecutionCounters::read(int64_t out[FIELD_COUNT]) const {
+    for (int i = 0; i < FIELD_COUNT; i++) {
+        out[i] = values[i].load(std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef QUICKJS_ANDROID_EXECUTION_COUNTERS_H
+#define QUICKJS_ANDROID_EXECUTION_COUNTERS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+extern "C" {
+#include "quickjs/quickjs.h"
+}
+
+// Running totals of the work one engine has done, mirrored by
+// QuickJSBridge.ExecutionMetrics
+//
+// Only the thread holding the engine's lease adds to them; the relaxed
+// atomics let the totals be read from any thread and cost no more than the
+// plain loads and stores they compile to. Timed phases nest: execute and
+// await time include the HTTP callouts made meanwhile.
+class ExecutionCounters {
+public:
+    enum Field {
+        COMPILE_NS,       // Parsing, compiling and reading bytecode
+        EXECUTE_NS,       // Running scripts and calls up to their first result
+        AWAIT_NS,         // Event loop: jobs, timers and completions until results settle
+        HTTP_NS,          // Inside JNI calls out to the HTTP service
+        JOBS_RUN,         // Promise jobs run
+        HTTP_CALLS,       // HTTP requests made
+        ALLOCATIONS,      // Runtime allocations and reallocations
+        ALLOCATED_BYTES,  // Bytes those asked for
+        GC_RUNS,          // Cycle collections, whoever triggered them
+        FIELD_COUNT
+    };
+
+    ExecutionCounters();
+
+    ExecutionCounters(const ExecutionCounters &) = delete;
+    ExecutionCounters &operator=(const ExecutionCounters &) = delete;
+
+    void add(Field field, int64_t amount) {
+        values[field].store(values[field].load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    // Add every total of other, as an arena engine's before it is discarded
+    void addAll(const ExecutionCounters &other);
+
+    // Bring the allocation and GC counts up to date with rt; requires the lease
+    void foldRuntime(JSRuntime *rt);
+
+    // Count rt's allocations and collections from now on only
+    void startRuntime(JSRuntime *rt);
+
+    void read(int64_t out[FIELD_COUNT]) const;
+
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    std::atomic<int64_t> values[FIELD_COUNT];
+
+    // Runtime counts already added, as of the last foldRuntime()
+    uint64_t foldedAllocations;
+    uint64_t foldedBytes;
+    uint64_t foldedGcRuns;
+};
+
+// Adds the time until it goes out of scope to one of the counters
+class PhaseTimer {
+public:
+    PhaseTimer(ExecutionCounters &counters, ExecutionCounters::Field field)
+        : counters(counters), field(field), start(ExecutionCounters::nowNs()) {
+    }
+
+    ~PhaseTimer() {
+        counters.add(field, ExecutionCounters::nowNs() - start);
+    }
+
+    PhaseTimer(const PhaseTimer &) = delete;
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+private:
+    ExecutionCounters &counters;
+    ExecutionCounters::Field field;
+    int64_t start;
+};
+
+#endif // QUICKJS_ANDROID_EXECUTION_COUNTERS_H
@@ -0,0 +1,323 @@
+#include "host_functions.h"
+
+#include <mutex>
+
+#include "logging.h"
+
+std::atomic<HostFunctions::Function *> HostFunctions::functions[HostFunctions::MAX_FUNCTIONS];
+std::atomic<int> HostFunctions::functionCount(0);
+
+namespace {
+
+// Guards registration; calls only read published functions
+std::mutex registrationMutex;
+JavaVM *javaVm = nullptr;
+jmethodID throwableToString = nullptr;
+jmethodID bufferLimit = nullptr;
+
+// Threads attached by threadEnv() are detached as they exit
+struct ThreadAttachment {
+    JavaVM *vm = nullptr;
+    JNIEnv *env = nullptr;
+
+    ~ThreadAttachment() {
+        if (vm) {
+            vm->DetachCurrentThread();
+        }
+    }
+};
+
+thread_local ThreadAttachment attachment;
+
+const char *jniTypeOf(char type, bool result) {
+    switch (type) {
+        case HostFunctions::TYPE_INT: return "I";
+        case HostFunctions::TYPE_DOUBLE: return "D";
+        case HostFunctions::TYPE_BOOLEAN: return "Z";
+        case HostFunctions::TYPE_STRING: return "Ljava/lang/String;";
+        case HostFunctions::TYPE_BYTE_BUFFER: return "Ljava/nio/ByteBuffer;";
+        case HostFunctions::TYPE_VOID: return result ? "V" : nullptr;
+        default: return nullptr;
+    }
+}
+
+// Describe and clear the pending Java exception
+std::string takeException(JNIEnv *env) {
+    jthrowable exception = env->ExceptionOccurred();
+    env->ExceptionClear();
+    std::string message = "Java exception";
+    if (exception && throwableToString) {
+        jstring description = static_cast<jstring>(env->CallObjectMethod(exception, throwableToString));
+        if (env->ExceptionCheck()) {
+            env->ExceptionClear();
+        } else if (description) {
+            const char *chars = env->GetStringUTFChars(description, nullptr);
+            if (chars) {
+                message = chars;
+                env->ReleaseStringUTFChars(description, chars);
+            }
+        }
+        if (description) {
+            env->DeleteLocalRef(description);
+        }
+    }
+    if (exception) {
+        env->DeleteLocalRef(exception);
+    }
+    return message;
+}
+
+// Bytes of an ArrayBuffer or typed array, in place
+bool bytesOf(JSContext *ctx, JSValueConst value, uint8_t **data, size_t *length) {
+    size_t offset, size, bytesPerElement;
+    JSValue buffer = JS_GetTypedArrayBuffer(ctx, value, &offset, &size, &bytesPerElement);
+    if (JS_IsException(buffer)) {
+        JS_FreeValue(ctx, JS_GetException(ctx));
+        *data = JS_GetArrayBuffer(ctx, length, value);
+        return *data != nullptr;
+    }
+    size_t bufferLength;
+    uint8_t *base = JS_GetArrayBuffer(ctx, &bufferLength, buffer);
+    JS_FreeValue(ctx, buffer);
+    if (!base) {
+        return false;
+    }
+    *data = base + offset;
+    *length = size;
+    return true;
+}
+
+} // namespace
+
+int HostFunctions::add(JNIEnv *env, const char *name, jobject receiver, const char *methodName,
+                       const char *signature) {
+    std::vector<Type> parameters;
+    const char *p = signature;
+    for (; *p && *p != ')'; p++) {
+        if (!jniTypeOf(*p, false)) {
+            break;
+        }
+        parameters.push_back(static_cast<Type>(*p));
+    }
+    if (*p != ')' || !jniTypeOf(p[1], true) || p[2] != '\0' || parameters.size() > MAX_PARAMETERS) {
+        LOGE("Invalid signature for host function %s: %s", name, signature);
+        return -1;
+    }
+    Type returns = static_cast<Type>(p[1]);
+
+    std::string jniSignature = "(";
+    for (Type type : parameters) {
+        jniSignature += jniTypeOf(type, false);
+    }
+    jniSignature += ")";
+    jniSignature += jniTypeOf(returns, true);
+
+    jclass receiverClass = env->GetObjectClass(receiver);
+    jmethodID method = env->GetMethodID(receiverClass, methodName, jniSignature.c_str());
+    env->DeleteLocalRef(receiverClass);
+    if (!method) {
+        env->ExceptionClear();
+        LOGE("Host function %s: no method %s%s", name, methodName, jniSignature.c_str());
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(registrationMutex);
+    int index = functionCount.load(std::memory_order_relaxed);
+    if (index >= MAX_FUNCTIONS) {
+        LOGE("Too many host functions, %s not registered", name);
+        return -1;
+    }
+    if (!javaVm) {
+        env->GetJavaVM(&javaVm);
+        jclass throwableClass = env->FindClass("java/lang/Throwable");
+        throwableToString = env->GetMethodID(throwableClass, "toString", "()Ljava/lang/String;");
+        env->DeleteLocalRef(throwableClass);
+        jclass bufferClass = env->FindClass("java/nio/Buffer");
+        bufferLimit = env->GetMethodID(bufferClass, "limit", "()I");
+        env->DeleteLocalRef(bufferClass);
+    }
+    functions[index].store(new Function{name, env->NewGlobalRef(receiver), method, parameters, returns},
+                           std::memory_order_relaxed);
+    functionCount.store(index + 1, std::memory_order_release);
+    LOGI("Registered host function %s as %s%s", name, methodName, jniSignature.c_str());
+    return index;
+}
+
+void HostFunctions::installAll(JSContext *ctx) {
+    int total = count();
+    for (int i = 0; i < total; i++) {
+        install(ctx, i);
+    }
+}
+
+bool HostFunctions::install(JSContext *ctx, int index) {
+    if (index < 0 || index >= count()) {
+        return false;
+    }
+    Function *function = functions[index].load(std::memory_order_relaxed);
+    JSValue global = JS_GetGlobalObject(ctx);
+    JSValue value = JS_NewCFunctionMagic(ctx, call, function->name.c_str(),
+                                         static_cast<int>(function->parameters.size()),
+                                         JS_CFUNC_generic_magic, index);
+    bool installed = JS_SetPropertyStr(ctx, global, function->name.c_str(), value) >= 0;
+    JS_FreeValue(ctx, global);
+    if (!installed) {
+        LOGE("Failed to define host function %s", function->name.c_str());
+        JS_FreeValue(ctx, JS_GetException(ctx));
+    }
+    return installed;
+}
+
+JNIEnv *HostFunctions::threadEnv(JavaVM *vm) {
+    if (attachment.env) {
+        return attachment.env;
+    }
+    JNIEnv *env = nullptr;
+    jint status = vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6);
+    if (status == JNI_OK) {
+        return env;  // Attached by its owner, which may detach it
+    }
+    if (status != JNI_EDETACHED || vm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+        return nullptr;
+    }
+    attachment.vm = vm;
+    attachment.env = env;
+    return env;
+}
+
+JSValue HostFunctions::call(JSContext *ctx, JSValueConst thisVal, int argc, JSValueConst *argv, int magic) {
+    // Installed only after being published, so the acquire in count() ordered it
+    Function *function = functions[magic].load(std::memory_order_relaxed);
+    const char *name = function->name.c_str();
+    JNIEnv *env = javaVm ? threadEnv(javaVm) : nullptr;
+    if (!env) {
+        return JS_ThrowInternalError(ctx, "%s: thread not attached to the JVM", name);
+    }
+
+    // Native threads run no Java frame that would release local references,
+    // so every reference made here is deleted before returning
+    size_t parameterCount = function->parameters.size();
+    jvalue args[MAX_PARAMETERS];
+    jobject references[MAX_PARAMETERS];
+    size_t referenceCount = 0;
+    bool converted = true;
+    for (size_t i = 0; i < parameterCount && converted; i++) {
+        JSValueConst arg = static_cast<int>(i) < argc ? argv[i] : JS_UNDEFINED;
+        switch (function->parameters[i]) {
+            case TYPE_INT:
+                converted = JS_ToInt32(ctx, &args[i].i, arg) == 0;
+                break;
+            case TYPE_DOUBLE:
+                converted = JS_ToFloat64(ctx, &args[i].d, arg) == 0;
+                break;
+            case TYPE_BOOLEAN: {
+                int truth = JS_ToBool(ctx, arg);
+                converted = truth >= 0;
+                args[i].z = truth > 0 ? JNI_TRUE : JNI_FALSE;
+                break;
+            }
+            case TYPE_STRING: {
+                args[i].l = nullptr;
+                if (JS_IsNull(arg) || JS_IsUndefined(arg)) {
+                    break;
+                }
+                const char *chars = JS_ToCString(ctx, arg);
+                if (!chars) {
+                    converted = false;
+                    break;
+                }
+                args[i].l = env->NewStringUTF(chars);
+                JS_FreeCString(ctx, chars);
+                if (!args[i].l) {
+                    env->ExceptionClear();
+                    JS_ThrowOutOfMemory(ctx);
+                    converted = false;
+                    break;
+                }
+                references[referenceCount++] = args[i].l;
+                break;
+            }
+            case TYPE_BYTE_BUFFER: {
+                args[i].l = nullptr;
+                if (JS_IsNull(arg) || JS_IsUndefined(arg)) {
+                    break;
+                }
+                uint8_t *data;
+                size_t length;
+                if (!bytesOf(ctx, arg, &data, &length)) {
+                    JS_FreeValue(ctx, JS_GetException(ctx));
+                    JS_ThrowTypeError(ctx, "%s: argument %zu must be an ArrayBuffer or typed array", name, i + 1);
+                    converted = false;
+                    break;
+                }
+                args[i].l = env->NewDirectByteBuffer(data, static_cast<jlong>(length));
+                if (!args[i].l) {
+                    env->ExceptionClear();
+                    JS_ThrowInternalError(ctx, "%s: cannot wrap argument %zu", name, i + 1);
+                    converted = false;
+                    break;
+                }
+                references[referenceCount++] = args[i].l;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    JSValue result = JS_EXCEPTION;
+    if (converted) {
+        jobject receiver = function->receiver;
+        jmethodID method = function->method;
+        jobject returned = nullptr;
+        switch (function->returns) {
+            case TYPE_VOID:
+                env->CallVoidMethodA(receiver, method, args);
+                result = JS_UNDEFINED;
+                break;
+            case TYPE_INT:
+                result = JS_NewInt32(ctx, env->CallIntMethodA(receiver, method, args));
+                break;
+            case TYPE_DOUBLE:
+                result = JS_NewFloat64(ctx, env->CallDoubleMethodA(receiver, method, args));
+                break;
+            case TYPE_BOOLEAN:
+                result = JS_NewBool(ctx, env->CallBooleanMethodA(receiver, method, args));
+                break;
+            default:
+                returned = env->CallObjectMethodA(receiver, method, args);
+                result = JS_NULL;
+                break;
+        }
+
+        if (env->ExceptionCheck()) {
+            std::string message = takeException(env);
+            result = JS_ThrowInternalError(ctx, "%s: %s", name, message.c_str());
+        } else if (returned && function->returns == TYPE_STRING) {
+            jstring string = static_cast<jstring>(returned);
+            const char *chars = env->GetStringUTFChars(string, nullptr);
+            result = chars ? JS_NewString(ctx, chars) : JS_ThrowOutOfMemory(ctx);
+            if (chars) {
+                env->ReleaseStringUTFChars(string, chars);
+            }
+        } else if (returned) {
+            // Copied, since the buffer is Kotlin's to reuse once the call returns
+            uint8_t *data = static_cast<uint8_t *>(env->GetDirectBufferAddress(returned));
+            jint limit = bufferLimit ? env->CallIntMethod(returned, bufferLimit) : 0;
+            if (!data || env->ExceptionCheck()) {
+                env->ExceptionClear();
+                result = JS_ThrowTypeError(ctx, "%s: returned a ByteBuffer that is not direct", name);
+            } else {
+                result = JS_NewArrayBufferCopy(ctx, data, static_cast<size_t>(limit));
+            }
+        }
+        if (returned) {
+            env->DeleteLocalRef(returned);
+        }
+    }
+
+    for (size_t i = 0; i < referenceCount; i++) {
+        env->DeleteLocalRef(references[i]);
+    }
+    return result;
+}
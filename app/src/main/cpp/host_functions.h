@@ -0,0 +1,75 @@
+#ifndef QUICKJS_ANDROID_HOST_FUNCTIONS_H
+#define QUICKJS_ANDROID_HOST_FUNCTIONS_H
+
+#include <jni.h>
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "quickjs/quickjs.h"
+}
+
+// Kotlin methods exposed to JavaScript as global functions with declared types
+//
+// A signature lists one type code per parameter, then ')' and the return
+// type, e.g. "ID)S" for (Int, Double) -> String. Arguments are converted
+// straight to JNI values and the method is called through its cached
+// jmethodID, so no call goes through JSON. Registrations are process-wide and
+// never removed; registering a name again installs a new function under it.
+class HostFunctions {
+public:
+    enum Type : char {
+        TYPE_VOID = 'V',         // Return type only
+        TYPE_INT = 'I',
+        TYPE_DOUBLE = 'D',
+        TYPE_BOOLEAN = 'Z',
+        TYPE_STRING = 'S',       // null and undefined pass as null
+        TYPE_BYTE_BUFFER = 'B',  // Direct buffer over an ArrayBuffer or view, valid during the call
+    };
+
+    static constexpr int MAX_FUNCTIONS = 256;
+    static constexpr int MAX_PARAMETERS = 16;
+
+    // Register receiver.methodName with the given signature
+    // Returns the function's index, or -1 (logged) if the method or signature is invalid
+    static int add(JNIEnv *env, const char *name, jobject receiver, const char *methodName,
+                   const char *signature);
+
+    // Define every registered function on ctx's global object
+    static void installAll(JSContext *ctx);
+
+    // Define one registered function on ctx's global object
+    static bool install(JSContext *ctx, int index);
+
+    // Global name of a registered function
+    static std::string name(int index) {
+        return functions[index].load(std::memory_order_relaxed)->name;
+    }
+
+    static int count() {
+        return functionCount.load(std::memory_order_acquire);
+    }
+
+    // JNIEnv of the calling thread, attaching it to the JVM for the rest of
+    // its life if it is not attached yet; nullptr if that fails
+    static JNIEnv *threadEnv(JavaVM *vm);
+
+private:
+    struct Function {
+        std::string name;
+        jobject receiver;  // Global reference
+        jmethodID method;
+        std::vector<Type> parameters;
+        Type returns;
+    };
+
+    static JSValue call(JSContext *ctx, JSValueConst thisVal, int argc, JSValueConst *argv, int magic);
+
+    static std::atomic<Function *> functions[MAX_FUNCTIONS];
+    static std::atomic<int> functionCount;
+};
+
+#endif // QUICKJS_ANDROID_HOST_FUNCTIONS_H
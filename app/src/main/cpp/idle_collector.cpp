@@ -0,0 +1,89 @@
+#include "idle_collector.h"
+
+#include <algorithm>
+
+#include "logging.h"
+
+IdleCollector::IdleCollector() : running(false) {
+}
+
+IdleCollector::~IdleCollector() {
+    stop();
+}
+
+bool IdleCollector::start(JavaVM *vm, CollectFunc collectFn) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        return true;
+    }
+    collect = std::move(collectFn);
+    running = true;
+    thread = std::thread([this, vm] {
+        run(vm);
+    });
+    return true;
+}
+
+void IdleCollector::stop() {
+    std::thread collectorThread;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+        due.clear();
+        collectorThread = std::move(thread);
+    }
+    wake.notify_all();
+    collectorThread.join();
+}
+
+void IdleCollector::schedule(int handle, int64_t delayMs) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        due[handle] = Clock::now() + std::chrono::milliseconds(delayMs);
+    }
+    wake.notify_all();
+}
+
+void IdleCollector::run(JavaVM *vm) {
+    JNIEnv *env = nullptr;
+    if (vm && vm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+        LOGE("Idle collector failed to attach to the JVM");
+        env = nullptr;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running) {
+        if (due.empty()) {
+            wake.wait(lock);
+            continue;
+        }
+        auto next = std::min_element(due.begin(), due.end(),
+                                     [](const std::pair<const int, Clock::time_point> &a,
+                                        const std::pair<const int, Clock::time_point> &b) {
+                                         return a.second < b.second;
+                                     });
+        if (Clock::now() < next->second) {
+            // By value: stop() clears the map while this waits
+            Clock::time_point deadline = next->second;
+            wake.wait_until(lock, deadline);
+            continue;  // Rescheduled, stopped or due
+        }
+        int handle = next->first;
+        due.erase(next);
+
+        lock.unlock();
+        collect(handle);
+        lock.lock();
+    }
+
+    lock.unlock();
+    if (env) {
+        vm->DetachCurrentThread();
+    }
+}
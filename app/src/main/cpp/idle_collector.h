@@ -0,0 +1,52 @@
+#ifndef QUICKJS_ANDROID_IDLE_COLLECTOR_H
+#define QUICKJS_ANDROID_IDLE_COLLECTOR_H
+
+#include <jni.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+// Native thread collecting garbage of engines between executions
+//
+// Engines handed back with enough garbage are scheduled here; once one has
+// gone a quiet period without being scheduled again, the collect callback
+// runs for it on the collector thread, which is attached to the JVM since
+// finalizers may release global references. The callback is expected to
+// skip engines that have been leased again in the meantime.
+class IdleCollector {
+public:
+    using CollectFunc = std::function<void(int handle)>;
+
+    IdleCollector();
+    ~IdleCollector();
+
+    IdleCollector(const IdleCollector &) = delete;
+    IdleCollector &operator=(const IdleCollector &) = delete;
+
+    bool start(JavaVM *vm, CollectFunc collect);
+
+    // Stop and join the collector thread; waits for a running collection
+    void stop();
+
+    // Collect the engine once delayMs pass without another schedule() for
+    // it; callable from any thread
+    void schedule(int handle, int64_t delayMs);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void run(JavaVM *vm);
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::thread thread;
+    std::map<int, Clock::time_point> due;  // By engine handle
+    CollectFunc collect;
+    bool running;
+};
+
+#endif // QUICKJS_ANDROID_IDLE_COLLECTOR_H
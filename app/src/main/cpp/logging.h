@@ -0,0 +1,18 @@
+#ifndef QUICKJS_ANDROID_LOGGING_H
+#define QUICKJS_ANDROID_LOGGING_H
+
+#include <android/log.h>
+#include <atomic>
+
+#define LOG_TAG "QuickJS"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+// Per-call tracing (scripts, results), off unless enabled from Kotlin
+extern std::atomic<bool> g_verboseLogging;
+#define LOGV(...) do { \
+        if (g_verboseLogging.load(std::memory_order_relaxed)) \
+            __android_log_print(ANDROID_LOG_VERBOSE, LOG_TAG, __VA_ARGS__); \
+    } while (0)
+
+#endif // QUICKJS_ANDROID_LOGGING_H
@@ -0,0 +1,51 @@
+#include "mapped_source.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logging.h"
+
+MappedSource *MappedSource::map(int fd, int64_t offset, int64_t length) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || offset < 0 || length < 0 || offset > st.st_size || length > st.st_size - offset) {
+        LOGE("Invalid script range: offset %lld, length %lld",
+             static_cast<long long>(offset), static_cast<long long>(length));
+        return nullptr;
+    }
+
+    // mmap offsets must be page aligned; assets usually are not
+    int64_t pageSize = sysconf(_SC_PAGESIZE);
+    int64_t alignedOffset = offset & ~(pageSize - 1);
+    size_t delta = static_cast<size_t>(offset - alignedOffset);
+    size_t fileLength = delta + static_cast<size_t>(length);
+    size_t mappingLength = (fileLength + 1 + pageSize - 1) & ~static_cast<size_t>(pageSize - 1);
+
+    // Pages past the end of a file fault instead of reading zeros, so the
+    // file goes over an anonymous reservation that covers the terminator
+    void *mapping = mmap(nullptr, mappingLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        LOGE("Failed to reserve script mapping: %s", strerror(errno));
+        return nullptr;
+    }
+    if (fileLength > 0 &&
+        mmap(mapping, fileLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, alignedOffset) == MAP_FAILED) {
+        LOGE("Failed to map script: %s", strerror(errno));
+        munmap(mapping, mappingLength);
+        return nullptr;
+    }
+
+    char *source = static_cast<char *>(mapping) + delta;
+    source[length] = '\0';
+    return new MappedSource(mapping, mappingLength, source, static_cast<size_t>(length));
+}
+
+MappedSource::MappedSource(void *mapping, size_t mappingLength, const char *source, size_t length)
+    : mapping(mapping), mappingLength(mappingLength), source(source), length(length) {
+}
+
+MappedSource::~MappedSource() {
+    munmap(mapping, mappingLength);
+}
@@ -0,0 +1,42 @@
+#ifndef QUICKJS_ANDROID_MAPPED_SOURCE_H
+#define QUICKJS_ANDROID_MAPPED_SOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// UTF-8 script source mapped from a file, followed by a NUL byte
+//
+// JS_Eval() needs the byte after the source to be zero. The range is mapped
+// copy-on-write over an anonymous reservation one byte longer, so the
+// terminator is written into memory of this process only: a private copy of
+// the last page, or the zero page after the end of the file. Nothing else of
+// the file is copied or read until the parser reaches it.
+class MappedSource {
+public:
+    // Map length bytes at offset in fd; fd may be closed afterwards
+    // Returns nullptr if the range is not inside the file or cannot be mapped
+    static MappedSource *map(int fd, int64_t offset, int64_t length);
+
+    ~MappedSource();
+
+    MappedSource(const MappedSource &) = delete;
+    MappedSource &operator=(const MappedSource &) = delete;
+
+    const char *data() const {
+        return source;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+private:
+    MappedSource(void *mapping, size_t mappingLength, const char *source, size_t length);
+
+    void *mapping;          // Page-aligned start of the reservation
+    size_t mappingLength;
+    const char *source;     // Start of the range inside the mapping
+    size_t length;
+};
+
+#endif // QUICKJS_ANDROID_MAPPED_SOURCE_H
@@ -0,0 +1,133 @@
+#include "microbench_runner.h"
+
+namespace {
+
+// Operations per allocation probe; large enough to amortize the call itself
+const int ALLOCATION_PROBE_COUNT = 100;
+
+// microbench.js runs main() as soon as it loads; an argument that matches no
+// case makes that first run return without benchmarking anything
+const char PRELUDE[] = "var scriptArgs = ['microbench', '\\u0000'];";
+
+} // namespace
+
+std::string MicrobenchRunner::run(JSContext *ctx, const std::string &source, const std::vector<std::string> &filters) {
+    JSValue loaded = JS_Eval(ctx, PRELUDE, sizeof(PRELUDE) - 1, "<microbench>", JS_EVAL_TYPE_GLOBAL);
+    if (!JS_IsException(loaded)) {
+        JS_FreeValue(ctx, loaded);
+        loaded = JS_Eval(ctx, source.c_str(), source.length(), "microbench.js", JS_EVAL_TYPE_GLOBAL);
+    }
+    if (JS_IsException(loaded)) {
+        return error(ctx);
+    }
+    JS_FreeValue(ctx, loaded);
+
+    JSValue global = JS_GetGlobalObject(ctx);
+    JSValue args = JS_NewArray(ctx);
+    JS_SetPropertyUint32(ctx, args, 0, JS_NewString(ctx, "microbench"));
+    for (size_t i = 0; i < filters.size(); i++) {
+        JS_SetPropertyUint32(ctx, args, i + 1, JS_NewStringLen(ctx, filters[i].data(), filters[i].length()));
+    }
+    JSValue mainArgs[] = {JS_NewInt32(ctx, static_cast<int32_t>(filters.size() + 1)), args, global};
+    JSValue main = JS_GetPropertyStr(ctx, global, "main");
+    JSValue status = JS_Call(ctx, main, JS_UNDEFINED, 3, mainArgs);
+    JS_FreeValue(ctx, main);
+    JS_FreeValue(ctx, args);
+    if (JS_IsException(status)) {
+        JS_FreeValue(ctx, global);
+        return error(ctx);
+    }
+    bool failed = JS_VALUE_GET_TAG(status) == JS_TAG_INT && JS_VALUE_GET_INT(status) != 0;
+    JS_FreeValue(ctx, status);
+    if (failed) {
+        JS_FreeValue(ctx, global);
+        return "{\"error\":\"Unknown microbench.js arguments\"}";
+    }
+
+    // log_data maps each timed case to its best ns per operation
+    JSValue timings = JS_GetPropertyStr(ctx, global, "log_data");
+    JSPropertyEnum *names = nullptr;
+    uint32_t count = 0;
+    if (!JS_IsObject(timings) ||
+        JS_GetOwnPropertyNames(ctx, &names, &count, timings, JS_GPN_STRING_MASK | JS_GPN_ENUM_ONLY) < 0) {
+        JS_FreeValue(ctx, timings);
+        JS_FreeValue(ctx, global);
+        return error(ctx);
+    }
+
+    JSValue benchmarks = JS_NewArray(ctx);
+    for (uint32_t i = 0; i < count; i++) {
+        JSValue entry = JS_NewObject(ctx);
+        JS_SetPropertyStr(ctx, entry, "name", JS_AtomToString(ctx, names[i].atom));
+        JS_SetPropertyStr(ctx, entry, "nsPerOp", JS_GetProperty(ctx, timings, names[i].atom));
+
+        JSValue function = JS_GetProperty(ctx, global, names[i].atom);
+        JSValue selfTimed = JS_GetPropertyStr(ctx, function, "bench");
+        double allocationsPerOp;
+        if (JS_IsFunction(ctx, function) && !JS_ToBool(ctx, selfTimed) &&
+            measureAllocations(ctx, function, &allocationsPerOp)) {
+            JS_SetPropertyStr(ctx, entry, "allocationsPerOp", JS_NewFloat64(ctx, allocationsPerOp));
+        } else {
+            JS_FreeValue(ctx, JS_GetException(ctx));
+            JS_SetPropertyStr(ctx, entry, "allocationsPerOp", JS_NULL);
+        }
+        JS_FreeValue(ctx, selfTimed);
+        JS_FreeValue(ctx, function);
+        JS_SetPropertyUint32(ctx, benchmarks, i, entry);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        JS_FreeAtom(ctx, names[i].atom);
+    }
+    js_free(ctx, names);
+    JS_FreeValue(ctx, timings);
+    JS_FreeValue(ctx, global);
+
+    JSValue report = JS_NewObject(ctx);
+    JS_SetPropertyStr(ctx, report, "engine", JS_NewString(ctx, "QuickJS " CONFIG_VERSION));
+    JS_SetPropertyStr(ctx, report, "benchmarks", benchmarks);
+    JSValue json = JS_JSONStringify(ctx, report, JS_UNDEFINED, JS_UNDEFINED);
+    JS_FreeValue(ctx, report);
+    if (JS_IsException(json)) {
+        return error(ctx);
+    }
+    const char *str = JS_ToCString(ctx, json);
+    std::string result = str ? str : "{\"error\":\"Out of memory\"}";
+    JS_FreeCString(ctx, str);
+    JS_FreeValue(ctx, json);
+    return result;
+}
+
+// Allocations per operation of one untimed call; case functions return their operation count
+bool MicrobenchRunner::measureAllocations(JSContext *ctx, JSValueConst function, double *allocationsPerOp) {
+    JSRuntime *rt = JS_GetRuntime(ctx);
+    JSValue arg = JS_NewInt32(ctx, ALLOCATION_PROBE_COUNT);
+    uint64_t before = JS_GetMallocCallCount(rt);
+    JSValue ops = JS_Call(ctx, function, JS_UNDEFINED, 1, &arg);
+    uint64_t after = JS_GetMallocCallCount(rt);
+    if (JS_IsException(ops)) {
+        return false;
+    }
+    double opCount;
+    int err = JS_ToFloat64(ctx, &opCount, ops);
+    JS_FreeValue(ctx, ops);
+    if (err || !(opCount > 0)) {
+        return false;
+    }
+    *allocationsPerOp = static_cast<double>(after - before) / opCount;
+    return true;
+}
+
+// The pending exception as an error report
+std::string MicrobenchRunner::error(JSContext *ctx) {
+    JSValue exception = JS_GetException(ctx);
+    JSValue report = JS_NewObject(ctx);
+    JS_SetPropertyStr(ctx, report, "error", JS_ToString(ctx, exception));
+    JS_FreeValue(ctx, exception);
+    JSValue json = JS_JSONStringify(ctx, report, JS_UNDEFINED, JS_UNDEFINED);
+    JS_FreeValue(ctx, report);
+    const char *str = JS_IsException(json) ? nullptr : JS_ToCString(ctx, json);
+    std::string result = str ? str : "{\"error\":\"Unknown error\"}";
+    JS_FreeCString(ctx, str);
+    JS_FreeValue(ctx, json);
+    return result;
+}
@@ -0,0 +1,32 @@
+#ifndef QUICKJS_ANDROID_MICROBENCH_RUNNER_H
+#define QUICKJS_ANDROID_MICROBENCH_RUNNER_H
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "quickjs/quickjs.h"
+}
+
+// Runs the cases of QuickJS's tests/microbench.js inside an engine context
+//
+// Timing is left to microbench.js itself (performance.now() based). Each
+// timed case is then called once more for a fixed count so its engine
+// allocations per operation can be read from JS_GetMallocCallCount().
+// The context is left full of benchmark globals and should be reset after.
+//
+// Results are JSON:
+//   {"engine": "...", "benchmarks": [{"name", "nsPerOp", "allocationsPerOp"}, ...]}
+// with allocationsPerOp null for self-timed cases such as sort_bench, or
+//   {"error": "..."} when microbench.js fails to load.
+class MicrobenchRunner {
+public:
+    // filters are microbench.js name prefixes; empty runs every case
+    static std::string run(JSContext *ctx, const std::string &source, const std::vector<std::string> &filters);
+
+private:
+    static bool measureAllocations(JSContext *ctx, JSValueConst function, double *allocationsPerOp);
+    static std::string error(JSContext *ctx);
+};
+
+#endif // QUICKJS_ANDROID_MICROBENCH_RUNNER_H
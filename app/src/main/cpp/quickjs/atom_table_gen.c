@@ -0,0 +1,116 @@
+/*
+ * Generator of quickjs-atom-table.h
+ *
+ * Lays out the predefined atoms of quickjs-atom.h as JS_InitAtoms()
+ * would register them one by one: hash of each atom, hash bucket heads
+ * and bucket chains. Run it on the host whenever quickjs-atom.h or the
+ * atom hash function changes:
+ *
+ *   cc -o atom_table_gen atom_table_gen.c
+ *   ./atom_table_gen > quickjs-atom-table.h
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+/* must match quickjs.c */
+#define JS_ATOM_HASH_MASK  ((1 << 30) - 1)
+#define JS_ATOM_HASH_PRIVATE JS_ATOM_HASH_MASK
+#define JS_ATOM_TYPE_STRING 1
+#define JS_ATOM_TYPE_SYMBOL 3
+#define JS_ATOM_TABLE_HASH_SIZE 256
+
+enum {
+    JS_ATOM_NULL,
+#define DEF(name, str) JS_ATOM_ ## name,
+#include "quickjs-atom.h"
+#undef DEF
+    JS_ATOM_END,
+};
+
+static const char *atom_names[JS_ATOM_END] = {
+    "",
+#define DEF(name, str) str,
+#include "quickjs-atom.h"
+#undef DEF
+};
+
+static const char *atom_ids[JS_ATOM_END] = {
+    "NULL",
+#define DEF(name, str) #name,
+#include "quickjs-atom.h"
+#undef DEF
+};
+
+static uint32_t hash_string8(const uint8_t *str, size_t len, uint32_t h)
+{
+    size_t i;
+
+    for(i = 0; i < len; i++)
+        h = h * 263 + str[i];
+    return h;
+}
+
+int main(void)
+{
+    uint32_t hash[JS_ATOM_END], hash_next[JS_ATOM_END];
+    uint32_t buckets[JS_ATOM_TABLE_HASH_SIZE];
+    uint32_t i, h1, str_size;
+    size_t len;
+
+    if (JS_ATOM_END - 1 >= 2 * JS_ATOM_TABLE_HASH_SIZE) {
+        /* JS_InitAtoms() would have resized the hash table */
+        fprintf(stderr, "JS_ATOM_TABLE_HASH_SIZE is too small\n");
+        return 1;
+    }
+    memset(buckets, 0, sizeof(buckets));
+    hash[0] = 0;
+    hash_next[0] = 0;
+    str_size = 8;
+    for(i = 1; i < JS_ATOM_END; i++) {
+        len = strlen(atom_names[i]);
+        if (len > 255) {
+            fprintf(stderr, "atom too long: %s\n", atom_names[i]);
+            return 1;
+        }
+        str_size += (len + 1 + 7) & ~7;
+        if (i == JS_ATOM_Private_brand) {
+            hash[i] = JS_ATOM_HASH_PRIVATE;
+            hash_next[i] = i;
+        } else if (i >= JS_ATOM_Symbol_toPrimitive) {
+            hash[i] = 0;
+            hash_next[i] = i;
+        } else {
+            hash[i] = hash_string8((const uint8_t *)atom_names[i], len,
+                                   JS_ATOM_TYPE_STRING) & JS_ATOM_HASH_MASK;
+            h1 = hash[i] & (JS_ATOM_TABLE_HASH_SIZE - 1);
+            hash_next[i] = buckets[h1];
+            buckets[h1] = i;
+        }
+    }
+
+    printf("/* Predefined atoms laid out as JS_InitAtoms() registers them.\n"
+           "   Automatically generated by atom_table_gen.c from quickjs-atom.h\n"
+           "   - do not edit */\n\n");
+    printf("#define JS_ATOM_TABLE_COUNT %u\n", (unsigned)JS_ATOM_END);
+    printf("#define JS_ATOM_TABLE_HASH_SIZE %u\n", JS_ATOM_TABLE_HASH_SIZE);
+    printf("/* size of the characters of all the atoms, 8 byte aligned */\n");
+    printf("#define JS_ATOM_TABLE_STR_SIZE %u\n\n", str_size);
+
+    printf("static const uint16_t js_atom_table_hash[JS_ATOM_TABLE_HASH_SIZE] = {");
+    for(i = 0; i < JS_ATOM_TABLE_HASH_SIZE; i++) {
+        if ((i % 12) == 0)
+            printf("\n   ");
+        printf(" %3u,", buckets[i]);
+    }
+    printf("\n};\n\n");
+
+    printf("static const JSAtomTableEntry js_atom_table[JS_ATOM_TABLE_COUNT] = {\n");
+    for(i = 0; i < JS_ATOM_END; i++) {
+        printf("    { 0x%08x, %3u, %2u }, /* %s */\n", hash[i], hash_next[i],
+               (unsigned)strlen(atom_names[i]), atom_ids[i]);
+    }
+    printf("};\n");
+    return 0;
+}
@@ -27,6 +27,11 @@
 #include <inttypes.h>
 #include <string.h>
 #include <assert.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "cutils.h"
 #include "libregexp.h"
@@ -105,8 +110,24 @@ static const REOpCode reopcode_info[REOP_COUNT] = {
 #define RE_HEADER_CAPTURE_COUNT 1
 #define RE_HEADER_STACK_SIZE    2
 #define RE_HEADER_BYTECODE_LEN  3
+#define RE_HEADER_SCAN_KIND     7
+#define RE_HEADER_SCAN_LEN      8
+
+#define RE_HEADER_LEN 9
+
+/* Where a match can start, computed by re_compute_scan(). The scan data
+   is stored after the bytecode, before the group names. */
+#define RE_SCAN_NONE     0
+#define RE_SCAN_ANCHORED 1 /* only at the start of the input */
+#define RE_SCAN_PREFIX   2 /* at a copy of the u16 chars of the scan data */
+#define RE_SCAN_SET      3 /* at a char in the scan data bitmap */
 
-#define RE_HEADER_LEN 7
+#define RE_SCAN_PREFIX_MAX 16
+/* bitmap of the Latin-1 chars, then non zero if all chars >= 0x100 match */
+#define RE_SCAN_SET_LEN    (32 + 1)
+
+/* loop emitted by lre_compile() to try every position if not sticky */
+#define RE_UNANCHORED_LOOP_LEN (5 + 1 + 5)
 
 static inline int is_digit(int c) {
     return c >= '0' && c <= '9';
@@ -206,11 +227,12 @@ static __maybe_unused void lre_dump_bytecode(const uint8_t *buf,
     re_flags = lre_get_flags(buf);
     bc_len = get_u32(buf + RE_HEADER_BYTECODE_LEN);
     assert(bc_len + RE_HEADER_LEN <= buf_len);
-    printf("flags: 0x%x capture_count=%d stack_size=%d\n",
-           re_flags, buf[RE_HEADER_CAPTURE_COUNT], buf[RE_HEADER_STACK_SIZE]);
+    printf("flags: 0x%x capture_count=%d stack_size=%d scan=%d\n",
+           re_flags, buf[RE_HEADER_CAPTURE_COUNT], buf[RE_HEADER_STACK_SIZE],
+           buf[RE_HEADER_SCAN_KIND]);
     if (re_flags & LRE_FLAG_NAMED_GROUPS) {
         const char *p;
-        p = (char *)buf + RE_HEADER_LEN + bc_len;
+        p = (char *)buf + RE_HEADER_LEN + bc_len + buf[RE_HEADER_SCAN_LEN];
         printf("named groups: ");
         for(i = 1; i < buf[RE_HEADER_CAPTURE_COUNT]; i++) {
             if (i != 1)
@@ -1719,6 +1741,145 @@ static int compute_stack_size(const uint8_t *bc_buf, int bc_buf_len)
     return stack_size_max;
 }
 
+/* Add the chars that can start a match of the opcode at 'p' to the
+   'set' bitmap. Return FALSE if it does not consume a char. */
+static BOOL re_get_first_chars(const uint8_t *p, uint8_t *set)
+{
+    uint32_t c, low, high;
+    int i, n;
+    BOOL is_range32;
+
+    switch(p[0]) {
+    case REOP_char:
+        c = get_u16(p + 1);
+        goto add_char;
+    case REOP_char32:
+        c = get_u32(p + 1);
+    add_char:
+        if (c >= 0x100)
+            set[32] = 1;
+        else
+            set[c >> 3] |= 1 << (c & 7);
+        return TRUE;
+    case REOP_range:
+    case REOP_range32:
+        is_range32 = (p[0] == REOP_range32);
+        n = get_u16(p + 1);
+        p += 3;
+        for(i = 0; i < n; i++) {
+            if (is_range32) {
+                low = get_u32(p + i * 8);
+                high = get_u32(p + i * 8 + 4);
+            } else {
+                low = get_u16(p + i * 4);
+                high = get_u16(p + i * 4 + 2);
+            }
+            if (high >= 0x100) {
+                set[32] = 1;
+                high = 0xff;
+            }
+            for(c = low; c <= high; c++)
+                set[c >> 3] |= 1 << (c & 7);
+        }
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+/* Record after the bytecode where a match can start, so that lre_exec()
+   can skip the positions where the body would fail at its first char
+   instead of stepping through the unanchored loop. Chars are compared
+   before case folding, so only anchoring is recorded with ignore_case. */
+static void re_compute_scan(REParseState *s)
+{
+    const uint8_t *bc;
+    uint8_t set[RE_SCAN_SET_LEN];
+    int pos, kind, n, i;
+    uint32_t c;
+
+    bc = s->byte_code.buf + RE_HEADER_LEN;
+    pos = RE_UNANCHORED_LOOP_LEN;
+    kind = RE_SCAN_NONE;
+    n = 0;
+    memset(set, 0, sizeof(set));
+    for(;;) {
+        switch(bc[pos]) {
+        case REOP_save_start:
+        case REOP_save_end:
+        case REOP_save_reset:
+            /* never fail nor consume chars */
+            pos += reopcode_info[bc[pos]].size;
+            continue;
+        case REOP_line_start:
+            if (n == 0 && !(s->re_flags & LRE_FLAG_MULTILINE))
+                kind = RE_SCAN_ANCHORED;
+            break;
+        case REOP_char:
+        case REOP_char32:
+            if (s->ignore_case)
+                break;
+            if (bc[pos] == REOP_char)
+                c = get_u16(bc + pos + 1);
+            else
+                c = get_u32(bc + pos + 1);
+            /* a prefix starting with a BMP char is never found in the middle
+               of a surrogate pair */
+            if (c > 0xffff || is_surrogate(c) || n == RE_SCAN_PREFIX_MAX)
+                break;
+            dbuf_put_u16(&s->byte_code, c);
+            n++;
+            bc = s->byte_code.buf + RE_HEADER_LEN;
+            pos += reopcode_info[bc[pos]].size;
+            continue;
+        case REOP_range:
+        case REOP_range32:
+            if (n == 0 && !s->ignore_case &&
+                re_get_first_chars(bc + pos, set))
+                kind = RE_SCAN_SET;
+            break;
+        case REOP_simple_greedy_quant:
+            /* the atom is matched at least once */
+            if (n == 0 && !s->ignore_case && get_u32(bc + pos + 5) != 0 &&
+                re_get_first_chars(bc + pos + 17, set))
+                kind = RE_SCAN_SET;
+            break;
+        default:
+            break;
+        }
+        break;
+    }
+
+    if (n != 0) {
+        kind = RE_SCAN_PREFIX;
+        i = n * 2;
+    } else if (kind == RE_SCAN_SET) {
+        /* a single Latin-1 char is faster to find as a prefix */
+        n = 0;
+        c = 0;
+        for(i = 0; i < 256; i++) {
+            if (set[i >> 3] & (1 << (i & 7))) {
+                c = i;
+                n++;
+            }
+        }
+        if (n == 1 && !set[32]) {
+            dbuf_put_u16(&s->byte_code, c);
+            kind = RE_SCAN_PREFIX;
+            i = 2;
+        } else {
+            dbuf_put(&s->byte_code, set, sizeof(set));
+            i = sizeof(set);
+        }
+    } else {
+        i = 0;
+    }
+    if (dbuf_error(&s->byte_code))
+        return;
+    s->byte_code.buf[RE_HEADER_SCAN_KIND] = kind;
+    s->byte_code.buf[RE_HEADER_SCAN_LEN] = i;
+}
+
 /* 'buf' must be a zero terminated UTF-8 string of length buf_len.
    Return NULL if error and allocate an error message in *perror_msg,
    otherwise the compiled bytecode and its length in plen.
@@ -1752,6 +1913,8 @@ uint8_t *lre_compile(int *plen, char *error_msg, int error_msg_size,
     dbuf_putc(&s->byte_code, 0); /* second element is the number of captures */
     dbuf_putc(&s->byte_code, 0); /* stack size */
     dbuf_put_u32(&s->byte_code, 0); /* bytecode length */
+    dbuf_putc(&s->byte_code, RE_SCAN_NONE); /* scan kind */
+    dbuf_putc(&s->byte_code, 0); /* scan data length */
 
     if (!is_sticky) {
         /* iterate thru all positions (about the same as .*?( ... ) )
@@ -1798,12 +1961,19 @@ uint8_t *lre_compile(int *plen, char *error_msg, int error_msg_size,
     put_u32(s->byte_code.buf + RE_HEADER_BYTECODE_LEN,
             s->byte_code.size - RE_HEADER_LEN);
 
+    if (!is_sticky)
+        re_compute_scan(s);
+
     /* add the named groups if needed */
     if (s->group_names.size > (s->capture_count - 1)) {
         dbuf_put(&s->byte_code, s->group_names.buf, s->group_names.size);
         s->byte_code.buf[RE_HEADER_FLAGS] |= LRE_FLAG_NAMED_GROUPS;
     }
     dbuf_free(&s->group_names);
+    if (dbuf_error(&s->byte_code)) {
+        re_parse_out_of_memory(s);
+        goto error;
+    }
 
 #ifdef DUMP_REOP
     lre_dump_bytecode(s->byte_code.buf, s->byte_code.size);
@@ -2410,6 +2580,116 @@ static intptr_t lre_exec_backtrack(REExecContext *s, uint8_t **capture,
     }
 }
 
+/* return the position of the first 'c' in buf[pos..end) or -1 */
+static int re_find_char16(const uint16_t *buf, int pos, int end, uint16_t c)
+{
+#if defined(__SSE2__)
+    __m128i v = _mm_set1_epi16(c);
+    while (end - pos >= 8) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(
+            _mm_loadu_si128((const __m128i *)(buf + pos)), v));
+        if (mask)
+            return pos + (ctz32(mask) >> 1);
+        pos += 8;
+    }
+#elif defined(__ARM_NEON)
+    uint16x8_t v = vdupq_n_u16(c);
+    while (end - pos >= 8) {
+        uint16x8_t eq = vceqq_u16(vld1q_u16(buf + pos), v);
+        /* one byte per lane */
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(eq, 4)), 0);
+        if (mask)
+            return pos + (ctz64(mask) >> 3);
+        pos += 8;
+    }
+#endif
+    for(; pos < end; pos++) {
+        if (buf[pos] == c)
+            return pos;
+    }
+    return -1;
+}
+
+/* return the first position >= pos where the scan data allows a match
+   to start, or -1 if there is none */
+static int re_scan_next(const uint8_t *cbuf, int shift, int pos, int clen,
+                        int kind, const uint8_t *scan, int scan_len)
+{
+    const uint16_t *buf16 = (const uint16_t *)cbuf;
+    const uint8_t *p;
+    int n, i, last;
+    uint32_t c;
+
+    if (kind == RE_SCAN_SET) {
+        for(; pos < clen; pos++) {
+            c = shift ? buf16[pos] : cbuf[pos];
+            if (c >= 0x100 ? scan[32] : (scan[c >> 3] >> (c & 7)) & 1)
+                return pos;
+        }
+        return -1;
+    }
+
+    n = scan_len / 2;
+    c = get_u16(scan);
+    last = clen - n;
+    if (!shift && c >= 0x100)
+        return -1;
+    while (pos <= last) {
+        if (shift) {
+            pos = re_find_char16(buf16, pos, last + 1, c);
+            if (pos < 0)
+                return -1;
+            for(i = 1; i < n && buf16[pos + i] == get_u16(scan + i * 2); i++)
+                continue;
+        } else {
+            p = memchr(cbuf + pos, c, last + 1 - pos);
+            if (!p)
+                return -1;
+            pos = p - cbuf;
+            for(i = 1; i < n && cbuf[pos + i] == get_u16(scan + i * 2); i++)
+                continue;
+        }
+        if (i == n)
+            return pos;
+        pos++;
+    }
+    return -1;
+}
+
+/* Run the body of a non-sticky regexp at each position where a match can
+   start. This is what the unanchored loop does, without stepping through
+   the positions where the body would fail at its first char. */
+static intptr_t lre_exec_scan(REExecContext *s, uint8_t **capture,
+                              StackInt *stack_buf, const uint8_t *bc_buf,
+                              int cindex, int clen, int shift)
+{
+    const uint8_t *pc, *scan;
+    int kind, scan_len, i;
+    intptr_t ret;
+
+    pc = bc_buf + RE_HEADER_LEN + RE_UNANCHORED_LOOP_LEN;
+    kind = bc_buf[RE_HEADER_SCAN_KIND];
+    if (kind == RE_SCAN_ANCHORED) {
+        if (cindex != 0)
+            return 0;
+        return lre_exec_backtrack(s, capture, stack_buf, 0, pc, s->cbuf, FALSE);
+    }
+    scan = bc_buf + RE_HEADER_LEN + get_u32(bc_buf + RE_HEADER_BYTECODE_LEN);
+    scan_len = bc_buf[RE_HEADER_SCAN_LEN];
+    for(;;) {
+        cindex = re_scan_next(s->cbuf, shift, cindex, clen, kind, scan, scan_len);
+        if (cindex < 0)
+            return 0;
+        ret = lre_exec_backtrack(s, capture, stack_buf, 0, pc,
+                                 s->cbuf + (cindex << shift), FALSE);
+        if (ret != 0)
+            return ret;
+        for(i = 0; i < s->capture_count * 2; i++)
+            capture[i] = NULL;
+        cindex++;
+    }
+}
+
 /* Return 1 if match, 0 if not match or < 0 if error (see LRE_RET_x). cindex is the
    starting position of the match and must be such as 0 <= cindex <=
    clen. */
@@ -2418,7 +2698,8 @@ int lre_exec(uint8_t **capture,
              int cbuf_type, void *opaque)
 {
     REExecContext s_s, *s = &s_s;
-    int re_flags, i, alloca_size, ret;
+    const uint8_t *scan;
+    int re_flags, i, alloca_size, ret, kind;
     StackInt *stack_buf;
 
     re_flags = lre_get_flags(bc_buf);
@@ -2446,8 +2727,21 @@ int lre_exec(uint8_t **capture,
         capture[i] = NULL;
     alloca_size = s->stack_size_max * sizeof(stack_buf[0]);
     stack_buf = alloca(alloca_size);
-    ret = lre_exec_backtrack(s, capture, stack_buf, 0, bc_buf + RE_HEADER_LEN,
-                             cbuf + (cindex << cbuf_type), FALSE);
+    kind = bc_buf[RE_HEADER_SCAN_KIND];
+    if (kind == RE_SCAN_SET && s->cbuf_type == 2) {
+        /* chars >= 0x100 include the second half of surrogate pairs,
+           where no match can start */
+        scan = bc_buf + RE_HEADER_LEN + get_u32(bc_buf + RE_HEADER_BYTECODE_LEN);
+        if (scan[32])
+            kind = RE_SCAN_NONE;
+    }
+    if (kind != RE_SCAN_NONE) {
+        ret = lre_exec_scan(s, capture, stack_buf, bc_buf, cindex, clen,
+                            cbuf_type);
+    } else {
+        ret = lre_exec_backtrack(s, capture, stack_buf, 0, bc_buf + RE_HEADER_LEN,
+                                 cbuf + (cindex << cbuf_type), FALSE);
+    }
     lre_realloc(s->opaque, s->state_stack, 0);
     return ret;
 }
@@ -2470,7 +2764,8 @@ const char *lre_get_groupnames(const uint8_t *bc_buf)
     if ((lre_get_flags(bc_buf) & LRE_FLAG_NAMED_GROUPS) == 0)
         return NULL;
     re_bytecode_len = get_u32(bc_buf + RE_HEADER_BYTECODE_LEN);
-    return (const char *)(bc_buf + RE_HEADER_LEN + re_bytecode_len);
+    return (const char *)(bc_buf + RE_HEADER_LEN + re_bytecode_len +
+                          bc_buf[RE_HEADER_SCAN_LEN]);
 }
 
 #ifdef TEST
@@ -0,0 +1,259 @@
+/* Predefined atoms laid out as JS_InitAtoms() registers them.
+   Automatically generated by atom_table_gen.c from quickjs-atom.h
+   - do not edit */
+
+#define JS_ATOM_TABLE_COUNT 223
+#define JS_ATOM_TABLE_HASH_SIZE 256
+/* size of the characters of all the atoms, 8 byte aligned */
+#define JS_ATOM_TABLE_STR_SIZE 2752
+
+static const uint16_t js_atom_table_hash[JS_ATOM_TABLE_HASH_SIZE] = {
+      0,  47,   0, 130,   0, 207,  52,  30, 106,   0, 195, 135,
+      0,   0,   0,  73,  53, 102, 208, 185,   0,   0,   0,   0,
+      0,   0, 181,   0,   0,   0,   0,   0,   0,  21,  24,   0,
+      0,   0,   0,   0,   0,   0, 117, 183,   0,   0,  99,   0,
+    201, 127,  43,   0,  54,   0,   0,   3,   0,   0, 146, 197,
+    112, 158,  35,   0, 200,   0, 165,   0,   0,  67,   0, 114,
+    179,  95, 192, 123,   0,   0, 125,   0,   0,   0,   0, 124,
+    182, 188, 171,  55,  17, 186,   0, 139, 203,  79,   0,   0,
+    122,   0, 194,   0, 145,  77,   0, 174,  98,   0,  84,   0,
+      0,   0,   0,  80,   0, 184,  25, 100,   0,   0,   4,   0,
+      0,   0,   2,   0,  81,   0,  13,  29,   0, 147, 141,  87,
+      0,  42,   0,   0,  16,   0,  31,   0, 205,   0,   0,   0,
+    115,  68,   0,   0,  97, 137,  96,   0,  66, 196,   0, 109,
+    143,   0, 204, 161,  75, 103,  36,   0,   0, 149,   0,  59,
+      0,  65,  88,   0,   9,  20,   0,  71,  38, 159, 199,   0,
+    168, 193,   0,   0, 131, 105,   0, 202,   0,  46, 116, 177,
+    178,   0,   0, 164,   0,  86, 189,   0,   0,   0, 154,   0,
+    150,  33,   0, 191,  49, 162, 136,   0, 108, 133, 111, 153,
+    180, 198, 163,   0, 173, 206,   0, 134,  83, 172,   0,  85,
+    190,  57, 129,   0, 119,  90, 155, 187,   0,   0, 138, 156,
+      0, 144,   0,  93,   0, 104,   0,  91, 152,   0, 176,   0,
+      0,  10,   0, 169,
+};
+
+static const JSAtomTableEntry js_atom_table[JS_ATOM_TABLE_COUNT] = {
+    { 0x00000000,   0,  0 }, /* NULL */
+    { 0x14ed0e88,   0,  4 }, /* null */
+    { 0x007f337a,   0,  5 }, /* false */
+    { 0x1b6b6737,   0,  4 }, /* true */
+    { 0x00017a76,   0,  2 }, /* if */
+    { 0x0b215eea,   0,  4 }, /* else */
+    { 0x1b081491,   0,  6 }, /* return */
+    { 0x01928306,   0,  3 }, /* var */
+    { 0x1b60cd07,   0,  4 }, /* this */
+    { 0x082273ac,   0,  6 }, /* delete */
+    { 0x1d9358fd,   0,  4 }, /* void */
+    { 0x0d2f15ea,   5,  6 }, /* typeof */
+    { 0x018a159f,   0,  3 }, /* new */
+    { 0x00017a7e,   0,  2 }, /* in */
+    { 0x1d1cf505,   0, 10 }, /* instanceof */
+    { 0x0001755c,   0,  2 }, /* do */
+    { 0x37f4cb88,   1,  5 }, /* while */
+    { 0x0181ae58,   0,  3 }, /* for */
+    { 0x1e3901ee,   0,  5 }, /* break */
+    { 0x1163f230,   0,  8 }, /* continue */
+    { 0x13bbdead,   0,  6 }, /* switch */
+    { 0x08ea9a21,   0,  4 }, /* case */
+    { 0x280b39e8,   0,  7 }, /* default */
+    { 0x207c1e45,   0,  5 }, /* throw */
+    { 0x01907822,   0,  3 }, /* try */
+    { 0x29056472,   0,  5 }, /* catch */
+    { 0x2426eafa,   0,  7 }, /* finally */
+    { 0x21bc22b1,   0,  8 }, /* function */
+    { 0x3d645ba2,   0,  8 }, /* debugger */
+    { 0x1ea2a37f,   0,  4 }, /* with */
+    { 0x34dec707,   8,  5 }, /* class */
+    { 0x382d3c8a,   0,  5 }, /* const */
+    { 0x0b237d62,   0,  4 }, /* enum */
+    { 0x2e50fdcd,   0,  6 }, /* export */
+    { 0x3f063ef8,   0,  7 }, /* extends */
+    { 0x0bc83d3e,   0,  6 }, /* import */
+    { 0x11671aa2,  28,  5 }, /* super */
+    { 0x06f7e4a9,   0, 10 }, /* implements */
+    { 0x292b2db0,   0,  9 }, /* interface */
+    { 0x0187f93a,   0,  3 }, /* let */
+    { 0x37b79c55,   0,  7 }, /* package */
+    { 0x2390faca,   0,  7 }, /* private */
+    { 0x07c5f985,   0,  9 }, /* protected */
+    { 0x2b062632,   0,  6 }, /* public */
+    { 0x338d11f7,   0,  6 }, /* static */
+    { 0x335cf1dc,   0,  5 }, /* yield */
+    { 0x067551bd,   0,  5 }, /* await */
+    { 0x00000001,   0,  0 }, /* empty_string */
+    { 0x06f8edf7,  44,  6 }, /* length */
+    { 0x08eba4d0,   0,  8 }, /* fileName */
+    { 0x0dd3569e,   0, 10 }, /* lineNumber */
+    { 0x0d6de4e0,   0, 12 }, /* columnNumber */
+    { 0x22bf0f06,   7,  7 }, /* message */
+    { 0x29068310,   0,  5 }, /* cause */
+    { 0x0177c634,   0,  6 }, /* errors */
+    { 0x1041af57,   0,  5 }, /* stack */
+    { 0x14d7f3b4,   0,  4 }, /* name */
+    { 0x15becee5,   0,  8 }, /* toString */
+    { 0x04732bf7,  48, 14 }, /* toLocaleString */
+    { 0x267a59a7,   0,  7 }, /* valueOf */
+    { 0x0b2bda5d,   0,  4 }, /* eval */
+    { 0x3dec1b59,   0,  9 }, /* prototype */
+    { 0x09c4a631,   0, 11 }, /* constructor */
+    { 0x266667aa,   0, 12 }, /* configurable */
+    { 0x2fbb9aa9,  37,  8 }, /* writable */
+    { 0x17b4c6a9,  64, 10 }, /* enumerable */
+    { 0x13358b98,   0,  5 }, /* value */
+    { 0x0182b245,  23,  3 }, /* get */
+    { 0x018f5c91,   6,  3 }, /* set */
+    { 0x000180a0,   0,  2 }, /* of */
+    { 0x3081320f,   0,  9 }, /* __proto__ */
+    { 0x3391bcaf,   0,  9 }, /* undefined */
+    { 0x07bea6aa,  63,  6 }, /* number */
+    { 0x31cc530f,  70,  7 }, /* boolean */
+    { 0x05f054ca,  41,  6 }, /* string */
+    { 0x11ddb2a0,  69,  6 }, /* object */
+    { 0x125607b1,  27,  6 }, /* symbol */
+    { 0x3c163065,   0,  7 }, /* integer */
+    { 0x3a1addd9,   0,  7 }, /* unknown */
+    { 0x3e06445d,  60,  9 }, /* arguments */
+    { 0x1be70b6f,   0,  6 }, /* callee */
+    { 0x1be70b7c,   0,  6 }, /* caller */
+    { 0x23a7f3d7,   0,  6 }, /* _eval_ */
+    { 0x09c808e0,  51,  5 }, /* _ret_ */
+    { 0x0e1a1f6a,   0,  5 }, /* _var_ */
+    { 0x2bec3ee3,   0,  9 }, /* _arg_var_ */
+    { 0x22b095c5,   0,  6 }, /* _with_ */
+    { 0x31867383,   0,  9 }, /* lastIndex */
+    { 0x134acfaa,  72,  6 }, /* target */
+    { 0x26116c31,  62,  5 }, /* index */
+    { 0x261e26e9,   0,  5 }, /* input */
+    { 0x3b4946f7,  58, 16 }, /* defineProperties */
+    { 0x3eee1b55,  40,  5 }, /* apply */
+    { 0x109064f3,   0,  4 }, /* join */
+    { 0x36683ba5,   0,  6 }, /* concat */
+    { 0x0bf70049,   0,  5 }, /* split */
+    { 0x2b4c5396,   0,  9 }, /* construct */
+    { 0x25300f94,   0, 14 }, /* getPrototypeOf */
+    { 0x11a7d668,   0, 14 }, /* setPrototypeOf */
+    { 0x3ec5152e,   0, 12 }, /* isExtensible */
+    { 0x12c48273,   0, 17 }, /* preventExtensions */
+    { 0x0183bc59,  61,  3 }, /* has */
+    { 0x3d2fe111,   0, 14 }, /* deleteProperty */
+    { 0x035ee5a1,   0, 14 }, /* defineProperty */
+    { 0x156a19f5,   0, 24 }, /* getOwnPropertyDescriptor */
+    { 0x027d54b9,   0,  7 }, /* ownKeys */
+    { 0x017c5c08,   0,  3 }, /* add */
+    { 0x0a0ef003,   0,  4 }, /* done */
+    { 0x14dc37d4,   0,  4 }, /* next */
+    { 0x3c02699b,   0,  6 }, /* values */
+    { 0x37618b54,   0,  6 }, /* source */
+    { 0x0c60ead6,   0,  5 }, /* flags */
+    { 0x3e4f2c3c,   0,  6 }, /* global */
+    { 0x33d69fcc,   0,  7 }, /* unicode */
+    { 0x018e4a47,   0,  3 }, /* raw */
+    { 0x0cee6f90,   0, 10 }, /* new_target */
+    { 0x18af09be,   0, 16 }, /* this_active_func */
+    { 0x0e95a32a,   0, 13 }, /* home_object */
+    { 0x338f9c0b,   0, 16 }, /* computed_field */
+    { 0x07de42e8,  22, 23 }, /* static_computed_field */
+    { 0x1d5715ea,  11, 19 }, /* class_fields_init */
+    { 0x0620bc12,   0,  7 }, /* brand */
+    { 0x0827e460,   0, 12 }, /* hash_constructor */
+    { 0x0001724b,   0,  2 }, /* as */
+    { 0x0c3d4453,   0,  4 }, /* from */
+    { 0x13c69f4e,   0,  4 }, /* meta */
+    { 0x026802b2,   0,  9 }, /* _default_ */
+    { 0x00000131,  89,  1 }, /* _star_ */
+    { 0x24d22895,   0,  6 }, /* Module */
+    { 0x1b60c8e6,   0,  4 }, /* then */
+    { 0x2199f503, 107,  7 }, /* resolve */
+    { 0x101f56b8,   0,  6 }, /* reject */
+    { 0x08db9482,   0,  7 }, /* promise */
+    { 0x36a332d5,   0,  5 }, /* proxy */
+    { 0x1d2ce0df,   0,  6 }, /* revoke */
+    { 0x02385a0b, 118,  5 }, /* async */
+    { 0x0b2dfad2,   0,  4 }, /* exec */
+    { 0x2d67a995, 128,  6 }, /* groups */
+    { 0x2db1f2ee,  18,  7 }, /* indices */
+    { 0x338d1e5b,   0,  6 }, /* status */
+    { 0x066bf2a5,  94,  6 }, /* reason */
+    { 0x2e0a4b82, 132, 10 }, /* globalThis */
+    { 0x083e08d8,   0,  6 }, /* bigint */
+    { 0x00013c9c,   0,  2 }, /* minus_zero */
+    { 0x22db7af1,   0,  8 }, /* Infinity */
+    { 0x13ee0c64,   0,  9 }, /* minus_Infinity */
+    { 0x01684b3a,  39,  3 }, /* NaN */
+    { 0x3753fe81,   0,  9 }, /* not_equal */
+    { 0x37ef57bf,   0,  9 }, /* timed_out */
+    { 0x000180a5, 140,  2 }, /* ok */
+    { 0x0035facc, 113,  6 }, /* toJSON */
+    { 0x1f38ddc0,   0,  6 }, /* Object */
+    { 0x1baea8f8,  34,  5 }, /* Array */
+    { 0x105c4cd7,  82,  5 }, /* Error */
+    { 0x1519d1ca,  74,  6 }, /* Number */
+    { 0x134b7fea, 120,  6 }, /* String */
+    { 0x2a75a0ef,   0,  7 }, /* Boolean */
+    { 0x1fb132d1,   0,  6 }, /* Symbol */
+    { 0x26906c3d,   0,  9 }, /* Arguments */
+    { 0x310fdbb1,  76,  4 }, /* Math */
+    { 0x2dc031e1,   0,  4 }, /* JSON */
+    { 0x274da49f,  12,  4 }, /* Date */
+    { 0x17ab23d1, 157,  8 }, /* Function */
+    { 0x01855bda,   0, 17 }, /* GeneratorFunction */
+    { 0x14ea15c3,   0, 13 }, /* ForInIterator */
+    { 0x1a181442,   0,  6 }, /* RegExp */
+    { 0x3be38340,   0, 11 }, /* ArrayBuffer */
+    { 0x139959eb,   0, 17 }, /* SharedArrayBuffer */
+    { 0x3eb01ab4,  56, 17 }, /* Uint8ClampedArray */
+    { 0x044405ff,   0,  9 }, /* Int8Array */
+    { 0x2662965c,  15, 10 }, /* Uint8Array */
+    { 0x31a1fa56,   0, 10 }, /* Int16Array */
+    { 0x3f0849e1, 160, 11 }, /* Uint16Array */
+    { 0x07c2cadc,  45, 10 }, /* Int32Array */
+    { 0x15291a67,   0, 11 }, /* Uint32Array */
+    { 0x2b6f8c3b,   0, 13 }, /* BigInt64Array */
+    { 0x2e172dfa,  26, 14 }, /* BigUint64Array */
+    { 0x39d999bf, 148, 12 }, /* Float32Array */
+    { 0x37b407c0, 151, 12 }, /* Float64Array */
+    { 0x19149548,   0,  8 }, /* DataView */
+    { 0x15776dd8, 142,  6 }, /* BigInt */
+    { 0x0be9da1a,   0,  7 }, /* WeakRef */
+    { 0x247ba554, 110, 20 }, /* FinalizationRegistry */
+    { 0x01673d2b,   0,  3 }, /* Map */
+    { 0x016d9671,   0,  3 }, /* Set */
+    { 0x0be48f13,   0,  7 }, /* WeakMap */
+    { 0x0beae859, 101,  7 }, /* WeakSet */
+    { 0x06eb2ceb, 167, 12 }, /* Map_Iterator */
+    { 0x10fb1f55,  92, 12 }, /* Set_Iterator */
+    { 0x288efac6,   0, 14 }, /* Array_Iterator */
+    { 0x2bdf27e4,   0, 15 }, /* String_Iterator */
+    { 0x3c617acf,   0, 22 }, /* RegExp_String_Iterator */
+    { 0x08b1234a,   0,  9 }, /* Generator */
+    { 0x113686b5,   0,  5 }, /* Proxy */
+    { 0x0184e262,  32,  7 }, /* Promise */
+    { 0x0971520a,   0, 22 }, /* PromiseResolveFunction */
+    { 0x3e403999,   0, 21 }, /* PromiseRejectFunction */
+    { 0x275c4d3b, 175, 13 }, /* AsyncFunction */
+    { 0x372b5bd9,  78, 20 }, /* AsyncFunctionResolve */
+    { 0x0e8041b2, 126, 19 }, /* AsyncFunctionReject */
+    { 0x3fc82840, 166, 22 }, /* AsyncGeneratorFunction */
+    { 0x27b2af30,  19, 14 }, /* AsyncGenerator */
+    { 0x20778ebb,   0,  9 }, /* EvalError */
+    { 0x12fdbe5c, 170, 10 }, /* RangeError */
+    { 0x22f79d9e,  50, 14 }, /* ReferenceError */
+    { 0x33bc728c,   0, 11 }, /* SyntaxError */
+    { 0x16c4f8dd,   0,  9 }, /* TypeError */
+    { 0x3e962805,  14,  8 }, /* URIError */
+    { 0x0d11fe12, 121, 13 }, /* InternalError */
+    { 0x3fffffff, 209,  7 }, /* Private_brand */
+    { 0x00000000, 210, 18 }, /* Symbol_toPrimitive */
+    { 0x00000000, 211, 15 }, /* Symbol_iterator */
+    { 0x00000000, 212, 12 }, /* Symbol_match */
+    { 0x00000000, 213, 15 }, /* Symbol_matchAll */
+    { 0x00000000, 214, 14 }, /* Symbol_replace */
+    { 0x00000000, 215, 13 }, /* Symbol_search */
+    { 0x00000000, 216, 12 }, /* Symbol_split */
+    { 0x00000000, 217, 18 }, /* Symbol_toStringTag */
+    { 0x00000000, 218, 25 }, /* Symbol_isConcatSpreadable */
+    { 0x00000000, 219, 18 }, /* Symbol_hasInstance */
+    { 0x00000000, 220, 14 }, /* Symbol_species */
+    { 0x00000000, 221, 18 }, /* Symbol_unscopables */
+    { 0x00000000, 222, 20 }, /* Symbol_asyncIterator */
+};
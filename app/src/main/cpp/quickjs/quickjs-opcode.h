@@ -260,6 +260,10 @@ DEF(             or, 1, 2, 1, none)
 DEF(is_undefined_or_null, 1, 1, 1, none)
 DEF(     private_in, 1, 2, 1, none)
 DEF(push_bigint_i32, 5, 0, 1, i32)
+/* object literal with static keys: the values of its leading properties
+   are on the stack and the constant pool entry at the u16 operand is a
+   template object with their final shape (see js_parse_object_literal()) */
+DEF(   object_shape, 5, 0, 1, npop_u16)
 /* must be the last non short and non temporary opcode */
 DEF(            nop, 1, 0, 0, none)
 
@@ -365,6 +369,24 @@ DEF(typeof_is_undefined, 1, 1, 1, none)
 DEF( typeof_is_function, 1, 1, 1, none)
 #endif
 
+/* property accesses through an inline cache, rewritten from get_field,
+   get_field2 and put_field once the bytecode is final (see
+   js_bytecode_init_ic()); the operand indexes JSFunctionBytecode.ic, which
+   holds the atom */
+DEF(   get_field_ic, 5, 1, 1, u32)
+DEF(  get_field2_ic, 5, 1, 2, u32)
+DEF(   put_field_ic, 5, 2, 0, u32)
+
+/* superinstructions, rewritten from the first opcode of the sequence they
+   run once the bytecode is final (see js_bytecode_fuse()). Each keeps the
+   size and format of that opcode, so the rest of the sequence stays in
+   place to be walked, jumped into and serialized; the interpreter runs the
+   whole sequence and skips it, or falls back to the first opcode alone.
+   The dispatch table has room for one more. */
+DEF(get_loc_check_add, 3, 0, 1, loc) /* get_loc_check a get_loc_check b add */
+DEF(    lt_if_false, 1, 2, 1, none) /* lt if_false8/if_false */
+DEF(get_field2_ic_call0, 5, 1, 2, u32) /* get_field2_ic call_method 0 */
+
 #undef DEF
 #undef def
 #endif  /* DEF */
@@ -39,6 +39,11 @@
 #elif defined(__FreeBSD__)
 #include <malloc_np.h>
 #endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "cutils.h"
 #include "list.h"
@@ -228,9 +233,25 @@ typedef enum {
 
 typedef enum OPCodeEnum OPCodeEnum;
 
+#define JS_REGEXP_CACHE_BITS 6
+#define JS_REGEXP_CACHE_SIZE (1 << JS_REGEXP_CACHE_BITS)
+
+/* compiled RegExp bytecode, see js_compile_regexp() */
+typedef struct JSRegExpCacheEntry {
+    JSString *pattern; /* NULL if the entry is free */
+    JSString *bytecode;
+    int re_flags;
+} JSRegExpCacheEntry;
+
 struct JSRuntime {
     JSMallocFunctions mf;
     JSMallocState malloc_state;
+    uint64_t malloc_call_count; /* js_malloc_rt() and js_realloc_rt() calls */
+    uint64_t malloc_call_bytes; /* bytes requested by those calls */
+    uint64_t gc_count; /* cycle collections run */
+    JSTraceBeginFunc *trace_begin; /* NULL if engine phases are not traced */
+    JSTraceEndFunc *trace_end;
+    void *trace_opaque;
     const char *rt_info;
 
     int atom_hash_size; /* power of two */
@@ -240,6 +261,7 @@ struct JSRuntime {
     uint32_t *atom_hash;
     JSAtomStruct **atom_array;
     int atom_free_index; /* 0 = none */
+    void *atom_init_storage; /* structures of the predefined atoms */
 
     int class_count;    /* size of class_array */
     JSClass *class_array;
@@ -253,6 +275,9 @@ struct JSRuntime {
     struct list_head tmp_obj_list; /* used during GC */
     JSGCPhaseEnum gc_phase : 8;
     size_t malloc_gc_threshold;
+    size_t gc_min_threshold; /* see JS_SetGCPolicy() */
+    size_t gc_max_threshold;
+    unsigned int gc_growth_percent;
     struct list_head weakref_list; /* list of JSWeakRefHeader.link */
 #ifdef DUMP_LEAKS
     struct list_head string_list; /* list of JSString.link */
@@ -293,6 +318,8 @@ struct JSRuntime {
     int shape_hash_size;
     int shape_hash_count; /* number of hashed shapes */
     JSShape **shape_hash;
+    /* direct mapped by pattern and flags */
+    JSRegExpCacheEntry regexp_cache[JS_REGEXP_CACHE_SIZE];
     void *user_opaque;
 };
 
@@ -600,6 +627,21 @@ typedef enum JSFunctionKindEnum {
     JS_FUNC_ASYNC_GENERATOR = (JS_FUNC_GENERATOR | JS_FUNC_ASYNC),
 } JSFunctionKindEnum;
 
+/* Inline cache of one get_field, get_field2 or put_field instruction:
+   the own data property of the atom was last found at these indexes of
+   objects with these shapes. Shapes are not referenced and only compared
+   by address; a hit is confirmed by the atom and flags of the cached
+   property, so a shape that was freed and reallocated, or modified in
+   place, cannot produce a wrong property. */
+#define JS_PROP_IC_WAYS 4
+
+typedef struct JSPropertyIC {
+    JSAtom atom;
+    uint32_t next_way; /* way replaced on the next miss */
+    JSShape *shapes[JS_PROP_IC_WAYS];
+    uint32_t prop_index[JS_PROP_IC_WAYS];
+} JSPropertyIC;
+
 typedef struct JSFunctionBytecode {
     JSGCObjectHeader header; /* must come first */
     uint8_t js_mode;
@@ -630,6 +672,8 @@ typedef struct JSFunctionBytecode {
     JSValue *cpool; /* constant pool (self pointer) */
     int cpool_count;
     int closure_var_count;
+    JSPropertyIC *ic; /* indexed by the operand of the *_field_ic opcodes */
+    int ic_count;
     struct {
         /* debug info, move to separate structure to save memory? */
         JSAtom filename;
@@ -896,6 +940,8 @@ struct JSShape {
     int deleted_prop_count;
     JSShape *shape_hash_next; /* in JSRuntime.shape_hash[h] list */
     JSObject *proto;
+    /* JSON.stringify() plan, only for hashed shapes (see js_json_get_plan()) */
+    struct JSJSONPlan *json_plan;
     JSShapeProperty prop[0]; /* prop_size elements */
 };
 
@@ -997,6 +1043,18 @@ static const char js_atom_init[] =
 #undef DEF
 ;
 
+typedef struct JSAtomTableEntry {
+    uint32_t hash;
+    uint16_t hash_next;
+    uint8_t len;
+} JSAtomTableEntry;
+
+#include "quickjs-atom-table.h"
+
+/* fails to compile if quickjs-atom-table.h was not regenerated after
+   quickjs-atom.h changed */
+typedef char js_atom_table_check[JS_ATOM_TABLE_COUNT == JS_ATOM_END ? 1 : -1];
+
 typedef enum OPCodeFormat {
 #define FMT(f) OP_FMT_ ## f,
 #define DEF(id, size, n_pop, n_push, f)
@@ -1208,6 +1266,8 @@ static JSValue js_promise_then(JSContext *ctx, JSValueConst this_val,
                                int argc, JSValueConst *argv);
 static int js_string_compare(JSContext *ctx,
                              const JSString *p1, const JSString *p2);
+static void js_TA_radix_sort32(uint32_t *a, uint32_t *tmp, size_t len);
+static void js_TA_radix_sort64(uint64_t *a, uint64_t *tmp, size_t len);
 static JSValue JS_ToNumber(JSContext *ctx, JSValueConst val);
 static int JS_SetPropertyValue(JSContext *ctx, JSValueConst this_obj,
                                JSValue prop, JSValue val, int flags);
@@ -1264,6 +1324,20 @@ static const JSClassExoticMethods js_proxy_exotic_methods;
 static const JSClassExoticMethods js_module_ns_exotic_methods;
 static JSClassID js_class_id_alloc = JS_CLASS_INIT_COUNT;
 
+/* return TRUE if a trace section was begun and must be ended */
+static inline BOOL js_trace_begin(JSRuntime *rt, const char *name)
+{
+    if (likely(!rt->trace_begin))
+        return FALSE;
+    return rt->trace_begin(rt->trace_opaque, name);
+}
+
+static inline void js_trace_end(JSRuntime *rt, BOOL traced)
+{
+    if (traced)
+        rt->trace_end(rt->trace_opaque);
+}
+
 static void js_trigger_gc(JSRuntime *rt, size_t size)
 {
     BOOL force_gc;
@@ -1278,9 +1352,15 @@ static void js_trigger_gc(JSRuntime *rt, size_t size)
         printf("GC: size=%" PRIu64 "\n",
                (uint64_t)rt->malloc_state.malloc_size);
 #endif
+        size_t live, threshold;
         JS_RunGC(rt);
-        rt->malloc_gc_threshold = rt->malloc_state.malloc_size +
-            (rt->malloc_state.malloc_size >> 1);
+        live = rt->malloc_state.malloc_size;
+        threshold = live + live / 100 * rt->gc_growth_percent;
+        if (threshold < rt->gc_min_threshold)
+            threshold = rt->gc_min_threshold;
+        if (threshold > rt->gc_max_threshold)
+            threshold = rt->gc_max_threshold;
+        rt->malloc_gc_threshold = threshold;
     }
 }
 
@@ -1291,6 +1371,8 @@ static size_t js_malloc_usable_size_unknown(const void *ptr)
 
 void *js_malloc_rt(JSRuntime *rt, size_t size)
 {
+    rt->malloc_call_count++;
+    rt->malloc_call_bytes += size;
     return rt->mf.js_malloc(&rt->malloc_state, size);
 }
 
@@ -1301,6 +1383,8 @@ void js_free_rt(JSRuntime *rt, void *ptr)
 
 void *js_realloc_rt(JSRuntime *rt, void *ptr, size_t size)
 {
+    rt->malloc_call_count++;
+    rt->malloc_call_bytes += size;
     return rt->mf.js_realloc(&rt->malloc_state, ptr, size);
 }
 
@@ -1552,6 +1636,8 @@ JSRuntime *JS_NewRuntime2(const JSMallocFunctions *mf, void *opaque)
     }
     rt->malloc_state = ms;
     rt->malloc_gc_threshold = 256 * 1024;
+    rt->gc_growth_percent = 50;
+    rt->gc_max_threshold = SIZE_MAX;
 
     init_list_head(&rt->context_list);
     init_list_head(&rt->gc_obj_list);
@@ -1699,6 +1785,42 @@ void JS_SetGCThreshold(JSRuntime *rt, size_t gc_threshold)
     rt->malloc_gc_threshold = gc_threshold;
 }
 
+void JS_SetGCPolicy(JSRuntime *rt, size_t min_threshold, unsigned int growth_percent,
+                    size_t max_threshold)
+{
+    rt->gc_min_threshold = min_threshold;
+    rt->gc_growth_percent = growth_percent;
+    rt->gc_max_threshold = max_threshold;
+}
+
+void JS_SetTraceFunctions(JSRuntime *rt, JSTraceBeginFunc *begin, JSTraceEndFunc *end,
+                          void *opaque)
+{
+    rt->trace_begin = begin;
+    rt->trace_end = end;
+    rt->trace_opaque = opaque;
+}
+
+size_t JS_GetMallocSize(JSRuntime *rt)
+{
+    return rt->malloc_state.malloc_size;
+}
+
+uint64_t JS_GetMallocCallCount(JSRuntime *rt)
+{
+    return rt->malloc_call_count;
+}
+
+uint64_t JS_GetMallocCallBytes(JSRuntime *rt)
+{
+    return rt->malloc_call_bytes;
+}
+
+uint64_t JS_GetGCCount(JSRuntime *rt)
+{
+    return rt->gc_count;
+}
+
 #define malloc(s) malloc_is_forbidden(s)
 #define free(p) free_is_forbidden(p)
 #define realloc(p,s) realloc_is_forbidden(p,s)
@@ -1868,6 +1990,8 @@ void JS_FreeRuntime(JSRuntime *rt)
     }
     init_list_head(&rt->job_list);
 
+    JS_FlushRegExpCache(rt);
+
     /* don't remove the weak objects to avoid create new jobs with
        FinalizationRegistry */
     JS_RunGCInternal(rt, FALSE);
@@ -1981,16 +2105,18 @@ void JS_FreeRuntime(JSRuntime *rt)
     }
 #endif
 
-    /* free the atoms */
+    /* free the atoms. The predefined ones are in atom_init_storage */
     for(i = 0; i < rt->atom_size; i++) {
         JSAtomStruct *p = rt->atom_array[i];
         if (!atom_is_free(p)) {
 #ifdef DUMP_LEAKS
             list_del(&p->link);
 #endif
-            js_free_rt(rt, p);
+            if (i >= JS_ATOM_END)
+                js_free_rt(rt, p);
         }
     }
+    js_free_rt(rt, rt->atom_init_storage);
     js_free_rt(rt, rt->atom_array);
     js_free_rt(rt, rt->atom_hash);
     js_free_rt(rt, rt->shape_hash);
@@ -2498,32 +2624,83 @@ static int JS_ResizeAtomHash(JSRuntime *rt, int new_hash_size)
     return 0;
 }
 
+/* The hashes and hash chains of the predefined atoms are computed at
+   build time (see atom_table_gen.c), so their structures are filled
+   in a single allocation instead of being hashed and registered one
+   by one. The result is the same as calling __JS_NewAtom() for each. */
 static int JS_InitAtoms(JSRuntime *rt)
 {
-    int i, len, atom_type;
-    const char *p;
+    const JSAtomTableEntry *e;
+    JSAtomStruct *p, **atom_array;
+    uint8_t *ptr;
+    const char *str;
+    int i, atom_size;
 
     rt->atom_hash_size = 0;
     rt->atom_hash = NULL;
     rt->atom_count = 0;
     rt->atom_size = 0;
     rt->atom_free_index = 0;
-    if (JS_ResizeAtomHash(rt, 256))     /* there are at least 195 predefined atoms */
+
+    rt->atom_hash = js_malloc_rt(rt, sizeof(rt->atom_hash[0]) *
+                                 JS_ATOM_TABLE_HASH_SIZE);
+    if (!rt->atom_hash)
+        return -1;
+    for(i = 0; i < JS_ATOM_TABLE_HASH_SIZE; i++)
+        rt->atom_hash[i] = js_atom_table_hash[i];
+    rt->atom_hash_size = JS_ATOM_TABLE_HASH_SIZE;
+    rt->atom_count_resize = JS_ATOM_COUNT_RESIZE(JS_ATOM_TABLE_HASH_SIZE);
+
+    /* same size progression as in __JS_NewAtom() */
+    atom_size = 211;
+    while (atom_size < JS_ATOM_END)
+        atom_size = atom_size * 3 / 2;
+    atom_array = js_malloc_rt(rt, sizeof(atom_array[0]) * atom_size);
+    if (!atom_array)
+        return -1;
+    rt->atom_array = atom_array;
+    ptr = js_malloc_rt(rt, sizeof(JSAtomStruct) * JS_ATOM_END +
+                       JS_ATOM_TABLE_STR_SIZE);
+    if (!ptr)
         return -1;
+    rt->atom_init_storage = ptr;
 
-    p = js_atom_init;
-    for(i = 1; i < JS_ATOM_END; i++) {
-        if (i == JS_ATOM_Private_brand)
-            atom_type = JS_ATOM_TYPE_PRIVATE;
-        else if (i >= JS_ATOM_Symbol_toPrimitive)
-            atom_type = JS_ATOM_TYPE_SYMBOL;
-        else
-            atom_type = JS_ATOM_TYPE_STRING;
-        len = strlen(p);
-        if (__JS_NewAtomInit(rt, p, len, atom_type) == JS_ATOM_NULL)
-            return -1;
-        p = p + len + 1;
+    str = js_atom_init;
+    for(i = 0; i < JS_ATOM_END; i++) {
+        e = &js_atom_table[i];
+        p = (JSAtomStruct *)ptr;
+        p->header.ref_count = 1;
+        p->len = e->len;
+        p->is_wide_char = 0;
+        p->hash = e->hash;
+        p->hash_next = e->hash_next;
+        if (i == JS_ATOM_NULL) {
+            p->atom_type = JS_ATOM_TYPE_SYMBOL;
+            p->u.str8[0] = '\0';
+        } else {
+            if (i == JS_ATOM_Private_brand || i >= JS_ATOM_Symbol_toPrimitive)
+                p->atom_type = JS_ATOM_TYPE_SYMBOL;
+            else
+                p->atom_type = JS_ATOM_TYPE_STRING;
+            memcpy(p->u.str8, str, e->len + 1);
+            str += e->len + 1;
+            assert(p->u.str8[e->len] == '\0');
+            assert(p->atom_type != JS_ATOM_TYPE_STRING ||
+                   p->hash == (hash_string(p, JS_ATOM_TYPE_STRING) &
+                               JS_ATOM_HASH_MASK));
+        }
+#ifdef DUMP_LEAKS
+        list_add_tail(&p->link, &rt->string_list);
+#endif
+        atom_array[i] = p;
+        ptr += sizeof(JSAtomStruct) + ((e->len + 1 + 7) & ~7);
+    }
+    for(i = JS_ATOM_END; i < atom_size; i++) {
+        atom_array[i] = atom_set_free(i == atom_size - 1 ? 0 : i + 1);
     }
+    rt->atom_free_index = JS_ATOM_END < atom_size ? JS_ATOM_END : 0;
+    rt->atom_size = atom_size;
+    rt->atom_count = JS_ATOM_END;
     return 0;
 }
 
@@ -3791,6 +3968,51 @@ static JSValue string_buffer_end(StringBuffer *s)
     return JS_MKPTR(JS_TAG_STRING, str);
 }
 
+/* Concatenate the strings or ropes tab[0..n-1], separated by 'sep' if
+   it is not NULL. The total length and width are computed first so
+   that the result is allocated once. The elements which are not
+   strings stand for empty strings. */
+static JSValue js_string_join_list(JSContext *ctx, const JSValue *tab,
+                                   uint32_t n, const JSString *sep)
+{
+    StringBuffer b_s, *b = &b_s;
+    int64_t len;
+    int is_wide;
+    uint32_t i;
+
+    len = 0;
+    is_wide = 0;
+    for(i = 0; i < n; i++) {
+        if (JS_VALUE_GET_TAG(tab[i]) == JS_TAG_STRING) {
+            JSString *p = JS_VALUE_GET_STRING(tab[i]);
+            len += p->len;
+            is_wide |= p->is_wide_char;
+        } else if (JS_VALUE_GET_TAG(tab[i]) == JS_TAG_STRING_ROPE) {
+            JSStringRope *r = JS_VALUE_GET_STRING_ROPE(tab[i]);
+            len += r->len;
+            is_wide |= r->is_wide_char;
+        }
+    }
+    if (sep && n > 1) {
+        len += (int64_t)sep->len * (n - 1);
+        is_wide |= sep->is_wide_char;
+    }
+    if (len > JS_STRING_LEN_MAX)
+        return JS_ThrowInternalError(ctx, "string too long");
+    if (len == 0)
+        return JS_AtomToString(ctx, JS_ATOM_empty_string);
+
+    string_buffer_init2(ctx, b, len, is_wide);
+    for(i = 0; i < n; i++) {
+        if (i > 0 && sep)
+            string_buffer_concat(b, sep, 0, sep->len);
+        if (JS_VALUE_GET_TAG(tab[i]) == JS_TAG_STRING ||
+            JS_VALUE_GET_TAG(tab[i]) == JS_TAG_STRING_ROPE)
+            string_buffer_concat_value(b, tab[i]);
+    }
+    return string_buffer_end(b);
+}
+
 /* create a string from a UTF-8 buffer */
 JSValue JS_NewStringLen(JSContext *ctx, const char *buf, size_t buf_len)
 {
@@ -4651,6 +4873,11 @@ static void js_shape_hash_unlink(JSRuntime *rt, JSShape *sh)
         psh = &(*psh)->shape_hash_next;
     *psh = sh->shape_hash_next;
     rt->shape_hash_count--;
+    /* the shape is about to change or be freed */
+    if (sh->json_plan) {
+        js_free_rt(rt, sh->json_plan);
+        sh->json_plan = NULL;
+    }
 }
 
 /* create a new empty shape with prototype 'proto' */
@@ -4686,6 +4913,7 @@ static no_inline JSShape *js_new_shape2(JSContext *ctx, JSObject *proto,
     sh->hash = shape_initial_hash(proto);
     sh->is_hashed = TRUE;
     sh->has_small_array_index = FALSE;
+    sh->json_plan = NULL;
     js_shape_hash_link(ctx->rt, sh);
     return sh;
 }
@@ -4717,6 +4945,7 @@ static JSShape *js_clone_shape(JSContext *ctx, JSShape *sh1)
     sh->header.ref_count = 1;
     add_gc_object(ctx->rt, &sh->header, JS_GC_OBJ_TYPE_SHAPE);
     sh->is_hashed = FALSE;
+    sh->json_plan = NULL;
     if (sh->proto) {
         JS_DupValue(ctx, JS_MKPTR(JS_TAG_OBJECT, sh->proto));
     }
@@ -6169,6 +6398,10 @@ static void gc_free_cycles(JSRuntime *rt)
 
 static void JS_RunGCInternal(JSRuntime *rt, BOOL remove_weak_objects)
 {
+    BOOL traced, traced_phase;
+
+    rt->gc_count++;
+    traced = js_trace_begin(rt, "JS_RunGC");
     if (remove_weak_objects) {
         /* free the weakly referenced object or symbol structures, delete
            the associated Map/Set entries and queue the finalization
@@ -6178,13 +6411,20 @@ static void JS_RunGCInternal(JSRuntime *rt, BOOL remove_weak_objects)
     
     /* decrement the reference of the children of each object. mark =
        1 after this pass. */
+    traced_phase = js_trace_begin(rt, "gc_decref");
     gc_decref(rt);
+    js_trace_end(rt, traced_phase);
 
     /* keep the GC objects with a non zero refcount and their childs */
+    traced_phase = js_trace_begin(rt, "gc_scan");
     gc_scan(rt);
+    js_trace_end(rt, traced_phase);
 
     /* free the GC objects in a cycle */
+    traced_phase = js_trace_begin(rt, "gc_free_cycles");
     gc_free_cycles(rt);
+    js_trace_end(rt, traced_phase);
+    js_trace_end(rt, traced);
 }
 
 void JS_RunGC(JSRuntime *rt)
@@ -6248,6 +6488,10 @@ static void compute_bytecode_size(JSFunctionBytecode *b, JSMemoryUsage_helper *h
     if (b->closure_var) {
         js_func_size += b->closure_var_count * sizeof(*b->closure_var);
     }
+    if (b->ic) {
+        memory_used_count++;
+        js_func_size += b->ic_count * sizeof(*b->ic);
+    }
     if (!b->read_only_bytecode && b->byte_code_buf) {
         hp->js_func_code_size += b->byte_code_len;
     }
@@ -6691,6 +6935,19 @@ JSValue JS_GetGlobalObject(JSContext *ctx)
     return JS_DupValue(ctx, ctx->global_obj);
 }
 
+JS_BOOL JS_HasGlobalLexicals(JSContext *ctx)
+{
+    JSObject *p = JS_VALUE_GET_OBJ(ctx->global_var_obj);
+    JSShapeProperty *pr;
+    uint32_t i;
+
+    for(i = 0, pr = get_shape_prop(p->shape); i < p->shape->prop_count; i++, pr++) {
+        if (pr->atom != JS_ATOM_NULL)
+            return TRUE;
+    }
+    return FALSE;
+}
+
 /* WARNING: obj is freed */
 JSValue JS_Throw(JSContext *ctx, JSValue obj)
 {
@@ -6938,6 +7195,41 @@ static void build_backtrace(JSContext *ctx, JSValueConst error_obj,
                            JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
 }
 
+int JS_VisitStackFrames(JSContext *ctx, JSStackFrameVisitor *visitor, void *opaque,
+                        int max_frames)
+{
+    JSStackFrame *sf;
+    char name_buf[ATOM_GET_STR_BUF_SIZE];
+    char filename_buf[ATOM_GET_STR_BUF_SIZE];
+    const char *name, *filename;
+    int n, line_num, col_num;
+
+    n = 0;
+    for(sf = ctx->rt->current_stack_frame; sf != NULL && n < max_frames; sf = sf->prev_frame) {
+        name = "";
+        filename = "";
+        line_num = 0;
+        if (JS_VALUE_GET_TAG(sf->cur_func) == JS_TAG_OBJECT) {
+            JSObject *p = JS_VALUE_GET_OBJ(sf->cur_func);
+            if (js_class_has_bytecode(p->class_id)) {
+                JSFunctionBytecode *b = p->u.func.function_bytecode;
+                if (b->func_name != JS_ATOM_NULL)
+                    name = JS_AtomGetStr(ctx, name_buf, sizeof(name_buf), b->func_name);
+                if (b->has_debug) {
+                    filename = JS_AtomGetStr(ctx, filename_buf, sizeof(filename_buf),
+                                             b->debug.filename);
+                    line_num = find_line_num(ctx, b, sf->cur_pc - b->byte_code_buf - 1, &col_num);
+                }
+            } else {
+                name = "(native)";
+            }
+        }
+        visitor(opaque, name, filename, line_num);
+        n++;
+    }
+    return n;
+}
+
 /* Note: it is important that no exception is returned by this function */
 static BOOL is_backtrace_needed(JSContext *ctx, JSValueConst obj)
 {
@@ -7189,6 +7481,20 @@ static inline __exception int js_poll_interrupts(JSContext *ctx)
     }
 }
 
+/* js_poll_interrupts() for interpreter branches: the current pc is saved
+   before the handler runs so that JS_VisitStackFrames() sees the line
+   being executed, without a store on the fast path */
+static inline __exception int js_poll_interrupts_pc(JSContext *ctx, JSStackFrame *sf,
+                                                    const uint8_t *pc)
+{
+    if (unlikely(--ctx->interrupt_counter <= 0)) {
+        sf->cur_pc = pc;
+        return __js_poll_interrupts(ctx);
+    } else {
+        return 0;
+    }
+}
+
 /* Return -1 (exception) or TRUE/FALSE. 'throw_flag' = FALSE indicates
    that it is called from Reflect.setPrototypeOf(). */
 static int JS_SetPrototypeInternal(JSContext *ctx, JSValueConst obj,
@@ -12512,6 +12818,45 @@ int JS_ToInt64Ext(JSContext *ctx, int64_t *pres, JSValueConst val)
 }
 
 /* return (<0, 0) in case of exception */
+/* ToInt32() of a number */
+static inline int32_t js_double_to_int32(double d)
+{
+    JSFloat64Union u;
+    int32_t ret;
+    int e;
+
+    u.d = d;
+    /* we avoid doing fmod(x, 2^32) */
+    e = (u.u64 >> 52) & 0x7ff;
+    if (likely(e <= (1023 + 30))) {
+        /* fast case */
+        ret = (int32_t)d;
+    } else if (e <= (1023 + 30 + 53)) {
+        uint64_t v;
+        /* remainder modulo 2^32 */
+        v = (u.u64 & (((uint64_t)1 << 52) - 1)) | ((uint64_t)1 << 52);
+        v = v << ((e - 1023) - 52 + 32);
+        ret = v >> 32;
+        /* take the sign into account */
+        if (u.u64 >> 63)
+            ret = -ret;
+    } else {
+        ret = 0; /* also handles NaN and +inf */
+    }
+    return ret;
+}
+
+/* ToUint8Clamp() of a number */
+static inline int js_double_to_uint8_clamp(double d)
+{
+    if (isnan(d) || d < 0)
+        return 0;
+    else if (d > 255)
+        return 255;
+    else
+        return lrint(d);
+}
+
 static int JS_ToInt32Free(JSContext *ctx, int32_t *pres, JSValue val)
 {
     uint32_t tag;
@@ -12527,30 +12872,7 @@ static int JS_ToInt32Free(JSContext *ctx, int32_t *pres, JSValue val)
         ret = JS_VALUE_GET_INT(val);
         break;
     case JS_TAG_FLOAT64:
-        {
-            JSFloat64Union u;
-            double d;
-            int e;
-            d = JS_VALUE_GET_FLOAT64(val);
-            u.d = d;
-            /* we avoid doing fmod(x, 2^32) */
-            e = (u.u64 >> 52) & 0x7ff;
-            if (likely(e <= (1023 + 30))) {
-                /* fast case */
-                ret = (int32_t)d;
-            } else if (e <= (1023 + 30 + 53)) {
-                uint64_t v;
-                /* remainder modulo 2^32 */
-                v = (u.u64 & (((uint64_t)1 << 52) - 1)) | ((uint64_t)1 << 52);
-                v = v << ((e - 1023) - 52 + 32);
-                ret = v >> 32;
-                /* take the sign into account */
-                if (u.u64 >> 63)
-                    ret = -ret;
-            } else {
-                ret = 0; /* also handles NaN and +inf */
-            }
-        }
+        ret = js_double_to_int32(JS_VALUE_GET_FLOAT64(val));
         break;
     default:
         val = JS_ToNumberFree(ctx, val);
@@ -12590,19 +12912,7 @@ static int JS_ToUint8ClampFree(JSContext *ctx, int32_t *pres, JSValue val)
         res = max_int(0, min_int(255, res));
         break;
     case JS_TAG_FLOAT64:
-        {
-            double d = JS_VALUE_GET_FLOAT64(val);
-            if (isnan(d)) {
-                res = 0;
-            } else {
-                if (d < 0)
-                    res = 0;
-                else if (d > 255)
-                    res = 255;
-                else
-                    res = lrint(d);
-            }
-        }
+        res = js_double_to_uint8_clamp(JS_VALUE_GET_FLOAT64(val));
         break;
     default:
         val = JS_ToNumberFree(ctx, val);
@@ -16145,6 +16455,137 @@ typedef enum {
 #define FUNC_RET_YIELD_STAR    2
 #define FUNC_RET_INITIAL_YIELD 3
 
+/* Create a plain object with the shape of the template, taking over the
+   n values of its properties, freed on failure */
+static JSValue js_create_object_from_template(JSContext *ctx, JSValueConst template,
+                                              JSValue *values, int n)
+{
+    JSShape *sh = JS_VALUE_GET_OBJ(template)->shape;
+    JSObject *p;
+    JSValue obj;
+    int i;
+
+    if (likely(sh->proto == JS_VALUE_GET_OBJ(ctx->class_proto[JS_CLASS_OBJECT]))) {
+        obj = JS_NewObjectFromShape(ctx, js_dup_shape(sh), JS_CLASS_OBJECT);
+        if (JS_IsException(obj))
+            goto fail;
+        p = JS_VALUE_GET_OBJ(obj);
+        for(i = 0; i < n; i++)
+            p->prop[i].u.value = values[i];
+        return obj;
+    }
+
+    /* template from another realm: define the properties one by one */
+    obj = JS_NewObject(ctx);
+    if (JS_IsException(obj))
+        goto fail;
+    for(i = 0; i < n; i++) {
+        if (JS_DefinePropertyValue(ctx, obj, get_shape_prop(sh)[i].atom, values[i],
+                                   JS_PROP_C_W_E | JS_PROP_THROW) < 0) {
+            JS_FreeValue(ctx, obj);
+            i++;
+            goto fail_from;
+        }
+    }
+    return obj;
+ fail:
+    i = 0;
+ fail_from:
+    for(; i < n; i++)
+        JS_FreeValue(ctx, values[i]);
+    return JS_EXCEPTION;
+}
+
+/* Return the index of the atom's own property in objects of shape sh
+   through the cache, or -1 on a miss */
+static force_inline int js_ic_find(JSPropertyIC *ic, JSShape *sh, int flag_mask,
+                                   int flags)
+{
+    JSShapeProperty *prs;
+    uint32_t idx;
+    int i;
+
+    for(i = 0; i < JS_PROP_IC_WAYS; i++) {
+        if (ic->shapes[i] == sh) {
+            idx = ic->prop_index[i];
+            if (likely(idx < sh->prop_count)) {
+                prs = &get_shape_prop(sh)[idx];
+                if (likely(prs->atom == ic->atom &&
+                           (prs->flags & flag_mask) == flags))
+                    return idx;
+            }
+            break;
+        }
+    }
+    return -1;
+}
+
+static void js_ic_update(JSPropertyIC *ic, JSShape *sh, uint32_t idx)
+{
+    int i;
+
+    for(i = 0; i < JS_PROP_IC_WAYS; i++) {
+        if (ic->shapes[i] == sh)
+            break;
+    }
+    if (i == JS_PROP_IC_WAYS) {
+        i = ic->next_way;
+        ic->next_way = (i + 1) % JS_PROP_IC_WAYS;
+    }
+    ic->shapes[i] = sh;
+    ic->prop_index[i] = idx;
+}
+
+/* JS_GetProperty() for get_field_ic and get_field2_ic */
+static force_inline JSValue js_get_field_ic(JSContext *ctx, JSPropertyIC *ic,
+                                            JSValueConst obj)
+{
+    if (likely(JS_VALUE_GET_TAG(obj) == JS_TAG_OBJECT)) {
+        JSObject *p = JS_VALUE_GET_OBJ(obj);
+        JSShapeProperty *prs;
+        JSProperty *pr;
+        int idx;
+
+        idx = js_ic_find(ic, p->shape, JS_PROP_TMASK, JS_PROP_NORMAL);
+        if (likely(idx >= 0))
+            return JS_DupValue(ctx, p->prop[idx].u.value);
+        prs = find_own_property(&pr, p, ic->atom);
+        if (prs && (prs->flags & JS_PROP_TMASK) == JS_PROP_NORMAL) {
+            js_ic_update(ic, p->shape, pr - p->prop);
+            return JS_DupValue(ctx, pr->u.value);
+        }
+    }
+    return JS_GetPropertyInternal(ctx, obj, ic->atom, obj, FALSE);
+}
+
+/* JS_SetPropertyInternal() with obj == this_obj for put_field_ic */
+static force_inline int js_put_field_ic(JSContext *ctx, JSPropertyIC *ic,
+                                        JSValueConst obj, JSValue val)
+{
+    const int flag_mask = JS_PROP_TMASK | JS_PROP_WRITABLE | JS_PROP_LENGTH;
+
+    if (likely(JS_VALUE_GET_TAG(obj) == JS_TAG_OBJECT)) {
+        JSObject *p = JS_VALUE_GET_OBJ(obj);
+        JSShapeProperty *prs;
+        JSProperty *pr;
+        int idx;
+
+        idx = js_ic_find(ic, p->shape, flag_mask, JS_PROP_WRITABLE);
+        if (likely(idx >= 0)) {
+            set_value(ctx, &p->prop[idx].u.value, val);
+            return TRUE;
+        }
+        prs = find_own_property(&pr, p, ic->atom);
+        if (prs && (prs->flags & flag_mask) == JS_PROP_WRITABLE) {
+            js_ic_update(ic, p->shape, pr - p->prop);
+            set_value(ctx, &pr->u.value, val);
+            return TRUE;
+        }
+    }
+    return JS_SetPropertyInternal(ctx, obj, ic->atom, val, obj,
+                                  JS_PROP_THROW_STRICT);
+}
+
 /* argv[] is modified if (flags & JS_CALL_FLAG_COPY_ARGV) = 0. */
 static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                                JSValueConst this_obj, JSValueConst new_target,
@@ -16371,6 +16812,20 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
             if (unlikely(JS_IsException(sp[-1])))
                 goto exception;
             BREAK;
+        CASE(OP_object_shape):
+            {
+                int n;
+                JSValue obj;
+                n = get_u16(pc);
+                obj = js_create_object_from_template(ctx, b->cpool[get_u16(pc + 2)],
+                                                     sp - n, n);
+                pc += 4;
+                sp -= n;
+                if (unlikely(JS_IsException(obj)))
+                    goto exception;
+                *sp++ = obj;
+            }
+            BREAK;
         CASE(OP_special_object):
             {
                 int arg = *pc++;
@@ -17156,6 +17611,7 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
             }
             BREAK;
         CASE(OP_get_loc_check):
+        get_loc_check_unfused:
             {
                 int idx;
                 idx = get_u16(pc);
@@ -17263,18 +17719,18 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
 
         CASE(OP_goto):
             pc += (int32_t)get_u32(pc);
-            if (unlikely(js_poll_interrupts(ctx)))
+            if (unlikely(js_poll_interrupts_pc(ctx, sf, pc)))
                 goto exception;
             BREAK;
 #if SHORT_OPCODES
         CASE(OP_goto16):
             pc += (int16_t)get_u16(pc);
-            if (unlikely(js_poll_interrupts(ctx)))
+            if (unlikely(js_poll_interrupts_pc(ctx, sf, pc)))
                 goto exception;
             BREAK;
         CASE(OP_goto8):
             pc += (int8_t)pc[0];
-            if (unlikely(js_poll_interrupts(ctx)))
+            if (unlikely(js_poll_interrupts_pc(ctx, sf, pc)))
                 goto exception;
             BREAK;
 #endif
@@ -17294,7 +17750,7 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                 if (res) {
                     pc += (int32_t)get_u32(pc - 4) - 4;
                 }
-                if (unlikely(js_poll_interrupts(ctx)))
+                if (unlikely(js_poll_interrupts_pc(ctx, sf, pc)))
                     goto exception;
             }
             BREAK;
@@ -17315,7 +17771,7 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                 if (!res) {
                     pc += (int32_t)get_u32(pc - 4) - 4;
                 }
-                if (unlikely(js_poll_interrupts(ctx)))
+                if (unlikely(js_poll_interrupts_pc(ctx, sf, pc)))
                     goto exception;
             }
             BREAK;
@@ -17336,7 +17792,7 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                 if (res) {
                     pc += (int8_t)pc[-1] - 1;
                 }
-                if (unlikely(js_poll_interrupts(ctx)))
+                if (unlikely(js_poll_interrupts_pc(ctx, sf, pc)))
                     goto exception;
             }
             BREAK;
@@ -17356,7 +17812,7 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
                 if (!res) {
                     pc += (int8_t)pc[-1] - 1;
                 }
-                if (unlikely(js_poll_interrupts(ctx)))
+                if (unlikely(js_poll_interrupts_pc(ctx, sf, pc)))
                     goto exception;
             }
             BREAK;
@@ -17594,6 +18050,136 @@ static JSValue JS_CallInternal(JSContext *caller_ctx, JSValueConst func_obj,
             }
             BREAK;
 
+        CASE(OP_get_field_ic):
+            {
+                JSValue val;
+                JSPropertyIC *ic;
+                ic = &b->ic[get_u32(pc)];
+                pc += 4;
+
+                sf->cur_pc = pc;
+                val = js_get_field_ic(ctx, ic, sp[-1]);
+                if (unlikely(JS_IsException(val)))
+                    goto exception;
+                JS_FreeValue(ctx, sp[-1]);
+                sp[-1] = val;
+            }
+            BREAK;
+
+        CASE(OP_get_field2_ic):
+            {
+                JSValue val;
+                JSPropertyIC *ic;
+                ic = &b->ic[get_u32(pc)];
+                pc += 4;
+
+                sf->cur_pc = pc;
+                val = js_get_field_ic(ctx, ic, sp[-1]);
+                if (unlikely(JS_IsException(val)))
+                    goto exception;
+                *sp++ = val;
+            }
+            BREAK;
+
+        CASE(OP_put_field_ic):
+            {
+                int ret;
+                JSPropertyIC *ic;
+                ic = &b->ic[get_u32(pc)];
+                pc += 4;
+                sf->cur_pc = pc;
+
+                ret = js_put_field_ic(ctx, ic, sp[-2], sp[-1]);
+                JS_FreeValue(ctx, sp[-2]);
+                sp -= 2;
+                if (unlikely(ret < 0))
+                    goto exception;
+            }
+            BREAK;
+
+            /* superinstructions: pc is past the first opcode of their
+               sequence, whose other opcodes follow unchanged */
+        CASE(OP_get_loc_check_add):
+            {
+                JSValue op1, op2;
+                op1 = var_buf[get_u16(pc)];
+                op2 = var_buf[get_u16(pc + 3)];
+                if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {
+                    int64_t r;
+                    r = (int64_t)JS_VALUE_GET_INT(op1) + JS_VALUE_GET_INT(op2);
+                    if (likely((int)r == r)) {
+                        *sp++ = JS_NewInt32(ctx, r);
+                        pc += 6;
+                        BREAK;
+                    }
+                } else if (JS_VALUE_IS_BOTH_FLOAT(op1, op2)) {
+                    *sp++ = __JS_NewFloat64(ctx, JS_VALUE_GET_FLOAT64(op1) +
+                                            JS_VALUE_GET_FLOAT64(op2));
+                    pc += 6;
+                    BREAK;
+                }
+                /* anything else, uninitialized variables included, runs
+                   the sequence one opcode at a time */
+                goto get_loc_check_unfused;
+            }
+        CASE(OP_lt_if_false):
+            {
+                JSValue op1, op2;
+                int res;
+                op1 = sp[-2];
+                op2 = sp[-1];
+                if (likely(JS_VALUE_IS_BOTH_INT(op1, op2))) {
+                    res = JS_VALUE_GET_INT(op1) < JS_VALUE_GET_INT(op2);
+                } else if (JS_VALUE_IS_BOTH_FLOAT(op1, op2)) {
+                    res = JS_VALUE_GET_FLOAT64(op1) < JS_VALUE_GET_FLOAT64(op2);
+                } else {
+                    /* the branch is left to the if_false that follows */
+                    sf->cur_pc = pc;
+                    if (js_relational_slow(ctx, sp, OP_lt))
+                        goto exception;
+                    sp--;
+                    BREAK;
+                }
+                sp -= 2;
+                if (*pc == OP_if_false8) {
+                    pc += 2;
+                    if (!res)
+                        pc += (int8_t)pc[-1] - 1;
+                } else {
+                    pc += 5;
+                    if (!res)
+                        pc += (int32_t)get_u32(pc - 4) - 4;
+                }
+                if (unlikely(js_poll_interrupts_pc(ctx, sf, pc)))
+                    goto exception;
+            }
+            BREAK;
+        CASE(OP_get_field2_ic_call0):
+            {
+                JSValue val;
+                JSPropertyIC *ic;
+                ic = &b->ic[get_u32(pc)];
+                pc += 4;
+
+                sf->cur_pc = pc;
+                val = js_get_field_ic(ctx, ic, sp[-1]);
+                if (unlikely(JS_IsException(val)))
+                    goto exception;
+                *sp++ = val;
+
+                /* call_method 0 */
+                pc += 3;
+                sf->cur_pc = pc;
+                ret_val = JS_CallInternal(ctx, val, sp[-2], JS_UNDEFINED, 0, sp, 0);
+                if (unlikely(JS_IsException(ret_val)))
+                    goto exception;
+                JS_FreeValue(ctx, sp[-1]);
+                JS_FreeValue(ctx, sp[-2]);
+                sp[-2] = ret_val;
+                sp--;
+            }
+            BREAK;
+
         CASE(OP_private_symbol):
             {
                 JSAtom atom;
@@ -22821,22 +23407,128 @@ static void set_object_name_computed(JSParseState *s)
     }
 }
 
+/* The leading properties of an object literal that have static keys and
+   plain values are evaluated before the object exists, then stored by
+   OP_object_shape into an object created with their final shape, instead
+   of each going through a shape transition. The first property that does
+   not fit ends the prefix: the object is created there and the remaining
+   properties are defined one by one. */
+#define OBJECT_SHAPE_MAX_PROPS 32
+
+typedef struct ObjectLiteralPrefix {
+    BOOL emitted; /* the object is on the stack */
+    int count;
+    int cpool_idx; /* template object, -1 until the first property */
+    JSAtom atoms[OBJECT_SHAPE_MAX_PROPS];
+} ObjectLiteralPrefix;
+
+/* Emit the creation of the object from the properties so far */
+static __exception int object_prefix_flush(JSParseState *s, ObjectLiteralPrefix *pf)
+{
+    JSValue template;
+    int i, ret;
+
+    if (pf->emitted)
+        return 0;
+    pf->emitted = TRUE;
+    if (pf->count == 0) {
+        emit_op(s, OP_object);
+        return 0;
+    }
+
+    ret = -1;
+    template = JS_NewObject(s->ctx);
+    if (JS_IsException(template))
+        goto done;
+    for(i = 0; i < pf->count; i++) {
+        if (JS_DefinePropertyValue(s->ctx, template, pf->atoms[i], JS_UNDEFINED,
+                                   JS_PROP_C_W_E | JS_PROP_THROW) < 0) {
+            JS_FreeValue(s->ctx, template);
+            goto done;
+        }
+    }
+    s->cur_func->cpool[pf->cpool_idx] = template;
+    emit_op(s, OP_object_shape);
+    emit_u16(s, pf->count);
+    emit_u16(s, pf->cpool_idx);
+    ret = 0;
+ done:
+    for(i = 0; i < pf->count; i++)
+        JS_FreeAtom(s->ctx, pf->atoms[i]);
+    pf->count = 0;
+    return ret;
+}
+
+/* Whether the property name at the current token emits no code */
+static BOOL object_prefix_static_key(JSParseState *s)
+{
+    int next;
+
+    if (token_is_pseudo_keyword(s, JS_ATOM_get) ||
+        token_is_pseudo_keyword(s, JS_ATOM_set) ||
+        token_is_pseudo_keyword(s, JS_ATOM_async)) {
+        /* get [expr]() and the like */
+        next = peek_token(s, FALSE);
+        return next != '[' && next != '*';
+    }
+    return token_is_ident(s->token.val) || s->token.val == TOK_STRING ||
+        s->token.val == TOK_NUMBER;
+}
+
+/* Take the property into the prefix, which then owns name. Return 1 if
+   taken, 0 if the object was created instead, -1 on error */
+static int object_prefix_add(JSParseState *s, ObjectLiteralPrefix *pf,
+                             int prop_type, JSAtom name)
+{
+    int i;
+
+    if (pf->emitted)
+        return 0;
+    if (!(prop_type == PROP_TYPE_VAR ||
+          (prop_type == PROP_TYPE_IDENT && s->token.val == ':')) ||
+        name == JS_ATOM_NULL || name == JS_ATOM___proto__ ||
+        __JS_AtomIsTaggedInt(name) || pf->count == OBJECT_SHAPE_MAX_PROPS)
+        goto flush;
+    for(i = 0; i < pf->count; i++) {
+        if (pf->atoms[i] == name)
+            goto flush;
+    }
+    if (pf->cpool_idx < 0) {
+        pf->cpool_idx = cpool_add(s, JS_UNDEFINED);
+        if (pf->cpool_idx < 0)
+            return -1;
+        if (pf->cpool_idx > 0xffff)
+            goto flush;
+    }
+    pf->atoms[pf->count++] = name;
+    return 1;
+ flush:
+    return object_prefix_flush(s, pf);
+}
+
 static __exception int js_parse_object_literal(JSParseState *s)
 {
     JSAtom name = JS_ATOM_NULL;
     const uint8_t *start_ptr;
-    int prop_type;
+    int prop_type, ret;
     BOOL has_proto;
+    ObjectLiteralPrefix pf;
 
+    pf.emitted = FALSE;
+    pf.count = 0;
+    pf.cpool_idx = -1;
     if (next_token(s))
         goto fail;
-    /* XXX: add an initial length that will be patched back */
-    emit_op(s, OP_object);
     has_proto = FALSE;
     while (s->token.val != '}') {
         /* specific case for getter/setter */
         start_ptr = s->token.ptr;
 
+        if (!pf.emitted && !object_prefix_static_key(s)) {
+            if (object_prefix_flush(s, &pf))
+                goto fail;
+        }
+
         if (s->token.val == TOK_ELLIPSIS) {
             if (next_token(s))
                 return -1;
@@ -22854,6 +23546,25 @@ static __exception int js_parse_object_literal(JSParseState *s)
         if (prop_type < 0)
             goto fail;
 
+        ret = object_prefix_add(s, &pf, prop_type, name);
+        if (ret < 0)
+            goto fail;
+        if (ret) {
+            /* only the value: OP_object_shape stores it */
+            if (prop_type == PROP_TYPE_VAR) {
+                emit_op(s, OP_scope_get_var);
+                emit_atom(s, name);
+                emit_u16(s, s->cur_func->scope_level);
+            } else {
+                if (js_parse_expect(s, ':'))
+                    goto fail_prefix;
+                if (js_parse_assign_expr(s))
+                    goto fail_prefix;
+                set_object_name(s, name);
+            }
+            goto next;
+        }
+
         if (prop_type == PROP_TYPE_VAR) {
             /* shortcut for x: x */
             emit_op(s, OP_scope_get_var);
@@ -22930,11 +23641,16 @@ static __exception int js_parse_object_literal(JSParseState *s)
         if (next_token(s))
             goto fail;
     }
+    if (object_prefix_flush(s, &pf))
+        goto fail;
     if (js_parse_expect(s, '}'))
         goto fail;
     return 0;
  fail:
     JS_FreeAtom(s->ctx, name);
+ fail_prefix:
+    for(ret = 0; ret < pf.count; ret++)
+        JS_FreeAtom(s->ctx, pf.atoms[ret]);
     return -1;
 }
 
@@ -32964,6 +33680,15 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
                     if (line2 >= 0) line_num = line2;
                     break;
                 }
+                /* Transformation: dup put_loc_check(n) drop -> put_loc_check(n) */
+                if (code_match(&cc, pos_next, OP_put_loc_check, -1, OP_drop, -1)) {
+                    if (cc.line_num >= 0) line_num = cc.line_num;
+                    add_pc2line_info(s, bc_out.size, line_num);
+                    dbuf_putc(&bc_out, OP_put_loc_check);
+                    dbuf_put_u16(&bc_out, cc.idx);
+                    pos_next = cc.pos;
+                    break;
+                }
             }
             goto no_change;
 
@@ -33097,6 +33822,16 @@ static __exception int resolve_labels(JSContext *ctx, JSFunctionDef *s)
                     put_short_code(&bc_out, op1, idx);
                     break;
                 }
+                /* transformation: post_inc put_loc_check(n) drop -> inc put_loc_check(n) */
+                if (code_match(&cc, pos_next, OP_put_loc_check, -1, OP_drop, -1)) {
+                    if (cc.line_num >= 0) line_num = cc.line_num;
+                    add_pc2line_info(s, bc_out.size, line_num);
+                    dbuf_putc(&bc_out, OP_dec + (op - OP_post_dec));
+                    dbuf_putc(&bc_out, OP_put_loc_check);
+                    dbuf_put_u16(&bc_out, cc.idx);
+                    pos_next = cc.pos;
+                    break;
+                }
                 if (code_match(&cc, pos_next, OP_perm3, M2(OP_put_field, OP_put_var_strict), OP_drop, -1)) {
                     if (cc.line_num >= 0) line_num = cc.line_num;
                     add_pc2line_info(s, bc_out.size, line_num);
@@ -33563,6 +34298,97 @@ static int add_module_variables(JSContext *ctx, JSFunctionDef *fd)
 /* create a function object from a function definition. The function
    definition is freed. All the child functions are also created. It
    must be done this way to resolve all the variables. */
+/* Rewrite the property accesses of final bytecode to go through inline
+   caches, which take over their atoms. Without memory for the caches the
+   bytecode is left as is. */
+static void js_bytecode_init_ic(JSRuntime *rt, JSFunctionBytecode *b)
+{
+    uint8_t *bc_buf = b->byte_code_buf;
+    int pos, len, op, count;
+    JSPropertyIC *ic;
+
+    if (b->read_only_bytecode)
+        return;
+    count = 0;
+    for(pos = 0; pos < b->byte_code_len; pos += len) {
+        op = bc_buf[pos];
+        len = short_opcode_info(op).size;
+        if (op == OP_get_field || op == OP_get_field2 || op == OP_put_field)
+            count++;
+    }
+    if (count == 0)
+        return;
+    ic = js_mallocz_rt(rt, count * sizeof(*ic));
+    if (!ic)
+        return;
+
+    count = 0;
+    for(pos = 0; pos < b->byte_code_len; pos += len) {
+        op = bc_buf[pos];
+        len = short_opcode_info(op).size;
+        if (op == OP_get_field || op == OP_get_field2 || op == OP_put_field) {
+            bc_buf[pos] = op - OP_get_field + OP_get_field_ic;
+            ic[count].atom = get_u32(bc_buf + pos + 1);
+            put_u32(bc_buf + pos + 1, count);
+            count++;
+        }
+    }
+    b->ic = ic;
+    b->ic_count = count;
+}
+
+/* Opcode a superinstruction was rewritten from, or 'op' itself */
+static int js_unfused_opcode(int op)
+{
+    switch(op) {
+    case OP_get_loc_check_add:
+        return OP_get_loc_check;
+    case OP_lt_if_false:
+        return OP_lt;
+    case OP_get_field2_ic_call0:
+        return OP_get_field2_ic;
+    default:
+        return op;
+    }
+}
+
+/* Rewrite the first opcode of common sequences in final bytecode to the
+   superinstruction running them. Only that byte changes, so jumps into
+   the sequence still find the rest of it. Done after
+   js_bytecode_init_ic(), whose opcodes it fuses. */
+static void js_bytecode_fuse(JSFunctionBytecode *b)
+{
+    uint8_t *bc_buf = b->byte_code_buf;
+    int pos, len, op, end;
+
+    if (b->read_only_bytecode)
+        return;
+    end = b->byte_code_len;
+    for(pos = 0; pos < end; pos += len) {
+        op = bc_buf[pos];
+        len = short_opcode_info(op).size;
+        switch(op) {
+        case OP_get_loc_check:
+            if (pos + 7 <= end && bc_buf[pos + 3] == OP_get_loc_check &&
+                bc_buf[pos + 6] == OP_add)
+                bc_buf[pos] = OP_get_loc_check_add;
+            break;
+        case OP_lt:
+            if (pos + 2 <= end && (bc_buf[pos + 1] == OP_if_false8 ||
+                                   bc_buf[pos + 1] == OP_if_false))
+                bc_buf[pos] = OP_lt_if_false;
+            break;
+        case OP_get_field2_ic:
+            if (pos + 8 <= end && bc_buf[pos + 5] == OP_call_method &&
+                get_u16(bc_buf + pos + 6) == 0)
+                bc_buf[pos] = OP_get_field2_ic_call0;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
 static JSValue js_create_function(JSContext *ctx, JSFunctionDef *fd)
 {
     JSValue func_obj;
@@ -33767,6 +34593,8 @@ static JSValue js_create_function(JSContext *ctx, JSFunctionDef *fd)
     b->is_direct_or_indirect_eval = (fd->eval_type == JS_EVAL_TYPE_DIRECT ||
                                      fd->eval_type == JS_EVAL_TYPE_INDIRECT);
     b->realm = JS_DupContext(ctx);
+    js_bytecode_init_ic(ctx->rt, b);
+    js_bytecode_fuse(b);
 
     add_gc_object(ctx->rt, &b->header, JS_GC_OBJ_TYPE_FUNCTION_BYTECODE);
 
@@ -33800,6 +34628,9 @@ static void free_function_bytecode(JSRuntime *rt, JSFunctionBytecode *b)
     }
 #endif
     free_bytecode_atoms(rt, b->byte_code_buf, b->byte_code_len, TRUE);
+    for(i = 0; i < b->ic_count; i++)
+        JS_FreeAtomRT(rt, b->ic[i].atom);
+    js_free_rt(rt, b->ic);
 
     if (b->vardefs) {
         for(i = 0; i < b->arg_count + b->var_count; i++) {
@@ -34785,10 +35616,12 @@ static JSValue __JS_EvalInternal(JSContext *ctx, JSValueConst this_obj,
     fun_obj = js_create_function(ctx, fd);
     if (JS_IsException(fun_obj))
         goto fail1;
-    /* Could add a flag to avoid resolution if necessary */
     if (m) {
         m->func_obj = fun_obj;
-        if (js_resolve_module(ctx, m) < 0)
+        /* only a module that is not run can be left unresolved */
+        if ((flags & (JS_EVAL_FLAG_NO_RESOLVE | JS_EVAL_FLAG_COMPILE_ONLY)) !=
+            (JS_EVAL_FLAG_NO_RESOLVE | JS_EVAL_FLAG_COMPILE_ONLY) &&
+            js_resolve_module(ctx, m) < 0)
             goto fail1;
         fun_obj = JS_NewModuleValue(ctx, m);
     }
@@ -34903,7 +35736,10 @@ static void js_object_list_init(JSObjectList *s)
 
 static uint32_t js_object_list_get_hash(JSObject *p, uint32_t hash_size)
 {
-    return ((uintptr_t)p * 3163) & (hash_size - 1);
+    /* objects are aligned and often evenly spaced, so the low bits of
+       the pointer alone would fill only a fraction of the buckets */
+    uint64_t h = (uint64_t)(uintptr_t)p * 0x9e3779b97f4a7c15;
+    return (uint32_t)(h >> 32) & (hash_size - 1);
 }
 
 static int js_object_list_resize_hash(JSContext *ctx, JSObjectList *s,
@@ -34983,6 +35819,188 @@ static void js_object_list_end(JSContext *ctx, JSObjectList *s)
     js_free(ctx, s->hash_table);
 }
 
+/*******************************************************************/
+/* object graph hash */
+
+typedef struct JSGraphHashState {
+    JSContext *ctx;
+    JSObjectList visited;
+    uint64_t h;
+} JSGraphHashState;
+
+static inline void js_graph_hash_mix(JSGraphHashState *s, uint64_t v)
+{
+    s->h = (s->h ^ v) * 0x100000001b3; /* FNV-1a, a word at a time */
+}
+
+/* C functions hash by what they call rather than by address, so the
+   lazily created built-in functions hash the same before and after
+   they are created */
+static void js_graph_hash_cfunc(JSGraphHashState *s, JSCFunctionType f,
+                                int magic)
+{
+    js_graph_hash_mix(s, JS_TAG_OBJECT);
+    js_graph_hash_mix(s, (uintptr_t)f.generic);
+    js_graph_hash_mix(s, (uint32_t)magic);
+}
+
+static int js_graph_hash_object(JSGraphHashState *s, JSObject *p);
+
+static int js_graph_hash_value(JSGraphHashState *s, JSValueConst val)
+{
+    uint32_t tag = JS_VALUE_GET_NORM_TAG(val);
+    JSFloat64Union u;
+
+    switch(tag) {
+    case JS_TAG_OBJECT:
+        return js_graph_hash_object(s, JS_VALUE_GET_OBJ(val));
+    case JS_TAG_STRING:
+    case JS_TAG_STRING_ROPE:
+        js_graph_hash_mix(s, JS_TAG_STRING);
+        js_graph_hash_mix(s, hash_string_rope(val, 0));
+        break;
+    case JS_TAG_FLOAT64:
+        js_graph_hash_mix(s, tag);
+        u.d = JS_VALUE_GET_FLOAT64(val);
+        js_graph_hash_mix(s, u.u64);
+        break;
+    case JS_TAG_INT:
+    case JS_TAG_BOOL:
+        js_graph_hash_mix(s, tag);
+        js_graph_hash_mix(s, (uint32_t)JS_VALUE_GET_INT(val));
+        break;
+    case JS_TAG_SHORT_BIG_INT:
+        js_graph_hash_mix(s, tag);
+        js_graph_hash_mix(s, (uint64_t)JS_VALUE_GET_SHORT_BIG_INT(val));
+        break;
+    default:
+        js_graph_hash_mix(s, tag);
+        if (JS_VALUE_HAS_REF_COUNT(val))
+            js_graph_hash_mix(s, (uintptr_t)JS_VALUE_GET_PTR(val));
+        break;
+    }
+    return 0;
+}
+
+static int js_graph_hash_property(JSGraphHashState *s, JSObject *p,
+                                  uint32_t i)
+{
+    JSShapeProperty *prs = &get_shape_prop(p->shape)[i];
+    JSProperty *pr = &p->prop[i];
+    const JSCFunctionListEntry *e;
+    JSAutoInitIDEnum id;
+
+    js_graph_hash_mix(s, prs->atom);
+    js_graph_hash_mix(s, prs->flags & (JS_PROP_C_W_E | JS_PROP_LENGTH));
+    switch(prs->flags & JS_PROP_TMASK) {
+    case JS_PROP_GETSET:
+        js_graph_hash_mix(s, JS_PROP_GETSET);
+        if (pr->u.getset.getter &&
+            js_graph_hash_object(s, pr->u.getset.getter))
+            return -1;
+        js_graph_hash_mix(s, JS_PROP_GETSET);
+        if (pr->u.getset.setter &&
+            js_graph_hash_object(s, pr->u.getset.setter))
+            return -1;
+        return 0;
+    case JS_PROP_VARREF:
+        return js_graph_hash_value(s, *pr->u.var_ref->pvalue);
+    case JS_PROP_AUTOINIT:
+        id = js_autoinit_get_id(pr);
+        if (id == JS_AUTOINIT_ID_PROP) {
+            e = pr->u.init.opaque;
+            if (e->def_type == JS_DEF_CFUNC) {
+                js_graph_hash_cfunc(s, e->u.func.cfunc, e->magic);
+                return 0;
+            } else if (e->def_type == JS_DEF_PROP_STRING) {
+                js_graph_hash_mix(s, JS_TAG_STRING);
+                js_graph_hash_mix(s, hash_string8((const uint8_t *)e->u.str,
+                                                  strlen(e->u.str), 0));
+                return 0;
+            }
+        } else if (id == JS_AUTOINIT_ID_MODULE_NS) {
+            js_graph_hash_mix(s, JS_PROP_AUTOINIT);
+            return 0;
+        }
+        /* objects are created to be hashed, so that they hash the same
+           once scripts have created them */
+        if (JS_AutoInitProperty(s->ctx, p, prs->atom, pr, prs))
+            return -1;
+        return js_graph_hash_value(s, p->prop[i].u.value);
+    default:
+        return js_graph_hash_value(s, pr->u.value);
+    }
+}
+
+static int js_graph_hash_object(JSGraphHashState *s, JSObject *p)
+{
+    JSContext *ctx = s->ctx;
+    JSObject *proto;
+    uint32_t i;
+    BOOL is_cfunc;
+
+    if (js_check_stack_overflow(ctx->rt, 0)) {
+        JS_ThrowStackOverflow(ctx);
+        return -1;
+    }
+    is_cfunc = (p->class_id == JS_CLASS_C_FUNCTION);
+    if (is_cfunc) {
+        js_graph_hash_cfunc(s, p->u.cfunc.c_function, p->u.cfunc.magic);
+    } else {
+        js_graph_hash_mix(s, JS_TAG_OBJECT);
+        js_graph_hash_mix(s, (uintptr_t)p);
+    }
+    /* the global object holds what scripts define, so callers pass what
+       of it matters as roots */
+    if (p == JS_VALUE_GET_OBJ(ctx->global_obj) ||
+        js_object_list_find(ctx, &s->visited, p) >= 0)
+        return 0;
+    if (js_object_list_add(ctx, &s->visited, p))
+        return -1;
+
+    /* an untouched C function adds nothing to its signature */
+    proto = p->shape->proto;
+    if (!p->extensible)
+        js_graph_hash_mix(s, 'X');
+    if (!is_cfunc || proto != JS_VALUE_GET_OBJ(ctx->function_proto)) {
+        js_graph_hash_mix(s, 'P');
+        if (proto && js_graph_hash_object(s, proto))
+            return -1;
+    }
+    for(i = 0; i < p->shape->prop_count; i++) {
+        JSAtom atom = get_shape_prop(p->shape)[i].atom;
+        if (atom == JS_ATOM_NULL ||
+            (is_cfunc && (atom == JS_ATOM_length || atom == JS_ATOM_name)))
+            continue;
+        if (js_graph_hash_property(s, p, i))
+            return -1;
+    }
+    if (p->class_id == JS_CLASS_ARRAY && p->fast_array) {
+        js_graph_hash_mix(s, p->u.array.count);
+        for(i = 0; i < p->u.array.count; i++) {
+            if (js_graph_hash_value(s, p->u.array.u.values[i]))
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int JS_HashObjectGraph(JSContext *ctx, uint64_t *phash,
+                       JSValueConst *roots, int count)
+{
+    JSGraphHashState s;
+    int i, ret = 0;
+
+    s.ctx = ctx;
+    s.h = 0xcbf29ce484222325;
+    js_object_list_init(&s.visited);
+    for(i = 0; i < count && ret == 0; i++)
+        ret = js_graph_hash_value(&s, roots[i]);
+    js_object_list_end(ctx, &s.visited);
+    *phash = s.h;
+    return ret;
+}
+
 /*******************************************************************/
 /* binary object writer & reader */
 
@@ -35006,9 +36024,23 @@ typedef enum BCTagEnum {
     BC_TAG_DATE,
     BC_TAG_OBJECT_VALUE,
     BC_TAG_OBJECT_REFERENCE,
+    BC_TAG_ARRAY_BUFFER_TRANSFER,
 } BCTagEnum;
 
-#define BC_VERSION 4
+#define BC_VERSION 6
+/* version byte of an object whose atoms are in a JSAtomTable */
+#define BC_VERSION_ATOM_TABLE (BC_VERSION | 0x80)
+
+struct JSAtomTable {
+    JSRuntime *rt;
+    /* as in BCWriterState; each atom of idx_to_atom holds a reference */
+    uint32_t *atom_to_idx;
+    int atom_to_idx_size;
+    JSAtom *idx_to_atom;
+    int idx_to_atom_count;
+    int idx_to_atom_size;
+    BOOL is_identity; /* atom i was interned as JS_ATOM_END + i */
+};
 
 typedef struct BCWriterState {
     JSContext *ctx;
@@ -35016,6 +36048,7 @@ typedef struct BCWriterState {
     BOOL allow_bytecode : 8;
     BOOL allow_sab : 8;
     BOOL allow_reference : 8;
+    BOOL strict : 8;
     uint32_t first_atom;
     uint32_t *atom_to_idx;
     int atom_to_idx_size;
@@ -35025,6 +36058,9 @@ typedef struct BCWriterState {
     uint8_t **sab_tab;
     int sab_tab_len;
     int sab_tab_size;
+    /* ArrayBuffers written by index */
+    JSValueConst *transfer_tab;
+    int transfer_len;
     /* list of referenced objects (used if allow_reference = TRUE) */
     JSObjectList object_list;
 } BCWriterState;
@@ -35051,6 +36087,7 @@ static const char * const bc_tag_str[] = {
     "Date",
     "ObjectValue",
     "ObjectReference",
+    "ArrayBufferTransfer",
 };
 #endif
 
@@ -35221,22 +36258,31 @@ static void bc_byte_swap(uint8_t *bc_buf, int bc_len)
 }
 
 static int JS_WriteFunctionBytecode(BCWriterState *s,
-                                    const uint8_t *bc_buf1, int bc_len)
+                                    const JSFunctionBytecode *b)
 {
-    int pos, len, op;
+    int pos, len, op, bc_len;
     JSAtom atom;
     uint8_t *bc_buf;
     uint32_t val;
 
+    bc_len = b->byte_code_len;
     bc_buf = js_malloc(s->ctx, bc_len);
     if (!bc_buf)
         return -1;
-    memcpy(bc_buf, bc_buf1, bc_len);
+    memcpy(bc_buf, b->byte_code_buf, bc_len);
 
     pos = 0;
     while (pos < bc_len) {
-        op = bc_buf[pos];
+        /* nor are superinstructions: write the opcode they replaced */
+        op = js_unfused_opcode(bc_buf[pos]);
+        bc_buf[pos] = op;
         len = short_opcode_info(op).size;
+        if (op >= OP_get_field_ic && op <= OP_put_field_ic) {
+            /* inline caches are not serialized: write the plain access */
+            op = op - OP_get_field_ic + OP_get_field;
+            bc_buf[pos] = op;
+            put_u32(bc_buf + pos + 1, b->ic[get_u32(bc_buf + pos + 1)].atom);
+        }
         switch(short_opcode_info(op).fmt) {
         case OP_FMT_atom:
         case OP_FMT_atom_u8:
@@ -35394,7 +36440,7 @@ static int JS_WriteFunctionTag(BCWriterState *s, JSValueConst obj)
         bc_put_u8(s, flags);
     }
 
-    if (JS_WriteFunctionBytecode(s, b->byte_code_buf, b->byte_code_len))
+    if (JS_WriteFunctionBytecode(s, b))
         goto fail;
 
     if (b->has_debug) {
@@ -35568,10 +36614,18 @@ static int JS_WriteArrayBuffer(BCWriterState *s, JSValueConst obj)
 {
     JSObject *p = JS_VALUE_GET_OBJ(obj);
     JSArrayBuffer *abuf = p->u.array_buffer;
+    int i;
     if (abuf->detached) {
         JS_ThrowTypeErrorDetachedArrayBuffer(s->ctx);
         return -1;
     }
+    for(i = 0; i < s->transfer_len; i++) {
+        if (JS_VALUE_GET_OBJ(s->transfer_tab[i]) == p) {
+            bc_put_u8(s, BC_TAG_ARRAY_BUFFER_TRANSFER);
+            bc_put_leb128(s, i);
+            return 0;
+        }
+    }
     bc_put_u8(s, BC_TAG_ARRAY_BUFFER);
     bc_put_leb128(s, abuf->byte_length);
     dbuf_put(&s->dbuf, abuf->data, abuf->byte_length);
@@ -35594,6 +36648,45 @@ static int JS_WriteSharedArrayBuffer(BCWriterState *s, JSValueConst obj)
     return 0;
 }
 
+/* JS_WRITE_OBJ_STRICT: check that 'p' reads back with the same
+   prototype, extensibility and own properties */
+static int JS_CheckWriteStrict(BCWriterState *s, JSObject *p)
+{
+    JSContext *ctx = s->ctx;
+    JSShape *sh = p->shape;
+    JSShapeProperty *pr;
+    JSValueConst proto;
+    uint32_t i;
+
+    proto = ctx->class_proto[p->class_id];
+    if (!p->extensible ||
+        JS_VALUE_GET_TAG(proto) != JS_TAG_OBJECT ||
+        sh->proto != JS_VALUE_GET_OBJ(proto) ||
+        (p->class_id == JS_CLASS_ARRAY && !p->fast_array))
+        goto fail;
+    for(i = 0, pr = get_shape_prop(sh); i < sh->prop_count; i++, pr++) {
+        if (pr->atom == JS_ATOM_NULL)
+            continue;
+        if (pr->atom == JS_ATOM_length &&
+            (p->class_id == JS_CLASS_ARRAY || p->class_id == JS_CLASS_STRING)) {
+            /* the array length must stay writable */
+            if (p->class_id == JS_CLASS_ARRAY &&
+                !(pr->flags & JS_PROP_WRITABLE))
+                goto fail;
+            continue;
+        }
+        /* only plain objects have their properties written */
+        if (p->class_id != JS_CLASS_OBJECT ||
+            !JS_AtomIsString(ctx, pr->atom) ||
+            (pr->flags & (JS_PROP_TMASK | JS_PROP_C_W_E)) != JS_PROP_C_W_E)
+            goto fail;
+    }
+    return 0;
+ fail:
+    JS_ThrowTypeError(ctx, "object cannot be written without loss");
+    return -1;
+}
+
 static int JS_WriteObjectRec(BCWriterState *s, JSValueConst obj)
 {
     uint32_t tag;
@@ -35677,6 +36770,10 @@ static int JS_WriteObjectRec(BCWriterState *s, JSValueConst obj)
                 }
                 p->tmp_mark = 1;
             }
+            if (s->strict && JS_CheckWriteStrict(s, p)) {
+                p->tmp_mark = 0;
+                goto fail;
+            }
             switch(p->class_id) {
             case JS_CLASS_ARRAY:
                 ret = JS_WriteArray(s, obj);
@@ -35769,16 +36866,48 @@ static int JS_WriteObjectAtoms(BCWriterState *s)
     return -1;
 }
 
-uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
-                         int flags, uint8_t ***psab_tab, size_t *psab_tab_len)
+/* give the atom indexes back to 'tab', keeping the atoms added */
+static void bc_atom_table_update(BCWriterState *s, JSAtomTable *tab)
+{
+    int i;
+
+    for(i = tab->idx_to_atom_count; i < s->idx_to_atom_count; i++)
+        JS_DupAtom(s->ctx, s->idx_to_atom[i]);
+    tab->atom_to_idx = s->atom_to_idx;
+    tab->atom_to_idx_size = s->atom_to_idx_size;
+    tab->idx_to_atom = s->idx_to_atom;
+    tab->idx_to_atom_count = s->idx_to_atom_count;
+    tab->idx_to_atom_size = s->idx_to_atom_size;
+    s->atom_to_idx = NULL;
+    s->idx_to_atom = NULL;
+}
+
+static uint8_t *JS_WriteObjectInternal(JSContext *ctx, size_t *psize, JSValueConst obj,
+                                       int flags, uint8_t ***psab_tab, size_t *psab_tab_len,
+                                       JSValueConst *transfer_tab, int transfer_len,
+                                       JSAtomTable *tab)
 {
     BCWriterState ss, *s = &ss;
+    int i;
 
+    for(i = 0; i < transfer_len; i++) {
+        if (!JS_GetOpaque(transfer_tab[i], JS_CLASS_ARRAY_BUFFER)) {
+            JS_ThrowTypeError(ctx, "only ArrayBuffers can be transferred");
+            goto fail1;
+        }
+    }
+    if (tab && (!(flags & JS_WRITE_OBJ_BYTECODE) || tab->rt != ctx->rt)) {
+        JS_ThrowTypeError(ctx, "invalid atom table");
+        goto fail1;
+    }
     memset(s, 0, sizeof(*s));
     s->ctx = ctx;
+    s->transfer_tab = transfer_tab;
+    s->transfer_len = transfer_len;
     s->allow_bytecode = ((flags & JS_WRITE_OBJ_BYTECODE) != 0);
     s->allow_sab = ((flags & JS_WRITE_OBJ_SAB) != 0);
     s->allow_reference = ((flags & JS_WRITE_OBJ_REFERENCE) != 0);
+    s->strict = ((flags & JS_WRITE_OBJ_STRICT) != 0);
     /* XXX: could use a different version when bytecode is included */
     if (s->allow_bytecode)
         s->first_atom = JS_ATOM_END;
@@ -35786,10 +36915,21 @@ uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
         s->first_atom = 1;
     js_dbuf_init(ctx, &s->dbuf);
     js_object_list_init(&s->object_list);
+    if (tab) {
+        /* indexes continue from those of the objects written before */
+        s->atom_to_idx = tab->atom_to_idx;
+        s->atom_to_idx_size = tab->atom_to_idx_size;
+        s->idx_to_atom = tab->idx_to_atom;
+        s->idx_to_atom_count = tab->idx_to_atom_count;
+        s->idx_to_atom_size = tab->idx_to_atom_size;
+        bc_put_u8(s, BC_VERSION_ATOM_TABLE);
+    }
 
     if (JS_WriteObjectRec(s, obj))
         goto fail;
-    if (JS_WriteObjectAtoms(s))
+    if (tab)
+        bc_atom_table_update(s, tab);
+    else if (JS_WriteObjectAtoms(s))
         goto fail;
     js_object_list_end(ctx, &s->object_list);
     js_free(ctx, s->atom_to_idx);
@@ -35802,9 +36942,12 @@ uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
     return s->dbuf.buf;
  fail:
     js_object_list_end(ctx, &s->object_list);
+    if (tab)
+        bc_atom_table_update(s, tab);
     js_free(ctx, s->atom_to_idx);
     js_free(ctx, s->idx_to_atom);
     dbuf_free(&s->dbuf);
+ fail1:
     *psize = 0;
     if (psab_tab)
         *psab_tab = NULL;
@@ -35813,12 +36956,79 @@ uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
     return NULL;
 }
 
+uint8_t *JS_WriteObject3(JSContext *ctx, size_t *psize, JSValueConst obj,
+                         int flags, uint8_t ***psab_tab, size_t *psab_tab_len,
+                         JSValueConst *transfer_tab, int transfer_len)
+{
+    return JS_WriteObjectInternal(ctx, psize, obj, flags, psab_tab, psab_tab_len,
+                                  transfer_tab, transfer_len, NULL);
+}
+
+uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
+                         int flags, uint8_t ***psab_tab, size_t *psab_tab_len)
+{
+    return JS_WriteObject3(ctx, psize, obj, flags, psab_tab, psab_tab_len,
+                           NULL, 0);
+}
+
 uint8_t *JS_WriteObject(JSContext *ctx, size_t *psize, JSValueConst obj,
                         int flags)
 {
     return JS_WriteObject2(ctx, psize, obj, flags, NULL, NULL);
 }
 
+JSAtomTable *JS_NewAtomTable(JSContext *ctx)
+{
+    JSAtomTable *tab;
+
+    tab = js_mallocz(ctx, sizeof(*tab));
+    if (!tab)
+        return NULL;
+    tab->rt = ctx->rt;
+    return tab;
+}
+
+void JS_FreeAtomTable(JSRuntime *rt, JSAtomTable *tab)
+{
+    int i;
+
+    if (!tab)
+        return;
+    for(i = 0; i < tab->idx_to_atom_count; i++)
+        JS_FreeAtomRT(rt, tab->idx_to_atom[i]);
+    js_free_rt(rt, tab->atom_to_idx);
+    js_free_rt(rt, tab->idx_to_atom);
+    js_free_rt(rt, tab);
+}
+
+uint8_t *JS_WriteObjectWithAtomTable(JSContext *ctx, size_t *psize,
+                                     JSValueConst obj, int flags,
+                                     JSAtomTable *tab)
+{
+    return JS_WriteObjectInternal(ctx, psize, obj, flags, NULL, NULL,
+                                  NULL, 0, tab);
+}
+
+uint8_t *JS_WriteAtomTable(JSContext *ctx, size_t *psize, JSAtomTable *tab)
+{
+    BCWriterState ss, *s = &ss;
+
+    memset(s, 0, sizeof(*s));
+    s->ctx = ctx;
+    s->first_atom = JS_ATOM_END;
+    s->idx_to_atom = tab->idx_to_atom;
+    s->idx_to_atom_count = tab->idx_to_atom_count;
+    js_dbuf_init(ctx, &s->dbuf);
+    /* same layout as the atoms at the start of JS_WriteObject() output */
+    if (JS_WriteObjectAtoms(s) || s->dbuf.error) {
+        dbuf_free(&s->dbuf);
+        *psize = 0;
+        return NULL;
+    }
+    *psize = s->dbuf.size;
+    return s->dbuf.buf;
+}
+
 typedef struct BCReaderState {
     JSContext *ctx;
     const uint8_t *buf_start, *ptr, *buf_end;
@@ -35830,6 +37040,9 @@ typedef struct BCReaderState {
     BOOL allow_bytecode : 8;
     BOOL is_rom_data : 8;
     BOOL allow_reference : 8;
+    BOOL shared_atoms : 8; /* idx_to_atom belongs to a JSAtomTable */
+    JSValueConst *transfer_tab;
+    int transfer_len;
     /* object references */
     JSObject **objects;
     int objects_count;
@@ -36352,6 +37565,8 @@ static JSValue JS_ReadFunctionTag(BCReaderState *s)
         bc_read_trace(s, "bytecode {\n");
         if (JS_ReadFunctionBytecode(s, b, byte_code_offset, b->byte_code_len))
             goto fail;
+        js_bytecode_init_ic(ctx->rt, b);
+        js_bytecode_fuse(b);
         bc_read_trace(s, "}\n");
     }
     if (b->has_debug) {
@@ -36686,6 +37901,26 @@ static JSValue JS_ReadSharedArrayBuffer(BCReaderState *s)
     return JS_EXCEPTION;
 }
 
+static JSValue JS_ReadArrayBufferTransfer(BCReaderState *s)
+{
+    JSContext *ctx = s->ctx;
+    uint32_t idx;
+    JSValue obj;
+
+    if (bc_get_leb128(s, &idx))
+        return JS_EXCEPTION;
+    if (idx >= s->transfer_len) {
+        JS_ThrowSyntaxError(ctx, "invalid transferred ArrayBuffer");
+        return JS_EXCEPTION;
+    }
+    obj = JS_DupValue(ctx, s->transfer_tab[idx]);
+    if (BC_add_object_ref(s, obj)) {
+        JS_FreeValue(ctx, obj);
+        return JS_EXCEPTION;
+    }
+    return obj;
+}
+
 static JSValue JS_ReadDate(BCReaderState *s)
 {
     JSContext *ctx = s->ctx;
@@ -36813,6 +38048,9 @@ static JSValue JS_ReadObjectRec(BCReaderState *s)
             goto invalid_tag;
         obj = JS_ReadSharedArrayBuffer(s);
         break;
+    case BC_TAG_ARRAY_BUFFER_TRANSFER:
+        obj = JS_ReadArrayBufferTransfer(s);
+        break;
     case BC_TAG_DATE:
         obj = JS_ReadDate(s);
         break;
@@ -36855,6 +38093,10 @@ static int JS_ReadObjectAtoms(BCReaderState *s)
 
     if (bc_get_u8(s, &v8))
         return -1;
+    if (v8 == BC_VERSION_ATOM_TABLE) {
+        JS_ThrowSyntaxError(s->ctx, "bytecode needs its atom table");
+        return -1;
+    }
     if (v8 != BC_VERSION) {
         JS_ThrowSyntaxError(s->ctx, "invalid version (%d expected=%d)",
                             v8, BC_VERSION);
@@ -36886,10 +38128,34 @@ static int JS_ReadObjectAtoms(BCReaderState *s)
     return 0;
 }
 
+/* use the atoms interned by JS_ReadAtomTable() instead of reading them */
+static int JS_ReadObjectAtomTable(BCReaderState *s, JSAtomTable *tab)
+{
+    uint8_t v8;
+
+    if (bc_get_u8(s, &v8))
+        return -1;
+    if (v8 != BC_VERSION_ATOM_TABLE) {
+        JS_ThrowSyntaxError(s->ctx, "invalid version (%d expected=%d)",
+                            v8, BC_VERSION_ATOM_TABLE);
+        return -1;
+    }
+    if (!s->allow_bytecode || tab->rt != s->ctx->rt) {
+        JS_ThrowTypeError(s->ctx, "invalid atom table");
+        return -1;
+    }
+    s->idx_to_atom = tab->idx_to_atom;
+    s->idx_to_atom_count = tab->idx_to_atom_count;
+    s->shared_atoms = TRUE;
+    if (!tab->is_identity)
+        s->is_rom_data = FALSE; /* atoms must be relocated */
+    return 0;
+}
+
 static void bc_reader_free(BCReaderState *s)
 {
     int i;
-    if (s->idx_to_atom) {
+    if (s->idx_to_atom && !s->shared_atoms) {
         for(i = 0; i < s->idx_to_atom_count; i++) {
             JS_FreeAtom(s->ctx, s->idx_to_atom[i]);
         }
@@ -36898,12 +38164,15 @@ static void bc_reader_free(BCReaderState *s)
     js_free(s->ctx, s->objects);
 }
 
-JSValue JS_ReadObject(JSContext *ctx, const uint8_t *buf, size_t buf_len,
-                       int flags)
+static JSValue JS_ReadObjectInternal(JSContext *ctx, const uint8_t *buf, size_t buf_len,
+                                     int flags, JSValueConst *transfer_tab, int transfer_len,
+                                     JSAtomTable *tab)
 {
     BCReaderState ss, *s = &ss;
     JSValue obj;
+    BOOL traced;
 
+    traced = js_trace_begin(ctx->rt, "JS_ReadObject");
     ctx->binary_object_count += 1;
     ctx->binary_object_size += buf_len;
 
@@ -36916,19 +38185,72 @@ JSValue JS_ReadObject(JSContext *ctx, const uint8_t *buf, size_t buf_len,
     s->is_rom_data = ((flags & JS_READ_OBJ_ROM_DATA) != 0);
     s->allow_sab = ((flags & JS_READ_OBJ_SAB) != 0);
     s->allow_reference = ((flags & JS_READ_OBJ_REFERENCE) != 0);
+    s->transfer_tab = transfer_tab;
+    s->transfer_len = transfer_len;
     if (s->allow_bytecode)
         s->first_atom = JS_ATOM_END;
     else
         s->first_atom = 1;
-    if (JS_ReadObjectAtoms(s)) {
+    if (tab ? JS_ReadObjectAtomTable(s, tab) : JS_ReadObjectAtoms(s)) {
         obj = JS_EXCEPTION;
     } else {
         obj = JS_ReadObjectRec(s);
     }
     bc_reader_free(s);
+    js_trace_end(ctx->rt, traced);
     return obj;
 }
 
+JSValue JS_ReadObject2(JSContext *ctx, const uint8_t *buf, size_t buf_len,
+                       int flags, JSValueConst *transfer_tab, int transfer_len)
+{
+    return JS_ReadObjectInternal(ctx, buf, buf_len, flags,
+                                 transfer_tab, transfer_len, NULL);
+}
+
+JSValue JS_ReadObjectWithAtomTable(JSContext *ctx, const uint8_t *buf,
+                                   size_t buf_len, int flags,
+                                   JSAtomTable *tab)
+{
+    return JS_ReadObjectInternal(ctx, buf, buf_len, flags, NULL, 0, tab);
+}
+
+JSAtomTable *JS_ReadAtomTable(JSContext *ctx, const uint8_t *buf,
+                              size_t buf_len)
+{
+    BCReaderState ss, *s = &ss;
+    JSAtomTable *tab;
+
+    memset(s, 0, sizeof(*s));
+    s->ctx = ctx;
+    s->buf_start = buf;
+    s->buf_end = buf + buf_len;
+    s->ptr = buf;
+    s->first_atom = JS_ATOM_END;
+    s->is_rom_data = TRUE; /* cleared if an atom is not interned in order */
+    tab = JS_NewAtomTable(ctx);
+    if (!tab)
+        return NULL;
+    if (JS_ReadObjectAtoms(s)) {
+        bc_reader_free(s);
+        js_free(ctx, tab);
+        return NULL;
+    }
+    tab->idx_to_atom = s->idx_to_atom;
+    tab->idx_to_atom_count = s->idx_to_atom_count;
+    tab->idx_to_atom_size = s->idx_to_atom_count;
+    tab->is_identity = s->is_rom_data;
+    s->idx_to_atom = NULL;
+    bc_reader_free(s);
+    return tab;
+}
+
+JSValue JS_ReadObject(JSContext *ctx, const uint8_t *buf, size_t buf_len,
+                       int flags)
+{
+    return JS_ReadObject2(ctx, buf, buf_len, flags, NULL, 0);
+}
+
 /*******************************************************************/
 /* runtime functions & objects */
 
@@ -37093,11 +38415,42 @@ static int JS_InstantiateFunctionListItem(JSContext *ctx, JSValueConst obj,
     return 0;
 }
 
+/* Make room for 'count' more properties in 'p' so that the shape is
+   not resized step by step while they are added. A shared shape is
+   cloned first, as add_property() would do. Failures are ignored: the
+   properties are then added the usual way. */
+static void js_reserve_properties(JSContext *ctx, JSObject *p, uint32_t count)
+{
+    JSShape *sh, *new_sh;
+
+    sh = p->shape;
+    if (sh->prop_count + count <= sh->prop_size)
+        return;
+    if (sh->is_hashed) {
+        if (sh->header.ref_count != 1) {
+            new_sh = js_clone_shape(ctx, sh);
+            if (!new_sh)
+                return;
+            new_sh->is_hashed = TRUE;
+            js_shape_hash_link(ctx->rt, new_sh);
+            js_free_shape(ctx->rt, p->shape);
+            p->shape = new_sh;
+        }
+        js_shape_hash_unlink(ctx->rt, p->shape);
+        resize_properties(ctx, &p->shape, p, p->shape->prop_count + count);
+        js_shape_hash_link(ctx->rt, p->shape);
+    } else {
+        resize_properties(ctx, &p->shape, p, sh->prop_count + count);
+    }
+}
+
 void JS_SetPropertyFunctionList(JSContext *ctx, JSValueConst obj,
                                 const JSCFunctionListEntry *tab, int len)
 {
     int i;
 
+    if (JS_VALUE_GET_TAG(obj) == JS_TAG_OBJECT && len > 1)
+        js_reserve_properties(ctx, JS_VALUE_GET_OBJ(obj), len);
     for (i = 0; i < len; i++) {
         const JSCFunctionListEntry *e = &tab[i];
         JSAtom atom = find_atom(ctx, e->name);
@@ -40036,12 +41389,73 @@ static JSValue js_array_toString(JSContext *ctx, JSValueConst this_val,
     return ret;
 }
 
+/* Join a fast array whose elements are all primitives: their
+   conversion cannot have side effects, so they are all converted
+   before the result is built with a single allocation. Return
+   JS_UNINITIALIZED if the array must be joined incrementally. */
+static JSValue js_array_join_fast(JSContext *ctx, const JSValue *arrp,
+                                  uint32_t len, const JSString *sep)
+{
+    JSValue *tab, ret;
+    uint32_t i, j;
+    BOOL need_convert;
+
+    need_convert = FALSE;
+    for(i = 0; i < len; i++) {
+        switch(JS_VALUE_GET_TAG(arrp[i])) {
+        case JS_TAG_OBJECT:
+        case JS_TAG_SYMBOL:
+            return JS_UNINITIALIZED;
+        case JS_TAG_STRING:
+        case JS_TAG_STRING_ROPE:
+        case JS_TAG_NULL:
+        case JS_TAG_UNDEFINED:
+            break;
+        default:
+            need_convert = TRUE;
+            break;
+        }
+    }
+    if (!need_convert)
+        return js_string_join_list(ctx, arrp, len, sep);
+    tab = js_malloc_rt(ctx->rt, sizeof(tab[0]) * max_int(len, 1));
+    if (!tab)
+        return JS_UNINITIALIZED;
+    for(i = 0; i < len; i++) {
+        switch(JS_VALUE_GET_TAG(arrp[i])) {
+        case JS_TAG_STRING:
+        case JS_TAG_STRING_ROPE:
+            tab[i] = JS_DupValue(ctx, arrp[i]);
+            break;
+        case JS_TAG_NULL:
+        case JS_TAG_UNDEFINED:
+            tab[i] = JS_UNDEFINED;
+            break;
+        default:
+            tab[i] = JS_ToString(ctx, arrp[i]);
+            if (JS_IsException(tab[i])) {
+                ret = JS_EXCEPTION;
+                goto done;
+            }
+            break;
+        }
+    }
+    ret = js_string_join_list(ctx, tab, len, sep);
+ done:
+    for(j = 0; j < i; j++)
+        JS_FreeValue(ctx, tab[j]);
+    js_free_rt(ctx->rt, tab);
+    return ret;
+}
+
 static JSValue js_array_join(JSContext *ctx, JSValueConst this_val,
                              int argc, JSValueConst *argv, int toLocaleString)
 {
     JSValue obj, sep = JS_UNDEFINED, el;
     StringBuffer b_s, *b = &b_s;
     JSString *p = NULL;
+    JSValue *arrp;
+    uint32_t count32;
     int64_t i, n;
     int c;
 
@@ -40060,6 +41474,22 @@ static JSValue js_array_join(JSContext *ctx, JSValueConst this_val,
         else
             c = -1;
     }
+    if (!toLocaleString && js_get_fast_array(ctx, obj, &arrp, &count32) &&
+        count32 == n) {
+        if (!p) {
+            sep = js_new_string8_len(ctx, ",", 1);
+            if (JS_IsException(sep))
+                goto exception;
+            p = JS_VALUE_GET_STRING(sep);
+        }
+        el = js_array_join_fast(ctx, arrp, count32, p);
+        if (!JS_IsUninitialized(el)) {
+            JS_FreeValue(ctx, sep);
+            JS_FreeValue(ctx, obj);
+            return el;
+        }
+    }
+
     string_buffer_init(ctx, b, 0);
 
     for(i = 0; i < n; i++) {
@@ -40717,6 +42147,174 @@ exception:
     return 0;
 }
 
+/* Return 1 if 'func' is (a, b) => a - b, -1 if it is (a, b) => b - a and
+   0 otherwise. The call has no side effect when both arguments are
+   numbers, so the sort can do without it. */
+static int js_sort_comparator_kind(JSValueConst func)
+{
+    JSObject *p;
+    JSFunctionBytecode *b;
+    const uint8_t *pc;
+
+    if (JS_VALUE_GET_TAG(func) != JS_TAG_OBJECT)
+        return 0;
+    p = JS_VALUE_GET_OBJ(func);
+    if (p->class_id != JS_CLASS_BYTECODE_FUNCTION)
+        return 0;
+    b = p->u.func.function_bytecode;
+    if (b->func_kind != JS_FUNC_NORMAL || b->arg_count != 2 ||
+        b->byte_code_len != 4)
+        return 0;
+    pc = b->byte_code_buf;
+    if (pc[2] != OP_sub || pc[3] != OP_return)
+        return 0;
+    if (pc[0] == OP_get_arg0 && pc[1] == OP_get_arg1)
+        return 1;
+    if (pc[0] == OP_get_arg1 && pc[1] == OP_get_arg0)
+        return -1;
+    return 0;
+}
+
+static int js_array_cmp_string(const void *a, const void *b, void *opaque)
+{
+    return js_string_compare(opaque, JS_VALUE_GET_STRING(*(const JSValue *)a),
+                             JS_VALUE_GET_STRING(*(const JSValue *)b));
+}
+
+/* Key ordered as the decimal representation of 'v': one base 12 digit
+   per character, 0 past the end, 1 for '-' and 2 to 11 for the digits */
+static uint64_t js_int32_string_key(int32_t v)
+{
+    char buf[16];
+    uint64_t key;
+    int i, n;
+
+    n = i32toa(buf, v);
+    key = 0;
+    for(i = 0; i < 11; i++) {
+        key *= 12;
+        if (i < n)
+            key += (buf[i] == '-') ? 1 : buf[i] - '0' + 2;
+    }
+    return key;
+}
+
+static int32_t js_int32_from_string_key(uint64_t key)
+{
+    uint8_t digits[11];
+    int64_t v;
+    int i, neg;
+
+    for(i = 10; i >= 0; i--) {
+        digits[i] = key % 12;
+        key /= 12;
+    }
+    neg = (digits[0] == 1);
+    v = 0;
+    for(i = neg; i < 11 && digits[i] != 0; i++)
+        v = v * 10 + digits[i] - 2;
+    return neg ? -v : v;
+}
+
+/* Sort in place a fast array whose elements are all strings or all
+   numbers, without calling back into JS: strings with the default
+   order, int32 values with the default order, and numbers with a
+   comparator recognized by js_sort_comparator_kind(). Equal elements
+   cannot be told apart (NaN and -0 are left to the generic sort), so
+   the stability of the generic sort is preserved. Return FALSE if the
+   generic sort must be used. */
+static BOOL js_array_sort_fast(JSContext *ctx, JSValueConst obj, int64_t len,
+                               struct array_sort_context *psc)
+{
+    JSValue *values;
+    uint32_t count, i;
+    int kind, tag;
+    BOOL is_string, all_int;
+
+    if (!js_get_fast_array(ctx, obj, &values, &count) || count != len ||
+        count < 2)
+        return FALSE;
+    kind = 0;
+    if (psc->has_method) {
+        kind = js_sort_comparator_kind(psc->method);
+        if (!kind)
+            return FALSE;
+    }
+
+    /* a comparator is only recognized for numbers */
+    is_string = (JS_VALUE_GET_TAG(values[0]) == JS_TAG_STRING);
+    if (is_string && kind)
+        return FALSE;
+    all_int = TRUE;
+    for(i = 0; i < count; i++) {
+        tag = JS_VALUE_GET_NORM_TAG(values[i]);
+        if (is_string) {
+            if (tag != JS_TAG_STRING)
+                return FALSE;
+        } else if (tag == JS_TAG_FLOAT64) {
+            double d = JS_VALUE_GET_FLOAT64(values[i]);
+            if (isnan(d) || (d == 0 && signbit(d)))
+                return FALSE;
+            all_int = FALSE;
+        } else if (tag != JS_TAG_INT) {
+            return FALSE;
+        }
+    }
+
+    if (is_string) {
+        rqsort(values, count, sizeof(values[0]), js_array_cmp_string, ctx);
+    } else if (all_int && kind) {
+        uint32_t *keys;
+        keys = js_malloc_rt(ctx->rt, 2 * sizeof(keys[0]) * count);
+        if (!keys)
+            return FALSE;
+        for(i = 0; i < count; i++)
+            keys[i] = JS_VALUE_GET_INT(values[i]) ^ 0x80000000;
+        js_TA_radix_sort32(keys, keys + count, count);
+        for(i = 0; i < count; i++) {
+            values[kind > 0 ? i : count - 1 - i] =
+                JS_NewInt32(ctx, keys[i] ^ 0x80000000);
+        }
+        js_free_rt(ctx->rt, keys);
+    } else if (all_int) {
+        uint64_t *keys;
+        keys = js_malloc_rt(ctx->rt, 2 * sizeof(keys[0]) * count);
+        if (!keys)
+            return FALSE;
+        for(i = 0; i < count; i++)
+            keys[i] = js_int32_string_key(JS_VALUE_GET_INT(values[i]));
+        js_TA_radix_sort64(keys, keys + count, count);
+        for(i = 0; i < count; i++)
+            values[i] = JS_NewInt32(ctx, js_int32_from_string_key(keys[i]));
+        js_free_rt(ctx->rt, keys);
+    } else if (kind) {
+        /* same keys as Float64Array sort */
+        const uint64_t sign = (uint64_t)1 << 63;
+        uint64_t *keys, k;
+        JSFloat64Union u;
+        keys = js_malloc_rt(ctx->rt, 2 * sizeof(keys[0]) * count);
+        if (!keys)
+            return FALSE;
+        for(i = 0; i < count; i++) {
+            if (JS_VALUE_GET_TAG(values[i]) == JS_TAG_INT)
+                u.d = JS_VALUE_GET_INT(values[i]);
+            else
+                u.d = JS_VALUE_GET_FLOAT64(values[i]);
+            keys[i] = (u.u64 & sign) ? ~u.u64 : (u.u64 | sign);
+        }
+        js_TA_radix_sort64(keys, keys + count, count);
+        for(i = 0; i < count; i++) {
+            k = keys[i];
+            u.u64 = (k & sign) ? (k & ~sign) : ~k;
+            values[kind > 0 ? i : count - 1 - i] = JS_NewFloat64(ctx, u.d);
+        }
+        js_free_rt(ctx->rt, keys);
+    } else {
+        return FALSE;
+    }
+    return TRUE;
+}
+
 static JSValue js_array_sort(JSContext *ctx, JSValueConst this_val,
                              int argc, JSValueConst *argv)
 {
@@ -40736,7 +42334,9 @@ static JSValue js_array_sort(JSContext *ctx, JSValueConst this_val,
     if (js_get_length64(ctx, &len, obj))
         goto exception;
 
-    /* XXX: should special case fast arrays */
+    if (js_array_sort_fast(ctx, obj, len, &asc))
+        return obj;
+
     for (i = 0; i < len; i++) {
         if (pos >= array_size) {
             size_t new_size, slack;
@@ -41775,49 +43375,180 @@ static JSValue js_string_codePointAt(JSContext *ctx, JSValueConst this_val,
     return ret;
 }
 
+/* also used for the template literals, which are compiled to a call
+   to concat() */
 static JSValue js_string_concat(JSContext *ctx, JSValueConst this_val,
                                 int argc, JSValueConst *argv)
 {
-    JSValue r;
-    int i;
-
-    /* XXX: Use more efficient method */
-    /* XXX: This method is OK if r has a single refcount */
-    /* XXX: should use string_buffer? */
-    r = JS_ToStringCheckObject(ctx, this_val);
-    for (i = 0; i < argc; i++) {
-        if (JS_IsException(r))
-            break;
-        r = JS_ConcatString(ctx, r, JS_DupValue(ctx, argv[i]));
+    JSValue tab_buf[8], *tab, r;
+    int64_t len;
+    int i, j, n;
+
+    /* all the conversions are done first, as in the spec, so that the
+       length of the result is known before building it */
+    n = argc + 1;
+    tab = tab_buf;
+    if (n > countof(tab_buf)) {
+        tab = js_malloc(ctx, sizeof(tab[0]) * n);
+        if (!tab)
+            return JS_EXCEPTION;
+    }
+    len = 0;
+    for(i = 0; i < n; i++) {
+        if (i == 0)
+            tab[i] = JS_ToStringCheckObject(ctx, this_val);
+        else
+            tab[i] = JS_ToString(ctx, argv[i - 1]);
+        if (JS_IsException(tab[i])) {
+            r = JS_EXCEPTION;
+            goto done;
+        }
+        if (JS_VALUE_GET_TAG(tab[i]) == JS_TAG_STRING)
+            len += JS_VALUE_GET_STRING(tab[i])->len;
+        else
+            len += JS_STRING_ROPE_SHORT2_LEN + 1; /* rope */
+    }
+    if (n == 1)
+        return tab[0];
+    if (len <= JS_STRING_ROPE_SHORT2_LEN) {
+        r = js_string_join_list(ctx, tab, n, NULL);
+    } else {
+        /* long results are built as ropes */
+        r = JS_DupValue(ctx, tab[0]);
+        for(j = 1; j < n; j++) {
+            r = JS_ConcatString(ctx, r, JS_DupValue(ctx, tab[j]));
+            if (JS_IsException(r))
+                break;
+        }
     }
+ done:
+    while (--i >= 0)
+        JS_FreeValue(ctx, tab[i]);
+    if (tab != tab_buf)
+        js_free(ctx, tab);
     return r;
 }
 
-static int string_cmp(JSString *p1, JSString *p2, int x1, int x2, int len)
+/* The searches below use memchr(), memcmp() and memmem() on 8-bit
+   strings. 16-bit strings are compared 8 chars at a time with SSE2 or
+   NEON, which the x86_64 and arm64 ABIs always provide. */
+
+/* return the index of the first 'c' in buf[from..len) or -1 */
+static int js_u16_indexof(const uint16_t *buf, int from, int len, uint16_t c)
+{
+    int i = from;
+#if defined(__SSE2__)
+    const __m128i v = _mm_set1_epi16(c);
+    while (len - i >= 8) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(
+            _mm_loadu_si128((const __m128i *)(buf + i)), v));
+        if (mask != 0)
+            return i + (ctz32(mask) >> 1);
+        i += 8;
+    }
+#elif defined(__ARM_NEON)
+    const uint16x8_t v = vdupq_n_u16(c);
+    while (len - i >= 8) {
+        uint16x8_t m = vceqq_u16(vld1q_u16(buf + i), v);
+        /* one byte per char */
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(m, 4)), 0);
+        if (mask != 0)
+            return i + (ctz64(mask) >> 3);
+        i += 8;
+    }
+#endif
+    for (; i < len; i++) {
+        if (buf[i] == c)
+            return i;
+    }
+    return -1;
+}
+
+/* return the index of the first 'v' in buf[from..len) or -1 */
+static int js_u32_indexof(const uint32_t *buf, int from, int len, uint32_t v)
+{
+    int i = from;
+#if defined(__SSE2__)
+    const __m128i vv = _mm_set1_epi32(v);
+    while (len - i >= 4) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi32(
+            _mm_loadu_si128((const __m128i *)(buf + i)), vv));
+        if (mask != 0)
+            return i + (ctz32(mask) >> 2);
+        i += 4;
+    }
+#elif defined(__ARM_NEON)
+    const uint32x4_t vv = vdupq_n_u32(v);
+    while (len - i >= 4) {
+        uint32x4_t m = vceqq_u32(vld1q_u32(buf + i), vv);
+        /* two bytes per element */
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u16(vmovn_u32(m)), 0);
+        if (mask != 0)
+            return i + (ctz64(mask) >> 4);
+        i += 4;
+    }
+#endif
+    for (; i < len; i++) {
+        if (buf[i] == v)
+            return i;
+    }
+    return -1;
+}
+
+/* return TRUE if the 16-bit a[0..len) and the 8-bit b[0..len) are equal */
+static BOOL js_u16_equal_u8(const uint16_t *a, const uint8_t *b, int len)
 {
-    int i, c1, c2;
-    for (i = 0; i < len; i++) {
-        if ((c1 = string_get(p1, x1 + i)) != (c2 = string_get(p2, x2 + i)))
-            return c1 - c2;
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    while (len - i >= 8) {
+        __m128i wide = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(b + i)),
+                                         zero);
+        __m128i m = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)(a + i)), wide);
+        if (_mm_movemask_epi8(m) != 0xffff)
+            return FALSE;
+        i += 8;
     }
-    return 0;
+#elif defined(__ARM_NEON)
+    while (len - i >= 8) {
+        uint16x8_t m = vceqq_u16(vld1q_u16(a + i), vmovl_u8(vld1_u8(b + i)));
+        if (vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(m, 4)), 0) != UINT64_MAX)
+            return FALSE;
+        i += 8;
+    }
+#endif
+    for (; i < len; i++) {
+        if (a[i] != b[i])
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/* return 0 if p1[x1..x1+len) and p2[x2..x2+len) are equal */
+static int string_cmp(JSString *p1, JSString *p2, int x1, int x2, int len)
+{
+    if (!p1->is_wide_char && !p2->is_wide_char)
+        return memcmp(p1->u.str8 + x1, p2->u.str8 + x2, len);
+    if (p1->is_wide_char && p2->is_wide_char)
+        return memcmp(p1->u.str16 + x1, p2->u.str16 + x2, len * 2);
+    if (p1->is_wide_char)
+        return !js_u16_equal_u8(p1->u.str16 + x1, p2->u.str8 + x2, len);
+    else
+        return !js_u16_equal_u8(p2->u.str16 + x2, p1->u.str8 + x1, len);
 }
 
 static int string_indexof_char(JSString *p, int c, int from)
 {
     /* assuming 0 <= from <= p->len */
-    int i, len = p->len;
+    const uint8_t *q;
     if (p->is_wide_char) {
-        for (i = from; i < len; i++) {
-            if (p->u.str16[i] == c)
-                return i;
-        }
+        if ((c & ~0xffff) == 0)
+            return js_u16_indexof(p->u.str16, from, p->len, c);
     } else {
         if ((c & ~0xff) == 0) {
-            for (i = from; i < len; i++) {
-                if (p->u.str8[i] == (uint8_t)c)
-                    return i;
-            }
+            q = memchr(p->u.str8 + from, c, p->len - from);
+            if (q)
+                return q - p->u.str8;
         }
     }
     return -1;
@@ -41826,9 +43557,30 @@ static int string_indexof_char(JSString *p, int c, int from)
 static int string_indexof(JSString *p1, JSString *p2, int from)
 {
     /* assuming 0 <= from <= p1->len */
-    int c, i, j, len1 = p1->len, len2 = p2->len;
+    int c, i, j, misses, len1 = p1->len, len2 = p2->len;
+    const uint8_t *h, *n, *q;
     if (len2 == 0)
         return from;
+    if (!p1->is_wide_char && !p2->is_wide_char) {
+        /* memchr() on the first char is the fastest with few false
+           candidates; memmem() bounds the time when there are many */
+        h = p1->u.str8;
+        n = p2->u.str8;
+        misses = 0;
+        for (i = from; i + len2 <= len1; i = j + 1) {
+            if (misses++ == 32) {
+                q = memmem(h + i, len1 - i, n, len2);
+                return q ? q - h : -1;
+            }
+            q = memchr(h + i, n[0], len1 - len2 + 1 - i);
+            if (!q)
+                break;
+            j = q - h;
+            if (!memcmp(h + j + 1, n + 1, len2 - 1))
+                return j;
+        }
+        return -1;
+    }
     for (i = from, c = string_get(p2, 0); i + len2 <= len1; i = j + 1) {
         j = string_indexof_char(p1, c, i);
         if (j < 0 || j + len2 > len1)
@@ -41970,7 +43722,9 @@ static JSValue js_string_indexOf(JSContext *ctx, JSValueConst this_val,
         inc = 1;
     }
     ret = -1;
-    if (len >= v_len && inc * (stop - start) >= 0) {
+    if (len >= v_len && inc > 0 && start <= stop) {
+        ret = string_indexof(p, p1, start);
+    } else if (len >= v_len && inc * (stop - start) >= 0) {
         for (i = start;; i += inc) {
             if (!string_cmp(p, p1, i, 0, v_len)) {
                 ret = i;
@@ -41997,7 +43751,7 @@ static JSValue js_string_includes(JSContext *ctx, JSValueConst this_val,
                                   int argc, JSValueConst *argv, int magic)
 {
     JSValue str, v = JS_UNDEFINED;
-    int i, len, v_len, pos, start, stop, ret;
+    int len, v_len, pos, start, stop, ret;
     JSString *p;
     JSString *p1;
 
@@ -42037,14 +43791,10 @@ static JSValue js_string_includes(JSContext *ctx, JSValueConst this_val,
         start = stop = pos;
     }
     if (start >= 0 && start <= stop) {
-        for (i = start;; i++) {
-            if (!string_cmp(p, p1, i, 0, v_len)) {
-                ret = 1;
-                break;
-            }
-            if (i == stop)
-                break;
-        }
+        if (magic == 0)
+            ret = string_indexof(p, p1, start) >= 0;
+        else
+            ret = !string_cmp(p, p1, start, 0, v_len);
     }
  done:
     JS_FreeValue(ctx, str);
@@ -42738,6 +44488,91 @@ static BOOL test_final_sigma(JSString *p, int sigma_pos)
     return !lre_is_cased(c1);
 }
 
+/* toLowerCase() or toUpperCase() of an 8-bit string, 16 chars at a time.
+   Return JS_UNINITIALIZED if it is not pure ASCII, and 'val' itself if no
+   char changes. */
+static JSValue js_string_convert_case_ascii(JSContext *ctx, JSValue val,
+                                            int to_lower)
+{
+    JSString *p = JS_VALUE_GET_STRING(val), *r;
+    const uint8_t *src = p->u.str8;
+    uint8_t *dst;
+    int i, c, len = p->len;
+    /* the letters to convert are in [lo, lo + 26) */
+    int lo = to_lower ? 'A' : 'a';
+    int high = 0;
+    BOOL need_conv = FALSE;
+
+    i = 0;
+#if defined(__SSE2__)
+    /* move [lo, lo + 26) to the bottom of the signed range */
+    const __m128i bias = _mm_set1_epi8((char)(0x80 - lo));
+    const __m128i limit = _mm_set1_epi8((char)(-128 + 26));
+    const __m128i flip = _mm_set1_epi8(0x20);
+    __m128i vhigh = _mm_setzero_si128(), vconv = _mm_setzero_si128();
+    for (; len - i >= 16; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        vhigh = _mm_or_si128(vhigh, v);
+        vconv = _mm_or_si128(vconv, _mm_cmplt_epi8(_mm_add_epi8(v, bias), limit));
+    }
+    high = _mm_movemask_epi8(vhigh);
+    need_conv = _mm_movemask_epi8(vconv) != 0;
+#elif defined(__ARM_NEON)
+    const uint8x16_t base = vdupq_n_u8(lo);
+    const uint8x16_t count = vdupq_n_u8(26);
+    const uint8x16_t flip = vdupq_n_u8(0x20);
+    uint8x16_t vhigh = vdupq_n_u8(0), vconv = vdupq_n_u8(0);
+    for (; len - i >= 16; i += 16) {
+        uint8x16_t v = vld1q_u8(src + i);
+        vhigh = vorrq_u8(vhigh, v);
+        vconv = vorrq_u8(vconv, vcltq_u8(vsubq_u8(v, base), count));
+    }
+    high = (vget_lane_u64(vreinterpret_u64_u8(vorr_u8(vget_low_u8(vhigh),
+                                                      vget_high_u8(vhigh))), 0) &
+            0x8080808080808080) != 0;
+    need_conv = vget_lane_u64(vreinterpret_u64_u8(vorr_u8(vget_low_u8(vconv),
+                                                          vget_high_u8(vconv))), 0) != 0;
+#endif
+    for (; i < len; i++) {
+        c = src[i];
+        high |= c & 0x80;
+        need_conv |= (unsigned)(c - lo) < 26;
+    }
+    if (high)
+        return JS_UNINITIALIZED;
+    if (!need_conv)
+        return val;
+
+    r = js_alloc_string(ctx, len, 0);
+    if (!r) {
+        JS_FreeValue(ctx, val);
+        return JS_EXCEPTION;
+    }
+    dst = r->u.str8;
+    i = 0;
+#if defined(__SSE2__)
+    for (; len - i >= 16; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i m = _mm_cmplt_epi8(_mm_add_epi8(v, bias), limit);
+        _mm_storeu_si128((__m128i *)(dst + i),
+                         _mm_xor_si128(v, _mm_and_si128(m, flip)));
+    }
+#elif defined(__ARM_NEON)
+    for (; len - i >= 16; i += 16) {
+        uint8x16_t v = vld1q_u8(src + i);
+        uint8x16_t m = vcltq_u8(vsubq_u8(v, base), count);
+        vst1q_u8(dst + i, veorq_u8(v, vandq_u8(m, flip)));
+    }
+#endif
+    for (; i < len; i++) {
+        c = src[i];
+        dst[i] = ((unsigned)(c - lo) < 26) ? c ^ 0x20 : c;
+    }
+    dst[len] = '\0';
+    JS_FreeValue(ctx, val);
+    return JS_MKPTR(JS_TAG_STRING, r);
+}
+
 static JSValue js_string_toLowerCase(JSContext *ctx, JSValueConst this_val,
                                      int argc, JSValueConst *argv, int to_lower)
 {
@@ -42753,6 +44588,11 @@ static JSValue js_string_toLowerCase(JSContext *ctx, JSValueConst this_val,
     p = JS_VALUE_GET_STRING(val);
     if (p->len == 0)
         return val;
+    if (!p->is_wide_char) {
+        JSValue ret = js_string_convert_case_ascii(ctx, val, to_lower);
+        if (!JS_IsUninitialized(ret))
+            return ret;
+    }
     if (string_buffer_init(ctx, b, p->len))
         goto fail;
     for(i = 0; i < p->len;) {
@@ -43586,16 +45426,37 @@ static void js_regexp_finalizer(JSRuntime *rt, JSValue val)
     JS_FreeValueRT(rt, JS_MKPTR(JS_TAG_STRING, re->pattern));
 }
 
-/* create a string containing the RegExp bytecode */
+void JS_FlushRegExpCache(JSRuntime *rt)
+{
+    JSRegExpCacheEntry *e;
+    int i;
+
+    for(i = 0; i < JS_REGEXP_CACHE_SIZE; i++) {
+        e = &rt->regexp_cache[i];
+        if (e->pattern) {
+            JS_FreeValueRT(rt, JS_MKPTR(JS_TAG_STRING, e->pattern));
+            JS_FreeValueRT(rt, JS_MKPTR(JS_TAG_STRING, e->bytecode));
+            e->pattern = NULL;
+            e->bytecode = NULL;
+        }
+    }
+}
+
+/* create a string containing the RegExp bytecode. The bytecode is
+   immutable, so the result of the last compilation of each pattern and
+   flags is kept in the runtime and shared. */
 static JSValue js_compile_regexp(JSContext *ctx, JSValueConst pattern,
                                  JSValueConst flags)
 {
+    JSRuntime *rt = ctx->rt;
     const char *str;
     int re_flags, mask;
     uint8_t *re_bytecode_buf;
     size_t i, len;
     int re_bytecode_len;
     JSValue ret;
+    JSString *p;
+    JSRegExpCacheEntry *e;
     char error_msg[64];
 
     re_flags = 0;
@@ -43640,6 +45501,16 @@ static JSValue js_compile_regexp(JSContext *ctx, JSValueConst pattern,
         JS_FreeCString(ctx, str);
     }
 
+    e = NULL;
+    if (JS_VALUE_GET_TAG(pattern) == JS_TAG_STRING) {
+        p = JS_VALUE_GET_STRING(pattern);
+        e = &rt->regexp_cache[(hash_string(p, re_flags) * 0x9E3779B1) >>
+                              (32 - JS_REGEXP_CACHE_BITS)];
+        if (e->pattern && e->re_flags == re_flags &&
+            e->pattern->len == p->len && !js_string_compare(ctx, e->pattern, p))
+            return JS_DupValue(ctx, JS_MKPTR(JS_TAG_STRING, e->bytecode));
+    }
+
     str = JS_ToCStringLen2(ctx, &len, pattern, !(re_flags & LRE_FLAG_UNICODE));
     if (!str)
         return JS_EXCEPTION;
@@ -43653,6 +45524,15 @@ static JSValue js_compile_regexp(JSContext *ctx, JSValueConst pattern,
 
     ret = js_new_string8_len(ctx, (const char *)re_bytecode_buf, re_bytecode_len);
     js_free(ctx, re_bytecode_buf);
+    if (e && !JS_IsException(ret)) {
+        if (e->pattern) {
+            JS_FreeValueRT(rt, JS_MKPTR(JS_TAG_STRING, e->pattern));
+            JS_FreeValueRT(rt, JS_MKPTR(JS_TAG_STRING, e->bytecode));
+        }
+        e->pattern = JS_VALUE_GET_STRING(JS_DupValue(ctx, pattern));
+        e->bytecode = JS_VALUE_GET_STRING(JS_DupValue(ctx, ret));
+        e->re_flags = re_flags;
+    }
     return ret;
 }
 
@@ -45147,6 +47027,537 @@ void JS_AddIntrinsicRegExp(JSContext *ctx)
 
 /* JSON */
 
+/* Fast path of JS_ParseJSON2() for strict JSON. It works directly on the
+   UTF-8 input: string contents are scanned 16 bytes at a time for the
+   bytes that need attention, the common number forms are converted
+   without js_atof(), and the values of an array or object are collected
+   on a stack so that the container is allocated once with its final size.
+   Objects found at the same place in a document (e.g. the records of an
+   array) usually have the same keys in the same order: the shape of the
+   last one is kept, the keys of the next one are compared against it,
+   which avoids hashing them, and on a match the object is created with
+   that shape directly. Anything unusual (a syntax error, a lenient
+   escape, deep nesting) makes it give up, and the token based parser
+   then handles the whole input and reports the error. */
+
+#define JSON_SHAPE_CACHE_BITS 6
+
+typedef struct JSONFastParser {
+    JSContext *ctx;
+    const uint8_t *p;
+    const uint8_t *end;
+    BOOL give_up; /* the input is left to the token based parser */
+    /* property values and elements of the containers being parsed */
+    JSValue *values;
+    int values_count;
+    int values_size;
+    /* property names of the objects being parsed */
+    JSAtom *atoms;
+    int atoms_count;
+    int atoms_size;
+    /* shape of the last object parsed, indexed by place in the document */
+    JSShape *shapes[1 << JSON_SHAPE_CACHE_BITS];
+} JSONFastParser;
+
+static const double json_pow10[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static JSValue json_fast_value(JSONFastParser *jp, uint32_t hint);
+
+static JSValue json_fast_give_up(JSONFastParser *jp)
+{
+    jp->give_up = TRUE;
+    return JS_EXCEPTION;
+}
+
+static inline void json_fast_skip_ws(JSONFastParser *jp)
+{
+    const uint8_t *p = jp->p;
+    while (p < jp->end &&
+           (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+        p++;
+    jp->p = p;
+}
+
+/* Length of the run of string bytes at p with no special meaning: not
+   '"', '\\', a control character or part of a UTF-8 sequence */
+static inline size_t json_scan_plain(const uint8_t *p, const uint8_t *end)
+{
+    const uint8_t *p_start = p;
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i space = _mm_set1_epi8(0x20);
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        /* the signed comparison also catches the bytes >= 0x80 */
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                              _mm_cmpeq_epi8(v, backslash)),
+                                 _mm_cmplt_epi8(v, space));
+        unsigned int mask = _mm_movemask_epi8(m);
+        if (mask != 0)
+            return p - p_start + ctz32(mask);
+        p += 16;
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t space = vdupq_n_u8(0x20);
+    const uint8x16_t high = vdupq_n_u8(0x80);
+    while (end - p >= 16) {
+        uint8x16_t v = vld1q_u8(p);
+        uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, quote),
+                                         vceqq_u8(v, backslash)),
+                                vorrq_u8(vcltq_u8(v, space),
+                                         vcgeq_u8(v, high)));
+        /* narrow the byte mask to 4 bits per byte */
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+            vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+        if (mask != 0)
+            return p - p_start + (ctz64(mask) >> 2);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != '"' && *p != '\\' && *p >= 0x20 && *p < 0x80)
+        p++;
+    return p - p_start;
+}
+
+/* Append the rest of the string at jp->p, up to its closing quote, to b.
+   Return -1 on exception or if giving up */
+static int json_fast_string_buffer(JSONFastParser *jp, StringBuffer *b)
+{
+    const uint8_t *p = jp->p, *p_next;
+    size_t len;
+    uint32_t c;
+    int i, h;
+
+    for(;;) {
+        len = json_scan_plain(p, jp->end);
+        if (string_buffer_write8(b, p, len))
+            return -1;
+        p += len;
+        if (p >= jp->end)
+            break;
+        c = *p;
+        if (c == '"') {
+            jp->p = p + 1;
+            return 0;
+        } else if (c == '\\') {
+            if (jp->end - p < 2)
+                break;
+            switch(p[1]) {
+            case '"':
+            case '\\':
+            case '/':
+                c = p[1];
+                break;
+            case 'b':
+                c = '\b';
+                break;
+            case 'f':
+                c = '\f';
+                break;
+            case 'n':
+                c = '\n';
+                break;
+            case 'r':
+                c = '\r';
+                break;
+            case 't':
+                c = '\t';
+                break;
+            case 'u':
+                if (jp->end - p < 6)
+                    goto give_up;
+                c = 0;
+                for(i = 2; i < 6; i++) {
+                    h = from_hex(p[i]);
+                    if (h < 0)
+                        goto give_up;
+                    c = (c << 4) | h;
+                }
+                /* surrogate pairs are made of two escapes */
+                if (string_buffer_putc16(b, c))
+                    return -1;
+                p += 6;
+                continue;
+            default:
+                goto give_up;
+            }
+            if (string_buffer_putc8(b, c))
+                return -1;
+            p += 2;
+        } else if (c >= 0x80) {
+            c = unicode_from_utf8(p, min_int(UTF8_CHAR_LEN_MAX, jp->end - p),
+                                  &p_next);
+            if (c > 0x10FFFF)
+                break;
+            if (string_buffer_putc(b, c))
+                return -1;
+            p = p_next;
+        } else {
+            break; /* control character */
+        }
+    }
+ give_up:
+    jp->give_up = TRUE;
+    return -1;
+}
+
+/* Parse the string after its opening quote */
+static JSValue json_fast_string(JSONFastParser *jp)
+{
+    const uint8_t *p = jp->p;
+    StringBuffer b_s, *b = &b_s;
+    size_t len;
+
+    len = json_scan_plain(p, jp->end);
+    if (unlikely(len > JS_STRING_LEN_MAX))
+        return json_fast_give_up(jp);
+    if (likely(p + len < jp->end && p[len] == '"')) {
+        jp->p = p + len + 1;
+        return js_new_string8_len(jp->ctx, (const char *)p, len);
+    }
+    if (string_buffer_init(jp->ctx, b, len + 16))
+        return JS_EXCEPTION;
+    if (json_fast_string_buffer(jp, b)) {
+        string_buffer_free(b);
+        return JS_EXCEPTION;
+    }
+    return string_buffer_end(b);
+}
+
+/* Parse the property name after its opening quote. 'expected' is the
+   name the object's shape prediction expects, or JS_ATOM_NULL */
+static JSAtom json_fast_key(JSONFastParser *jp, JSAtom expected)
+{
+    const uint8_t *p = jp->p;
+    JSString *str;
+    JSValue val;
+    size_t len;
+
+    len = json_scan_plain(p, jp->end);
+    if (likely(p + len < jp->end && p[len] == '"')) {
+        jp->p = p + len + 1;
+        if (expected != JS_ATOM_NULL && !__JS_AtomIsTaggedInt(expected)) {
+            str = jp->ctx->rt->atom_array[expected];
+            if (!str->is_wide_char && str->len == len &&
+                memcmp(str->u.str8, p, len) == 0)
+                return JS_DupAtom(jp->ctx, expected);
+        }
+        return JS_NewAtomLen(jp->ctx, (const char *)p, len);
+    }
+    val = json_fast_string(jp);
+    if (JS_IsException(val))
+        return JS_ATOM_NULL;
+    return JS_NewAtomStr(jp->ctx, JS_VALUE_GET_STRING(val));
+}
+
+static JSValue json_fast_number(JSONFastParser *jp)
+{
+    const uint8_t *p = jp->p, *end = jp->end, *p_digits, *p_frac;
+    uint64_t m;
+    int n_digits, exp, e, e_sign;
+    BOOL is_neg;
+    double d;
+
+    is_neg = FALSE;
+    if (p < end && *p == '-') {
+        is_neg = TRUE;
+        p++;
+    }
+    if (p >= end || !is_digit(*p))
+        return json_fast_give_up(jp);
+    /* the digits beyond the 19th do not fit m and are not used */
+    m = 0;
+    p_digits = p;
+    if (*p == '0') {
+        p++;
+        if (p < end && is_digit(*p))
+            return json_fast_give_up(jp);
+    } else {
+        while (p < end && is_digit(*p))
+            m = m * 10 + (*p++ - '0');
+    }
+    n_digits = p - p_digits;
+    exp = 0;
+    if (p < end && *p == '.') {
+        p_frac = ++p;
+        if (p >= end || !is_digit(*p))
+            return json_fast_give_up(jp);
+        while (p < end && is_digit(*p))
+            m = m * 10 + (*p++ - '0');
+        exp = -(int)(p - p_frac);
+        n_digits += p - p_frac;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        e_sign = 1;
+        if (p < end && (*p == '+' || *p == '-')) {
+            if (*p == '-')
+                e_sign = -1;
+            p++;
+        }
+        if (p >= end || !is_digit(*p))
+            return json_fast_give_up(jp);
+        e = 0;
+        while (p < end && is_digit(*p)) {
+            if (e < 100000)
+                e = e * 10 + (*p - '0');
+            p++;
+        }
+        exp += e_sign * e;
+    }
+
+    if (n_digits <= 19 && m <= ((uint64_t)1 << 53) && exp >= -22 && exp <= 22) {
+        /* both operands are exact, so the result is correctly rounded */
+        d = (double)m;
+        if (exp < 0)
+            d /= json_pow10[-exp];
+        else
+            d *= json_pow10[exp];
+        if (is_neg)
+            d = -d;
+        jp->p = p;
+        return JS_NewFloat64(jp->ctx, d);
+    }
+    jp->p = p;
+    return js_atof(jp->ctx, (const char *)p_digits - is_neg, NULL, 10, 0);
+}
+
+static JSValue json_fast_literal(JSONFastParser *jp, const char *str,
+                                 size_t len, JSValue val)
+{
+    const uint8_t *p = jp->p;
+
+    if (jp->end - p < len || memcmp(p, str, len) != 0 ||
+        (p + len < jp->end &&
+         (p[len] >= 0x80 || lre_is_id_continue_byte(p[len]))))
+        return json_fast_give_up(jp);
+    jp->p = p + len;
+    return val;
+}
+
+static int json_fast_push_value(JSONFastParser *jp, JSValue val)
+{
+    if (js_resize_array(jp->ctx, (void **)&jp->values, sizeof(jp->values[0]),
+                        &jp->values_size, jp->values_count + 1)) {
+        JS_FreeValue(jp->ctx, val);
+        return -1;
+    }
+    jp->values[jp->values_count++] = val;
+    return 0;
+}
+
+/* 'hint' identifies the place of the value in the document */
+static JSValue json_fast_object(JSONFastParser *jp, uint32_t hint)
+{
+    JSContext *ctx = jp->ctx;
+    int slot = (hint * 0x9E3779B1) >> (32 - JSON_SHAPE_CACHE_BITS);
+    JSShape *sh = jp->shapes[slot];
+    BOOL predicted = (sh != NULL); /* the names so far match sh */
+    int values_base = jp->values_count;
+    int atoms_base = jp->atoms_count;
+    int i, n;
+    JSAtom atom;
+    JSValue val, obj;
+    JSObject *p;
+
+    jp->p++;
+    json_fast_skip_ws(jp);
+    if (jp->p < jp->end && *jp->p == '}') {
+        jp->p++;
+        return JS_NewObject(ctx);
+    }
+    for(;;) {
+        if (jp->p >= jp->end || *jp->p != '"')
+            return json_fast_give_up(jp);
+        jp->p++;
+        n = jp->atoms_count - atoms_base;
+        predicted = predicted && n < sh->prop_count;
+        atom = json_fast_key(jp, predicted ? get_shape_prop(sh)[n].atom :
+                             JS_ATOM_NULL);
+        if (atom == JS_ATOM_NULL)
+            return JS_EXCEPTION;
+        if (js_resize_array(ctx, (void **)&jp->atoms, sizeof(jp->atoms[0]),
+                            &jp->atoms_size, jp->atoms_count + 1)) {
+            JS_FreeAtom(ctx, atom);
+            return JS_EXCEPTION;
+        }
+        jp->atoms[jp->atoms_count++] = atom;
+        predicted = predicted && atom == get_shape_prop(sh)[n].atom;
+
+        json_fast_skip_ws(jp);
+        if (jp->p >= jp->end || *jp->p != ':')
+            return json_fast_give_up(jp);
+        jp->p++;
+        json_fast_skip_ws(jp);
+        val = json_fast_value(jp, atom);
+        if (JS_IsException(val))
+            return JS_EXCEPTION;
+        if (json_fast_push_value(jp, val))
+            return JS_EXCEPTION;
+
+        json_fast_skip_ws(jp);
+        if (jp->p >= jp->end)
+            return json_fast_give_up(jp);
+        if (*jp->p == '}') {
+            jp->p++;
+            break;
+        }
+        if (*jp->p != ',')
+            return json_fast_give_up(jp);
+        jp->p++;
+        json_fast_skip_ws(jp);
+    }
+
+    n = jp->atoms_count - atoms_base;
+    if (predicted && n == sh->prop_count) {
+        obj = JS_NewObjectFromShape(ctx, js_dup_shape(sh), JS_CLASS_OBJECT);
+        if (JS_IsException(obj))
+            return obj;
+        p = JS_VALUE_GET_OBJ(obj);
+        for(i = 0; i < n; i++)
+            p->prop[i].u.value = jp->values[values_base + i];
+    } else {
+        obj = JS_NewObject(ctx);
+        if (JS_IsException(obj))
+            return obj;
+        for(i = 0; i < n; i++) {
+            val = jp->values[values_base + i];
+            jp->values[values_base + i] = JS_UNDEFINED;
+            if (JS_DefinePropertyValue(ctx, obj, jp->atoms[atoms_base + i],
+                                       val, JS_PROP_C_W_E) < 0) {
+                JS_FreeValue(ctx, obj);
+                return JS_EXCEPTION;
+            }
+        }
+        /* predict the next object at this place, unless names repeated */
+        p = JS_VALUE_GET_OBJ(obj);
+        if (p->shape->is_hashed && p->shape->prop_count == n) {
+            if (sh)
+                js_free_shape(ctx->rt, sh);
+            jp->shapes[slot] = js_dup_shape(p->shape);
+        }
+    }
+    for(i = atoms_base; i < jp->atoms_count; i++)
+        JS_FreeAtom(ctx, jp->atoms[i]);
+    jp->atoms_count = atoms_base;
+    jp->values_count = values_base;
+    return obj;
+}
+
+static JSValue json_fast_array(JSONFastParser *jp, uint32_t hint)
+{
+    JSContext *ctx = jp->ctx;
+    int values_base = jp->values_count;
+    int n;
+    JSValue val, arr;
+    JSObject *p;
+
+    jp->p++;
+    json_fast_skip_ws(jp);
+    if (jp->p < jp->end && *jp->p == ']') {
+        jp->p++;
+        return JS_NewArray(ctx);
+    }
+    for(;;) {
+        val = json_fast_value(jp, hint + 1);
+        if (JS_IsException(val))
+            return JS_EXCEPTION;
+        if (json_fast_push_value(jp, val))
+            return JS_EXCEPTION;
+        json_fast_skip_ws(jp);
+        if (jp->p >= jp->end)
+            return json_fast_give_up(jp);
+        if (*jp->p == ']') {
+            jp->p++;
+            break;
+        }
+        if (*jp->p != ',')
+            return json_fast_give_up(jp);
+        jp->p++;
+        json_fast_skip_ws(jp);
+    }
+
+    n = jp->values_count - values_base;
+    arr = js_allocate_fast_array(ctx, n);
+    if (JS_IsException(arr))
+        return arr;
+    p = JS_VALUE_GET_OBJ(arr);
+    memcpy(p->u.array.u.values, jp->values + values_base,
+           n * sizeof(jp->values[0]));
+    p->prop[0].u.value = JS_NewInt32(ctx, n); /* length */
+    jp->values_count = values_base;
+    return arr;
+}
+
+static JSValue json_fast_value(JSONFastParser *jp, uint32_t hint)
+{
+    if (jp->p >= jp->end)
+        return json_fast_give_up(jp);
+    switch(*jp->p) {
+    case '{':
+        if (js_check_stack_overflow(jp->ctx->rt, 0))
+            return json_fast_give_up(jp);
+        return json_fast_object(jp, hint);
+    case '[':
+        if (js_check_stack_overflow(jp->ctx->rt, 0))
+            return json_fast_give_up(jp);
+        return json_fast_array(jp, hint);
+    case '"':
+        jp->p++;
+        return json_fast_string(jp);
+    case 't':
+        return json_fast_literal(jp, "true", 4, JS_TRUE);
+    case 'f':
+        return json_fast_literal(jp, "false", 5, JS_FALSE);
+    case 'n':
+        return json_fast_literal(jp, "null", 4, JS_NULL);
+    default:
+        return json_fast_number(jp);
+    }
+}
+
+/* Return JS_UNINITIALIZED if the input is left to the token based parser */
+static JSValue json_parse_fast(JSContext *ctx, const char *buf, size_t buf_len)
+{
+    JSONFastParser jp_s, *jp = &jp_s;
+    JSValue val;
+    int i;
+
+    memset(jp, 0, sizeof(*jp));
+    jp->ctx = ctx;
+    jp->p = (const uint8_t *)buf;
+    jp->end = jp->p + buf_len;
+    json_fast_skip_ws(jp);
+    val = json_fast_value(jp, 0);
+    if (!JS_IsException(val)) {
+        json_fast_skip_ws(jp);
+        if (jp->p != jp->end) {
+            JS_FreeValue(ctx, val);
+            val = json_fast_give_up(jp);
+        }
+    }
+
+    for(i = 0; i < jp->values_count; i++)
+        JS_FreeValue(ctx, jp->values[i]);
+    for(i = 0; i < jp->atoms_count; i++)
+        JS_FreeAtom(ctx, jp->atoms[i]);
+    js_free(ctx, jp->values);
+    js_free(ctx, jp->atoms);
+    for(i = 0; i < countof(jp->shapes); i++) {
+        if (jp->shapes[i])
+            js_free_shape(ctx->rt, jp->shapes[i]);
+    }
+    if (jp->give_up)
+        return JS_UNINITIALIZED;
+    return val;
+}
+
 static int json_parse_expect(JSParseState *s, int tok)
 {
     if (s->token.val != tok) {
@@ -45289,6 +47700,11 @@ JSValue JS_ParseJSON2(JSContext *ctx, const char *buf, size_t buf_len,
     JSParseState s1, *s = &s1;
     JSValue val = JS_UNDEFINED;
 
+    if (!(flags & JS_PARSE_JSON_EXT)) {
+        val = json_parse_fast(ctx, buf, buf_len);
+        if (!JS_IsUninitialized(val))
+            return val;
+    }
     js_parse_init(ctx, s, buf, buf_len, filename);
     s->ext_json = ((flags & JS_PARSE_JSON_EXT) != 0);
     if (json_next_token(s))
@@ -45418,11 +47834,15 @@ static JSValue js_json_parse(JSContext *ctx, JSValueConst this_val,
 
 typedef struct JSONStringifyContext {
     JSValueConst replacer_func;
-    JSValue stack;
+    /* objects being serialized, to detect cycles */
+    JSObject **stack;
+    int stack_len;
+    int stack_size;
     JSValue property_list;
     JSValue gap;
     JSValue empty;
     StringBuffer *b;
+    BOOL fast; /* no replacer, property list or gap */
 } JSONStringifyContext;
 
 static JSValue JS_ToQuotedStringFree(JSContext *ctx, JSValue val) {
@@ -45489,6 +47909,445 @@ exception:
     return JS_EXCEPTION;
 }
 
+static int js_json_push(JSContext *ctx, JSONStringifyContext *jsc,
+                        JSValueConst val)
+{
+    JSObject *p = JS_VALUE_GET_OBJ(val);
+    int i;
+
+    for(i = 0; i < jsc->stack_len; i++) {
+        if (jsc->stack[i] == p) {
+            JS_ThrowTypeError(ctx, "circular reference");
+            return -1;
+        }
+    }
+    if (js_resize_array(ctx, (void **)&jsc->stack, sizeof(jsc->stack[0]),
+                        &jsc->stack_size, jsc->stack_len + 1))
+        return -1;
+    jsc->stack[jsc->stack_len++] = p;
+    return 0;
+}
+
+/* JSON.stringify() fast path. Without a replacer, a property list or a
+   gap, plain objects and fast arrays whose prototype chain has no toJSON
+   are serialized directly from their properties and elements. For the
+   objects of a hashed shape, the enumerable properties to serialize and
+   their quoted keys are computed once and kept with the shape as a plan,
+   dropped when the shape changes. Values that may run code (toJSON
+   methods, accessors, proxies, ...) take the generic path; since that
+   code may modify the object being serialized, its remaining properties
+   are then read through property lookups unless it kept its shape. */
+
+typedef struct JSJSONPlan {
+    int count; /* -1 if the objects of the shape take the generic path */
+    uint32_t *prop_index; /* index in JSObject.prop, per property */
+    uint32_t *key_end; /* end of the quoted key and ':' in keys */
+    uint8_t *keys;
+    uint32_t data[0]; /* prop_index, key_end and keys */
+} JSJSONPlan;
+
+enum {
+    JSON_VALUE_SKIP,    /* undefined or a symbol: omitted */
+    JSON_VALUE_FAST,
+    JSON_VALUE_GENERIC, /* through js_json_check() and js_json_to_str() */
+};
+
+/* Length of the run at p of Latin-1 characters copied as they are */
+static inline size_t json_scan_unescaped8(const uint8_t *p, size_t len)
+{
+    const uint8_t *p_start = p, *end = p + len;
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1f);
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                              _mm_cmpeq_epi8(v, backslash)),
+                                 _mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+        unsigned int mask = _mm_movemask_epi8(m);
+        if (mask != 0)
+            return p - p_start + ctz32(mask);
+        p += 16;
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t space = vdupq_n_u8(0x20);
+    while (end - p >= 16) {
+        uint8x16_t v = vld1q_u8(p);
+        uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, quote),
+                                         vceqq_u8(v, backslash)),
+                                vcltq_u8(v, space));
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+            vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+        if (mask != 0)
+            return p - p_start + (ctz64(mask) >> 2);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != '"' && *p != '\\' && *p >= 0x20)
+        p++;
+    return p - p_start;
+}
+
+/* Append a Latin-1 string quoted as by JS_ToQuotedString() */
+static int json_put_quoted8(StringBuffer *b, const uint8_t *str, size_t len)
+{
+    size_t i, n;
+    char buf[8];
+    int c;
+
+    if (string_buffer_putc8(b, '\"'))
+        return -1;
+    i = 0;
+    for(;;) {
+        n = json_scan_unescaped8(str + i, len - i);
+        if (string_buffer_write8(b, str + i, n))
+            return -1;
+        i += n;
+        if (i >= len)
+            break;
+        c = str[i++];
+        switch(c) {
+        case '\t':
+            c = 't';
+            goto quote;
+        case '\r':
+            c = 'r';
+            goto quote;
+        case '\n':
+            c = 'n';
+            goto quote;
+        case '\b':
+            c = 'b';
+            goto quote;
+        case '\f':
+            c = 'f';
+            goto quote;
+        case '\"':
+        case '\\':
+        quote:
+            if (string_buffer_putc8(b, '\\') || string_buffer_putc8(b, c))
+                return -1;
+            break;
+        default:
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            if (string_buffer_puts8(b, buf))
+                return -1;
+            break;
+        }
+    }
+    return string_buffer_putc8(b, '\"');
+}
+
+/* Whether looking up toJSON from p finds nothing without running code */
+static BOOL js_json_no_tojson(JSObject *p)
+{
+    JSProperty *pr;
+
+    for(; p != NULL; p = p->shape->proto) {
+        if (p->class_id != JS_CLASS_OBJECT && p->class_id != JS_CLASS_ARRAY)
+            return FALSE;
+        if (find_own_property(&pr, p, JS_ATOM_toJSON))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/* Return the plan of a hashed shape, or NULL on exception */
+static JSJSONPlan *js_json_get_plan(JSContext *ctx, JSShape *sh)
+{
+    JSRuntime *rt = ctx->rt;
+    JSShapeProperty *prs;
+    JSJSONPlan *plan, *new_plan;
+    JSString *str;
+    StringBuffer b_s, *b = &b_s;
+    uint32_t i, idx;
+    int count;
+
+    if (sh->json_plan)
+        return sh->json_plan;
+
+    count = 0;
+    for(i = 0, prs = get_shape_prop(sh); i < sh->prop_count; i++, prs++) {
+        if (prs->atom == JS_ATOM_NULL)
+            continue;
+        /* index properties are enumerated first */
+        if (prs->atom == JS_ATOM_toJSON || __JS_AtomIsTaggedInt(prs->atom))
+            goto generic;
+        str = rt->atom_array[prs->atom];
+        if (str->atom_type != JS_ATOM_TYPE_STRING ||
+            !(prs->flags & JS_PROP_ENUMERABLE))
+            continue;
+        if ((prs->flags & JS_PROP_TMASK) != JS_PROP_NORMAL ||
+            str->is_wide_char || is_num_string(&idx, str))
+            goto generic;
+        count++;
+    }
+
+    plan = js_malloc(ctx, sizeof(*plan) + count * 2 * sizeof(uint32_t));
+    if (!plan)
+        return NULL;
+    plan->count = count;
+    plan->prop_index = (uint32_t *)plan->data;
+    plan->key_end = plan->prop_index + count;
+    if (string_buffer_init(ctx, b, count * 8))
+        goto fail;
+    count = 0;
+    for(i = 0, prs = get_shape_prop(sh); i < sh->prop_count; i++, prs++) {
+        if (prs->atom == JS_ATOM_NULL || !(prs->flags & JS_PROP_ENUMERABLE))
+            continue;
+        str = rt->atom_array[prs->atom];
+        if (str->atom_type != JS_ATOM_TYPE_STRING)
+            continue;
+        if (json_put_quoted8(b, str->u.str8, str->len) ||
+            string_buffer_putc8(b, ':'))
+            goto fail;
+        plan->prop_index[count] = i;
+        plan->key_end[count] = b->len;
+        count++;
+    }
+    new_plan = js_realloc(ctx, plan, sizeof(*plan) +
+                          count * 2 * sizeof(uint32_t) + b->len);
+    if (!new_plan)
+        goto fail;
+    plan = new_plan;
+    plan->prop_index = (uint32_t *)plan->data;
+    plan->key_end = plan->prop_index + count;
+    plan->keys = (uint8_t *)(plan->key_end + count);
+    memcpy(plan->keys, b->str->u.str8, b->len);
+    string_buffer_free(b);
+    sh->json_plan = plan;
+    return plan;
+ fail:
+    string_buffer_free(b);
+    js_free(ctx, plan);
+    return NULL;
+ generic:
+    plan = js_malloc(ctx, sizeof(*plan));
+    if (!plan)
+        return NULL;
+    plan->count = -1;
+    sh->json_plan = plan;
+    return plan;
+}
+
+/* Return JSON_VALUE_xxx, or -1 on exception */
+static int js_json_classify(JSContext *ctx, JSValueConst v)
+{
+    JSObject *p;
+    JSJSONPlan *plan;
+
+    switch(JS_VALUE_GET_NORM_TAG(v)) {
+    case JS_TAG_INT:
+    case JS_TAG_BOOL:
+    case JS_TAG_NULL:
+    case JS_TAG_FLOAT64:
+    case JS_TAG_STRING:
+        return JSON_VALUE_FAST;
+    case JS_TAG_UNDEFINED:
+    case JS_TAG_SYMBOL:
+        return JSON_VALUE_SKIP;
+    case JS_TAG_OBJECT:
+        p = JS_VALUE_GET_OBJ(v);
+        if (p->class_id == JS_CLASS_OBJECT) {
+            if (!p->shape->is_hashed || !js_json_no_tojson(p->shape->proto))
+                return JSON_VALUE_GENERIC;
+            plan = js_json_get_plan(ctx, p->shape);
+            if (!plan)
+                return -1;
+            return plan->count >= 0 ? JSON_VALUE_FAST : JSON_VALUE_GENERIC;
+        }
+        if (p->class_id == JS_CLASS_ARRAY && p->fast_array &&
+            js_json_no_tojson(p))
+            return JSON_VALUE_FAST;
+        return JSON_VALUE_GENERIC;
+    default:
+        return JSON_VALUE_GENERIC;
+    }
+}
+
+static int js_json_to_str(JSContext *ctx, JSONStringifyContext *jsc,
+                          JSValueConst holder, JSValue val,
+                          JSValueConst indent);
+static int js_json_fast_object(JSContext *ctx, JSONStringifyContext *jsc,
+                               JSValueConst val);
+static int js_json_fast_array(JSContext *ctx, JSONStringifyContext *jsc,
+                              JSValueConst val);
+
+/* Append a value classified as JSON_VALUE_FAST */
+static int js_json_fast_value(JSContext *ctx, JSONStringifyContext *jsc,
+                              JSValueConst v)
+{
+    StringBuffer *b = jsc->b;
+    JSString *str;
+    JSObject *p;
+    JSValue obj;
+    char buf[16];
+    int ret;
+
+    switch(JS_VALUE_GET_NORM_TAG(v)) {
+    case JS_TAG_INT:
+        return string_buffer_write8(b, (const uint8_t *)buf,
+                                    i32toa(buf, JS_VALUE_GET_INT(v)));
+    case JS_TAG_BOOL:
+        return string_buffer_puts8(b, JS_VALUE_GET_BOOL(v) ? "true" : "false");
+    case JS_TAG_NULL:
+        return string_buffer_puts8(b, "null");
+    case JS_TAG_FLOAT64:
+        if (!isfinite(JS_VALUE_GET_FLOAT64(v)))
+            return string_buffer_puts8(b, "null");
+        return string_buffer_concat_value(b, v);
+    case JS_TAG_STRING:
+        str = JS_VALUE_GET_STRING(v);
+        if (!str->is_wide_char)
+            return json_put_quoted8(b, str->u.str8, str->len);
+        return string_buffer_concat_value_free(b, JS_ToQuotedString(ctx, v));
+    default:
+        /* held, the code run for its own values could delete it */
+        obj = JS_DupValue(ctx, v);
+        p = JS_VALUE_GET_OBJ(obj);
+        if (p->class_id == JS_CLASS_ARRAY)
+            ret = js_json_fast_array(ctx, jsc, obj);
+        else
+            ret = js_json_fast_object(ctx, jsc, obj);
+        JS_FreeValue(ctx, obj);
+        return ret;
+    }
+}
+
+static int js_json_fast_object(JSContext *ctx, JSONStringifyContext *jsc,
+                               JSValueConst val)
+{
+    StringBuffer *b = jsc->b;
+    JSObject *p = JS_VALUE_GET_OBJ(val);
+    /* held so that it and its plan stay as they are */
+    JSShape *sh = js_dup_shape(p->shape);
+    JSJSONPlan *plan = sh->json_plan;
+    BOOL has_content = FALSE;
+    uint32_t key_start;
+    JSAtom atom;
+    JSValue v, prop;
+    int i, kind, ret = -1;
+
+    if (js_check_stack_overflow(ctx->rt, 0)) {
+        JS_ThrowStackOverflow(ctx);
+        goto done;
+    }
+    if (js_json_push(ctx, jsc, val))
+        goto done;
+    string_buffer_putc8(b, '{');
+    for(i = 0; i < plan->count; i++) {
+        if (likely(p->shape == sh)) {
+            v = JS_DupValue(ctx, p->prop[plan->prop_index[i]].u.value);
+        } else {
+            /* modified by the code run for a previous value */
+            atom = get_shape_prop(sh)[plan->prop_index[i]].atom;
+            v = JS_GetProperty(ctx, val, atom);
+            if (JS_IsException(v))
+                goto done;
+        }
+        kind = js_json_classify(ctx, v);
+        if (kind == JSON_VALUE_GENERIC) {
+            prop = JS_AtomToString(ctx, get_shape_prop(sh)[plan->prop_index[i]].atom);
+            if (JS_IsException(prop)) {
+                JS_FreeValue(ctx, v);
+                goto done;
+            }
+            v = js_json_check(ctx, jsc, val, v, prop);
+            JS_FreeValue(ctx, prop);
+            if (JS_IsException(v))
+                goto done;
+            if (JS_IsUndefined(v))
+                continue;
+        } else if (kind != JSON_VALUE_FAST) {
+            JS_FreeValue(ctx, v);
+            if (kind < 0)
+                goto done;
+            continue;
+        }
+        if (has_content)
+            string_buffer_putc8(b, ',');
+        has_content = TRUE;
+        key_start = i ? plan->key_end[i - 1] : 0;
+        string_buffer_write8(b, plan->keys + key_start,
+                             plan->key_end[i] - key_start);
+        if (kind == JSON_VALUE_FAST) {
+            ret = js_json_fast_value(ctx, jsc, v);
+            JS_FreeValue(ctx, v);
+        } else {
+            ret = js_json_to_str(ctx, jsc, val, v, jsc->empty);
+        }
+        if (ret)
+            goto done;
+    }
+    ret = string_buffer_putc8(b, '}');
+    jsc->stack_len--;
+ done:
+    js_free_shape(ctx->rt, sh);
+    return ret;
+}
+
+static int js_json_fast_array(JSContext *ctx, JSONStringifyContext *jsc,
+                              JSValueConst val)
+{
+    StringBuffer *b = jsc->b;
+    JSObject *p = JS_VALUE_GET_OBJ(val);
+    JSValue v, prop;
+    int64_t i, len;
+    int kind, ret;
+
+    if (js_check_stack_overflow(ctx->rt, 0)) {
+        JS_ThrowStackOverflow(ctx);
+        return -1;
+    }
+    if (js_json_push(ctx, jsc, val))
+        return -1;
+    if (js_get_length64(ctx, &len, val))
+        return -1;
+    string_buffer_putc8(b, '[');
+    for(i = 0; i < len; i++) {
+        if (i > 0)
+            string_buffer_putc8(b, ',');
+        /* elements of a fast array are plain values */
+        if (likely(p->fast_array && i < p->u.array.count)) {
+            v = JS_DupValue(ctx, p->u.array.u.values[i]);
+        } else {
+            v = JS_GetPropertyInt64(ctx, val, i);
+            if (JS_IsException(v))
+                return -1;
+        }
+        kind = js_json_classify(ctx, v);
+        if (kind == JSON_VALUE_FAST) {
+            ret = js_json_fast_value(ctx, jsc, v);
+            JS_FreeValue(ctx, v);
+        } else if (kind == JSON_VALUE_GENERIC) {
+            prop = JS_ToStringFree(ctx, JS_NewInt64(ctx, i));
+            if (JS_IsException(prop)) {
+                JS_FreeValue(ctx, v);
+                return -1;
+            }
+            v = js_json_check(ctx, jsc, val, v, prop);
+            JS_FreeValue(ctx, prop);
+            if (JS_IsException(v))
+                return -1;
+            if (JS_IsUndefined(v))
+                v = JS_NULL;
+            ret = js_json_to_str(ctx, jsc, val, v, jsc->empty);
+        } else {
+            JS_FreeValue(ctx, v);
+            if (kind < 0)
+                return -1;
+            ret = string_buffer_puts8(b, "null");
+        }
+        if (ret)
+            return -1;
+    }
+    jsc->stack_len--;
+    return string_buffer_putc8(b, ']');
+}
+
 static int js_json_to_str(JSContext *ctx, JSONStringifyContext *jsc,
                           JSValueConst holder, JSValue val,
                           JSValueConst indent)
@@ -45529,13 +48388,18 @@ static int js_json_to_str(JSContext *ctx, JSONStringifyContext *jsc,
             set_value(ctx, &val, JS_DupValue(ctx, p->u.object_data));
             goto concat_primitive;
         }
-        v = js_array_includes(ctx, jsc->stack, 1, (JSValueConst *)&val);
-        if (JS_IsException(v))
-            goto exception;
-        if (JS_ToBoolFree(ctx, v)) {
-            JS_ThrowTypeError(ctx, "circular reference");
-            goto exception;
+        if (jsc->fast) {
+            ret = js_json_classify(ctx, val);
+            if (ret < 0)
+                goto exception;
+            if (ret == JSON_VALUE_FAST) {
+                ret = js_json_fast_value(ctx, jsc, val);
+                JS_FreeValue(ctx, val);
+                return ret;
+            }
         }
+        if (js_json_push(ctx, jsc, val))
+            goto exception;
         indent1 = JS_ConcatString(ctx, JS_DupValue(ctx, indent), JS_DupValue(ctx, jsc->gap));
         if (JS_IsException(indent1))
             goto exception;
@@ -45550,9 +48414,6 @@ static int js_json_to_str(JSContext *ctx, JSONStringifyContext *jsc,
             sep = JS_DupValue(ctx, jsc->empty);
             sep1 = JS_DupValue(ctx, jsc->empty);
         }
-        v = js_array_push(ctx, jsc->stack, 1, (JSValueConst *)&val, 0);
-        if (check_exception_free(ctx, v))
-            goto exception;
         ret = JS_IsArray(ctx, val);
         if (ret < 0)
             goto exception;
@@ -45631,8 +48492,7 @@ static int js_json_to_str(JSContext *ctx, JSONStringifyContext *jsc,
             }
             string_buffer_putc8(jsc->b, '}');
         }
-        if (check_exception_free(ctx, js_array_pop(ctx, jsc->stack, 0, NULL, 0)))
-            goto exception;
+        jsc->stack_len--;
         JS_FreeValue(ctx, val);
         JS_FreeValue(ctx, tab);
         JS_FreeValue(ctx, sep);
@@ -45689,7 +48549,9 @@ JSValue JS_JSONStringify(JSContext *ctx, JSValueConst obj,
     int64_t i, j, n;
 
     jsc->replacer_func = JS_UNDEFINED;
-    jsc->stack = JS_UNDEFINED;
+    jsc->stack = NULL;
+    jsc->stack_len = 0;
+    jsc->stack_size = 0;
     jsc->property_list = JS_UNDEFINED;
     jsc->gap = JS_UNDEFINED;
     jsc->b = &b_s;
@@ -45698,9 +48560,6 @@ JSValue JS_JSONStringify(JSContext *ctx, JSValueConst obj,
     wrapper = JS_UNDEFINED;
 
     string_buffer_init(ctx, jsc->b, 0);
-    jsc->stack = JS_NewArray(ctx);
-    if (JS_IsException(jsc->stack))
-        goto exception;
     if (JS_IsFunction(ctx, replacer)) {
         jsc->replacer_func = replacer;
     } else {
@@ -45779,6 +48638,8 @@ JSValue JS_JSONStringify(JSContext *ctx, JSValueConst obj,
     JS_FreeValue(ctx, space);
     if (JS_IsException(jsc->gap))
         goto exception;
+    jsc->fast = JS_IsUndefined(jsc->replacer_func) &&
+        JS_IsUndefined(jsc->property_list) && JS_IsEmptyString(jsc->gap);
     wrapper = JS_NewObject(ctx);
     if (JS_IsException(wrapper))
         goto exception;
@@ -45809,7 +48670,7 @@ done:
     JS_FreeValue(ctx, jsc->empty);
     JS_FreeValue(ctx, jsc->gap);
     JS_FreeValue(ctx, jsc->property_list);
-    JS_FreeValue(ctx, jsc->stack);
+    js_free(ctx, jsc->stack);
     return ret;
 }
 
@@ -47094,24 +49955,45 @@ static const JSCFunctionListEntry js_symbol_funcs[] = {
 
 /* Set/Map/WeakSet/WeakMap */
 
+/* The records are stored in insertion order in a dense array. A
+   deleted record leaves a hole (key = JS_UNINITIALIZED) until the
+   array is compacted. The hash table uses open addressing with linear
+   probing and keeps the hash of each record inline so that most
+   probes do not touch the records. */
+
 typedef struct JSMapRecord {
-    int ref_count; /* used during enumeration to avoid freeing the record */
-    BOOL empty : 8; /* TRUE if the record is deleted */
-    struct list_head link;
-    struct JSMapRecord *hash_next;
-    JSValue key;
+    JSValue key; /* JS_UNINITIALIZED if the record is deleted */
     JSValue value;
+    uint32_t hash;
 } JSMapRecord;
 
+#define MAP_INDEX_EMPTY   0xffffffff
+#define MAP_INDEX_DELETED 0xfffffffe
+
+typedef struct JSMapHashSlot {
+    uint32_t hash;
+    uint32_t index; /* index in JSMapState.records, MAP_INDEX_EMPTY or
+                       MAP_INDEX_DELETED */
+} JSMapHashSlot;
+
+/* position of an enumeration, updated when the records are compacted */
+typedef struct JSMapCursor {
+    struct list_head link; /* JSMapState.cursors */
+    uint32_t pos; /* index of the next record to visit */
+} JSMapCursor;
+
+#define MAP_RECORDS_MAX (1U << 30)
+
 typedef struct JSMapState {
     BOOL is_weak; /* TRUE if WeakSet/WeakMap */
-    struct list_head records; /* list of JSMapRecord.link */
-    uint32_t record_count;
-    JSMapRecord **hash_table;
+    uint32_t record_count; /* number of live records */
+    JSMapRecord *records;
+    uint32_t records_len; /* used entries in 'records', including holes */
+    uint32_t records_size; /* allocated entries in 'records' */
+    JSMapHashSlot *hash_table; /* NULL if records_size = 0 */
     int hash_bits;
-    uint32_t hash_size; /* = 2 ^ hash_bits */
-    uint32_t record_count_threshold; /* count at which a hash table
-                                        resize is needed */
+    uint32_t hash_size; /* = 2 ^ hash_bits = 2 * records_size */
+    struct list_head cursors; /* list of JSMapCursor.link */
     JSWeakRefHeader weakref_header; /* only used if is_weak = TRUE */
 } JSMapState;
 
@@ -47207,19 +50089,14 @@ static JSValue js_map_constructor(JSContext *ctx, JSValueConst new_target,
     s = js_mallocz(ctx, sizeof(*s));
     if (!s)
         goto fail;
-    init_list_head(&s->records);
+    init_list_head(&s->cursors);
     s->is_weak = is_weak;
     if (is_weak) {
         s->weakref_header.weakref_type = JS_WEAKREF_TYPE_MAP;
         list_add_tail(&s->weakref_header.link, &ctx->rt->weakref_list);
     }
     JS_SetOpaque(obj, s);
-    s->hash_bits = 1;
-    s->hash_size = 1U << s->hash_bits;
-    s->hash_table = js_mallocz(ctx, sizeof(s->hash_table[0]) * s->hash_size);
-    if (!s->hash_table)
-        goto fail;
-    s->record_count_threshold = 4;
+    /* the records and the hash table are allocated with the first record */
 
     arr = JS_UNDEFINED;
     if (argc > 0)
@@ -47396,143 +50273,208 @@ static uint32_t map_hash_key(JSValueConst key, int hash_bits)
     return h;
 }
 
-static JSMapRecord *map_find_record(JSContext *ctx, JSMapState *s,
-                                    JSValueConst key)
+static JSMapHashSlot *map_find_slot(JSContext *ctx, JSMapState *s,
+                                    JSValueConst key, uint32_t h)
 {
+    JSMapHashSlot *slot;
     JSMapRecord *mr;
-    uint32_t h;
-    h = map_hash_key(key, s->hash_bits);
-    for(mr = s->hash_table[h]; mr != NULL; mr = mr->hash_next) {
-        if (mr->empty || (s->is_weak && !js_weakref_is_live(mr->key))) {
-            /* cannot match */
-        } else {
-            if (js_same_value_zero(ctx, mr->key, key))
-                return mr;
+    uint32_t i, mask;
+
+    if (!s->hash_table)
+        return NULL;
+    mask = s->hash_size - 1;
+    for(i = h >> (32 - s->hash_bits);; i = (i + 1) & mask) {
+        slot = &s->hash_table[i];
+        if (slot->index == MAP_INDEX_EMPTY)
+            return NULL;
+        if (slot->hash == h && slot->index != MAP_INDEX_DELETED) {
+            mr = &s->records[slot->index];
+            if ((!s->is_weak || js_weakref_is_live(mr->key)) &&
+                js_same_value_zero(ctx, mr->key, key))
+                return slot;
         }
     }
-    return NULL;
 }
 
-static void map_hash_resize(JSContext *ctx, JSMapState *s)
+/* 'h' is the result of map_hash_key(key, 32) */
+static JSMapRecord *map_find_record(JSContext *ctx, JSMapState *s,
+                                    JSValueConst key, uint32_t h)
 {
-    uint32_t new_hash_size, h;
-    int new_hash_bits;
+    JSMapHashSlot *slot;
+    slot = map_find_slot(ctx, s, key, h);
+    if (!slot)
+        return NULL;
+    return &s->records[slot->index];
+}
+
+static void map_hash_insert(JSMapState *s, uint32_t h, uint32_t idx)
+{
+    JSMapHashSlot *slot;
+    uint32_t i, mask;
+
+    mask = s->hash_size - 1;
+    for(i = h >> (32 - s->hash_bits);; i = (i + 1) & mask) {
+        slot = &s->hash_table[i];
+        if (slot->index == MAP_INDEX_EMPTY || slot->index == MAP_INDEX_DELETED)
+            break;
+    }
+    slot->hash = h;
+    slot->index = idx;
+}
+
+/* remove the record 'idx' from the hash table */
+static void map_hash_remove(JSMapState *s, uint32_t h, uint32_t idx)
+{
+    JSMapHashSlot *slot;
+    uint32_t i, mask;
+
+    mask = s->hash_size - 1;
+    for(i = h >> (32 - s->hash_bits);; i = (i + 1) & mask) {
+        slot = &s->hash_table[i];
+        assert(slot->index != MAP_INDEX_EMPTY);
+        if (slot->index == idx)
+            break;
+    }
+    slot->index = MAP_INDEX_DELETED;
+}
+
+/* size of the records array holding 'count' records with room to grow */
+static uint32_t map_new_size(uint32_t count)
+{
+    uint32_t size = 4;
+    while (size < 2 * count)
+        size *= 2;
+    return size;
+}
+
+/* Remove the holes from the records and resize the records array to
+   'new_size' entries (a power of two). The enumeration cursors are
+   updated. Return -1 if there is not enough memory, in which case the
+   map is left unchanged. */
+static int map_resize(JSRuntime *rt, JSMapState *s, uint32_t new_size)
+{
+    JSMapHashSlot *new_hash_table;
+    JSMapRecord *new_records, *mr;
+    JSMapCursor *c;
     struct list_head *el;
-    JSMapRecord *mr, **new_hash_table;
+    uint32_t i, j, new_hash_size;
+    int new_hash_bits;
 
-    /* XXX: no reporting of memory allocation failure */
-    new_hash_bits = min_int(s->hash_bits + 1, 31);
+    new_hash_bits = ctz32(new_size) + 1;
     new_hash_size = 1U << new_hash_bits;
-    new_hash_table = js_realloc(ctx, s->hash_table,
-                                sizeof(new_hash_table[0]) * new_hash_size);
+    new_hash_table = js_malloc_rt(rt, sizeof(new_hash_table[0]) * new_hash_size);
     if (!new_hash_table)
-        return;
+        return -1;
+    if (new_size > s->records_size) {
+        new_records = js_realloc_rt(rt, s->records,
+                                    sizeof(s->records[0]) * new_size);
+        if (!new_records) {
+            js_free_rt(rt, new_hash_table);
+            return -1;
+        }
+        s->records = new_records;
+    }
 
-    memset(new_hash_table, 0, sizeof(new_hash_table[0]) * new_hash_size);
+    /* a cursor moves to the number of live records before it */
+    list_for_each(el, &s->cursors) {
+        c = list_entry(el, JSMapCursor, link);
+        j = 0;
+        for(i = 0; i < c->pos; i++) {
+            if (!JS_IsUninitialized(s->records[i].key))
+                j++;
+        }
+        c->pos = j;
+    }
 
-    list_for_each(el, &s->records) {
-        mr = list_entry(el, JSMapRecord, link);
-        if (mr->empty || (s->is_weak && !js_weakref_is_live(mr->key))) {
-        } else {
-            h = map_hash_key(mr->key, new_hash_bits);
-            mr->hash_next = new_hash_table[h];
-            new_hash_table[h] = mr;
+    j = 0;
+    for(i = 0; i < s->records_len; i++) {
+        mr = &s->records[i];
+        if (!JS_IsUninitialized(mr->key)) {
+            if (i != j)
+                s->records[j] = *mr;
+            j++;
         }
     }
+    s->records_len = j;
+
+    js_free_rt(rt, s->hash_table);
+    memset(new_hash_table, 0xff, sizeof(new_hash_table[0]) * new_hash_size);
     s->hash_table = new_hash_table;
     s->hash_bits = new_hash_bits;
     s->hash_size = new_hash_size;
-    s->record_count_threshold = new_hash_size * 2;
+    for(i = 0; i < s->records_len; i++)
+        map_hash_insert(s, s->records[i].hash, i);
+
+    if (new_size < s->records_size) {
+        /* keep the larger array if it cannot be shrunk */
+        new_records = js_realloc_rt(rt, s->records,
+                                    sizeof(s->records[0]) * new_size);
+        if (new_records)
+            s->records = new_records;
+    }
+    s->records_size = new_size;
+    return 0;
 }
 
+/* 'h' is the result of map_hash_key(key, 32). The value of the
+   returned record must be set by the caller. */
 static JSMapRecord *map_add_record(JSContext *ctx, JSMapState *s,
-                                   JSValueConst key)
+                                   JSValueConst key, uint32_t h)
 {
-    uint32_t h;
     JSMapRecord *mr;
+    uint32_t new_size;
 
-    mr = js_malloc(ctx, sizeof(*mr));
-    if (!mr)
-        return NULL;
-    mr->ref_count = 1;
-    mr->empty = FALSE;
+    if (s->records_len >= s->records_size) {
+        new_size = map_new_size(s->record_count);
+        if (new_size > MAP_RECORDS_MAX || map_resize(ctx->rt, s, new_size)) {
+            JS_ThrowOutOfMemory(ctx);
+            return NULL;
+        }
+    }
+    mr = &s->records[s->records_len];
     if (s->is_weak) {
         mr->key = js_weakref_new(ctx, key);
     } else {
         mr->key = JS_DupValue(ctx, key);
     }
-    h = map_hash_key(key, s->hash_bits);
-    mr->hash_next = s->hash_table[h];
-    s->hash_table[h] = mr;
-    list_add_tail(&mr->link, &s->records);
+    mr->value = JS_UNDEFINED;
+    mr->hash = h;
+    map_hash_insert(s, h, s->records_len);
+    s->records_len++;
     s->record_count++;
-    if (s->record_count >= s->record_count_threshold) {
-        map_hash_resize(ctx, s);
-    }
     return mr;
 }
 
 /* warning: the record must be removed from the hash table before */
 static void map_delete_record(JSRuntime *rt, JSMapState *s, JSMapRecord *mr)
 {
-    if (mr->empty)
-        return;
-    
+    JSValue key, value;
+
+    key = mr->key;
+    value = mr->value;
+    /* leave a hole so that the indexes of the cursors stay valid */
+    mr->key = JS_UNINITIALIZED;
+    mr->value = JS_UNDEFINED;
+    s->record_count--;
     if (s->is_weak) {
-        js_weakref_free(rt, mr->key);
+        js_weakref_free(rt, key);
     } else {
-        JS_FreeValueRT(rt, mr->key);
-    }
-    JS_FreeValueRT(rt, mr->value);
-    if (--mr->ref_count == 0) {
-        list_del(&mr->link);
-        js_free_rt(rt, mr);
-    } else {
-        /* keep a zombie record for iterators */
-        mr->empty = TRUE;
-        mr->key = JS_UNDEFINED;
-        mr->value = JS_UNDEFINED;
-    }
-    s->record_count--;
-}
-
-static void map_decref_record(JSRuntime *rt, JSMapRecord *mr)
-{
-    if (--mr->ref_count == 0) {
-        /* the record can be safely removed */
-        assert(mr->empty);
-        list_del(&mr->link);
-        js_free_rt(rt, mr);
+        JS_FreeValueRT(rt, key);
     }
+    JS_FreeValueRT(rt, value);
 }
 
 static void map_delete_weakrefs(JSRuntime *rt, JSWeakRefHeader *wh)
 {
     JSMapState *s = container_of(wh, JSMapState, weakref_header);
-    struct list_head *el, *el1;
-    JSMapRecord *mr1, **pmr;
-    uint32_t h;
-
-    list_for_each_safe(el, el1, &s->records) {
-        JSMapRecord *mr = list_entry(el, JSMapRecord, link);
-        if (!js_weakref_is_live(mr->key)) {
+    JSMapRecord *mr;
+    uint32_t i;
 
-            /* even if key is not live it can be hashed as a pointer */
-            h = map_hash_key(mr->key, s->hash_bits);
-            pmr = &s->hash_table[h];
-            for(;;) {
-                mr1 = *pmr;
-                /* the entry may already be removed from the hash
-                   table if the map was resized */
-                if (mr1 == NULL)
-                    goto done; 
-                if (mr1 == mr)
-                    break;
-                pmr = &mr1->hash_next;
-            }
-            /* remove from the hash table */
-            *pmr = mr1->hash_next;
-        done:
+    /* the holes are removed when the map is next resized */
+    for(i = 0; i < s->records_len; i++) {
+        mr = &s->records[i];
+        if (!JS_IsUninitialized(mr->key) && !js_weakref_is_live(mr->key)) {
+            map_hash_remove(s, mr->hash, i);
             map_delete_record(rt, s, mr);
         }
     }
@@ -47544,6 +50486,7 @@ static JSValue js_map_set(JSContext *ctx, JSValueConst this_val,
     JSMapState *s = JS_GetOpaque2(ctx, this_val, JS_CLASS_MAP + magic);
     JSMapRecord *mr;
     JSValueConst key, value;
+    uint32_t h;
 
     if (!s)
         return JS_EXCEPTION;
@@ -47554,11 +50497,12 @@ static JSValue js_map_set(JSContext *ctx, JSValueConst this_val,
         value = JS_UNDEFINED;
     else
         value = argv[1];
-    mr = map_find_record(ctx, s, key);
+    h = map_hash_key(key, 32);
+    mr = map_find_record(ctx, s, key, h);
     if (mr) {
         JS_FreeValue(ctx, mr->value);
     } else {
-        mr = map_add_record(ctx, s, key);
+        mr = map_add_record(ctx, s, key, h);
         if (!mr)
             return JS_EXCEPTION;
     }
@@ -47576,7 +50520,7 @@ static JSValue js_map_get(JSContext *ctx, JSValueConst this_val,
     if (!s)
         return JS_EXCEPTION;
     key = map_normalize_key(ctx, argv[0]);
-    mr = map_find_record(ctx, s, key);
+    mr = map_find_record(ctx, s, key, map_hash_key(key, 32));
     if (!mr)
         return JS_UNDEFINED;
     else
@@ -47593,7 +50537,7 @@ static JSValue js_map_has(JSContext *ctx, JSValueConst this_val,
     if (!s)
         return JS_EXCEPTION;
     key = map_normalize_key(ctx, argv[0]);
-    mr = map_find_record(ctx, s, key);
+    mr = map_find_record(ctx, s, key, map_hash_key(key, 32));
     return JS_NewBool(ctx, mr != NULL);
 }
 
@@ -47601,33 +50545,27 @@ static JSValue js_map_delete(JSContext *ctx, JSValueConst this_val,
                              int argc, JSValueConst *argv, int magic)
 {
     JSMapState *s = JS_GetOpaque2(ctx, this_val, JS_CLASS_MAP + magic);
-    JSMapRecord *mr, **pmr;
+    JSMapHashSlot *slot;
+    JSMapRecord *mr;
     JSValueConst key;
-    uint32_t h;
 
     if (!s)
         return JS_EXCEPTION;
     key = map_normalize_key(ctx, argv[0]);
-    
-    h = map_hash_key(key, s->hash_bits);
-    pmr = &s->hash_table[h];
-    for(;;) {
-        mr = *pmr;
-        if (mr == NULL)
-            return JS_FALSE;
-        if (mr->empty || (s->is_weak && !js_weakref_is_live(mr->key))) {
-            /* not valid */
-        } else {
-            if (js_same_value_zero(ctx, mr->key, key))
-                break;
-        }
-        pmr = &mr->hash_next;
-    }
+    slot = map_find_slot(ctx, s, key, map_hash_key(key, 32));
+    if (!slot)
+        return JS_FALSE;
+    mr = &s->records[slot->index];
 
     /* remove from the hash table */
-    *pmr = mr->hash_next;
-    
+    slot->index = MAP_INDEX_DELETED;
+
     map_delete_record(ctx->rt, s, mr);
+
+    /* give back the memory when most of the records are deleted. A
+       failure is harmless. */
+    if (s->records_size > 16 && s->record_count < s->records_size / 8)
+        map_resize(ctx->rt, s, map_new_size(s->record_count));
     return JS_TRUE;
 }
 
@@ -47635,19 +50573,40 @@ static JSValue js_map_clear(JSContext *ctx, JSValueConst this_val,
                             int argc, JSValueConst *argv, int magic)
 {
     JSMapState *s = JS_GetOpaque2(ctx, this_val, JS_CLASS_MAP + magic);
-    struct list_head *el, *el1;
-    JSMapRecord *mr;
+    JSMapRecord *records, *mr;
+    struct list_head *el;
+    uint32_t i, len;
 
     if (!s)
         return JS_EXCEPTION;
 
-    /* remove from the hash table */
-    memset(s->hash_table, 0, sizeof(s->hash_table[0]) * s->hash_size);
-    
-    list_for_each_safe(el, el1, &s->records) {
-        mr = list_entry(el, JSMapRecord, link);
-        map_delete_record(ctx->rt, s, mr);
+    /* detach the records before freeing them */
+    records = s->records;
+    len = s->records_len;
+    js_free(ctx, s->hash_table);
+    s->records = NULL;
+    s->records_len = 0;
+    s->records_size = 0;
+    s->record_count = 0;
+    s->hash_table = NULL;
+    s->hash_bits = 0;
+    s->hash_size = 0;
+    /* the enumerations continue with the records added later */
+    list_for_each(el, &s->cursors) {
+        list_entry(el, JSMapCursor, link)->pos = 0;
+    }
+
+    for(i = 0; i < len; i++) {
+        mr = &records[i];
+        if (!JS_IsUninitialized(mr->key)) {
+            if (s->is_weak)
+                js_weakref_free(ctx->rt, mr->key);
+            else
+                JS_FreeValue(ctx, mr->key);
+            JS_FreeValue(ctx, mr->value);
+        }
     }
+    js_free(ctx, records);
     return JS_UNDEFINED;
 }
 
@@ -47665,7 +50624,7 @@ static JSValue js_map_forEach(JSContext *ctx, JSValueConst this_val,
     JSMapState *s = JS_GetOpaque2(ctx, this_val, JS_CLASS_MAP + magic);
     JSValueConst func, this_arg;
     JSValue ret, args[3];
-    struct list_head *el;
+    JSMapCursor cursor;
     JSMapRecord *mr;
 
     if (!s)
@@ -47677,34 +50636,33 @@ static JSValue js_map_forEach(JSContext *ctx, JSValueConst this_val,
         this_arg = JS_UNDEFINED;
     if (check_function(ctx, func))
         return JS_EXCEPTION;
-    /* Note: the list can be modified while traversing it, but the
-       current element is locked */
-    el = s->records.next;
-    while (el != &s->records) {
-        mr = list_entry(el, JSMapRecord, link);
-        if (!mr->empty) {
-            mr->ref_count++;
-            /* must duplicate in case the record is deleted */
-            args[1] = JS_DupValue(ctx, mr->key);
-            if (magic)
-                args[0] = args[1];
-            else
-                args[0] = JS_DupValue(ctx, mr->value);
-            args[2] = (JSValue)this_val;
-            ret = JS_Call(ctx, func, this_arg, 3, (JSValueConst *)args);
-            JS_FreeValue(ctx, args[0]);
-            if (!magic)
-                JS_FreeValue(ctx, args[1]);
-            el = el->next;
-            map_decref_record(ctx->rt, mr);
-            if (JS_IsException(ret))
-                return ret;
-            JS_FreeValue(ctx, ret);
-        } else {
-            el = el->next;
-        }
+    /* Note: the records can be modified while traversing them. The
+       cursor follows them if they are compacted. */
+    cursor.pos = 0;
+    list_add_tail(&cursor.link, &s->cursors);
+    ret = JS_UNDEFINED;
+    while (cursor.pos < s->records_len) {
+        mr = &s->records[cursor.pos++];
+        if (JS_IsUninitialized(mr->key))
+            continue;
+        /* must duplicate in case the record is deleted */
+        args[1] = JS_DupValue(ctx, mr->key);
+        if (magic)
+            args[0] = args[1];
+        else
+            args[0] = JS_DupValue(ctx, mr->value);
+        args[2] = (JSValue)this_val;
+        ret = JS_Call(ctx, func, this_arg, 3, (JSValueConst *)args);
+        JS_FreeValue(ctx, args[0]);
+        if (!magic)
+            JS_FreeValue(ctx, args[1]);
+        if (JS_IsException(ret))
+            break;
+        JS_FreeValue(ctx, ret);
+        ret = JS_UNDEFINED;
     }
-    return JS_UNDEFINED;
+    list_del(&cursor.link);
+    return ret;
 }
 
 static JSValue js_object_groupBy(JSContext *ctx, JSValueConst this_val,
@@ -47828,25 +50786,25 @@ static void js_map_finalizer(JSRuntime *rt, JSValue val)
 {
     JSObject *p;
     JSMapState *s;
-    struct list_head *el, *el1;
     JSMapRecord *mr;
+    uint32_t i;
 
     p = JS_VALUE_GET_OBJ(val);
     s = p->u.map_state;
     if (s) {
         /* if the object is deleted we are sure that no iterator is
            using it */
-        list_for_each_safe(el, el1, &s->records) {
-            mr = list_entry(el, JSMapRecord, link);
-            if (!mr->empty) {
+        for(i = 0; i < s->records_len; i++) {
+            mr = &s->records[i];
+            if (!JS_IsUninitialized(mr->key)) {
                 if (s->is_weak)
                     js_weakref_free(rt, mr->key);
                 else
                     JS_FreeValueRT(rt, mr->key);
                 JS_FreeValueRT(rt, mr->value);
             }
-            js_free_rt(rt, mr);
         }
+        js_free_rt(rt, s->records);
         js_free_rt(rt, s->hash_table);
         if (s->is_weak) {
             list_del(&s->weakref_header.link);
@@ -47859,13 +50817,15 @@ static void js_map_mark(JSRuntime *rt, JSValueConst val, JS_MarkFunc *mark_func)
 {
     JSObject *p = JS_VALUE_GET_OBJ(val);
     JSMapState *s;
-    struct list_head *el;
     JSMapRecord *mr;
+    uint32_t i;
 
     s = p->u.map_state;
     if (s) {
-        list_for_each(el, &s->records) {
-            mr = list_entry(el, JSMapRecord, link);
+        for(i = 0; i < s->records_len; i++) {
+            mr = &s->records[i];
+            if (JS_IsUninitialized(mr->key))
+                continue;
             if (!s->is_weak)
                 JS_MarkValue(rt, mr->key, mark_func);
             JS_MarkValue(rt, mr->value, mark_func);
@@ -47878,7 +50838,7 @@ static void js_map_mark(JSRuntime *rt, JSValueConst val, JS_MarkFunc *mark_func)
 typedef struct JSMapIteratorData {
     JSValue obj;
     JSIteratorKindEnum kind;
-    JSMapRecord *cur_record;
+    JSMapCursor cursor; /* linked to the map while 'obj' is defined */
 } JSMapIteratorData;
 
 static void js_map_iterator_finalizer(JSRuntime *rt, JSValue val)
@@ -47891,8 +50851,8 @@ static void js_map_iterator_finalizer(JSRuntime *rt, JSValue val)
     if (it) {
         /* During the GC sweep phase the Map finalizer may be
            called before the Map iterator finalizer */
-        if (JS_IsLiveObject(rt, it->obj) && it->cur_record) {
-            map_decref_record(rt, it->cur_record);
+        if (JS_IsLiveObject(rt, it->obj)) {
+            list_del(&it->cursor.link);
         }
         JS_FreeValueRT(rt, it->obj);
         js_free_rt(rt, it);
@@ -47934,7 +50894,8 @@ static JSValue js_create_map_iterator(JSContext *ctx, JSValueConst this_val,
     }
     it->obj = JS_DupValue(ctx, this_val);
     it->kind = kind;
-    it->cur_record = NULL;
+    it->cursor.pos = 0;
+    list_add_tail(&it->cursor.link, &s->cursors);
     JS_SetOpaque(enum_obj, it);
     return enum_obj;
  fail:
@@ -47948,7 +50909,6 @@ static JSValue js_map_iterator_next(JSContext *ctx, JSValueConst this_val,
     JSMapIteratorData *it;
     JSMapState *s;
     JSMapRecord *mr;
-    struct list_head *el;
 
     it = JS_GetOpaque2(ctx, this_val, JS_CLASS_MAP_ITERATOR + magic);
     if (!it) {
@@ -47959,17 +50919,10 @@ static JSValue js_map_iterator_next(JSContext *ctx, JSValueConst this_val,
         goto done;
     s = JS_GetOpaque(it->obj, JS_CLASS_MAP + magic);
     assert(s != NULL);
-    if (!it->cur_record) {
-        el = s->records.next;
-    } else {
-        mr = it->cur_record;
-        el = mr->link.next;
-        map_decref_record(ctx->rt, mr); /* the record can be freed here */
-    }
     for(;;) {
-        if (el == &s->records) {
+        if (it->cursor.pos >= s->records_len) {
             /* no more record  */
-            it->cur_record = NULL;
+            list_del(&it->cursor.link);
             JS_FreeValue(ctx, it->obj);
             it->obj = JS_UNDEFINED;
         done:
@@ -47977,16 +50930,11 @@ static JSValue js_map_iterator_next(JSContext *ctx, JSValueConst this_val,
             *pdone = TRUE;
             return JS_UNDEFINED;
         }
-        mr = list_entry(el, JSMapRecord, link);
-        if (!mr->empty)
+        mr = &s->records[it->cursor.pos++];
+        if (!JS_IsUninitialized(mr->key))
             break;
-        /* get the next record */
-        el = mr->link.next;
     }
 
-    /* lock the record so that it won't be freed */
-    mr->ref_count++;
-    it->cur_record = mr;
     *pdone = FALSE;
 
     if (it->kind == JS_ITERATOR_KIND_KEY) {
@@ -51591,15 +54539,10 @@ static JSValue js_array_buffer_get_byteLength(JSContext *ctx,
     return JS_NewUint32(ctx, abuf->byte_length);
 }
 
-void JS_DetachArrayBuffer(JSContext *ctx, JSValueConst obj)
+static void array_buffer_detach(JSArrayBuffer *abuf)
 {
-    JSArrayBuffer *abuf = JS_GetOpaque(obj, JS_CLASS_ARRAY_BUFFER);
     struct list_head *el;
 
-    if (!abuf || abuf->detached)
-        return;
-    if (abuf->free_func)
-        abuf->free_func(ctx->rt, abuf->opaque, abuf->data);
     abuf->data = NULL;
     abuf->byte_length = 0;
     abuf->detached = TRUE;
@@ -51618,6 +54561,43 @@ void JS_DetachArrayBuffer(JSContext *ctx, JSValueConst obj)
     }
 }
 
+void JS_DetachArrayBuffer(JSContext *ctx, JSValueConst obj)
+{
+    JSArrayBuffer *abuf = JS_GetOpaque(obj, JS_CLASS_ARRAY_BUFFER);
+
+    if (!abuf || abuf->detached)
+        return;
+    if (abuf->free_func)
+        abuf->free_func(ctx->rt, abuf->opaque, abuf->data);
+    array_buffer_detach(abuf);
+}
+
+/* Detach an ArrayBuffer without freeing its data, which is handed over
+   to the caller with the function and opaque that release it. Return
+   NULL if exception. */
+uint8_t *JS_TransferArrayBuffer(JSContext *ctx, JSValueConst obj, size_t *psize,
+                                JSFreeArrayBufferDataFunc **pfree_func,
+                                void **popaque)
+{
+    JSArrayBuffer *abuf = JS_GetOpaque2(ctx, obj, JS_CLASS_ARRAY_BUFFER);
+    uint8_t *data;
+
+    if (!abuf)
+        return NULL;
+    if (abuf->detached) {
+        JS_ThrowTypeErrorDetachedArrayBuffer(ctx);
+        return NULL;
+    }
+    data = abuf->data;
+    *psize = abuf->byte_length;
+    *pfree_func = abuf->free_func;
+    *popaque = abuf->opaque;
+    array_buffer_detach(abuf);
+    /* the storage is owned by the caller now */
+    abuf->free_func = NULL;
+    return data;
+}
+
 /* get an ArrayBuffer or SharedArrayBuffer */
 static JSArrayBuffer *js_get_array_buffer(JSContext *ctx, JSValueConst obj)
 {
@@ -51888,6 +54868,21 @@ JSValue JS_GetTypedArrayBuffer(JSContext *ctx, JSValueConst obj,
     return JS_DupValue(ctx, JS_MKPTR(JS_TAG_OBJECT, ta->buffer));
 }
 
+int JS_GetTypedArrayType(JSValueConst obj)
+{
+    JSClassID class_id = JS_GetClassID(obj);
+    if (class_id >= JS_CLASS_UINT8C_ARRAY && class_id <= JS_CLASS_FLOAT64_ARRAY)
+        return class_id - JS_CLASS_UINT8C_ARRAY;
+    return -1;
+}
+
+JS_BOOL JS_IsArrayBuffer(JSValueConst obj)
+{
+    JSClassID class_id = JS_GetClassID(obj);
+    return class_id == JS_CLASS_ARRAY_BUFFER ||
+        class_id == JS_CLASS_SHARED_ARRAY_BUFFER;
+}
+
 static JSValue js_typed_array_get_toStringTag(JSContext *ctx,
                                               JSValueConst this_val)
 {
@@ -51901,6 +54896,153 @@ static JSValue js_typed_array_get_toStringTag(JSContext *ctx,
     return JS_AtomToString(ctx, ctx->rt->class_array[p->class_id].class_name);
 }
 
+/* typed arrays with Number elements */
+static inline BOOL is_number_typed_array(JSClassID class_id)
+{
+    return class_id >= JS_CLASS_UINT8C_ARRAY &&
+        class_id <= JS_CLASS_FLOAT64_ARRAY &&
+        class_id != JS_CLASS_BIG_INT64_ARRAY &&
+        class_id != JS_CLASS_BIG_UINT64_ARRAY;
+}
+
+static inline int js_int_to_uint8_clamp(int64_t v)
+{
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+#define TA_CAST(x) (x)
+
+#define TA_CONVERT_LOOP(dst_type, src_type, conv)               \
+    do {                                                        \
+        dst_type *d = dst;                                      \
+        const src_type *s = src;                                \
+        for(i = 0; i < len; i++)                                \
+            d[i] = conv(s[i]);                                  \
+    } while (0)
+
+#define TA_CONVERT_FROM(dst_type, conv_int, conv_float)                 \
+    switch(src_class) {                                                 \
+    case JS_CLASS_UINT8C_ARRAY:                                         \
+    case JS_CLASS_UINT8_ARRAY:                                          \
+        TA_CONVERT_LOOP(dst_type, uint8_t, conv_int);                   \
+        break;                                                          \
+    case JS_CLASS_INT8_ARRAY:                                           \
+        TA_CONVERT_LOOP(dst_type, int8_t, conv_int);                    \
+        break;                                                          \
+    case JS_CLASS_INT16_ARRAY:                                          \
+        TA_CONVERT_LOOP(dst_type, int16_t, conv_int);                   \
+        break;                                                          \
+    case JS_CLASS_UINT16_ARRAY:                                         \
+        TA_CONVERT_LOOP(dst_type, uint16_t, conv_int);                  \
+        break;                                                          \
+    case JS_CLASS_INT32_ARRAY:                                          \
+        TA_CONVERT_LOOP(dst_type, int32_t, conv_int);                   \
+        break;                                                          \
+    case JS_CLASS_UINT32_ARRAY:                                         \
+        TA_CONVERT_LOOP(dst_type, uint32_t, conv_int);                  \
+        break;                                                          \
+    case JS_CLASS_FLOAT32_ARRAY:                                        \
+        TA_CONVERT_LOOP(dst_type, float, conv_float);                   \
+        break;                                                          \
+    case JS_CLASS_FLOAT64_ARRAY:                                        \
+        TA_CONVERT_LOOP(dst_type, double, conv_float);                  \
+        break;                                                          \
+    default:                                                            \
+        abort();                                                        \
+    }
+
+/* Convert 'len' elements between two Number typed array types with the
+   conversions of the element setters. One loop per pair of types, which
+   the compiler can vectorize. */
+static void js_typed_array_convert(void *dst, int dst_class,
+                                   const void *src, int src_class, size_t len)
+{
+    size_t i;
+
+    switch(dst_class) {
+    case JS_CLASS_UINT8C_ARRAY:
+        TA_CONVERT_FROM(uint8_t, js_int_to_uint8_clamp, js_double_to_uint8_clamp);
+        break;
+    case JS_CLASS_INT8_ARRAY:
+        TA_CONVERT_FROM(int8_t, TA_CAST, js_double_to_int32);
+        break;
+    case JS_CLASS_UINT8_ARRAY:
+        TA_CONVERT_FROM(uint8_t, TA_CAST, js_double_to_int32);
+        break;
+    case JS_CLASS_INT16_ARRAY:
+        TA_CONVERT_FROM(int16_t, TA_CAST, js_double_to_int32);
+        break;
+    case JS_CLASS_UINT16_ARRAY:
+        TA_CONVERT_FROM(uint16_t, TA_CAST, js_double_to_int32);
+        break;
+    case JS_CLASS_INT32_ARRAY:
+        TA_CONVERT_FROM(int32_t, TA_CAST, js_double_to_int32);
+        break;
+    case JS_CLASS_UINT32_ARRAY:
+        TA_CONVERT_FROM(uint32_t, TA_CAST, js_double_to_int32);
+        break;
+    case JS_CLASS_FLOAT32_ARRAY:
+        TA_CONVERT_FROM(float, TA_CAST, TA_CAST);
+        break;
+    case JS_CLASS_FLOAT64_ARRAY:
+        TA_CONVERT_FROM(double, TA_CAST, TA_CAST);
+        break;
+    default:
+        abort();
+    }
+}
+
+#undef TA_CONVERT_FROM
+#undef TA_CONVERT_LOOP
+#undef TA_CAST
+
+/* Store the leading Number elements of the fast array 'src_p' at
+   'offset' in the Number typed array 'p'. Storing them cannot run user
+   code. Return the index of the first element left. */
+static uint32_t js_typed_array_set_numbers(JSObject *p, uint32_t offset,
+                                           JSObject *src_p, uint32_t len)
+{
+    const JSValue *values = src_p->u.array.u.values;
+    uint32_t i;
+    double d;
+
+    for(i = 0; i < len; i++) {
+        JSValue v = values[i];
+        if (JS_VALUE_GET_TAG(v) == JS_TAG_INT)
+            d = JS_VALUE_GET_INT(v);
+        else if (JS_TAG_IS_FLOAT64(JS_VALUE_GET_TAG(v)))
+            d = JS_VALUE_GET_FLOAT64(v);
+        else
+            break;
+        switch(p->class_id) {
+        case JS_CLASS_UINT8C_ARRAY:
+            p->u.array.u.uint8_ptr[offset + i] = js_double_to_uint8_clamp(d);
+            break;
+        case JS_CLASS_INT8_ARRAY:
+        case JS_CLASS_UINT8_ARRAY:
+            p->u.array.u.uint8_ptr[offset + i] = js_double_to_int32(d);
+            break;
+        case JS_CLASS_INT16_ARRAY:
+        case JS_CLASS_UINT16_ARRAY:
+            p->u.array.u.uint16_ptr[offset + i] = js_double_to_int32(d);
+            break;
+        case JS_CLASS_INT32_ARRAY:
+        case JS_CLASS_UINT32_ARRAY:
+            p->u.array.u.uint32_ptr[offset + i] = js_double_to_int32(d);
+            break;
+        case JS_CLASS_FLOAT32_ARRAY:
+            p->u.array.u.float_ptr[offset + i] = d;
+            break;
+        case JS_CLASS_FLOAT64_ARRAY:
+            p->u.array.u.double_ptr[offset + i] = d;
+            break;
+        default:
+            abort();
+        }
+    }
+    return i;
+}
+
 static JSValue js_typed_array_set_internal(JSContext *ctx,
                                            JSValueConst dst,
                                            JSValueConst src,
@@ -51950,11 +55092,30 @@ static JSValue js_typed_array_set_internal(JSContext *ctx,
                     src_abuf->data + src_ta->offset, src_len << shift);
             goto done;
         }
-        if (dest_abuf->data == src_abuf->data) {
-            /* copying between the same buffer using different types of mappings
-               would require a temporary buffer */
+        if (is_number_typed_array(p->class_id) &&
+            is_number_typed_array(src_p->class_id)) {
+            uint8_t *dst_ptr = dest_abuf->data + dest_ta->offset + (offset << shift);
+            const uint8_t *src_ptr = src_abuf->data + src_ta->offset;
+            size_t src_size = src_len << typed_array_size_log2(src_p->class_id);
+            uint8_t *tmp = NULL;
+
+            if (dest_abuf->data == src_abuf->data &&
+                src_ptr < dst_ptr + (src_len << shift) &&
+                dst_ptr < src_ptr + src_size) {
+                /* the source is read as it was before the copy */
+                tmp = js_malloc(ctx, src_size);
+                if (!tmp)
+                    goto fail;
+                memcpy(tmp, src_ptr, src_size);
+                src_ptr = tmp;
+            }
+            js_typed_array_convert(dst_ptr, p->class_id, src_ptr,
+                                   src_p->class_id, src_len);
+            js_free(ctx, tmp);
+            goto done;
         }
         /* otherwise, default behavior is slow but correct */
+        i = 0;
     } else {
         if (js_get_length64(ctx, &src_len, src_obj))
             goto fail;
@@ -51963,8 +55124,16 @@ static JSValue js_typed_array_set_internal(JSContext *ctx,
             JS_ThrowRangeError(ctx, "invalid array length");
             goto fail;
         }
+        i = 0;
+        /* the length getter may have detached the typed array */
+        if (src_p->class_id == JS_CLASS_ARRAY && src_p->fast_array &&
+            is_number_typed_array(p->class_id) &&
+            !typed_array_is_detached(ctx, p)) {
+            i = js_typed_array_set_numbers(p, offset, src_p,
+                                           min_int64(src_len, src_p->u.array.count));
+        }
     }
-    for(i = 0; i < src_len; i++) {
+    for(; i < src_len; i++) {
         val = JS_GetPropertyUint32(ctx, src_obj, i);
         if (JS_IsException(val))
             goto fail;
@@ -52298,6 +55467,41 @@ static JSValue js_typed_array_copyWithin(JSContext *ctx, JSValueConst this_val,
     return JS_DupValue(ctx, this_val);
 }
 
+/* Set 'count' elements of 1 << shift bytes to the low bits of 'v64'.
+   Past the first elements, the filled part is doubled with memcpy(). */
+static void js_fill_elements(uint8_t *dst, size_t count, int shift,
+                             uint64_t v64)
+{
+    size_t i, n, size, done;
+
+    size = count << shift;
+    if (shift == 0 || v64 == 0) {
+        memset(dst, v64, size);
+        return;
+    }
+    n = min_int(count, 256 >> shift);
+    switch(shift) {
+    case 1:
+        for(i = 0; i < n; i++)
+            ((uint16_t *)dst)[i] = v64;
+        break;
+    case 2:
+        for(i = 0; i < n; i++)
+            ((uint32_t *)dst)[i] = v64;
+        break;
+    case 3:
+        for(i = 0; i < n; i++)
+            ((uint64_t *)dst)[i] = v64;
+        break;
+    default:
+        abort();
+    }
+    for(done = n << shift; done < size; done += n) {
+        n = (size - done < done) ? size - done : done;
+        memcpy(dst + done, dst, n);
+    }
+}
+
 static JSValue js_typed_array_fill(JSContext *ctx, JSValueConst this_val,
                                    int argc, JSValueConst *argv)
 {
@@ -52357,29 +55561,9 @@ static JSValue js_typed_array_fill(JSContext *ctx, JSValueConst this_val,
         return JS_ThrowTypeErrorDetachedArrayBuffer(ctx);
 
     shift = typed_array_size_log2(p->class_id);
-    switch(shift) {
-    case 0:
-        if (k < final) {
-            memset(p->u.array.u.uint8_ptr + k, v64, final - k);
-        }
-        break;
-    case 1:
-        for(; k < final; k++) {
-            p->u.array.u.uint16_ptr[k] = v64;
-        }
-        break;
-    case 2:
-        for(; k < final; k++) {
-            p->u.array.u.uint32_ptr[k] = v64;
-        }
-        break;
-    case 3:
-        for(; k < final; k++) {
-            p->u.array.u.uint64_ptr[k] = v64;
-        }
-        break;
-    default:
-        abort();
+    if (k < final) {
+        js_fill_elements(p->u.array.u.uint8_ptr + (k << shift), final - k,
+                         shift, v64);
     }
     return JS_DupValue(ctx, this_val);
 }
@@ -52593,10 +55777,14 @@ static JSValue js_typed_array_indexOf(JSContext *ctx, JSValueConst this_val,
         scan16:
             pv = p->u.array.u.uint16_ptr;
             v = v64;
-            for (; k != stop; k += inc) {
-                if (pv[k] == v) {
-                    res = k;
-                    break;
+            if (inc > 0) {
+                res = js_u16_indexof(pv, k, len, v);
+            } else {
+                for (; k != stop; k += inc) {
+                    if (pv[k] == v) {
+                        res = k;
+                        break;
+                    }
                 }
             }
         }
@@ -52612,10 +55800,14 @@ static JSValue js_typed_array_indexOf(JSContext *ctx, JSValueConst this_val,
         scan32:
             pv = p->u.array.u.uint32_ptr;
             v = v64;
-            for (; k != stop; k += inc) {
-                if (pv[k] == v) {
-                    res = k;
-                    break;
+            if (inc > 0) {
+                res = js_u32_indexof(pv, k, len, v);
+            } else {
+                for (; k != stop; k += inc) {
+                    if (pv[k] == v) {
+                        res = k;
+                        break;
+                    }
                 }
             }
         }
@@ -52636,10 +55828,29 @@ static JSValue js_typed_array_indexOf(JSContext *ctx, JSValueConst this_val,
             }
         } else if ((f = (float)d) == d) {
             const float *pv = p->u.array.u.float_ptr;
-            for (; k != stop; k += inc) {
-                if (pv[k] == f) {
-                    res = k;
-                    break;
+            if (inc > 0) {
+                /* the elements equal to a non NaN float have its bits,
+                   except that -0 and +0 are equal */
+                union {
+                    float f;
+                    uint32_t u32;
+                } u;
+                int res2;
+                u.f = f;
+                res = js_u32_indexof((const uint32_t *)pv, k, len, u.u32);
+                if (f == 0) {
+                    res2 = js_u32_indexof((const uint32_t *)pv, k,
+                                          res >= 0 ? res : len,
+                                          u.u32 ^ 0x80000000);
+                    if (res2 >= 0)
+                        res = res2;
+                }
+            } else {
+                for (; k != stop; k += inc) {
+                    if (pv[k] == f) {
+                        res = k;
+                        break;
+                    }
                 }
             }
         }
@@ -52759,6 +55970,117 @@ exception:
     return JS_EXCEPTION;
 }
 
+#if defined(__SSE2__)
+/* reverse the order of the elements of 1 << shift bytes in 'v' */
+static inline __m128i js_reverse_m128(__m128i v, int shift)
+{
+    if (shift == 3)
+        return _mm_shuffle_epi32(v, 0x4e);
+    v = _mm_shuffle_epi32(v, 0x1b);
+    if (shift <= 1)
+        v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xb1), 0xb1);
+    if (shift == 0)
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    return v;
+}
+#elif defined(__ARM_NEON)
+static inline uint8x16_t js_reverse_u8x16(uint8x16_t v, int shift)
+{
+    switch(shift) {
+    case 0:
+        v = vrev64q_u8(v);
+        break;
+    case 1:
+        v = vreinterpretq_u8_u16(vrev64q_u16(vreinterpretq_u16_u8(v)));
+        break;
+    case 2:
+        v = vreinterpretq_u8_u32(vrev64q_u32(vreinterpretq_u32_u8(v)));
+        break;
+    }
+    return vextq_u8(v, v, 8);
+}
+#endif
+
+/* reverse 'len' elements of 1 << shift bytes, swapping 16 bytes from
+   each end at a time */
+static void js_reverse_elements(uint8_t *ptr, size_t len, int shift)
+{
+    uint8_t *p1 = ptr, *p2 = ptr + (len << shift);
+
+#if defined(__SSE2__)
+    while (p2 - p1 >= 32) {
+        __m128i v1, v2;
+        p2 -= 16;
+        v1 = _mm_loadu_si128((const __m128i *)p1);
+        v2 = _mm_loadu_si128((const __m128i *)p2);
+        _mm_storeu_si128((__m128i *)p1, js_reverse_m128(v2, shift));
+        _mm_storeu_si128((__m128i *)p2, js_reverse_m128(v1, shift));
+        p1 += 16;
+    }
+#elif defined(__ARM_NEON)
+    while (p2 - p1 >= 32) {
+        uint8x16_t v1, v2;
+        p2 -= 16;
+        v1 = vld1q_u8(p1);
+        v2 = vld1q_u8(p2);
+        vst1q_u8(p1, js_reverse_u8x16(v2, shift));
+        vst1q_u8(p2, js_reverse_u8x16(v1, shift));
+        p1 += 16;
+    }
+#endif
+    len = (p2 - p1) >> shift;
+    if (len == 0)
+        return;
+    switch(shift) {
+    case 0:
+        {
+            uint8_t *q1 = p1;
+            uint8_t *q2 = q1 + len - 1;
+            while (q1 < q2) {
+                uint8_t v = *q1;
+                *q1++ = *q2;
+                *q2-- = v;
+            }
+        }
+        break;
+    case 1:
+        {
+            uint16_t *q1 = (uint16_t *)p1;
+            uint16_t *q2 = q1 + len - 1;
+            while (q1 < q2) {
+                uint16_t v = *q1;
+                *q1++ = *q2;
+                *q2-- = v;
+            }
+        }
+        break;
+    case 2:
+        {
+            uint32_t *q1 = (uint32_t *)p1;
+            uint32_t *q2 = q1 + len - 1;
+            while (q1 < q2) {
+                uint32_t v = *q1;
+                *q1++ = *q2;
+                *q2-- = v;
+            }
+        }
+        break;
+    case 3:
+        {
+            uint64_t *q1 = (uint64_t *)p1;
+            uint64_t *q2 = q1 + len - 1;
+            while (q1 < q2) {
+                uint64_t v = *q1;
+                *q1++ = *q2;
+                *q2-- = v;
+            }
+        }
+        break;
+    default:
+        abort();
+    }
+}
+
 static JSValue js_typed_array_reverse(JSContext *ctx, JSValueConst this_val,
                                       int argc, JSValueConst *argv)
 {
@@ -52770,54 +56092,8 @@ static JSValue js_typed_array_reverse(JSContext *ctx, JSValueConst this_val,
         return JS_EXCEPTION;
     if (len > 0) {
         p = JS_VALUE_GET_OBJ(this_val);
-        switch (typed_array_size_log2(p->class_id)) {
-        case 0:
-            {
-                uint8_t *p1 = p->u.array.u.uint8_ptr;
-                uint8_t *p2 = p1 + len - 1;
-                while (p1 < p2) {
-                    uint8_t v = *p1;
-                    *p1++ = *p2;
-                    *p2-- = v;
-                }
-            }
-            break;
-        case 1:
-            {
-                uint16_t *p1 = p->u.array.u.uint16_ptr;
-                uint16_t *p2 = p1 + len - 1;
-                while (p1 < p2) {
-                    uint16_t v = *p1;
-                    *p1++ = *p2;
-                    *p2-- = v;
-                }
-            }
-            break;
-        case 2:
-            {
-                uint32_t *p1 = p->u.array.u.uint32_ptr;
-                uint32_t *p2 = p1 + len - 1;
-                while (p1 < p2) {
-                    uint32_t v = *p1;
-                    *p1++ = *p2;
-                    *p2-- = v;
-                }
-            }
-            break;
-        case 3:
-            {
-                uint64_t *p1 = p->u.array.u.uint64_ptr;
-                uint64_t *p2 = p1 + len - 1;
-                while (p1 < p2) {
-                    uint64_t v = *p1;
-                    *p1++ = *p2;
-                    *p2-- = v;
-                }
-            }
-            break;
-        default:
-            abort();
-        }
+        js_reverse_elements(p->u.array.u.uint8_ptr, len,
+                            typed_array_size_log2(p->class_id));
     }
     return JS_DupValue(ctx, this_val);
 }
@@ -53118,6 +56394,188 @@ static int js_TA_cmp_generic(const void *a, const void *b, void *opaque) {
     return cmp;
 }
 
+/* LSD radix sort of unsigned keys with 8-bit digits, using 'tmp' as
+   scratch; the digits shared by all the keys are skipped */
+#define DEF_TA_RADIX_SORT(name, type)                                   \
+static void name(type *a, type *tmp, size_t len)                        \
+{                                                                       \
+    uint32_t count[sizeof(type)][256];                                  \
+    type *src, *dst, *t;                                                \
+    size_t i;                                                           \
+    uint32_t sum, c;                                                    \
+    int d, k;                                                           \
+                                                                        \
+    memset(count, 0, sizeof(count));                                    \
+    for(i = 0; i < len; i++) {                                          \
+        type v = a[i];                                                  \
+        for(d = 0; d < sizeof(type); d++)                               \
+            count[d][(v >> (d * 8)) & 0xff]++;                          \
+    }                                                                   \
+    src = a;                                                            \
+    dst = tmp;                                                          \
+    for(d = 0; d < sizeof(type); d++) {                                 \
+        if (count[d][(a[0] >> (d * 8)) & 0xff] == len)                  \
+            continue;                                                   \
+        sum = 0;                                                        \
+        for(k = 0; k < 256; k++) {                                      \
+            c = count[d][k];                                            \
+            count[d][k] = sum;                                          \
+            sum += c;                                                   \
+        }                                                               \
+        for(i = 0; i < len; i++) {                                      \
+            type v = src[i];                                            \
+            dst[count[d][(v >> (d * 8)) & 0xff]++] = v;                 \
+        }                                                               \
+        t = src;                                                        \
+        src = dst;                                                      \
+        dst = t;                                                        \
+    }                                                                   \
+    if (src != a)                                                       \
+        memcpy(a, src, len * sizeof(type));                             \
+}
+
+DEF_TA_RADIX_SORT(js_TA_radix_sort16, uint16_t)
+DEF_TA_RADIX_SORT(js_TA_radix_sort32, uint32_t)
+DEF_TA_RADIX_SORT(js_TA_radix_sort64, uint64_t)
+
+#undef DEF_TA_RADIX_SORT
+
+/* Move the NaNs of the float array 'a' after the other elements,
+   keeping their order, and return the number of other elements */
+#define DEF_TA_PARTITION_NAN(name, type, abs_mask, inf_bits)            \
+static size_t name(type *a, type *tmp, size_t len)                      \
+{                                                                       \
+    size_t i, j, n;                                                     \
+    j = 0;                                                              \
+    n = 0;                                                              \
+    for(i = 0; i < len; i++) {                                          \
+        type v = a[i];                                                  \
+        if ((v & abs_mask) > inf_bits)                                  \
+            tmp[n++] = v;                                               \
+        else                                                            \
+            a[j++] = v;                                                 \
+    }                                                                   \
+    memcpy(a + j, tmp, n * sizeof(type));                               \
+    return j;                                                           \
+}
+
+DEF_TA_PARTITION_NAN(js_TA_partition_nan32, uint32_t,
+                     0x7fffffff, 0x7f800000)
+DEF_TA_PARTITION_NAN(js_TA_partition_nan64, uint64_t,
+                     0x7fffffffffffffff, 0x7ff0000000000000)
+
+#undef DEF_TA_PARTITION_NAN
+
+/* Sort the elements of a typed array in the default order: counting
+   sort for the 8-bit types, radix sort of keys ordered as unsigned
+   integers otherwise. Return FALSE if the scratch buffer cannot be
+   allocated. */
+static BOOL js_TA_sort_default(JSRuntime *rt, void *array_ptr, size_t len,
+                               JSClassID class_id)
+{
+    void *tmp;
+    size_t i, n;
+
+    switch(class_id) {
+    case JS_CLASS_INT8_ARRAY:
+    case JS_CLASS_UINT8C_ARRAY:
+    case JS_CLASS_UINT8_ARRAY:
+        {
+            uint8_t *a = array_ptr;
+            uint32_t count[256];
+            int k, b, flip;
+
+            /* int8 values are in order of their bytes with the sign
+               bit flipped */
+            flip = (class_id == JS_CLASS_INT8_ARRAY) ? 0x80 : 0;
+            memset(count, 0, sizeof(count));
+            for(i = 0; i < len; i++)
+                count[a[i]]++;
+            for(k = 0; k < 256; k++) {
+                b = k ^ flip;
+                memset(a, b, count[b]);
+                a += count[b];
+            }
+        }
+        return TRUE;
+    default:
+        break;
+    }
+
+    tmp = js_malloc_rt(rt, len << typed_array_size_log2(class_id));
+    if (!tmp)
+        return FALSE;
+    switch(class_id) {
+    case JS_CLASS_INT16_ARRAY:
+    case JS_CLASS_UINT16_ARRAY:
+        {
+            uint16_t *a = array_ptr;
+            uint16_t flip = (class_id == JS_CLASS_INT16_ARRAY) ? 0x8000 : 0;
+            for(i = 0; i < len; i++)
+                a[i] ^= flip;
+            js_TA_radix_sort16(a, tmp, len);
+            for(i = 0; i < len; i++)
+                a[i] ^= flip;
+        }
+        break;
+    case JS_CLASS_INT32_ARRAY:
+    case JS_CLASS_UINT32_ARRAY:
+        {
+            uint32_t *a = array_ptr;
+            uint32_t flip = (class_id == JS_CLASS_INT32_ARRAY) ? 0x80000000 : 0;
+            for(i = 0; i < len; i++)
+                a[i] ^= flip;
+            js_TA_radix_sort32(a, tmp, len);
+            for(i = 0; i < len; i++)
+                a[i] ^= flip;
+        }
+        break;
+    case JS_CLASS_BIG_INT64_ARRAY:
+    case JS_CLASS_BIG_UINT64_ARRAY:
+        {
+            uint64_t *a = array_ptr;
+            uint64_t flip = (class_id == JS_CLASS_BIG_INT64_ARRAY) ?
+                ((uint64_t)1 << 63) : 0;
+            for(i = 0; i < len; i++)
+                a[i] ^= flip;
+            js_TA_radix_sort64(a, tmp, len);
+            for(i = 0; i < len; i++)
+                a[i] ^= flip;
+        }
+        break;
+    case JS_CLASS_FLOAT32_ARRAY:
+        {
+            /* negative numbers have all their bits flipped so that -0
+               comes before +0 */
+            uint32_t *a = array_ptr;
+            const uint32_t sign = 0x80000000;
+            n = js_TA_partition_nan32(a, tmp, len);
+            for(i = 0; i < n; i++)
+                a[i] = (a[i] & sign) ? ~a[i] : (a[i] | sign);
+            js_TA_radix_sort32(a, tmp, n);
+            for(i = 0; i < n; i++)
+                a[i] = (a[i] & sign) ? (a[i] & ~sign) : ~a[i];
+        }
+        break;
+    case JS_CLASS_FLOAT64_ARRAY:
+        {
+            uint64_t *a = array_ptr;
+            const uint64_t sign = (uint64_t)1 << 63;
+            n = js_TA_partition_nan64(a, tmp, len);
+            for(i = 0; i < n; i++)
+                a[i] = (a[i] & sign) ? ~a[i] : (a[i] | sign);
+            js_TA_radix_sort64(a, tmp, n);
+            for(i = 0; i < n; i++)
+                a[i] = (a[i] & sign) ? (a[i] & ~sign) : ~a[i];
+        }
+        break;
+    default:
+        abort();
+    }
+    js_free_rt(rt, tmp);
+    return TRUE;
+}
+
 static JSValue js_typed_array_sort(JSContext *ctx, JSValueConst this_val,
                                    int argc, JSValueConst *argv)
 {
@@ -53247,7 +56705,9 @@ static JSValue js_typed_array_sort(JSContext *ctx, JSValueConst this_val,
             }
             js_free(ctx, array_idx);
         } else {
-            rqsort(array_ptr, len, elt_size, cmpfun, &tsc);
+            if (len < 64 ||
+                !js_TA_sort_default(ctx->rt, array_ptr, len, p->class_id))
+                rqsort(array_ptr, len, elt_size, cmpfun, &tsc);
             if (tsc.exception)
                 return JS_EXCEPTION;
         }
@@ -54170,6 +57630,19 @@ static pthread_mutex_t js_atomics_mutex = PTHREAD_MUTEX_INITIALIZER;
 static struct list_head js_atomics_waiter_list =
     LIST_HEAD_INIT(js_atomics_waiter_list);
 
+/* interval at which blocked Atomics.wait() calls poll the interrupt handler */
+#define JS_ATOMICS_WAIT_POLL_MS 20
+
+static void js_timespec_add_ms(struct timespec *ts, int64_t ms)
+{
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (ms % 1000) * 1000000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_nsec -= 1000000000;
+        ts->tv_sec++;
+    }
+}
+
 static JSValue js_atomics_wait(JSContext *ctx,
                                JSValueConst this_obj,
                                int argc, JSValueConst *argv)
@@ -54177,10 +57650,12 @@ static JSValue js_atomics_wait(JSContext *ctx,
     int64_t v;
     int32_t v32;
     void *ptr;
+    JSRuntime *rt = ctx->rt;
     int64_t timeout;
-    struct timespec ts;
+    struct timespec ts, slice;
     JSAtomicsWaiter waiter_s, *waiter;
     int ret, size_log2, res;
+    BOOL interrupted, last;
     double d;
 
     ptr = js_atomics_get_ptr(ctx, NULL, &size_log2, NULL,
@@ -54204,7 +57679,7 @@ static JSValue js_atomics_wait(JSContext *ctx,
         timeout = 0;
     else
         timeout = (int64_t)d;
-    if (!ctx->rt->can_block)
+    if (!rt->can_block)
         return JS_ThrowTypeError(ctx, "cannot block in this thread");
 
     /* XXX: inefficient if large number of waiters, should hash on
@@ -54227,26 +57702,53 @@ static JSValue js_atomics_wait(JSContext *ctx,
     waiter->linked = TRUE;
     list_add_tail(&waiter->link, &js_atomics_waiter_list);
 
-    if (timeout == INT64_MAX) {
-        pthread_cond_wait(&waiter->cond, &js_atomics_mutex);
-        ret = 0;
-    } else {
+    if (timeout != INT64_MAX) {
         /* XXX: use clock monotonic */
         clock_gettime(CLOCK_REALTIME, &ts);
-        ts.tv_sec += timeout / 1000;
-        ts.tv_nsec += (timeout % 1000) * 1000000;
-        if (ts.tv_nsec >= 1000000000) {
-            ts.tv_nsec -= 1000000000;
-            ts.tv_sec++;
+        js_timespec_add_ms(&ts, timeout);
+    }
+    interrupted = FALSE;
+    if (!rt->interrupt_handler) {
+        if (timeout == INT64_MAX) {
+            pthread_cond_wait(&waiter->cond, &js_atomics_mutex);
+            ret = 0;
+        } else {
+            ret = pthread_cond_timedwait(&waiter->cond, &js_atomics_mutex,
+                                         &ts);
+        }
+    } else {
+        /* wake up regularly to poll the interrupt handler, so that a
+           blocked thread can still be stopped */
+        for(;;) {
+            clock_gettime(CLOCK_REALTIME, &slice);
+            js_timespec_add_ms(&slice, JS_ATOMICS_WAIT_POLL_MS);
+            last = (timeout != INT64_MAX &&
+                    (ts.tv_sec < slice.tv_sec ||
+                     (ts.tv_sec == slice.tv_sec && ts.tv_nsec <= slice.tv_nsec)));
+            ret = pthread_cond_timedwait(&waiter->cond, &js_atomics_mutex,
+                                         last ? &ts : &slice);
+            if (!waiter->linked) {
+                ret = 0; /* notified */
+                break;
+            }
+            if (ret == ETIMEDOUT && last)
+                break;
+            pthread_mutex_unlock(&js_atomics_mutex);
+            interrupted = rt->interrupt_handler(rt, rt->interrupt_opaque);
+            pthread_mutex_lock(&js_atomics_mutex);
+            if (interrupted && waiter->linked)
+                break;
+            interrupted = FALSE;
         }
-        ret = pthread_cond_timedwait(&waiter->cond, &js_atomics_mutex,
-                                     &ts);
     }
     if (waiter->linked)
         list_del(&waiter->link);
     pthread_mutex_unlock(&js_atomics_mutex);
     pthread_cond_destroy(&waiter->cond);
-    if (ret == ETIMEDOUT) {
+    if (interrupted) {
+        JS_ThrowInterrupted(ctx);
+        return JS_EXCEPTION;
+    } else if (ret == ETIMEDOUT) {
         return JS_AtomToString(ctx, JS_ATOM_timed_out);
     } else {
         return JS_AtomToString(ctx, JS_ATOM_ok);
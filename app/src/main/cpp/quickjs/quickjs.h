@@ -343,6 +343,10 @@ static inline JSValue __JS_NewShortBigInt(JSContext *ctx, int64_t d)
 /* allow top-level await in normal script. JS_Eval() returns a
    promise. Only allowed with JS_EVAL_TYPE_GLOBAL */
 #define JS_EVAL_FLAG_ASYNC (1 << 7)
+/* with JS_EVAL_TYPE_MODULE and JS_EVAL_FLAG_COMPILE_ONLY, do not load
+   the imported modules. The module can only be serialized with
+   JS_WriteObject(); once read back it must be resolved before use. */
+#define JS_EVAL_FLAG_NO_RESOLVE (1 << 8)
 
 typedef JSValue JSCFunction(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
 typedef JSValue JSCFunctionMagic(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv, int magic);
@@ -369,6 +373,28 @@ JSRuntime *JS_NewRuntime(void);
 void JS_SetRuntimeInfo(JSRuntime *rt, const char *info);
 void JS_SetMemoryLimit(JSRuntime *rt, size_t limit);
 void JS_SetGCThreshold(JSRuntime *rt, size_t gc_threshold);
+/* Threshold set after each automatic GC: the live size grown by
+   growth_percent, no lower than min_threshold and no higher than
+   max_threshold. The default policy is (0, 50, SIZE_MAX). */
+void JS_SetGCPolicy(JSRuntime *rt, size_t min_threshold, unsigned int growth_percent,
+                    size_t max_threshold);
+/* Release the compiled RegExp bytecode cached by the runtime */
+void JS_FlushRegExpCache(JSRuntime *rt);
+/* number of bytes currently allocated by the runtime */
+size_t JS_GetMallocSize(JSRuntime *rt);
+/* number of allocations and reallocations made since the runtime was created */
+uint64_t JS_GetMallocCallCount(JSRuntime *rt);
+/* number of bytes those allocations and reallocations asked for */
+uint64_t JS_GetMallocCallBytes(JSRuntime *rt);
+/* number of cycle collections run since the runtime was created */
+uint64_t JS_GetGCCount(JSRuntime *rt);
+/* Optional tracing of engine phases (GC, bytecode reading). begin returns
+   nonzero if it began a section, which is then closed by end; sections
+   nest and are begun and ended on the thread running the runtime. */
+typedef int JSTraceBeginFunc(void *opaque, const char *name);
+typedef void JSTraceEndFunc(void *opaque);
+void JS_SetTraceFunctions(JSRuntime *rt, JSTraceBeginFunc *begin, JSTraceEndFunc *end,
+                          void *opaque);
 /* use 0 to disable maximum stack size check */
 void JS_SetMaxStackSize(JSRuntime *rt, size_t stack_size);
 /* should be called when changing thread to update the stack top value
@@ -827,6 +853,14 @@ JSValue JS_EvalThis(JSContext *ctx, JSValueConst this_obj,
                     const char *input, size_t input_len,
                     const char *filename, int eval_flags);
 JSValue JS_GetGlobalObject(JSContext *ctx);
+/* TRUE if scripts defined top level let, const or class bindings */
+JS_BOOL JS_HasGlobalLexicals(JSContext *ctx);
+/* hash of the objects reachable from 'roots' through own properties,
+   elements and prototypes, to tell whether scripts changed any of them;
+   only comparable within one context. The global object is hashed by
+   address only. Return -1 on exception. */
+int JS_HashObjectGraph(JSContext *ctx, uint64_t *phash,
+                       JSValueConst *roots, int count);
 int JS_IsInstanceOf(JSContext *ctx, JSValueConst val, JSValueConst obj);
 int JS_DefineProperty(JSContext *ctx, JSValueConst this_obj,
                       JSAtom prop, JSValueConst val,
@@ -860,6 +894,9 @@ JSValue JS_NewArrayBuffer(JSContext *ctx, uint8_t *buf, size_t len,
                           JS_BOOL is_shared);
 JSValue JS_NewArrayBufferCopy(JSContext *ctx, const uint8_t *buf, size_t len);
 void JS_DetachArrayBuffer(JSContext *ctx, JSValueConst obj);
+uint8_t *JS_TransferArrayBuffer(JSContext *ctx, JSValueConst obj, size_t *psize,
+                                JSFreeArrayBufferDataFunc **pfree_func,
+                                void **popaque);
 uint8_t *JS_GetArrayBuffer(JSContext *ctx, size_t *psize, JSValueConst obj);
 
 typedef enum JSTypedArrayEnum {
@@ -882,6 +919,10 @@ JSValue JS_GetTypedArrayBuffer(JSContext *ctx, JSValueConst obj,
                                size_t *pbyte_offset,
                                size_t *pbyte_length,
                                size_t *pbytes_per_element);
+/* return the JSTypedArrayEnum of a typed array, or -1 for other values */
+int JS_GetTypedArrayType(JSValueConst obj);
+/* true for ArrayBuffer and SharedArrayBuffer objects */
+JS_BOOL JS_IsArrayBuffer(JSValueConst obj);
 typedef struct {
     void *(*sab_alloc)(void *opaque, size_t size);
     void (*sab_free)(void *opaque, void *ptr);
@@ -910,6 +951,16 @@ void JS_SetHostPromiseRejectionTracker(JSRuntime *rt, JSHostPromiseRejectionTrac
 /* return != 0 if the JS code needs to be interrupted */
 typedef int JSInterruptHandler(JSRuntime *rt, void *opaque);
 void JS_SetInterruptHandler(JSRuntime *rt, JSInterruptHandler *cb, void *opaque);
+
+/* Called for each stack frame, innermost first. function_name is "" for
+   anonymous functions and "(native)" for C functions; line_num is 0 when
+   unknown. The strings are only valid during the call. */
+typedef void JSStackFrameVisitor(void *opaque, const char *function_name,
+                                 const char *filename, int line_num);
+/* Visit at most max_frames frames of the running stack, e.g. from an
+   interrupt handler; returns the number of frames visited */
+int JS_VisitStackFrames(JSContext *ctx, JSStackFrameVisitor *visitor, void *opaque,
+                        int max_frames);
 /* if can_block is TRUE, Atomics.wait() can be used */
 void JS_SetCanBlock(JSRuntime *rt, JS_BOOL can_block);
 /* select which debug info is stripped from the compiled code */
@@ -956,10 +1007,19 @@ int JS_ExecutePendingJob(JSRuntime *rt, JSContext **pctx);
 #define JS_WRITE_OBJ_REFERENCE (1 << 3) /* allow object references to
                                            encode arbitrary object
                                            graph */
+#define JS_WRITE_OBJ_STRICT    (1 << 4) /* fail on objects that would not
+                                           read back as they are, such as
+                                           class instances or non-enumerable,
+                                           symbol and read-only properties */
 uint8_t *JS_WriteObject(JSContext *ctx, size_t *psize, JSValueConst obj,
                         int flags);
 uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
                          int flags, uint8_t ***psab_tab, size_t *psab_tab_len);
+/* the ArrayBuffers of 'transfer_tab' are written as their index in the
+   table instead of their contents */
+uint8_t *JS_WriteObject3(JSContext *ctx, size_t *psize, JSValueConst obj,
+                         int flags, uint8_t ***psab_tab, size_t *psab_tab_len,
+                         JSValueConst *transfer_tab, int transfer_len);
 
 #define JS_READ_OBJ_BYTECODE  (1 << 0) /* allow function/module */
 #define JS_READ_OBJ_ROM_DATA  (1 << 1) /* avoid duplicating 'buf' data */
@@ -967,6 +1027,31 @@ uint8_t *JS_WriteObject2(JSContext *ctx, size_t *psize, JSValueConst obj,
 #define JS_READ_OBJ_REFERENCE (1 << 3) /* allow object references */
 JSValue JS_ReadObject(JSContext *ctx, const uint8_t *buf, size_t buf_len,
                       int flags);
+/* transferred ArrayBuffers are taken from 'transfer_tab', in the order
+   given to JS_WriteObject3() */
+JSValue JS_ReadObject2(JSContext *ctx, const uint8_t *buf, size_t buf_len,
+                       int flags, JSValueConst *transfer_tab, int transfer_len);
+
+/* Atom table shared by several bytecode objects, e.g. the scripts of a
+   bundle: each atom is written once for all of them, and interned once
+   per runtime when the table is read. The objects must be written and
+   read with JS_WRITE_OBJ_BYTECODE / JS_READ_OBJ_BYTECODE. */
+typedef struct JSAtomTable JSAtomTable;
+JSAtomTable *JS_NewAtomTable(JSContext *ctx);
+void JS_FreeAtomTable(JSRuntime *rt, JSAtomTable *tab);
+/* the atoms of 'obj' are added to 'tab' instead of being written */
+uint8_t *JS_WriteObjectWithAtomTable(JSContext *ctx, size_t *psize,
+                                     JSValueConst obj, int flags,
+                                     JSAtomTable *tab);
+/* serialize the atoms added so far */
+uint8_t *JS_WriteAtomTable(JSContext *ctx, size_t *psize, JSAtomTable *tab);
+/* intern the atoms of a serialized table; the table belongs to the
+   runtime of 'ctx' */
+JSAtomTable *JS_ReadAtomTable(JSContext *ctx, const uint8_t *buf,
+                              size_t buf_len);
+JSValue JS_ReadObjectWithAtomTable(JSContext *ctx, const uint8_t *buf,
+                                   size_t buf_len, int flags,
+                                   JSAtomTable *tab);
 /* instantiate and evaluate a bytecode function. Only used when
    reading a script or module with JS_ReadObject() */
 JSValue JS_EvalFunction(JSContext *ctx, JSValue fun_obj);
@@ -1,16 +1,43 @@
 #include <jni.h>
 #include <string>
 #include <vector>
-#include <android/log.h>
 #include <sstream>
 #include <map>
 #include <regex>
 #include <algorithm>
 #include <cmath>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <deque>
+#include <queue>
+#include <chrono>
+#include <thread>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <malloc.h>
+#include <unistd.h>
 
-#define LOG_TAG "QuickJS"
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#include "logging.h"
+#include "bytecode_bundle.h"
+#include "host_functions.h"
+#include "mapped_source.h"
+#include "console_log.h"
+#include "microbench_runner.h"
+#include "sampling_profiler.h"
+#include "slab_allocator.h"
+#include "tracing.h"
+#include "event_loop.h"
+#include "execution_counters.h"
+#include "idle_collector.h"
+#include "value_codec.h"
+#include "worker_message.h"
 
 // Include real QuickJS headers
 extern "C" {
@@ -24,10 +51,27 @@ JavaVM *g_jvm = nullptr;
 // Global references for HTTP polyfills
 static jobject g_quickjsBridgeInstance = nullptr;
 static jmethodID g_handleHttpRequestMethod = nullptr;
+static jmethodID g_handleHttpRequestAsyncMethod = nullptr;
+static jmethodID g_scriptResultMethod = nullptr;
 
 // Forward declarations
 static JSValue js_http_request(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+static JSValue js_http_request_async(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+static ExecutionCounters *countersOf(JSContext *ctx);
+static JSValue js_decode_body(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+static void js_free_http_body(JSRuntime *rt, void *opaque, void *ptr);
+static JSValue js_set_timer(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv, int magic);
+static JSValue js_clear_timer(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+static JSValue js_performance_now(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+static JSValue js_console_log(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv, int magic);
+static JSValue js_worker_ctor(JSContext *ctx, JSValueConst new_target, int argc, JSValueConst *argv);
+static JSValue js_worker_post_message(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+static JSValue js_worker_terminate(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+static JSValue js_worker_scope_post_message(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+static JSValue js_worker_scope_close(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
 void initializeHttpPolyfill(JNIEnv *env, jobject bridgeInstance);
+static JSValue evalPolyfill(JSContext *ctx, const char *source, const char *filename);
+static JSModuleDef *loadBundledModule(JSContext *ctx, const char *moduleName, void *opaque);
 void addConsoleSupport(JSContext *ctx);
 void addTimerPolyfills(JSContext *ctx);
 void addHttpPolyfills(JSContext *ctx);
@@ -68,8 +112,17 @@ static JSValue js_http_request(JSContext *ctx, JSValueConst this_val, int argc,
     jstring jUrl = env->NewStringUTF(url);
     jstring jOptions = env->NewStringUTF(options);
     
-    jstring jResult = (jstring)env->CallObjectMethod(g_quickjsBridgeInstance, 
-        g_handleHttpRequestMethod, jUrl, jOptions);
+    jstring jResult;
+    {
+        TraceSection trace("js_http_request");
+        int64_t start = ExecutionCounters::nowNs();
+        jResult = (jstring)env->CallObjectMethod(g_quickjsBridgeInstance,
+            g_handleHttpRequestMethod, jUrl, jOptions);
+        if (ExecutionCounters *counters = countersOf(ctx)) {
+            counters->add(ExecutionCounters::HTTP_CALLS, 1);
+            counters->add(ExecutionCounters::HTTP_NS, ExecutionCounters::nowNs() - start);
+        }
+    }
     
     env->DeleteLocalRef(jUrl);
     env->DeleteLocalRef(jOptions);
@@ -108,96 +161,101 @@ void initializeHttpPolyfill(JNIEnv *env, jobject bridgeInstance) {
     if (!g_handleHttpRequestMethod) {
         LOGE("Failed to find handleHttpRequest method");
     }
+    
+    g_handleHttpRequestAsyncMethod = env->GetMethodID(bridgeClass, "handleHttpRequestAsync", 
+        "(IILjava/lang/String;Ljava/lang/String;)V");
+    
+    if (!g_handleHttpRequestAsyncMethod) {
+        LOGE("Failed to find handleHttpRequestAsync method");
+    }
+}
+
+// Polyfill bytecode snapshot, keyed by polyfill filename
+// Each polyfill is parsed once per process; every later initialize() and
+// resetContext() in any pooled engine only deserializes the bytecode.
+// Entries are never removed, so references into the map stay valid.
+static std::mutex g_polyfillSnapshotMutex;
+static std::map<std::string, std::vector<uint8_t>> g_polyfillSnapshot;
+
+// Evaluate a polyfill in global scope, from its bytecode snapshot when available
+// Returns the evaluation result with the same semantics as JS_Eval
+static JSValue evalPolyfill(JSContext *ctx, const char *source, const char *filename) {
+    const std::vector<uint8_t> *snapshot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(g_polyfillSnapshotMutex);
+        auto it = g_polyfillSnapshot.find(filename);
+        if (it != g_polyfillSnapshot.end()) {
+            snapshot = &it->second;
+        }
+    }
+
+    JSValue function;
+    if (snapshot) {
+        function = JS_ReadObject(ctx, snapshot->data(), snapshot->size(), JS_READ_OBJ_BYTECODE);
+    } else {
+        function = JS_Eval(ctx, source, strlen(source), filename,
+                           JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+        if (!JS_IsException(function)) {
+            size_t bytecodeSize;
+            uint8_t *bytecode = JS_WriteObject(ctx, &bytecodeSize, function, JS_WRITE_OBJ_BYTECODE);
+            if (bytecode) {
+                std::lock_guard<std::mutex> lock(g_polyfillSnapshotMutex);
+                g_polyfillSnapshot.emplace(filename, std::vector<uint8_t>(bytecode, bytecode + bytecodeSize));
+                js_free(ctx, bytecode);
+                LOGI("Created polyfill snapshot %s: %zu bytes", filename, bytecodeSize);
+            }
+        }
+    }
+
+    if (JS_IsException(function)) {
+        return function;
+    }
+    return JS_EvalFunction(ctx, function);
 }
 
 // Add console support to QuickJS context
+// Console records of every engine, drained from Kotlin
+static ConsoleLog g_consoleLog;
+std::atomic<bool> g_verboseLogging(false);
+
 void addConsoleSupport(JSContext *ctx) {
-    // Add console.log function
-    const char *consolePolyfill = R"(
-(function() {
-    globalThis.console = {
-        log: function(...args) {
-            var message = args.map(arg => {
-                if (typeof arg === 'object') {
-                    try {
-                        return JSON.stringify(arg, null, 2);
-                    } catch (e) {
-                        return '[object Object]';
-                    }
-                } else {
-                    return String(arg);
-                }
-            }).join(' ');
-            
-            // In a real implementation, this would call a native function
-            // For now, we'll just return the message
-            return message;
-        },
-        error: function(...args) {
-            return this.log('ERROR:', ...args);
-        },
-        warn: function(...args) {
-            return this.log('WARN:', ...args);
-        },
-        info: function(...args) {
-            return this.log('INFO:', ...args);
-        }
+    static const struct {
+        const char *name;
+        int level;
+    } methods[] = {
+        {"debug", ConsoleLog::LEVEL_DEBUG},
+        {"log", ConsoleLog::LEVEL_INFO},
+        {"info", ConsoleLog::LEVEL_INFO},
+        {"warn", ConsoleLog::LEVEL_WARN},
+        {"error", ConsoleLog::LEVEL_ERROR},
     };
-})();
-)";
     
-    JSValue result = JS_Eval(ctx, consolePolyfill, strlen(consolePolyfill), "<console-polyfill>", JS_EVAL_TYPE_GLOBAL);
-    if (JS_IsException(result)) {
-        JSValue exception = JS_GetException(ctx);
-        const char *exceptionStr = JS_ToCString(ctx, exception);
-        LOGE("Failed to add console support: %s", exceptionStr ? exceptionStr : "Unknown error");
-        if (exceptionStr) JS_FreeCString(ctx, exceptionStr);
-        JS_FreeValue(ctx, exception);
+    JSValue global = JS_GetGlobalObject(ctx);
+    JSValue console = JS_NewObject(ctx);
+    for (const auto &method : methods) {
+        JS_SetPropertyStr(ctx, console, method.name,
+            JS_NewCFunctionMagic(ctx, js_console_log, method.name, 1, JS_CFUNC_generic_magic, method.level));
     }
-    JS_FreeValue(ctx, result);
+    JS_SetPropertyStr(ctx, global, "console", console);
+    JS_FreeValue(ctx, global);
 }
 
 // Add timer polyfills to QuickJS context
 void addTimerPolyfills(JSContext *ctx) {
-    // Add setTimeout/setInterval polyfills - simple immediate execution for demo
-    const char *timerPolyfill = R"(
-(function() {
-    // Simple setTimeout that executes immediately for demo purposes
-    // In a real implementation, this would use native threading/timers
-    globalThis.setTimeout = function(callback, delay) {
-        // For demo purposes, execute the callback immediately
-        // This allows promises with setTimeout to resolve
-        try {
-            callback();
-        } catch (e) {
-            throw e;
-        }
-        return 1; // return a dummy timer ID
-    };
-    
-    globalThis.clearTimeout = function(id) {
-        // No-op for demo
-    };
-    
-    globalThis.setInterval = function(callback, delay) {
-        return setTimeout(callback, delay);
-    };
-    
-    globalThis.clearInterval = function(id) {
-        clearTimeout(id);
-    };
-})();
-)";
+    JSValue global = JS_GetGlobalObject(ctx);
+    JS_SetPropertyStr(ctx, global, "setTimeout",
+        JS_NewCFunctionMagic(ctx, js_set_timer, "setTimeout", 2, JS_CFUNC_generic_magic, 0));
+    JS_SetPropertyStr(ctx, global, "setInterval",
+        JS_NewCFunctionMagic(ctx, js_set_timer, "setInterval", 2, JS_CFUNC_generic_magic, 1));
+    JS_SetPropertyStr(ctx, global, "clearTimeout",
+        JS_NewCFunction(ctx, js_clear_timer, "clearTimeout", 1));
+    JS_SetPropertyStr(ctx, global, "clearInterval",
+        JS_NewCFunction(ctx, js_clear_timer, "clearInterval", 1));
     
-    JSValue result = JS_Eval(ctx, timerPolyfill, strlen(timerPolyfill), "<timer-polyfill>", JS_EVAL_TYPE_GLOBAL);
-    if (JS_IsException(result)) {
-        JSValue exception = JS_GetException(ctx);
-        const char *exceptionStr = JS_ToCString(ctx, exception);
-        LOGE("Failed to add timer support: %s", exceptionStr ? exceptionStr : "Unknown error");
-        if (exceptionStr) JS_FreeCString(ctx, exceptionStr);
-        JS_FreeValue(ctx, exception);
-    }
-    JS_FreeValue(ctx, result);
+    JSValue performance = JS_NewObject(ctx);
+    JS_SetPropertyStr(ctx, performance, "now", JS_NewCFunction(ctx, js_performance_now, "now", 0));
+    JS_SetPropertyStr(ctx, global, "performance", performance);
+    JS_FreeValue(ctx, global);
 }
 
 // Add HTTP polyfills to QuickJS context
@@ -206,62 +264,80 @@ void addHttpPolyfills(JSContext *ctx) {
     JSValue global = JS_GetGlobalObject(ctx);
     JS_SetPropertyStr(ctx, global, "_nativeHttpRequest", 
         JS_NewCFunction(ctx, js_http_request, "_nativeHttpRequest", 2));
+    JS_SetPropertyStr(ctx, global, "_nativeHttpRequestAsync", 
+        JS_NewCFunction(ctx, js_http_request_async, "_nativeHttpRequestAsync", 2));
+    JS_SetPropertyStr(ctx, global, "_nativeDecodeBody", 
+        JS_NewCFunction(ctx, js_decode_body, "_nativeDecodeBody", 2));
     
     // Add fetch polyfill
     const char *fetchPolyfill = R"(
 (function() {
     // Fetch API polyfill
+    // Requests run concurrently on the Kotlin side; the promise settles from
+    // the engine's event loop when the response arrives
     globalThis.fetch = function(url, options) {
         options = options || {};
         
-        return new Promise(function(resolve, reject) {
-            try {
-                var requestOptions = {
-                    method: options.method || 'GET',
-                    headers: options.headers || {},
-                    body: options.body || null,
-                    timeout: options.timeout || 30000,
-                    redirect: options.redirect || 'follow',
-                    credentials: options.credentials || 'same-origin'
-                };
+        var requestOptions = {
+            method: options.method || 'GET',
+            headers: options.headers || {},
+            body: options.body || null,
+            timeout: options.timeout || 30000,
+            redirect: options.redirect || 'follow',
+            credentials: options.credentials || 'same-origin'
+        };
+        
+        return _nativeHttpRequestAsync(String(url), JSON.stringify(requestOptions)).then(function(response) {
+            if (!response || response.status === undefined) {
+                throw new Error('Network request failed');
+            }
+            
+            // The body arrives as an ArrayBuffer over the downloaded bytes;
+            // text() and json() decode it natively on demand
+            var body = response.body;
+            var headers = new Map(Object.entries(response.headers || {}));
+            function read(decode) {
+                try {
+                    return Promise.resolve(decode());
+                } catch (e) {
+                    return Promise.reject(e);
+                }
+            }
+            
+            // Create Response object
+            return {
+                status: response.status,
+                statusText: response.statusText,
+                ok: response.ok,
+                redirected: response.redirected,
+                url: response.url,
+                type: response.type,
+                headers: headers,
                 
-                var response = _nativeHttpRequest(url, JSON.stringify(requestOptions));
+                text: function() {
+                    return read(function() { return _nativeDecodeBody(body, false); });
+                },
                 
-                if (response && response.status !== undefined) {
-                    // Create Response object
-                    var responseObj = {
-                        status: response.status,
-                        statusText: response.statusText,
-                        ok: response.ok,
-                        redirected: response.redirected,
-                        url: response.url,
-                        type: response.type,
-                        headers: new Map(Object.entries(response.headers || {})),
-                        
-                        text: function() {
-                            return Promise.resolve(response.body || '');
-                        },
-                        
-                        json: function() {
-                            return Promise.resolve(JSON.parse(response.body || '{}'));
-                        },
-                        
-                        blob: function() {
-                            return Promise.reject(new Error('Blob not supported'));
-                        },
-                        
-                        arrayBuffer: function() {
-                            return Promise.reject(new Error('ArrayBuffer not supported'));
-                        }
-                    };
-                    
-                    resolve(responseObj);
-                } else {
-                    reject(new Error('Network request failed'));
+                json: function() {
+                    return read(function() {
+                        return body.byteLength ? _nativeDecodeBody(body, true) : {};
+                    });
+                },
+                
+                blob: function() {
+                    var type = headers.get('content-type') || headers.get('Content-Type') || '';
+                    return Promise.resolve({
+                        size: body.byteLength,
+                        type: type,
+                        arrayBuffer: function() { return Promise.resolve(body); },
+                        text: function() { return read(function() { return _nativeDecodeBody(body, false); }); }
+                    });
+                },
+                
+                arrayBuffer: function() {
+                    return Promise.resolve(body);
                 }
-            } catch (e) {
-                reject(e);
-            }
+            };
         });
     };
     
@@ -271,6 +347,8 @@ void addHttpPolyfills(JSContext *ctx) {
         this.status = 0;
         this.statusText = '';
         this.responseText = '';
+        this.responseType = '';
+        this.response = null;
         this.responseXML = null;
         this.onreadystatechange = null;
         this._method = 'GET';
@@ -281,6 +359,7 @@ void addHttpPolyfills(JSContext *ctx) {
         this.open = function(method, url, async) {
             this._method = method;
             this._url = url;
+            this._async = async !== false;
             this.readyState = 1;
             if (this.onreadystatechange) this.onreadystatechange();
         };
@@ -292,34 +371,56 @@ void addHttpPolyfills(JSContext *ctx) {
         this.send = function(body) {
             var self = this;
             this._body = body;
+            this._aborted = false;
             this.readyState = 2;
             if (this.onreadystatechange) this.onreadystatechange();
             
+            var options = {
+                method: this._method,
+                headers: this._headers,
+                body: this._body
+            };
+            
+            function complete(response) {
+                if (self._aborted) return;
+                self.status = response.status || 0;
+                self.statusText = response.statusText || '';
+                // Async responses carry the body as an ArrayBuffer, sync ones as a string
+                var body = response.body || '';
+                if (self.responseType === 'arraybuffer' && body instanceof ArrayBuffer) {
+                    self.response = body;
+                } else {
+                    self.responseText = body instanceof ArrayBuffer ? _nativeDecodeBody(body, false) : body;
+                    self.response = self.responseText;
+                }
+                self.readyState = 4;
+                if (self.onreadystatechange) self.onreadystatechange();
+            }
+            
+            function fail() {
+                if (self._aborted) return;
+                self.status = 0;
+                self.statusText = 'Error';
+                self.responseText = '';
+                self.response = null;
+                self.readyState = 4;
+                if (self.onreadystatechange) self.onreadystatechange();
+            }
+            
+            if (this._async) {
+                _nativeHttpRequestAsync(this._url, JSON.stringify(options)).then(complete, fail);
+                return;
+            }
+            
             try {
-                var options = {
-                    method: this._method,
-                    headers: this._headers,
-                    body: this._body
-                };
-                
-                var response = _nativeHttpRequest(this._url, JSON.stringify(options));
-                
-                this.status = response.status || 0;
-                this.statusText = response.statusText || '';
-                this.responseText = response.body || '';
-                this.readyState = 4;
-                
-                if (this.onreadystatechange) this.onreadystatechange();
+                complete(_nativeHttpRequest(this._url, JSON.stringify(options)));
             } catch (e) {
-                this.status = 0;
-                this.statusText = 'Error';
-                this.responseText = '';
-                this.readyState = 4;
-                if (this.onreadystatechange) this.onreadystatechange();
+                fail();
             }
         };
         
         this.abort = function() {
+            this._aborted = true;
             this.readyState = 0;
         };
         
@@ -341,7 +442,7 @@ void addHttpPolyfills(JSContext *ctx) {
 })();
 )";
     
-    JSValue result = JS_Eval(ctx, fetchPolyfill, strlen(fetchPolyfill), "<fetch-polyfill>", JS_EVAL_TYPE_GLOBAL);
+    JSValue result = evalPolyfill(ctx, fetchPolyfill, "<fetch-polyfill>");
     if (JS_IsException(result)) {
         JSValue exception = JS_GetException(ctx);
         const char *exceptionStr = JS_ToCString(ctx, exception);
@@ -353,46 +454,488 @@ void addHttpPolyfills(JSContext *ctx) {
     JS_FreeValue(ctx, global);
 }
 
+// Class of Worker objects; the opaque is the worker id in the parent engine
+static JSClassID g_workerClassId;
+static std::once_flag g_workerClassOnce;
+
+// Add the Worker constructor to a QuickJS context
+void addWorkerPolyfills(JSContext *ctx) {
+    std::call_once(g_workerClassOnce, [] {
+        JS_NewClassID(&g_workerClassId);
+    });
+    JSRuntime *rt = JS_GetRuntime(ctx);
+    if (!JS_IsRegisteredClass(rt, g_workerClassId)) {
+        JSClassDef workerClass = {"Worker", nullptr, nullptr, nullptr, nullptr};
+        JS_NewClass(rt, g_workerClassId, &workerClass);
+    }
+
+    JSValue proto = JS_NewObject(ctx);
+    JS_SetPropertyStr(ctx, proto, "postMessage",
+        JS_NewCFunction(ctx, js_worker_post_message, "postMessage", 2));
+    JS_SetPropertyStr(ctx, proto, "terminate",
+        JS_NewCFunction(ctx, js_worker_terminate, "terminate", 0));
+    JSValue ctor = JS_NewCFunction2(ctx, js_worker_ctor, "Worker", 1, JS_CFUNC_constructor, 0);
+    JS_SetConstructor(ctx, ctor, proto);
+    JS_SetClassProto(ctx, g_workerClassId, proto);
+
+    JSValue global = JS_GetGlobalObject(ctx);
+    JS_SetPropertyStr(ctx, global, "Worker", ctor);
+    JS_FreeValue(ctx, global);
+}
+
+// Add the scope of a worker script: self, postMessage() and close()
+void addWorkerScopePolyfills(JSContext *ctx) {
+    JSValue global = JS_GetGlobalObject(ctx);
+    JS_SetPropertyStr(ctx, global, "self", JS_DupValue(ctx, global));
+    JS_SetPropertyStr(ctx, global, "postMessage",
+        JS_NewCFunction(ctx, js_worker_scope_post_message, "postMessage", 2));
+    JS_SetPropertyStr(ctx, global, "close",
+        JS_NewCFunction(ctx, js_worker_scope_close, "close", 0));
+    JS_FreeValue(ctx, global);
+}
+
+// LRU cache of compiled script functions, keyed by a hash of the source
+// Holds JS_EVAL_FLAG_COMPILE_ONLY results so repeated executions skip the parser.
+// Compiled functions belong to the context they were compiled in, so the cache
+// must be cleared before that context is freed.
+class ScriptCache {
+public:
+    static constexpr size_t DEFAULT_BUDGET = 2 * 1024 * 1024;  // 2MB per engine
+
+    ScriptCache() : budget(DEFAULT_BUDGET), bytes(0), entryCount(0), hits(0), misses(0) {
+    }
+
+    // Returns a new reference to the compiled function for source, compiling it on a miss
+    JSValue getOrCompile(JSContext *ctx, const std::string &source, const char *filename) {
+        uint64_t hash = hashSource(source);
+        auto it = index.find(hash);
+        if (it != index.end() && it->second->source == source) {
+            entries.splice(entries.begin(), entries, it->second);
+            hits++;
+            return JS_DupValue(ctx, it->second->function);
+        }
+        misses++;
+
+        JSRuntime *rt = JS_GetRuntime(ctx);
+        size_t before = JS_GetMallocSize(rt);
+        JSValue function;
+        {
+            TraceSection trace("QuickJS compile");
+            function = JS_Eval(ctx, source.c_str(), source.length(), filename,
+                               JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+        }
+        if (JS_IsException(function)) {
+            return function;
+        }
+        size_t after = JS_GetMallocSize(rt);
+
+        // Charge the retained source copy plus what the compiler allocated
+        size_t cost = source.length() + (after > before ? after - before : 0);
+        if (cost > budget.load()) {
+            return function;
+        }
+
+        if (it != index.end()) {
+            // Hash collision with a different source: replace the old entry
+            evict(ctx, it->second);
+        }
+        entries.push_front(Entry{hash, source, JS_DupValue(ctx, function), cost});
+        index[hash] = entries.begin();
+        bytes += cost;
+        trim(ctx);
+        return function;
+    }
+
+    void setBudget(JSContext *ctx, size_t newBudget) {
+        budget = newBudget;
+        if (ctx) {
+            trim(ctx);
+        }
+    }
+
+    void clear(JSContext *ctx) {
+        for (auto &entry : entries) {
+            JS_FreeValue(ctx, entry.function);
+        }
+        forget();
+    }
+
+    // Drop every entry without freeing it, for a context thrown away with its heap
+    void forget() {
+        entries.clear();
+        index.clear();
+        bytes = 0;
+        entryCount = 0;
+    }
+
+    // Counters may be read without holding the engine lease
+    size_t getBudget() const { return budget.load(); }
+    size_t getBytes() const { return bytes.load(); }
+    size_t getEntryCount() const { return entryCount.load(); }
+    uint64_t getHits() const { return hits.load(); }
+    uint64_t getMisses() const { return misses.load(); }
+
+    // 64-bit FNV-1a, the key sources are cached under
+    static uint64_t hashSource(const std::string &source) {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (unsigned char c : source) {
+            hash ^= c;
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+private:
+    struct Entry {
+        uint64_t hash;
+        std::string source;
+        JSValue function;
+        size_t cost;
+    };
+
+    void evict(JSContext *ctx, std::list<Entry>::iterator entry) {
+        bytes -= entry->cost;
+        JS_FreeValue(ctx, entry->function);
+        index.erase(entry->hash);
+        entries.erase(entry);
+    }
+
+    void trim(JSContext *ctx) {
+        while (!entries.empty() && bytes.load() > budget.load()) {
+            evict(ctx, std::prev(entries.end()));
+        }
+        entryCount = entries.size();
+    }
+
+    std::list<Entry> entries;  // Most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+    std::atomic<size_t> budget;
+    std::atomic<size_t> bytes;
+    std::atomic<size_t> entryCount;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+};
+
+// Minimum time between memory samples taken as leases end; 0 disables sampling
+static std::atomic<int64_t> g_memorySampleIntervalMs(0);
+
+// Execution timeout applied to every lease unless overridden; 0 disables it
+static std::atomic<int64_t> g_defaultExecutionTimeoutMs(0);
+
+// Memory settings for mobile environments
+// After each GC the next one is scheduled once the live heap has doubled, so
+// allocation-heavy scripts collect in proportion to what they keep rather
+// than every megabyte; the headroom below the limit makes sure garbage is
+// collected before an allocation fails.
+static const size_t MEMORY_LIMIT = 64 * 1024 * 1024;
+static const size_t GC_MIN_THRESHOLD = 2 * 1024 * 1024;
+static const unsigned int GC_GROWTH_PERCENT = 100;
+static const size_t GC_MAX_THRESHOLD = MEMORY_LIMIT - MEMORY_LIMIT / 8;
+
+// Engines handed back with at least this much heap growth since their last
+// collection are collected once idle for g_idleGcDelayMs, so executions rarely
+// pay for garbage left by earlier ones; 0 disables idle collection
+static const size_t IDLE_GC_MIN_GARBAGE = 512 * 1024;
+static std::atomic<int64_t> g_idleGcDelayMs(100);
+
+// JSMemoryUsage is all int64_t counters, so high-water marks are tracked field by field
+static constexpr size_t MEMORY_USAGE_FIELDS = sizeof(JSMemoryUsage) / sizeof(int64_t);
+static_assert(sizeof(JSMemoryUsage) == MEMORY_USAGE_FIELDS * sizeof(int64_t), "JSMemoryUsage layout changed");
+
+// Features a realm is built with, see QuickJSEngine::executeInRealm()
+// Mirrored by QuickJSBridge.RealmFeature
+enum RealmFeature {
+    REALM_CONSOLE = 1 << 0,
+    REALM_TIMERS = 1 << 1,
+    REALM_FETCH = 1 << 2,         // fetch() and XMLHttpRequest; brings typed arrays for response bodies
+    REALM_DATE = 1 << 3,
+    REALM_REGEXP = 1 << 4,
+    REALM_PROXY = 1 << 5,
+    REALM_TYPED_ARRAYS = 1 << 6,  // ArrayBuffer, typed arrays, DataView and Atomics
+    REALM_WEAK_REFS = 1 << 7,     // WeakRef and FinalizationRegistry
+};
+static const int REALM_ALL_FEATURES = (1 << 8) - 1;
+
+// Features of an engine's ordinary context: every intrinsic, the host helpers and all polyfills
+static const int REALM_FULL_CONTEXT = -1;
+
+// Last realm features of an engine that has not used a realm yet
+static const int REALM_UNUSED = -2;
+
 // Real QuickJS Engine implementation
-class QuickJSEngine {
+class QuickJSEngine;
+class WorkerThread;
+
+// Owner of a response body wrapped in an ArrayBuffer
+struct HttpBody {
+    jobject buffer;  // Global reference to the direct ByteBuffer
+    QuickJSEngine *engine;
+};
+
+// What a worker or its parent posted to the other
+enum WorkerEventKind {
+    WORKER_MESSAGE,
+    WORKER_ERROR,   // Uncaught exception in the worker
+    WORKER_EXIT,    // The worker script has ended
+};
+
+// Delete a global reference from whichever JVM thread the engine runs on
+static void releaseGlobalRef(jobject ref) {
+    if (!ref) {
+        return;
+    }
+    JNIEnv *env = nullptr;
+    if (g_jvm && g_jvm->GetEnv((void**)&env, JNI_VERSION_1_6) == JNI_OK) {
+        env->DeleteGlobalRef(ref);
+    } else {
+        LOGE("Leaking global reference: thread not attached to the JVM");
+    }
+}
+
+class QuickJSEngine : public BufferHome {
 public:
     JSRuntime *runtime;  // Made public for memory stats access
 private:
     JSContext *context;
     bool initialized;
+    int id;  // Pool handle, used to route async completions back to this engine
+    ScriptCache scriptCache;
+    
+    // Atom tables of the bundles read in this runtime, keyed by bundle handle,
+    // interned on first use and freed with the runtime or after the bundle closes
+    struct BundleAtoms {
+        std::weak_ptr<BytecodeBundle> bundle;
+        JSAtomTable *table;
+    };
+    std::map<jlong, BundleAtoms> bundleAtoms;
+    
+    // Allocator of the runtime when slab allocation is on; outlives the runtime
+    // Arena engines run one throwaway execution and are then discarded whole
+    // Worker engines run the scripts of Worker objects on a WorkerThread
+    bool useSlabAllocator;
+    bool arena;
+    bool worker;
+    std::unique_ptr<SlabAllocator> slabAllocator;
+    
+    // REALM_* features the context is built with, or REALM_FULL_CONTEXT
+    int realmFeatures;
+    
+    // Arena engine made ahead for the next realm, while the engine sat idle,
+    // and the features the last realm asked for; only touched under the lease
+    std::unique_ptr<QuickJSEngine> spareRealm;
+    int lastRealmFeatures;
+    
+    // In-flight async HTTP requests, keyed by request id
+    // Only touched while the engine is leased
+    struct PendingHttpRequest {
+        JSValue resolve;
+        JSValue reject;
+    };
+    std::map<uint32_t, PendingHttpRequest> pendingHttpRequests;
+    uint32_t nextHttpRequestId;
+    
+    // Response bodies handed to JS that are followed by a NUL byte, so
+    // JS_ParseJSON can read them in place
+    std::unordered_set<const uint8_t *> terminatedBodies;
+    
+    // Owners of response bodies still referenced from JS
+    std::unordered_set<HttpBody *> liveBodies;
+    
+    // Responses posted from other threads, drained by the event loop
+    // The body is a direct ByteBuffer that JS wraps without copying
+    struct HttpCompletion {
+        uint32_t requestId;
+        std::string metadata;
+        jobject body;       // Global reference
+        uint8_t *bodyData;
+        size_t bodyLength;
+        bool terminated;    // bodyData[bodyLength] == '\0'
+    };
+    std::mutex completionMutex;
+    std::deque<HttpCompletion> completions;
+    
+    // Workers started by this engine's context, keyed by worker id
+    // Only touched while the engine is leased
+    struct WorkerEntry {
+        JSValue object;     // The Worker, kept alive until its script ends
+        WorkerThread *thread;
+        uint64_t job;
+    };
+    std::map<uint32_t, WorkerEntry> workers;
+    uint32_t nextWorkerId;
+    
+    // Messages between this engine and its workers, or its parent when it is
+    // a worker engine; guarded by completionMutex like completions
+    struct WorkerEvent {
+        uint32_t workerId;  // 0 for events from the parent
+        WorkerEventKind kind;
+        std::unique_ptr<WorkerMessage> message;
+        std::string error;
+    };
+    std::deque<WorkerEvent> workerEvents;
+    
+    // Storage of this runtime's ArrayBuffers freed by other runtimes, to be
+    // released on this engine's thread; guarded by completionMutex
+    std::vector<TransferredBuffer *> returnedBuffers;
+    
+    // Buffers of this runtime sent to other runtimes and not yet back; their
+    // storage must outlive them, so the runtime is kept while any are away
+    std::atomic<size_t> buffersAway;
+    
+    // Engine that started the script a worker engine is running; it outlives
+    // the script, since it terminates its workers before going away
+    QuickJSEngine *workerParent;
+    uint32_t parentWorkerId;
+    bool workerClosing;  // close() was called by the worker script
+    
+    // Arena engine running a throwaway execution for this one, if any
+    // Completions of its requests and cancels are forwarded to it; guarded by
+    // both completionMutex and limitsMutex
+    QuickJSEngine *arenaChild;
+    uint32_t arenaFirstRequestId;
+    
+    // Event loop wakeups: wakeFd is signalled when a completion is posted and
+    // timerFd is armed for the next timer deadline; pollFd is an epoll set over
+    // both, so a waiter (this thread or the shared EventLoop) watches one fd
+    int wakeFd;
+    int timerFd;
+    int pollFd;
+    
+    // setTimeout/setInterval timers, keyed by timer id
+    typedef std::chrono::steady_clock Clock;
+    struct Timer {
+        JSValue callback;
+        std::vector<JSValue> args;
+        int64_t intervalMs;  // Negative for one-shot timers
+    };
+    std::map<uint32_t, Timer> timers;
+    // Min-heap of (deadline, timer id); entries of cleared timers are skipped when popped
+    typedef std::pair<Clock::time_point, uint32_t> TimerDeadline;
+    std::priority_queue<TimerDeadline, std::vector<TimerDeadline>, std::greater<TimerDeadline>> timerHeap;
+    uint32_t nextTimerId;
+    
+    // Per-field high-water marks of memory samples, readable without a lease
+    std::mutex memoryMutex;
+    JSMemoryUsage memoryPeak;
+    uint64_t memorySamples;
+    Clock::time_point lastMemorySample;
+    
+    SamplingProfiler profiler;
+    
+    // Work done by this engine, including the arena engines it ran
+    ExecutionCounters counters;
+    
+    // Execution limits of the current lease, enforced by the interrupt handler
+    // and while awaiting. cancelRequested may be set from any thread; the lease
+    // serial lets a late cancel for an earlier lease be ignored.
+    enum InterruptReason {
+        INTERRUPT_NONE,
+        INTERRUPT_TIMEOUT,
+        INTERRUPT_CANCEL,
+    };
+    std::mutex limitsMutex;
+    uint64_t leaseSerial;
+    std::atomic<bool> cancelRequested;
+    int64_t executionTimeoutMs;
+    int64_t deadlineNs;          // steady_clock time, 0 while no execution is timed
+    InterruptReason interruptReason;  // Latched once an execution is stopped
+    
+    // Trim asked for by Android while the engine was leased, applied as the lease ends
+    std::atomic<int> trimRequested;
+    
+    size_t heapAfterCollection;  // Baseline of the garbage estimate
+    
+    // Global names of a freshly set up full context, so hibernate() saves only
+    // what scripts defined; gathered from every context, host functions included
+    std::unordered_set<std::string> baselineGlobals;
+    
+    // Set while the runtime is freed by hibernate(), with the globals it saved
+    // Changed only under the lease; read without it by the pool
+    std::atomic<bool> hibernated;
+    std::vector<uint8_t> hibernatedState;
+    
+    // Globals the current context was set up with, and a hash of what they
+    // hold down to the built-in prototypes, so hibernate() can tell whether
+    // scripts changed what a restore rebuilds instead of saving
+    std::vector<std::string> contextGlobals;
+    uint64_t contextGlobalsHash;
+    bool contextGlobalsHashed;
     
 public:
-    QuickJSEngine() : runtime(nullptr), context(nullptr), initialized(false) {
+    enum TrimLevel {
+        TRIM_NONE = 0,
+        TRIM_GC = 1,        // Collect garbage and return free slab chunks
+        TRIM_CACHES = 2,    // Also drop compiled scripts and regexps
+    };
+    
+    explicit QuickJSEngine(int id = 0, bool useSlabAllocator = false, bool arena = false,
+                           bool worker = false, int realmFeatures = REALM_FULL_CONTEXT)
+        : runtime(nullptr), context(nullptr), initialized(false), id(id),
+          useSlabAllocator(useSlabAllocator || arena), arena(arena), worker(worker),
+          realmFeatures(realmFeatures), lastRealmFeatures(REALM_UNUSED), nextHttpRequestId(1),
+          nextWorkerId(1), buffersAway(0), workerParent(nullptr), parentWorkerId(0), workerClosing(false),
+          arenaChild(nullptr), arenaFirstRequestId(0),
+          wakeFd(-1), timerFd(-1), pollFd(-1), nextTimerId(1), memoryPeak(), memorySamples(0),
+          leaseSerial(0), cancelRequested(false), executionTimeoutMs(0), deadlineNs(0),
+          interruptReason(INTERRUPT_NONE), trimRequested(TRIM_NONE), heapAfterCollection(0),
+          hibernated(false), contextGlobalsHash(0), contextGlobalsHashed(false) {
     }
     
     bool initialize() {
-        LOGI("Initializing QuickJS Engine");
+        // Arena engines are created per execution, so only pooled ones log
+        if (!arena) {
+            LOGI("Initializing QuickJS Engine");
+        }
+
+        if (!setupWakeFds()) {
+            LOGE("Failed to create event loop fds: %s", strerror(errno));
+            closeWakeFds();
+            return false;
+        }
 
-        runtime = JS_NewRuntime();
+        if (useSlabAllocator) {
+            slabAllocator.reset(new SlabAllocator(arena));
+            runtime = JS_NewRuntime2(&SlabAllocator::MALLOC_FUNCTIONS, slabAllocator.get());
+        } else {
+            runtime = JS_NewRuntime();
+        }
         if (!runtime) {
             LOGE("Failed to create QuickJS runtime");
+            slabAllocator.reset();
+            closeWakeFds();
             return false;
         }
 
-        // Set memory limits for mobile environment
-        JS_SetMemoryLimit(runtime, 64 * 1024 * 1024); // 64MB limit
-        JS_SetGCThreshold(runtime, 1024 * 1024);       // 1MB GC threshold
+        JS_SetMemoryLimit(runtime, MEMORY_LIMIT);
+        JS_SetGCThreshold(runtime, GC_MIN_THRESHOLD);
+        JS_SetGCPolicy(runtime, GC_MIN_THRESHOLD, GC_GROWTH_PERCENT, GC_MAX_THRESHOLD);
+        JS_SetInterruptHandler(runtime, interruptHandler, this);
+        JS_SetModuleLoaderFunc(runtime, nullptr, loadBundledModule, nullptr);
+        TraceSection::install(runtime);
+        if (!arena) {
+            // Shared memory that every engine and worker can map
+            JS_SetSharedArrayBufferFunctions(runtime, &SharedBuffers::FUNCTIONS);
+        }
+        if (worker) {
+            // As on the web, Atomics.wait() only blocks in workers
+            JS_SetCanBlock(runtime, true);
+        }
 
-        context = JS_NewContext(runtime);
-        if (!context) {
+        if (!setupContext()) {
             LOGE("Failed to create QuickJS context");
             JS_FreeRuntime(runtime);
             runtime = nullptr;
+            slabAllocator.reset();
+            closeWakeFds();
             return false;
         }
 
-        js_std_add_helpers(context, 0, nullptr);
-        addConsoleSupport(context);
-        addTimerPolyfills(context);
-        addHttpPolyfills(context);
-
+        // Setting the context up is not part of any execution
+        counters.startRuntime(runtime);
         initialized = true;
-        LOGI("QuickJS Engine initialized successfully with memory management and HTTP polyfills");
+        if (!arena) {
+            LOGI("QuickJS Engine initialized successfully with memory management and HTTP polyfills");
+        }
         return true;
     }
     
@@ -401,141 +944,352 @@ public:
             return "Error: QuickJS not initialized";
         }
         
-        LOGI("Executing QuickJS script: %s", script.c_str());
-
-        // Evaluate the JavaScript code
-        JSValue result = JS_Eval(context, script.c_str(), script.length(),
-                "<input>", JS_EVAL_TYPE_GLOBAL);
-
+        TraceSection trace("QuickJS executeScript");
+        JSValue result = evaluateScript(script);
         if (JS_IsException(result)) {
-            // Handle JavaScript exceptions
-            JSValue exception = JS_GetException(context);
-            std::string error = "JavaScript Error: ";
-            
-            // Try to get error message
-            const char *exceptionStr = JS_ToCString(context, exception);
-            if (exceptionStr) {
-                error += exceptionStr;
-                JS_FreeCString(context, exceptionStr);
-            } else {
-                // If direct conversion fails, try to get more details
-                JSValue nameVal = JS_GetPropertyStr(context, exception, "name");
-                JSValue messageVal = JS_GetPropertyStr(context, exception, "message");
-                
-                const char *name = JS_ToCString(context, nameVal);
-                const char *message = JS_ToCString(context, messageVal);
-                
-                if (name && message) {
-                    error += name;
-                    error += ": ";
-                    error += message;
-                } else if (name) {
-                    error += name;
-                } else if (message) {
-                    error += message;
-                } else {
-                    error += "Unknown error (exception object could not be converted to string)";
-                }
-                
-                if (name) JS_FreeCString(context, name);
-                if (message) JS_FreeCString(context, message);
-                JS_FreeValue(context, nameVal);
-                JS_FreeValue(context, messageVal);
-            }
-            
-            JS_FreeValue(context, exception);
-            JS_FreeValue(context, result);
-            LOGE("JavaScript execution error: %s", error.c_str());
-            return error;
+            return describeException("JavaScript Error: ");
+        }
+        return describeResult(awaitResult(result));
+    }
+    
+    // Run UTF-8 source that lives outside the engine, parsing it where it lies
+    // source[length] must be NUL. The source is not kept in the script cache,
+    // which would copy it, so this suits large scripts run once per context.
+    std::string executeSource(const char *source, size_t length, const char *filename) {
+        if (!initialized || !context) {
+            return "Error: QuickJS not initialized";
         }
-
-        result = js_std_await(context, result);
         
-        // Check if awaiting resulted in an exception (promise rejection)
-        if (JS_IsException(result)) {
-            JSValue exception = JS_GetException(context);
-            std::string error = "Promise Rejection: ";
-            
-            // Try to get error message
-            const char *exceptionStr = JS_ToCString(context, exception);
-            if (exceptionStr) {
-                error += exceptionStr;
-                JS_FreeCString(context, exceptionStr);
-            } else {
-                // If direct conversion fails, try to get more details
-                JSValue nameVal = JS_GetPropertyStr(context, exception, "name");
-                JSValue messageVal = JS_GetPropertyStr(context, exception, "message");
-                
-                const char *name = JS_ToCString(context, nameVal);
-                const char *message = JS_ToCString(context, messageVal);
-                
-                if (name && message) {
-                    error += name;
-                    error += ": ";
-                    error += message;
-                } else if (name) {
-                    error += name;
-                } else if (message) {
-                    error += message;
-                } else {
-                    error += "Unknown error (promise rejection could not be converted to string)";
-                }
-                
-                if (name) JS_FreeCString(context, name);
-                if (message) JS_FreeCString(context, message);
-                JS_FreeValue(context, nameVal);
-                JS_FreeValue(context, messageVal);
-            }
-            
-            JS_FreeValue(context, exception);
-            JS_FreeValue(context, result);
-            LOGE("Promise rejection error: %s", error.c_str());
-            return error;
+        TraceSection trace("QuickJS executeSource");
+        JS_UpdateStackTop(runtime);
+        JSValue function;
+        {
+            TraceSection compileTrace("QuickJS compile");
+            PhaseTimer timer(counters, ExecutionCounters::COMPILE_NS);
+            function = JS_Eval(context, source, length, filename, JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
         }
-
-        // Convert result to string
-        const char *resultStr = JS_ToCString(context, result);
-        std::string resultString;
-        if (resultStr) {
-            resultString = resultStr;
-            JS_FreeCString(context, resultStr);
-        } else {
-            resultString = "undefined";
+        JSValue result = JS_IsException(function) ? function : evalFunction(function);
+        if (JS_IsException(result)) {
+            return describeException("JavaScript Error: ");
         }
-
-        JS_FreeValue(context, result);
-
-        LOGI("JavaScript result: %s", resultString.c_str());
-        return resultString;
+        return describeResult(awaitResult(result));
     }
     
-    bool resetContext() {
-        LOGI("Resetting QuickJS context");
-        
-        if (!runtime) {
-            LOGE("Cannot reset context: runtime not initialized");
-            return false;
+    // Like executeScript(), but returns the result in the ValueCodec encoding
+    std::vector<uint8_t> executeScriptEncoded(const std::string& script) {
+        std::vector<uint8_t> encoded;
+        if (!initialized || !context) {
+            ValueCodec::encodeHostError("QuickJS not initialized", encoded);
+            return encoded;
         }
         
-        // Free the old context
-        if (context) {
-            JS_FreeContext(context);
-            context = nullptr;
+        TraceSection trace("QuickJS executeScript");
+        JSValue result = evaluateScript(script);
+        if (JS_IsException(result)) {
+            encodeException(ValueCodec::ERROR_SCRIPT, encoded);
+            return encoded;
+        }
+        encodeResult(awaitResult(result), encoded);
+        return encoded;
+    }
+    
+    // Run scripts one after another, returning their encoded results back to back
+    // The execution limits cover the batch as a whole: once it times out or is
+    // cancelled, the remaining scripts fail the same way without running
+    std::vector<uint8_t> executeBatchEncoded(const std::vector<std::string> &scripts) {
+        std::vector<uint8_t> encoded;
+        if (!initialized || !context) {
+            encodeHostErrors("QuickJS not initialized", scripts.size(), encoded);
+            return encoded;
         }
         
-        // Create a new context
-        context = JS_NewContext(runtime);
-        if (!context) {
+        TraceSection trace("QuickJS executeBatch");
+        JS_UpdateStackTop(runtime);
+        startExecutionTimer();
+        for (const std::string &script : scripts) {
+            JSValue function = compileScript(script);
+            JSValue result = JS_IsException(function) ? function : evalFunction(function, false);
+            if (JS_IsException(result)) {
+                encodeException(ValueCodec::ERROR_SCRIPT, encoded);
+            } else {
+                encodeResult(awaitResult(result), encoded);
+            }
+        }
+        return encoded;
+    }
+    
+    // Call the function functionSource evaluates to once per element of the
+    // JSON array argsJson, returning the encoded results back to back
+    // An element that is an array is spread as the arguments, any other value
+    // is the only argument. count is the expected number of elements; when the
+    // function or the arguments cannot be had, every call fails with that error.
+    // Limits cover the batch as for executeBatchEncoded().
+    std::vector<uint8_t> invokeBatchEncoded(const std::string &functionSource, const std::string &argsJson,
+                                            size_t count) {
+        std::vector<uint8_t> encoded;
+        if (!initialized || !context) {
+            encodeHostErrors("QuickJS not initialized", count, encoded);
+            return encoded;
+        }
+        
+        TraceSection trace("QuickJS invokeBatch");
+        JSValue argsList = JS_ParseJSON(context, argsJson.data(), argsJson.size(), "<arguments>");
+        if (JS_IsException(argsList)) {
+            JS_FreeValue(context, JS_GetException(context));
+            encodeHostErrors("Batch arguments are not valid JSON", count, encoded);
+            return encoded;
+        }
+        uint32_t length = 0;
+        if (JS_IsArray(context, argsList) <= 0 || !arrayLength(argsList, &length) || length != count) {
+            JS_FreeValue(context, JS_GetException(context));
+            JS_FreeValue(context, argsList);
+            encodeHostErrors("Batch arguments do not match the number of calls", count, encoded);
+            return encoded;
+        }
+        
+        JSValue function = evaluateScript(functionSource);
+        if (!JS_IsException(function) && !JS_IsFunction(context, function)) {
+            JS_FreeValue(context, function);
+            function = JS_ThrowTypeError(context, "Batch target is not a function");
+        }
+        if (JS_IsException(function)) {
+            std::vector<uint8_t> error;
+            encodeException(ValueCodec::ERROR_SCRIPT, error);
+            for (size_t i = 0; i < count; i++) {
+                encoded.insert(encoded.end(), error.begin(), error.end());
+            }
+            JS_FreeValue(context, argsList);
+            return encoded;
+        }
+        
+        for (size_t i = 0; i < count; i++) {
+            JSValue args = JS_GetPropertyUint32(context, argsList, static_cast<uint32_t>(i));
+            JSValue result = callFunction(function, args);
+            JS_FreeValue(context, args);
+            if (JS_IsException(result)) {
+                encodeException(ValueCodec::ERROR_SCRIPT, encoded);
+            } else {
+                encodeResult(awaitResult(result), encoded);
+            }
+        }
+        JS_FreeValue(context, function);
+        JS_FreeValue(context, argsList);
+        return encoded;
+    }
+    
+    // Evaluate a script without waiting for it; the completion value may be a
+    // pending promise, to be settled by awaitResult() or advanceResult()
+    JSValue evaluateScript(const std::string& script) {
+        LOGV("Executing QuickJS script: %s", script.c_str());
+
+        // Pooled engines may be entered from different threads
+        JS_UpdateStackTop(runtime);
+
+        // Evaluate the JavaScript code, reusing the compiled function for repeated sources
+        JSValue function = compileScript(script);
+        return JS_IsException(function) ? function : evalFunction(function);
+    }
+    
+    // The compiled function for script, from the script cache on a repeat
+    JSValue compileScript(const std::string &script) {
+        PhaseTimer timer(counters, ExecutionCounters::COMPILE_NS);
+        return scriptCache.getOrCompile(context, script, "<input>");
+    }
+    
+    // Run a compiled script under the lease's execution limits, as a new
+    // execution unless startTimer is false
+    // Takes ownership of function, like JS_EvalFunction
+    JSValue evalFunction(JSValue function, bool startTimer = true) {
+        if (startTimer) {
+            startExecutionTimer();
+        }
+        if (limitReached()) {
+            // Cancelled before it started
+            JS_FreeValue(context, function);
+            return JS_ThrowInternalError(context, "%s", interruptMessage());
+        }
+        TraceSection trace("JS_EvalFunction");
+        JSValue result;
+        {
+            PhaseTimer timer(counters, ExecutionCounters::EXECUTE_NS);
+            result = JS_EvalFunction(context, function);
+        }
+        if (JS_IsException(result) && isInterrupted()) {
+            abandonAsyncWork();
+        }
+        return result;
+    }
+    
+    // Call function for a batch element under the execution limits already started
+    // args is spread as the arguments if it is an array, else passed as the only one
+    JSValue callFunction(JSValueConst function, JSValueConst args) {
+        if (limitReached()) {
+            return JS_ThrowInternalError(context, "%s", interruptMessage());
+        }
+        std::vector<JSValue> argv;
+        uint32_t length = 0;
+        if (JS_IsArray(context, args) > 0) {
+            if (!arrayLength(args, &length)) {
+                return JS_EXCEPTION;
+            }
+            for (uint32_t i = 0; i < length; i++) {
+                argv.push_back(JS_GetPropertyUint32(context, args, i));
+            }
+        } else {
+            argv.push_back(JS_DupValue(context, args));
+        }
+        JSValue result;
+        {
+            PhaseTimer timer(counters, ExecutionCounters::EXECUTE_NS);
+            result = JS_Call(context, function, JS_UNDEFINED, static_cast<int>(argv.size()), argv.data());
+        }
+        for (JSValue arg : argv) {
+            JS_FreeValue(context, arg);
+        }
+        if (JS_IsException(result) && isInterrupted()) {
+            abandonAsyncWork();
+        }
+        return result;
+    }
+    
+    // Read the length of an array; on failure returns false with an exception pending
+    bool arrayLength(JSValueConst array, uint32_t *length) {
+        JSValue value = JS_GetPropertyStr(context, array, "length");
+        int failed = JS_ToUint32(context, length, value);
+        JS_FreeValue(context, value);
+        return !failed;
+    }
+    
+    // Whether the current execution was stopped by its timeout or a cancel
+    bool isInterrupted() const {
+        return interruptReason != INTERRUPT_NONE;
+    }
+    
+    // Convert a settled result into the string returned to Kotlin
+    // Takes ownership of result; exceptions are reported as promise rejections
+    std::string describeResult(JSValue result) {
+        TraceSection trace("QuickJS result conversion");
+        if (JS_IsException(result)) {
+            return describeException("Promise Rejection: ");
+        }
+        
+        // Convert result to string
+        const char *resultStr = JS_ToCString(context, result);
+        std::string resultString;
+        if (resultStr) {
+            resultString = resultStr;
+            JS_FreeCString(context, resultStr);
+        } else {
+            resultString = "undefined";
+        }
+
+        JS_FreeValue(context, result);
+
+        LOGV("JavaScript result: %s", resultString.c_str());
+        return resultString;
+    }
+    
+    // Append the encoding of a settled result; takes ownership of result
+    void encodeResult(JSValue result, std::vector<uint8_t> &encoded) {
+        TraceSection trace("QuickJS result conversion");
+        if (JS_IsException(result)) {
+            encodeException(ValueCodec::ERROR_REJECTION, encoded);
+            return;
+        }
+        size_t start = encoded.size();
+        if (!ValueCodec::encodeValue(context, result, encoded)) {
+            // Unencodable results (e.g. cyclic objects) replace any partial output
+            encoded.resize(start);
+            ValueCodec::encodeException(context, ValueCodec::ERROR_HOST, encoded);
+        }
+        JS_FreeValue(context, result);
+    }
+    
+    // Take the pending exception and encode it, reporting stopped executions by their reason
+    void encodeException(ValueCodec::ErrorKind kind, std::vector<uint8_t> &encoded) {
+        if (!isInterrupted()) {
+            ValueCodec::encodeException(context, kind, encoded);
+            return;
+        }
+        JS_FreeValue(context, JS_GetException(context));
+        ValueCodec::encodeError(interruptReason == INTERRUPT_TIMEOUT ? ValueCodec::ERROR_TIMEOUT
+                                                                     : ValueCodec::ERROR_CANCELLED,
+                                interruptMessage(), encoded);
+    }
+    
+    static void encodeHostErrors(const std::string &message, size_t count, std::vector<uint8_t> &encoded) {
+        for (size_t i = 0; i < count; i++) {
+            ValueCodec::encodeHostError(message, encoded);
+        }
+    }
+    
+    // Take the pending exception and format it with the given prefix
+    std::string describeException(const char *prefix) {
+        if (isInterrupted()) {
+            JS_FreeValue(context, JS_GetException(context));
+            std::string error = std::string("Error: ") + interruptMessage();
+            LOGE("JavaScript execution stopped: %s", error.c_str());
+            return error;
+        }
+        
+        JSValue exception = JS_GetException(context);
+        std::string error = prefix;
+        
+        // Try to get error message
+        const char *exceptionStr = JS_ToCString(context, exception);
+        if (exceptionStr) {
+            error += exceptionStr;
+            JS_FreeCString(context, exceptionStr);
+        } else {
+            // If direct conversion fails, try to get more details
+            JSValue nameVal = JS_GetPropertyStr(context, exception, "name");
+            JSValue messageVal = JS_GetPropertyStr(context, exception, "message");
+            
+            const char *name = JS_ToCString(context, nameVal);
+            const char *message = JS_ToCString(context, messageVal);
+            
+            if (name && message) {
+                error += name;
+                error += ": ";
+                error += message;
+            } else if (name) {
+                error += name;
+            } else if (message) {
+                error += message;
+            } else {
+                error += "Unknown error (exception could not be converted to string)";
+            }
+            
+            if (name) JS_FreeCString(context, name);
+            if (message) JS_FreeCString(context, message);
+            JS_FreeValue(context, nameVal);
+            JS_FreeValue(context, messageVal);
+        }
+        
+        JS_FreeValue(context, exception);
+        LOGE("JavaScript execution error: %s", error.c_str());
+        return error;
+    }
+    
+    bool resetContext() {
+        LOGI("Resetting QuickJS context");
+        
+        if (!runtime) {
+            LOGE("Cannot reset context: runtime not initialized");
+            return false;
+        }
+        JS_UpdateStackTop(runtime);
+        
+        // Free the old context
+        releaseContext();
+        
+        // Create a new context
+        if (!setupContext()) {
             LOGE("Failed to create new QuickJS context");
             initialized = false;
             return false;
         }
         
-        js_std_add_helpers(context, 0, nullptr);
-        addConsoleSupport(context);
-        addTimerPolyfills(context);
-        addHttpPolyfills(context);
-        
         LOGI("QuickJS context reset successfully");
         return true;
     }
@@ -543,18 +1297,80 @@ public:
     void cleanup() {
         LOGI("Cleaning up QuickJS Engine");
 
-        if (context) {
-            JS_FreeContext(context);
-            context = nullptr;
+        releaseRuntime();
+        hibernated = false;
+        hibernatedState.clear();
+        LOGI("QuickJS cleanup complete");
+    }
+    
+    // Save the globals scripts defined and free the whole runtime, until the
+    // next lease restores it; requires the lease
+    // Refused while timers, requests, jobs or workers are pending, since they
+    // cannot be saved, and while any global would not come back as it is:
+    // functions, class instances, Maps, accessors, top-level let and const
+    // bindings, and built-ins scripts changed. force hibernates anyway,
+    // dropping those globals and changes.
+    bool hibernate(bool force = false) {
+        if (hibernated) {
+            return true;
         }
-
-        if (runtime) {
-            JS_FreeRuntime(runtime);
-            runtime = nullptr;
+        if (!isInitialized() || arena || worker || realmFeatures != REALM_FULL_CONTEXT) {
+            return false;
         }
-
-        initialized = false;
-        LOGI("QuickJS cleanup complete");
+        if (!timers.empty() || !pendingHttpRequests.empty() || !workers.empty() ||
+            buffersAway.load(std::memory_order_acquire) > 0 || JS_IsJobPending(runtime)) {
+            LOGI("Engine %d has async work pending, not hibernating", id);
+            return false;
+        }
+        if (!force && JS_HasGlobalLexicals(context)) {
+            LOGI("Engine %d has let or const globals, not hibernating", id);
+            return false;
+        }
+        TraceSection trace("QuickJS hibernate");
+        JS_UpdateStackTop(runtime);
+        if (!force && !contextGlobalsUnchanged()) {
+            LOGI("Engine %d has changed built-in globals, not hibernating", id);
+            return false;
+        }
+        
+        std::vector<uint8_t> state;
+        size_t dropped = 0;
+        if (!saveGlobals(state, force, &dropped)) {
+            LOGI("Engine %d has globals that cannot be saved, not hibernating", id);
+            return false;
+        }
+        
+        counters.foldRuntime(runtime);
+        releaseRuntime();
+        hibernatedState.swap(state);
+        hibernated = true;
+        LOGI("Engine %d hibernated with %zu bytes of globals, %zu dropped", id, hibernatedState.size(), dropped);
+        return true;
+    }
+    
+    // Rebuild a hibernated runtime from the polyfill snapshot and put the saved
+    // globals back; requires the lease
+    // On failure the engine stays hibernated, and the next lease tries again
+    bool restore() {
+        if (!hibernated) {
+            return true;
+        }
+        TraceSection trace("QuickJS restore");
+        if (!initialize()) {
+            LOGE("Engine %d: failed to restore runtime", id);
+            return false;
+        }
+        hibernated = false;
+        if (!hibernatedState.empty()) {
+            restoreGlobals();
+        }
+        hibernatedState.clear();
+        hibernatedState.shrink_to_fit();
+        return true;
+    }
+    
+    bool isHibernated() const {
+        return hibernated.load();
     }
     
     bool isInitialized() const {
@@ -564,249 +1380,3783 @@ public:
     JSContext* getContext() const {
         return context;
     }
-};
-
-static QuickJSEngine *g_quickjsEngine = nullptr;
-
-extern "C" {
-
-// Initialize QuickJS Engine
-JNIEXPORT jboolean JNICALL
-Java_com_quickjs_android_QuickJSBridge_initializeQuickJS(JNIEnv *env, jobject thiz) {
-    LOGI("JNI: Initializing QuickJS Engine with HTTP polyfills");
     
-    // Store JavaVM reference for HTTP requests
-    if (!g_jvm) {
-        env->GetJavaVM(&g_jvm);
+    // Requires a lease for anything but reading the counters
+    ScriptCache &getScriptCache() {
+        return scriptCache;
     }
     
-    if (g_quickjsEngine == nullptr) {
-        g_quickjsEngine = new QuickJSEngine();
+    // Thread-safe; samples are taken on whichever thread runs the engine
+    SamplingProfiler &getProfiler() {
+        return profiler;
     }
     
-    // Initialize HTTP polyfill references
-    initializeHttpPolyfill(env, thiz);
+    // Added to only under the lease; readable from any thread
+    ExecutionCounters &getCounters() {
+        return counters;
+    }
+    
+    // Counters up to this moment, allocations included; requires the lease
+    void readCounters(int64_t out[ExecutionCounters::FIELD_COUNT]) {
+        counters.foldRuntime(runtime);
+        counters.read(out);
+    }
+    
+    int getId() const {
+        return id;
+    }
+    
+    // Walk the runtime for a full memory breakdown and fold it into the peaks
+    // Requires a lease; the walk is proportional to the heap size
+    bool sampleMemoryUsage(JSMemoryUsage *usage) {
+        if (!runtime) {
+            return false;
+        }
+        JS_ComputeMemoryUsage(runtime, usage);
+        
+        std::lock_guard<std::mutex> lock(memoryMutex);
+        const int64_t *fields = reinterpret_cast<const int64_t *>(usage);
+        int64_t *peaks = reinterpret_cast<int64_t *>(&memoryPeak);
+        for (size_t i = 0; i < MEMORY_USAGE_FIELDS; i++) {
+            peaks[i] = std::max(peaks[i], fields[i]);
+        }
+        memorySamples++;
+        lastMemorySample = Clock::now();
+        return true;
+    }
+    
+    // Take a sample if periodic sampling is on and the interval has elapsed
+    // Requires a lease; called as leases end, so running scripts are never walked
+    void sampleMemoryIfDue() {
+        int64_t intervalMs = g_memorySampleIntervalMs.load(std::memory_order_relaxed);
+        if (intervalMs <= 0) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(memoryMutex);
+            if (memorySamples > 0 && Clock::now() - lastMemorySample < std::chrono::milliseconds(intervalMs)) {
+                return;
+            }
+        }
+        JSMemoryUsage usage;
+        sampleMemoryUsage(&usage);
+    }
+    
+    // Ask for a trim at the given level; callable from any thread
+    // Levels only escalate until the trim is applied
+    void requestTrim(TrimLevel level) {
+        int current = trimRequested.load(std::memory_order_relaxed);
+        while (current < level &&
+               !trimRequested.compare_exchange_weak(current, level, std::memory_order_relaxed)) {
+        }
+    }
+    
+    // Apply a requested trim; requires a lease, called as leases end
+    void trimIfRequested() {
+        int level = trimRequested.exchange(TRIM_NONE, std::memory_order_relaxed);
+        if (level == TRIM_NONE || !runtime) {
+            return;
+        }
+        if (level >= TRIM_CACHES) {
+            scriptCache.clear(context);
+            JS_FlushRegExpCache(runtime);
+        }
+        collectGarbage();
+        if (slabAllocator) {
+            slabAllocator->trim();
+        }
+    }
+    
+    // Run a full collection outside the allocation path; requires a lease
+    void collectGarbage() {
+        if (!runtime) {
+            return;
+        }
+        TraceSection trace("QuickJS idle GC");
+        releaseReturnedBuffers();
+        JS_RunGC(runtime);
+        // Restart the adaptive threshold from the collected heap, pushing the
+        // next collection inside an execution as far out as it would be after
+        // an automatic one
+        size_t live = JS_GetMallocSize(runtime);
+        JS_SetGCThreshold(runtime, std::min(std::max(GC_MIN_THRESHOLD, live + live / 100 * GC_GROWTH_PERCENT),
+                                            GC_MAX_THRESHOLD));
+        heapAfterCollection = live;
+    }
+    
+    // Upper bound on the garbage left since the last collectGarbage(): heap
+    // growth, which also counts whatever the executions kept alive
+    // Requires a lease
+    size_t garbageEstimate() {
+        if (!runtime) {
+            return 0;
+        }
+        size_t heap = JS_GetMallocSize(runtime);
+        if (heap < heapAfterCollection) {
+            heapAfterCollection = heap;  // Shrunk by a reset or an automatic collection
+        }
+        return heap - heapAfterCollection;
+    }
+    
+    // Copy the high-water marks; returns the number of samples they cover
+    uint64_t getMemoryPeak(JSMemoryUsage *peak) {
+        std::lock_guard<std::mutex> lock(memoryMutex);
+        *peak = memoryPeak;
+        return memorySamples;
+    }
+    
+    void resetMemoryPeak() {
+        std::lock_guard<std::mutex> lock(memoryMutex);
+        memoryPeak = JSMemoryUsage();
+        memorySamples = 0;
+    }
+    
+    // Wait for a promise result while running jobs and delivering async
+    // completions; non-promise values are returned as is
+    // Takes ownership of obj, like js_std_await
+    JSValue awaitResult(JSValue obj) {
+        TraceSection trace("QuickJS await");
+        PhaseTimer timer(counters, ExecutionCounters::AWAIT_NS);
+        JSValue result;
+        while (!advanceResult(obj, &result)) {
+            // Sleep until a response arrives or the next timer is due
+            struct epoll_event event;
+            while (epoll_wait(pollFd, &event, 1, -1) < 0 && errno == EINTR) {
+            }
+            drainWakeFds();
+        }
+        return result;
+    }
     
-    return g_quickjsEngine->initialize() ? JNI_TRUE : JNI_FALSE;
+    // Run everything that is ready without blocking, until obj settles or
+    // only outside events could make progress
+    // Returns true once obj is settled, consuming obj and storing the result;
+    // otherwise the timer fd is armed for the next deadline and obj is kept
+    bool advanceResult(JSValue obj, JSValue *result) {
+        for (;;) {
+            int state = JS_PromiseState(context, obj);
+            if (state == JS_PROMISE_FULFILLED) {
+                *result = JS_PromiseResult(context, obj);
+                JS_FreeValue(context, obj);
+                return true;
+            } else if (state == JS_PROMISE_REJECTED) {
+                *result = JS_Throw(context, JS_PromiseResult(context, obj));
+                JS_FreeValue(context, obj);
+                return true;
+            } else if (state != JS_PROMISE_PENDING) {
+                // Not a promise
+                *result = obj;
+                return true;
+            }
+            
+            if (limitReached()) {
+                // Whatever the stopped execution still had in flight goes with it
+                JS_FreeValue(context, obj);
+                abandonAsyncWork();
+                *result = JS_ThrowInternalError(context, "%s", interruptMessage());
+                return true;
+            }
+            
+            if (runPendingJobs() > 0 || dispatchHttpCompletions() > 0 || dispatchWorkerEvents() > 0 ||
+                fireExpiredTimers() > 0) {
+                continue;
+            }
+            
+            if (pendingHttpRequests.empty() && timers.empty() && workers.empty()) {
+                // Nothing left that could ever settle the promise
+                JS_FreeValue(context, obj);
+                *result = JS_ThrowInternalError(context, "Promise can never settle: no pending jobs, requests, timers or workers");
+                return true;
+            }
+            
+            releaseReturnedBuffers();
+            armTimerFd();
+            return false;
+        }
+    }
+    
+    // Called when JS frees a response body wrapped by wrapHttpBody()
+    void forgetHttpBody(HttpBody *owner, const uint8_t *data) {
+        liveBodies.erase(owner);
+        terminatedBodies.erase(data);
+    }
+    
+    // Whether data is a response body followed by a NUL byte
+    bool isTerminatedHttpBody(const uint8_t *data) const {
+        return terminatedBodies.count(data) > 0;
+    }
+    
+    // Readable whenever advanceResult() may make progress; stays owned by the engine
+    int getPollFd() const {
+        return pollFd;
+    }
+    
+    // Reset the wakeup fds after pollFd was reported readable
+    void drainWakeFds() {
+        uint64_t count;
+        while (read(wakeFd, &count, sizeof(count)) > 0) {
+        }
+        while (read(timerFd, &count, sizeof(count)) > 0) {
+        }
+    }
+    
+    // Schedule a timer; returns its id
+    // Takes ownership of callback and args
+    uint32_t addTimer(JSValue callback, std::vector<JSValue> args, int64_t delayMs, bool repeat) {
+        uint32_t timerId = nextTimerId++;
+        delayMs = std::max<int64_t>(delayMs, repeat ? 1 : 0);
+        timers[timerId] = Timer{callback, std::move(args), repeat ? delayMs : -1};
+        timerHeap.push(TimerDeadline(Clock::now() + std::chrono::milliseconds(delayMs), timerId));
+        return timerId;
+    }
+    
+    void removeTimer(uint32_t timerId) {
+        auto it = timers.find(timerId);
+        if (it == timers.end()) {
+            return;
+        }
+        freeTimer(it->second);
+        timers.erase(it);
+    }
+    
+    // Start an async HTTP request through the Kotlin bridge
+    // Returns a promise resolved with the parsed response envelope
+    JSValue startHttpRequest(JSContext *ctx, JNIEnv *env, const char *url, const char *options) {
+        JSValue resolvingFuncs[2];
+        JSValue promise = JS_NewPromiseCapability(ctx, resolvingFuncs);
+        if (JS_IsException(promise)) {
+            return promise;
+        }
+        
+        uint32_t requestId = nextHttpRequestId++;
+        pendingHttpRequests[requestId] = PendingHttpRequest{resolvingFuncs[0], resolvingFuncs[1]};
+        
+        jstring jUrl = env->NewStringUTF(url);
+        jstring jOptions = env->NewStringUTF(options);
+        {
+            TraceSection trace("js_http_request");
+            PhaseTimer timer(counters, ExecutionCounters::HTTP_NS);
+            counters.add(ExecutionCounters::HTTP_CALLS, 1);
+            env->CallVoidMethod(g_quickjsBridgeInstance, g_handleHttpRequestAsyncMethod,
+                                static_cast<jint>(id), static_cast<jint>(requestId), jUrl, jOptions);
+        }
+        env->DeleteLocalRef(jUrl);
+        env->DeleteLocalRef(jOptions);
+        
+        if (env->ExceptionCheck()) {
+            env->ExceptionClear();
+            pendingHttpRequests.erase(requestId);
+            JSValue error = JS_NewError(ctx);
+            JS_SetPropertyStr(ctx, error, "message", JS_NewString(ctx, "HTTP request failed"));
+            JSValue ret = JS_Call(ctx, resolvingFuncs[1], JS_UNDEFINED, 1, &error);
+            JS_FreeValue(ctx, ret);
+            JS_FreeValue(ctx, error);
+            JS_FreeValue(ctx, resolvingFuncs[0]);
+            JS_FreeValue(ctx, resolvingFuncs[1]);
+        }
+        return promise;
+    }
+    
+    // Queue a response for delivery on the engine thread; callable from any thread
+    // Takes ownership of the global reference to body
+    void postHttpCompletion(uint32_t requestId, std::string metadata, jobject body,
+                            uint8_t *bodyData, size_t bodyLength, bool terminated) {
+        {
+            std::lock_guard<std::mutex> lock(completionMutex);
+            if (arenaChild && requestId >= arenaFirstRequestId) {
+                // Issued by the throwaway execution running for this engine
+                arenaChild->postHttpCompletion(requestId, std::move(metadata), body,
+                                               bodyData, bodyLength, terminated);
+                return;
+            }
+            completions.push_back(HttpCompletion{requestId, std::move(metadata), body,
+                                                 bodyData, bodyLength, terminated});
+        }
+        wake();
+    }
+    
+    // Queue an event from a worker, or from the parent of a worker engine, for
+    // dispatch on the engine thread; callable from any thread
+    void postWorkerEvent(uint32_t workerId, WorkerEventKind kind,
+                         std::unique_ptr<WorkerMessage> message, std::string error = std::string()) {
+        {
+            std::lock_guard<std::mutex> lock(completionMutex);
+            workerEvents.push_back(WorkerEvent{workerId, kind, std::move(message), std::move(error)});
+        }
+        wake();
+    }
+    
+    // Storage of one of this runtime's ArrayBuffers, let go of by another
+    // runtime; callable from any thread
+    void returnBuffer(TransferredBuffer *buffer) override {
+        {
+            std::lock_guard<std::mutex> lock(completionMutex);
+            returnedBuffers.push_back(buffer);
+            // Counted back only once queued, where hibernate() frees it
+            buffersAway.fetch_sub(1, std::memory_order_release);
+        }
+        wake();
+    }
+    
+    // Atom table of a bundle's scripts, read into this runtime the first time
+    // one of them runs; *table is nullptr for bundles written without one
+    // Returns false with an exception pending if the table cannot be read
+    bool bundleAtomTable(JSContext *ctx, jlong handle, const std::shared_ptr<BytecodeBundle> &bundle,
+                         JSAtomTable **table) {
+        releaseBundleAtoms(false);
+        auto it = bundleAtoms.find(handle);
+        if (it != bundleAtoms.end()) {
+            *table = it->second.table;
+            return true;
+        }
+        
+        const uint8_t *data;
+        size_t length;
+        *table = nullptr;
+        if (!bundle->atomTable(&data, &length)) {
+            return true;
+        }
+        *table = JS_ReadAtomTable(ctx, data, length);
+        if (!*table) {
+            return false;
+        }
+        bundleAtoms[handle] = BundleAtoms{bundle, *table};
+        return true;
+    }
+    
+    // Define a host function registered after the context was set up; requires
+    // the lease. Realm contexts offer scripts no host functions.
+    void installHostFunction(int index) {
+        if (context && realmFeatures == REALM_FULL_CONTEXT) {
+            JS_UpdateStackTop(runtime);
+            if (HostFunctions::install(context, index)) {
+                // Reinstalled on restore, so not saved by hibernate()
+                std::string name = HostFunctions::name(index);
+                baselineGlobals.insert(name);
+                if (std::find(contextGlobals.begin(), contextGlobals.end(), name) == contextGlobals.end()) {
+                    contextGlobals.push_back(name);
+                }
+                contextGlobalsHashed = hashContextGlobals(&contextGlobalsHash);
+            }
+        }
+    }
+    
+    // Free the atom tables of closed bundles, or all of them
+    void releaseBundleAtoms(bool all) {
+        for (auto it = bundleAtoms.begin(); it != bundleAtoms.end();) {
+            if (all || it->second.bundle.expired()) {
+                JS_FreeAtomTable(runtime, it->second.table);
+                it = bundleAtoms.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    
+    // Free the storage returned by other runtimes; requires a lease
+    void releaseReturnedBuffers() {
+        std::vector<TransferredBuffer *> buffers;
+        {
+            std::lock_guard<std::mutex> lock(completionMutex);
+            buffers.swap(returnedBuffers);
+        }
+        for (TransferredBuffer *buffer : buffers) {
+            buffer->free();
+            delete buffer;
+        }
+    }
+    
+    // Make pollFd readable; callable from any thread
+    void wake() {
+        uint64_t one = 1;
+        if (wakeFd >= 0 && write(wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            LOGE("Failed to wake engine %d: %s", id, strerror(errno));
+        }
+    }
+    
+    // Throw an arena engine's runtime away without freeing its objects; only
+    // native resources are released, and no finalizers run
+    void discard() {
+        {
+            std::lock_guard<std::mutex> lock(completionMutex);
+            for (HttpCompletion &completion : completions) {
+                releaseGlobalRef(completion.body);
+            }
+            completions.clear();
+        }
+        for (HttpBody *owner : liveBodies) {
+            releaseGlobalRef(owner->buffer);
+            delete owner;
+        }
+        liveBodies.clear();
+        terminatedBodies.clear();
+        
+        // Everything else lives in the arena
+        pendingHttpRequests.clear();
+        timers.clear();
+        timerHeap = decltype(timerHeap)();
+        scriptCache.forget();
+        context = nullptr;
+        runtime = nullptr;
+        slabAllocator.reset();
+        closeWakeFds();
+        initialized = false;
+    }
+    
+    // Start a fresh set of limits; called by the pool as leases begin and end
+    // Untimed limits skip the default timeout, for worker scripts that run
+    // until they are terminated
+    void resetExecutionLimits(bool timed = true) {
+        std::lock_guard<std::mutex> lock(limitsMutex);
+        leaseSerial++;
+        cancelRequested.store(false, std::memory_order_relaxed);
+        executionTimeoutMs = timed ? g_defaultExecutionTimeoutMs.load(std::memory_order_relaxed) : 0;
+        deadlineNs = 0;
+        interruptReason = INTERRUPT_NONE;
+    }
+    
+    // Override the timeout of executions for the rest of the lease, keeping the
+    // default when timeoutMs is 0; requires the lease
+    // Returns the lease serial to pass to cancel()
+    uint64_t setExecutionTimeout(int64_t timeoutMs) {
+        std::lock_guard<std::mutex> lock(limitsMutex);
+        if (timeoutMs > 0) {
+            executionTimeoutMs = timeoutMs;
+        }
+        return leaseSerial;
+    }
+    
+    // Stop the execution of the given lease as soon as it next polls for
+    // interrupts or wakes up while awaiting; callable from any thread
+    // A cancel before execution starts makes it fail immediately
+    bool cancel(uint64_t serial) {
+        std::lock_guard<std::mutex> lock(limitsMutex);
+        if (serial != leaseSerial) {
+            return false;  // That lease has ended
+        }
+        cancelRequested.store(true, std::memory_order_relaxed);
+        wake();
+        if (arenaChild) {
+            arenaChild->cancel(arenaChild->leaseSerial);
+        }
+        return true;
+    }
+    
+    // Run a script in a fresh context on an arena runtime, then throw that
+    // runtime away in one piece instead of freeing it object by object
+    // Requires the lease; this engine's own context is not touched, and the
+    // lease's execution limits apply
+    std::string executeThrowaway(const std::string& script) {
+        return inArenaChild(REALM_FULL_CONTEXT,
+                            [&script](QuickJSEngine &child) { return child.executeScript(script); });
+    }
+    
+    // Run serialized bytecode like executeThrowaway() runs a script
+    std::string executeThrowawayBytecode(const uint8_t *data, size_t length) {
+        return inArenaChild(REALM_FULL_CONTEXT,
+                            [data, length](QuickJSEngine &child) { return child.executeBytecode(data, length); });
+    }
+    
+    // Run UTF-8 source like executeThrowaway() runs a script, without copying
+    // it; source[length] must be NUL
+    std::string executeThrowawaySource(const char *source, size_t length, const char *filename) {
+        return inArenaChild(REALM_FULL_CONTEXT, [source, length, filename](QuickJSEngine &child) {
+            return child.executeSource(source, length, filename);
+        });
+    }
+    
+    // Run a script like executeThrowaway(), in a context holding only the
+    // REALM_* features asked for and none of the host helpers
+    std::string executeInRealm(const std::string& script, int features) {
+        return inArenaChild(features & REALM_ALL_FEATURES,
+                            [&script](QuickJSEngine &child) { return child.executeScript(script); });
+    }
+    
+    // Whether prepareSpareRealm() has a realm to make
+    bool wantsSpareRealm() const {
+        return !hibernated && lastRealmFeatures != REALM_UNUSED &&
+               !(spareRealm && spareRealm->realmFeatures == lastRealmFeatures);
+    }
+    
+    // Make the arena engine for the next realm ahead of need, with the
+    // features the last one had; called between executions, under a lease
+    void prepareSpareRealm() {
+        if (!wantsSpareRealm()) {
+            return;
+        }
+        TraceSection trace("QuickJS prepare realm");
+        discardSpareRealm();
+        spareRealm = newRealm(lastRealmFeatures);
+        if (!spareRealm) {
+            lastRealmFeatures = REALM_UNUSED;  // Not retried until a realm is used again
+        }
+    }
+    
+    // Run serialized bytecode in this engine's context; data is not retained
+    std::string executeBytecode(const uint8_t *data, size_t length) {
+        if (!initialized || !context) {
+            return "Error: QuickJS not initialized";
+        }
+        
+        TraceSection trace("QuickJS executeBytecode");
+        JS_UpdateStackTop(runtime);
+        JSValue function;
+        {
+            PhaseTimer timer(counters, ExecutionCounters::COMPILE_NS);
+            function = JS_ReadObject(context, data, length, JS_READ_OBJ_BYTECODE);
+        }
+        if (JS_IsException(function)) {
+            return describeException("Error: Bytecode deserialization failed: ");
+        }
+        JSValue result = evalFunction(function);
+        if (JS_IsException(result)) {
+            return describeException("JavaScript Error: ");
+        }
+        return describeResult(awaitResult(result));
+    }
+    
+    // new Worker(source): run source on a worker thread; requires the lease
+    // Returns the Worker object, or an exception if no thread is free
+    JSValue startWorker(JSContext *ctx, JSValueConst newTarget, const std::string &source);
+    
+    // worker.postMessage(): queue value for the worker's onmessage
+    JSValue postToWorker(JSContext *ctx, uint32_t workerId, JSValueConst value, JSValueConst transfer);
+    
+    // worker.terminate(): stop the worker script, waiting until it has ended
+    void terminateWorker(uint32_t workerId);
+    
+    // postMessage() of a worker script: queue value for the Worker's onmessage
+    JSValue postToParent(JSContext *ctx, JSValueConst value, JSValueConst transfer) {
+        if (!workerParent) {
+            return JS_UNDEFINED;
+        }
+        std::unique_ptr<WorkerMessage> message(new WorkerMessage());
+        if (!message->write(ctx, this, value, transfer)) {
+            return JS_EXCEPTION;
+        }
+        buffersAway.fetch_add(message->transfersFrom(this), std::memory_order_relaxed);
+        workerParent->postWorkerEvent(parentWorkerId, WORKER_MESSAGE, std::move(message));
+        return JS_UNDEFINED;
+    }
+    
+    // close() of a worker script: end it once the current task returns
+    void closeWorker() {
+        workerClosing = true;
+    }
+    
+    // Run the script of a worker engine, then deliver its messages and timers
+    // until it closes itself or is cancelled; requires the limits of the job
+    // set up by the WorkerThread running it
+    void runWorker(const std::string &source, QuickJSEngine *parent, uint32_t workerId) {
+        workerParent = parent;
+        parentWorkerId = workerId;
+        workerClosing = false;
+        
+        JSValue result = evaluateScript(source);
+        if (JS_IsException(result)) {
+            reportWorkerError();
+        } else {
+            JS_FreeValue(context, result);
+        }
+        
+        while (!workerClosing && !limitReached()) {
+            if (runPendingJobs() > 0 || dispatchWorkerEvents() > 0 || fireExpiredTimers() > 0) {
+                continue;
+            }
+            releaseReturnedBuffers();
+            armTimerFd();
+            struct epoll_event event;
+            while (epoll_wait(pollFd, &event, 1, -1) < 0 && errno == EINTR) {
+            }
+            drainWakeFds();
+        }
+    }
+    
+    // Tear down what the script of runWorker() left behind, leaving a fresh
+    // context for the next one. The collection frees everything it still
+    // referenced, so buffers transferred in are back with their home runtimes
+    // before the parent hears the worker has exited.
+    void finishWorker() {
+        releaseContext();
+        JS_RunGC(runtime);
+        if (!setupContext()) {
+            LOGE("Failed to create new QuickJS context for worker engine %d", id);
+            initialized = false;
+        }
+        releaseReturnedBuffers();
+        workerParent = nullptr;
+    }
+    
+private:
+    // Polled by the interpreter every few thousand calls and backward branches
+    static int interruptHandler(JSRuntime *rt, void *opaque) {
+        QuickJSEngine *engine = static_cast<QuickJSEngine *>(opaque);
+        if (engine->context) {
+            engine->profiler.sample(engine->context);
+        }
+        return engine->limitReached() ? 1 : 0;
+    }
+    
+    // Run fn on an arena engine with the given realm features, then throw
+    // its runtime away; the engine is the spare one when that matches
+    template <typename Fn>
+    std::string inArenaChild(int features, Fn fn) {
+        lastRealmFeatures = features;
+        std::unique_ptr<QuickJSEngine> child;
+        if (spareRealm && spareRealm->realmFeatures == features) {
+            child = std::move(spareRealm);
+        } else {
+            child = newRealm(features);
+        }
+        if (!child) {
+            return "Error: Failed to create arena context";
+        }
+        // Request ids stay unique across both, so completions reach the right one
+        child->nextHttpRequestId = nextHttpRequestId;
+        
+        setArenaChild(child.get());
+        std::string result = fn(*child);
+        setArenaChild(nullptr);
+        
+        nextHttpRequestId = child->nextHttpRequestId;
+        child->counters.foldRuntime(child->runtime);
+        counters.addAll(child->counters);
+        child->discard();
+        return result;
+    }
+    
+    std::unique_ptr<QuickJSEngine> newRealm(int features) {
+        std::unique_ptr<QuickJSEngine> realm(new QuickJSEngine(id, true, true, false, features));
+        if (!realm->initialize()) {
+            return nullptr;
+        }
+        return realm;
+    }
+    
+    void discardSpareRealm() {
+        if (spareRealm) {
+            spareRealm->discard();
+            spareRealm.reset();
+        }
+    }
+    
+    // Forward completions and cancels to child while it runs, handing it the lease's limits    
+    void setArenaChild(QuickJSEngine *child) {
+        std::lock(completionMutex, limitsMutex);
+        std::lock_guard<std::mutex> completionLock(completionMutex, std::adopt_lock);
+        std::lock_guard<std::mutex> limitsLock(limitsMutex, std::adopt_lock);
+        arenaChild = child;
+        if (child) {
+            arenaFirstRequestId = child->nextHttpRequestId;
+            child->executionTimeoutMs = executionTimeoutMs;
+            if (cancelRequested.load(std::memory_order_relaxed)) {
+                child->cancelRequested.store(true, std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now().time_since_epoch()).count();
+    }
+    
+    // Start the deadline of an execution; the timeout covers time spent awaiting too
+    void startExecutionTimer() {
+        std::lock_guard<std::mutex> lock(limitsMutex);
+        deadlineNs = executionTimeoutMs > 0 ? nowNs() + executionTimeoutMs * 1000000 : 0;
+    }
+    
+    // Whether the current execution must stop; once true, stays true for the lease
+    // so the interpreter keeps unwinding. Only runs on the engine thread.
+    bool limitReached() {
+        if (interruptReason == INTERRUPT_NONE) {
+            if (cancelRequested.load(std::memory_order_relaxed)) {
+                interruptReason = INTERRUPT_CANCEL;
+            } else if (deadlineNs != 0 && nowNs() >= deadlineNs) {
+                interruptReason = INTERRUPT_TIMEOUT;
+            }
+        }
+        return isInterrupted();
+    }
+    
+    const char *interruptMessage() const {
+        return interruptReason == INTERRUPT_TIMEOUT ? "Execution timed out" : "Execution cancelled";
+    }
+    
+    bool setupWakeFds() {
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        pollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (wakeFd < 0 || timerFd < 0 || pollFd < 0) {
+            return false;
+        }
+        
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = wakeFd;
+        if (epoll_ctl(pollFd, EPOLL_CTL_ADD, wakeFd, &event) < 0) {
+            return false;
+        }
+        event.data.fd = timerFd;
+        return epoll_ctl(pollFd, EPOLL_CTL_ADD, timerFd, &event) == 0;
+    }
+    
+    void closeWakeFds() {
+        for (int *fd : {&pollFd, &timerFd, &wakeFd}) {
+            if (*fd >= 0) {
+                close(*fd);
+                *fd = -1;
+            }
+        }
+    }
+    
+    // Arm the timer fd for the earliest live timer, or disarm it
+    void armTimerFd() {
+        while (!timerHeap.empty() && timers.find(timerHeap.top().second) == timers.end()) {
+            timerHeap.pop();  // Cleared
+        }
+        
+        // steady_clock is CLOCK_MONOTONIC on Linux, so deadlines map onto the timer fd directly
+        // The execution deadline wakes the waiter as well, so it can stop the execution
+        int64_t deadline = deadlineNs;
+        if (!timerHeap.empty()) {
+            int64_t timerDeadline = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                timerHeap.top().first.time_since_epoch()).count();
+            deadline = deadline ? std::min(deadline, timerDeadline) : timerDeadline;
+        }
+        struct itimerspec spec = {};
+        if (deadline) {
+            // A zero it_value disarms the timer, so an already due deadline becomes 1ns
+            deadline = std::max<int64_t>(deadline, 1);
+            spec.it_value.tv_sec = deadline / 1000000000;
+            spec.it_value.tv_nsec = deadline % 1000000000;
+        }
+        timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    }
+    
+    // Free the context and the runtime with everything they hold
+    void releaseRuntime() {
+        discardSpareRealm();
+        releaseContext();
+        releaseReturnedBuffers();
+        releaseBundleAtoms(true);
+
+        if (runtime) {
+            JS_FreeRuntime(runtime);
+            runtime = nullptr;
+        }
+        slabAllocator.reset();
+        closeWakeFds();
+        initialized = false;
+    }
+    
+    // Own string-keyed names of the global object
+    std::vector<std::string> globalNames(JSValueConst global) {
+        std::vector<std::string> names;
+        JSPropertyEnum *properties;
+        uint32_t count;
+        if (JS_GetOwnPropertyNames(context, &properties, &count, global, JS_GPN_STRING_MASK) < 0) {
+            JS_FreeValue(context, JS_GetException(context));
+            return names;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            const char *name = JS_AtomToCString(context, properties[i].atom);
+            if (name) {
+                names.push_back(name);
+                JS_FreeCString(context, name);
+            }
+            JS_FreeAtom(context, properties[i].atom);
+        }
+        js_free(context, properties);
+        return names;
+    }
+    
+    // Hash the attributes and values of contextGlobals, and everything they
+    // reach; false if that fails, e.g. out of memory
+    bool hashContextGlobals(uint64_t *hash) {
+        JS_UpdateStackTop(runtime);
+        JSValue global = JS_GetGlobalObject(context);
+        std::vector<JSValue> roots;
+        bool hashed = true;
+        for (const std::string &name : contextGlobals) {
+            JSPropertyDescriptor desc;
+            JSAtom atom = JS_NewAtom(context, name.c_str());
+            int found = JS_GetOwnProperty(context, &desc, global, atom);
+            JS_FreeAtom(context, atom);
+            if (found < 0) {
+                hashed = false;
+                break;
+            }
+            if (found == 0) {
+                roots.push_back(JS_UNINITIALIZED);  // Deleted
+                continue;
+            }
+            roots.push_back(JS_NewInt32(context, desc.flags));
+            roots.push_back(desc.value);
+            roots.push_back(desc.getter);
+            roots.push_back(desc.setter);
+        }
+        hashed = hashed && JS_HashObjectGraph(context, hash, roots.data(), static_cast<int>(roots.size())) >= 0;
+        if (!hashed) {
+            JS_FreeValue(context, JS_GetException(context));
+        }
+        for (JSValue &root : roots) {
+            JS_FreeValue(context, root);
+        }
+        JS_FreeValue(context, global);
+        return hashed;
+    }
+    
+    // Whether the globals the context was set up with still hold what they did
+    bool contextGlobalsUnchanged() {
+        uint64_t hash;
+        return contextGlobalsHashed && hashContextGlobals(&hash) && hash == contextGlobalsHash;
+    }
+    
+    // Serialize the globals not in baselineGlobals with their attributes, in
+    // one graph so values they share stay shared
+    // Fails if any of them would not read back as it is, unless lossy, which
+    // drops those and counts them in *dropped
+    bool saveGlobals(std::vector<uint8_t> &state, bool lossy, size_t *dropped) {
+        JSValue values = JS_NewObject(context);
+        JSValue attributes = JS_NewObject(context);
+        JSValue saved = JS_NewArray(context);
+        if (JS_IsException(values) || JS_IsException(attributes) || JS_IsException(saved)) {
+            JS_FreeValue(context, JS_GetException(context));
+            JS_FreeValue(context, values);
+            JS_FreeValue(context, attributes);
+            JS_FreeValue(context, saved);
+            return false;
+        }
+        JSValue global = JS_GetGlobalObject(context);
+        std::vector<std::string> names;
+        for (const std::string &name : globalNames(global)) {
+            if (baselineGlobals.count(name)) {
+                continue;
+            }
+            JSPropertyDescriptor desc;
+            JSAtom atom = JS_NewAtom(context, name.c_str());
+            int found = JS_GetOwnProperty(context, &desc, global, atom);
+            JS_FreeAtom(context, atom);
+            if (found <= 0) {
+                JS_FreeValue(context, JS_GetException(context));
+                continue;
+            }
+            JS_FreeValue(context, desc.getter);
+            JS_FreeValue(context, desc.setter);
+            // Accessors and closures cannot be written
+            if ((desc.flags & JS_PROP_GETSET) || JS_IsFunction(context, desc.value)) {
+                JS_FreeValue(context, desc.value);
+                (*dropped)++;
+                continue;
+            }
+            int flags = desc.flags & JS_PROP_C_W_E;
+            if (JS_DefinePropertyValueStr(context, values, name.c_str(), desc.value, JS_PROP_C_W_E) >= 0 &&
+                JS_DefinePropertyValueStr(context, attributes, name.c_str(), JS_NewInt32(context, flags),
+                                          JS_PROP_C_W_E) >= 0) {
+                names.push_back(name);
+            }
+        }
+        JS_FreeValue(context, global);
+        if (*dropped > 0 && !lossy) {
+            JS_FreeValue(context, values);
+            JS_FreeValue(context, attributes);
+            JS_FreeValue(context, saved);
+            return false;
+        }
+        JS_SetPropertyUint32(context, saved, 0, JS_DupValue(context, values));
+        JS_SetPropertyUint32(context, saved, 1, attributes);
+        
+        // Strict, so class instances and the like fail instead of coming
+        // back as plain objects
+        int writeFlags = lossy ? JS_WRITE_OBJ_REFERENCE : JS_WRITE_OBJ_REFERENCE | JS_WRITE_OBJ_STRICT;
+        size_t size;
+        uint8_t *bytes = JS_WriteObject(context, &size, saved, writeFlags);
+        if (!bytes && lossy) {
+            // Find the values that cannot be written, such as shared buffers
+            // and host objects, and write the rest without them
+            JS_FreeValue(context, JS_GetException(context));
+            for (const std::string &name : names) {
+                JSValue value = JS_GetPropertyStr(context, values, name.c_str());
+                size_t valueSize;
+                uint8_t *valueBytes = JS_WriteObject(context, &valueSize, value, writeFlags);
+                JS_FreeValue(context, value);
+                if (valueBytes) {
+                    js_free(context, valueBytes);
+                    continue;
+                }
+                JS_FreeValue(context, JS_GetException(context));
+                JSAtom atom = JS_NewAtom(context, name.c_str());
+                JS_DeleteProperty(context, values, atom, 0);
+                JS_FreeAtom(context, atom);
+                (*dropped)++;
+            }
+            bytes = JS_WriteObject(context, &size, saved, writeFlags);
+        }
+        JS_FreeValue(context, values);
+        JS_FreeValue(context, saved);
+        if (!bytes) {
+            JS_FreeValue(context, JS_GetException(context));
+            return false;
+        }
+        // Kept past the runtime, so copied out of its allocator
+        state.assign(bytes, bytes + size);
+        js_free(context, bytes);
+        return true;
+    }
+    
+    // Define the globals saved by saveGlobals() on the fresh global object,
+    // with the attributes they had
+    void restoreGlobals() {
+        JSValue saved = JS_ReadObject(context, hibernatedState.data(), hibernatedState.size(),
+                                      JS_READ_OBJ_REFERENCE);
+        if (JS_IsException(saved)) {
+            std::string error = describeException("Engine state unreadable: ");
+            LOGE("Engine %d: %s", id, error.c_str());
+            return;
+        }
+        JSValue values = JS_GetPropertyUint32(context, saved, 0);
+        JSValue attributes = JS_GetPropertyUint32(context, saved, 1);
+        JSValue global = JS_GetGlobalObject(context);
+        for (const std::string &name : globalNames(values)) {
+            JSValue value = JS_GetPropertyStr(context, values, name.c_str());
+            JSValue flags = JS_GetPropertyStr(context, attributes, name.c_str());
+            int32_t flagBits = JS_PROP_C_W_E;
+            JS_ToInt32(context, &flagBits, flags);
+            JS_FreeValue(context, flags);
+            if (JS_IsException(value) ||
+                JS_DefinePropertyValueStr(context, global, name.c_str(), value, flagBits & JS_PROP_C_W_E) < 0) {
+                JS_FreeValue(context, JS_GetException(context));
+            }
+        }
+        JS_FreeValue(context, global);
+        JS_FreeValue(context, attributes);
+        JS_FreeValue(context, values);
+        JS_FreeValue(context, saved);
+    }
+    
+    bool setupContext() {
+        if (realmFeatures != REALM_FULL_CONTEXT) {
+            return setupRealmContext();
+        }
+        context = JS_NewContext(runtime);
+        if (!context) {
+            return false;
+        }
+        JS_SetContextOpaque(context, this);
+        
+        js_std_add_helpers(context, 0, nullptr);
+        addConsoleSupport(context);
+        addTimerPolyfills(context);
+        if (worker) {
+            // HTTP completions are routed by pool handle, so workers have no fetch
+            addWorkerScopePolyfills(context);
+        } else {
+            addHttpPolyfills(context);
+            // Arena runtimes are discarded without finalizers, which a Worker needs
+            if (!arena) {
+                addWorkerPolyfills(context);
+            }
+        }
+        HostFunctions::installAll(context);
+        if (!arena && !worker) {
+            // Every context, since host functions registered while the engine
+            // had none appear only in the next one
+            JSValue global = JS_GetGlobalObject(context);
+            contextGlobals = globalNames(global);
+            JS_FreeValue(context, global);
+            baselineGlobals.insert(contextGlobals.begin(), contextGlobals.end());
+            contextGlobalsHashed = hashContextGlobals(&contextGlobalsHash);
+        }
+        return true;
+    }
+    
+    // A raw context with only realmFeatures on top of the core language,
+    // so it is cheaper to build and scripts reach no more than they need
+    bool setupRealmContext() {
+        context = JS_NewContextRaw(runtime);
+        if (!context) {
+            return false;
+        }
+        JS_SetContextOpaque(context, this);
+        
+        // Eval is what runs scripts at all; the fetch polyfill needs JSON, Map and Promise
+        JS_AddIntrinsicBaseObjects(context);
+        JS_AddIntrinsicEval(context);
+        JS_AddIntrinsicStringNormalize(context);
+        JS_AddIntrinsicJSON(context);
+        JS_AddIntrinsicMapSet(context);
+        JS_AddIntrinsicPromise(context);
+        if (realmFeatures & REALM_DATE) {
+            JS_AddIntrinsicDate(context);
+        }
+        if (realmFeatures & REALM_REGEXP) {
+            JS_AddIntrinsicRegExp(context);
+        }
+        if (realmFeatures & REALM_PROXY) {
+            JS_AddIntrinsicProxy(context);
+        }
+        if (realmFeatures & (REALM_TYPED_ARRAYS | REALM_FETCH)) {
+            JS_AddIntrinsicTypedArrays(context);
+        }
+        if (realmFeatures & REALM_WEAK_REFS) {
+            JS_AddIntrinsicWeakRef(context);
+        }
+        
+        if (realmFeatures & REALM_CONSOLE) {
+            addConsoleSupport(context);
+        }
+        if (realmFeatures & REALM_TIMERS) {
+            addTimerPolyfills(context);
+        }
+        if (realmFeatures & REALM_FETCH) {
+            addHttpPolyfills(context);
+        }
+        return true;
+    }
+    
+    void releaseContext() {
+        if (!context) {
+            return;
+        }
+        
+        abandonAsyncWork();
+        scriptCache.clear(context);
+        JS_FreeContext(context);
+        context = nullptr;
+    }
+    
+    // Drop pending requests, timers and workers, so they never run
+    void abandonAsyncWork() {
+        // Requests still in flight will complete into the void
+        for (auto &entry : pendingHttpRequests) {
+            JS_FreeValue(context, entry.second.resolve);
+            JS_FreeValue(context, entry.second.reject);
+        }
+        pendingHttpRequests.clear();
+        
+        // Workers are stopped before their events are dropped, so none follow
+        terminateWorkers();
+        std::deque<WorkerEvent> events;
+        {
+            std::lock_guard<std::mutex> lock(completionMutex);
+            for (HttpCompletion &completion : completions) {
+                releaseGlobalRef(completion.body);
+            }
+            completions.clear();
+            // Freed outside the lock: undelivered messages hand their buffers back
+            events.swap(workerEvents);
+        }
+        
+        // Timers never outlive the context that created them
+        for (auto &entry : timers) {
+            freeTimer(entry.second);
+        }
+        timers.clear();
+        timerHeap = decltype(timerHeap)();
+    }
+    
+    // Run every queued job; returns the number of jobs run
+    int runPendingJobs() {
+        int count = 0;
+        for (;;) {
+            JSContext *jobContext;
+            int err = JS_ExecutePendingJob(runtime, &jobContext);
+            if (err == 0) {
+                counters.add(ExecutionCounters::JOBS_RUN, count);
+                return count;
+            }
+            if (err < 0) {
+                js_std_dump_error(jobContext);
+            }
+            count++;
+        }
+    }
+    
+    void freeTimer(Timer &timer) {
+        JS_FreeValue(context, timer.callback);
+        for (JSValue arg : timer.args) {
+            JS_FreeValue(context, arg);
+        }
+    }
+    
+    // Run the callbacks of every timer that is due; returns the number fired
+    int fireExpiredTimers() {
+        int count = 0;
+        Clock::time_point now = Clock::now();
+        
+        while (!timerHeap.empty() && timerHeap.top().first <= now) {
+            uint32_t timerId = timerHeap.top().second;
+            timerHeap.pop();
+            
+            auto it = timers.find(timerId);
+            if (it == timers.end()) {
+                continue;  // Cleared
+            }
+            
+            // Keep our own references: the callback may clear its own timer
+            JSValue callback;
+            std::vector<JSValue> args;
+            if (it->second.intervalMs >= 0) {
+                callback = JS_DupValue(context, it->second.callback);
+                for (JSValue arg : it->second.args) {
+                    args.push_back(JS_DupValue(context, arg));
+                }
+                timerHeap.push(TimerDeadline(now + std::chrono::milliseconds(it->second.intervalMs), timerId));
+            } else {
+                callback = it->second.callback;
+                args = std::move(it->second.args);
+                timers.erase(it);
+            }
+            
+            JSValue ret = JS_Call(context, callback, JS_UNDEFINED,
+                                  static_cast<int>(args.size()), args.data());
+            if (JS_IsException(ret)) {
+                js_std_dump_error(context);
+            }
+            JS_FreeValue(context, ret);
+            JS_FreeValue(context, callback);
+            for (JSValue arg : args) {
+                JS_FreeValue(context, arg);
+            }
+            count++;
+        }
+        return count;
+    }
+    
+    // Wrap a completion's body as an ArrayBuffer that keeps the ByteBuffer alive
+    JSValue wrapHttpBody(const HttpCompletion &completion) {
+        HttpBody *owner = new HttpBody{completion.body, this};
+        JSValue buffer = JS_NewArrayBuffer(context, completion.bodyData, completion.bodyLength,
+                                           js_free_http_body, owner, false);
+        if (JS_IsException(buffer)) {
+            releaseGlobalRef(completion.body);
+            delete owner;
+        } else {
+            liveBodies.insert(owner);
+            if (completion.terminated) {
+                terminatedBodies.insert(completion.bodyData);
+            }
+        }
+        return buffer;
+    }
+    
+    // Settle the promises of completed HTTP requests; returns the number delivered
+    int dispatchHttpCompletions() {
+        std::deque<HttpCompletion> ready;
+        {
+            std::lock_guard<std::mutex> lock(completionMutex);
+            ready.swap(completions);
+        }
+        
+        int count = 0;
+        for (HttpCompletion &completion : ready) {
+            auto it = pendingHttpRequests.find(completion.requestId);
+            if (it == pendingHttpRequests.end()) {
+                releaseGlobalRef(completion.body);
+                continue;  // Issued by a context that has since been reset
+            }
+            PendingHttpRequest request = it->second;
+            pendingHttpRequests.erase(it);
+            
+            JSValue response = JS_ParseJSON(context, completion.metadata.c_str(),
+                                            completion.metadata.length(), "<http-response>");
+            if (!JS_IsException(response)) {
+                JSValue body = wrapHttpBody(completion);
+                if (JS_IsException(body)) {
+                    JS_FreeValue(context, response);
+                    response = JS_EXCEPTION;
+                } else {
+                    JS_SetPropertyStr(context, response, "body", body);
+                }
+            } else {
+                releaseGlobalRef(completion.body);
+            }
+            
+            JSValue ret;
+            if (JS_IsException(response)) {
+                JSValue exception = JS_GetException(context);
+                ret = JS_Call(context, request.reject, JS_UNDEFINED, 1, &exception);
+                JS_FreeValue(context, exception);
+            } else {
+                ret = JS_Call(context, request.resolve, JS_UNDEFINED, 1, &response);
+                JS_FreeValue(context, response);
+            }
+            JS_FreeValue(context, ret);
+            JS_FreeValue(context, request.resolve);
+            JS_FreeValue(context, request.reject);
+            count++;
+        }
+        return count;
+    }
+    
+    // Stop every worker of this context, waiting for their scripts to end
+    void terminateWorkers();
+    
+    // Take the pending exception of a worker script and post it to the
+    // Worker's onerror; stopped scripts report nothing
+    void reportWorkerError() {
+        if (isInterrupted()) {
+            JS_FreeValue(context, JS_GetException(context));
+            return;
+        }
+        std::string error = describeException("");
+        workerParent->postWorkerEvent(parentWorkerId, WORKER_ERROR, nullptr, error);
+    }
+    
+    // Call the onmessage and onerror handlers of workers, or those of the
+    // worker scope in a worker engine; returns the number of events handled
+    int dispatchWorkerEvents() {
+        std::deque<WorkerEvent> ready;
+        {
+            std::lock_guard<std::mutex> lock(completionMutex);
+            ready.swap(workerEvents);
+        }
+        
+        int count = 0;
+        for (WorkerEvent &event : ready) {
+            if (workerClosing || isInterrupted()) {
+                break;  // The rest is dropped along with the script
+            }
+            JSValue target;
+            if (worker) {
+                target = JS_GetGlobalObject(context);
+            } else {
+                auto it = workers.find(event.workerId);
+                if (it == workers.end()) {
+                    continue;  // Terminated
+                }
+                if (event.kind == WORKER_EXIT) {
+                    JS_FreeValue(context, it->second.object);
+                    workers.erase(it);
+                    count++;
+                    continue;
+                }
+                target = JS_DupValue(context, it->second.object);
+            }
+            
+            JSValue payload = JS_NewObject(context);
+            if (event.kind == WORKER_MESSAGE) {
+                // Buffers of this runtime coming back are freed here again
+                size_t away = event.message->transfersFrom(this);
+                JSValue data = event.message->read(context);
+                buffersAway.fetch_sub(away - event.message->transfersFrom(this), std::memory_order_relaxed);
+                if (JS_IsException(data)) {
+                    // A messageerror on the web; onmessage does not see it
+                    js_std_dump_error(context);
+                    JS_FreeValue(context, payload);
+                    JS_FreeValue(context, target);
+                    count++;
+                    continue;
+                }
+                JS_SetPropertyStr(context, payload, "data", data);
+            } else {
+                JS_SetPropertyStr(context, payload, "message", JS_NewString(context, event.error.c_str()));
+            }
+            JSValue handler = JS_GetPropertyStr(context, target,
+                                                event.kind == WORKER_MESSAGE ? "onmessage" : "onerror");
+            if (JS_IsFunction(context, handler)) {
+                JSValue ret = JS_Call(context, handler, target, 1, &payload);
+                if (!JS_IsException(ret)) {
+                    JS_FreeValue(context, ret);
+                } else if (worker) {
+                    reportWorkerError();
+                } else {
+                    js_std_dump_error(context);
+                }
+            } else if (event.kind == WORKER_ERROR) {
+                LOGE("Uncaught error in worker %u: %s", event.workerId, event.error.c_str());
+            }
+            JS_FreeValue(context, handler);
+            JS_FreeValue(context, payload);
+            JS_FreeValue(context, target);
+            count++;
+        }
+        return count;
+    }
+};
+
+// Append a console argument to buffer: strings as is, objects as JSON
+static void appendConsoleArg(JSContext *ctx, JSValueConst arg, char *buffer, size_t capacity, size_t *length) {
+    JSValue text = JS_UNDEFINED;
+    if (JS_IsObject(arg) && !JS_IsFunction(ctx, arg) && !JS_IsError(ctx, arg)) {
+        text = JS_JSONStringify(ctx, arg, JS_UNDEFINED, JS_UNDEFINED);
+        if (JS_IsException(text)) {
+            JS_FreeValue(ctx, JS_GetException(ctx));  // e.g. cyclic; fall back to toString()
+            text = JS_UNDEFINED;
+        }
+    }
+    
+    size_t size;
+    const char *str = JS_ToCStringLen(ctx, &size, JS_IsUndefined(text) ? arg : text);
+    JS_FreeValue(ctx, text);
+    if (!str) {
+        JS_FreeValue(ctx, JS_GetException(ctx));
+        str = JS_ToCStringLen(ctx, &size, JS_NewString(ctx, "[unprintable]"));
+        if (!str) {
+            return;
+        }
+    }
+    
+    size_t count = std::min(size, capacity - *length);
+    memcpy(buffer + *length, str, count);
+    *length += count;
+    JS_FreeCString(ctx, str);
+}
+
+// Native console.debug/log/info/warn/error (magic is the ConsoleLog level)
+// Disabled levels return before any argument is converted
+static JSValue js_console_log(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv, int magic) {
+    if (!g_consoleLog.isEnabled(magic)) {
+        return JS_UNDEFINED;
+    }
+    
+    char buffer[ConsoleLog::MESSAGE_CAPACITY];
+    size_t length = 0;
+    for (int i = 0; i < argc && length < sizeof(buffer); i++) {
+        if (i > 0) {
+            buffer[length++] = ' ';
+        }
+        appendConsoleArg(ctx, argv[i], buffer, sizeof(buffer), &length);
+    }
+    
+    QuickJSEngine *engine = static_cast<QuickJSEngine *>(JS_GetContextOpaque(ctx));
+    int64_t timestampMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    g_consoleLog.append(magic, engine ? engine->getId() : -1, timestampMs, buffer, length);
+    return JS_UNDEFINED;
+}
+
+// Native setTimeout (magic 0) and setInterval (magic 1)
+static JSValue js_set_timer(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv, int magic) {
+    QuickJSEngine *engine = static_cast<QuickJSEngine *>(JS_GetContextOpaque(ctx));
+    if (!engine) {
+        return JS_ThrowInternalError(ctx, "Timers not available");
+    }
+    if (argc < 1 || !JS_IsFunction(ctx, argv[0])) {
+        return JS_ThrowTypeError(ctx, "Timer callback must be a function");
+    }
+    
+    int64_t delayMs = 0;
+    if (argc > 1 && JS_ToInt64(ctx, &delayMs, argv[1])) {
+        return JS_EXCEPTION;
+    }
+    
+    std::vector<JSValue> args;
+    for (int i = 2; i < argc; i++) {
+        args.push_back(JS_DupValue(ctx, argv[i]));
+    }
+    uint32_t timerId = engine->addTimer(JS_DupValue(ctx, argv[0]), std::move(args), delayMs, magic == 1);
+    return JS_NewUint32(ctx, timerId);
+}
+
+// Native clearTimeout/clearInterval
+static JSValue js_clear_timer(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    QuickJSEngine *engine = static_cast<QuickJSEngine *>(JS_GetContextOpaque(ctx));
+    uint32_t timerId;
+    if (engine && argc > 0 && JS_IsNumber(argv[0]) && JS_ToUint32(ctx, &timerId, argv[0]) == 0) {
+        engine->removeTimer(timerId);
+    }
+    return JS_UNDEFINED;
+}
+
+// Native performance.now(): monotonic milliseconds since the library was loaded
+static const std::chrono::steady_clock::time_point g_timeOrigin = std::chrono::steady_clock::now();
+
+static JSValue js_performance_now(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - g_timeOrigin;
+    return JS_NewFloat64(ctx, elapsed.count());
+}
+
+// Native async HTTP request function (called from JavaScript)
+// Returns a promise that the engine's event loop settles with the response
+// Counters of the engine running ctx, if it has one
+static ExecutionCounters *countersOf(JSContext *ctx) {
+    QuickJSEngine *engine = static_cast<QuickJSEngine *>(JS_GetContextOpaque(ctx));
+    return engine ? &engine->getCounters() : nullptr;
+}
+
+static JSValue js_http_request_async(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    QuickJSEngine *engine = static_cast<QuickJSEngine *>(JS_GetContextOpaque(ctx));
+    if (argc < 1 || !engine || !g_quickjsBridgeInstance || !g_handleHttpRequestAsyncMethod) {
+        return JS_ThrowReferenceError(ctx, "HTTP service not available");
+    }
+    
+    JNIEnv *env = nullptr;
+    if (!g_jvm || g_jvm->GetEnv((void**)&env, JNI_VERSION_1_6) != JNI_OK) {
+        return JS_ThrowInternalError(ctx, "Failed to get JNI environment");
+    }
+    
+    const char *url = JS_ToCString(ctx, argv[0]);
+    if (!url) {
+        return JS_ThrowTypeError(ctx, "URL must be a string");
+    }
+    
+    const char *options = argc > 1 ? JS_ToCString(ctx, argv[1]) : nullptr;
+    if (argc > 1 && !options) {
+        JS_FreeCString(ctx, url);
+        return JS_ThrowTypeError(ctx, "Options must be an object");
+    }
+    
+    JSValue promise = engine->startHttpRequest(ctx, env, url, options ? options : "{}");
+    
+    JS_FreeCString(ctx, url);
+    if (options) JS_FreeCString(ctx, options);
+    return promise;
+}
+
+// Decode an ArrayBuffer as UTF-8 text, or as JSON when the second argument is true
+static JSValue js_decode_body(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    QuickJSEngine *engine = static_cast<QuickJSEngine *>(JS_GetContextOpaque(ctx));
+    if (argc < 1 || !JS_IsArrayBuffer(argv[0])) {
+        return JS_ThrowTypeError(ctx, "Body must be an ArrayBuffer");
+    }
+    
+    size_t size;
+    uint8_t *data = JS_GetArrayBuffer(ctx, &size, argv[0]);
+    if (!data) {
+        return JS_EXCEPTION;
+    }
+    const char *text = reinterpret_cast<const char *>(data);
+    
+    if (argc < 2 || !JS_ToBool(ctx, argv[1])) {
+        return JS_NewStringLen(ctx, text, size);
+    }
+    
+    // JS_ParseJSON needs a NUL after the input; response bodies have one
+    if (engine && engine->isTerminatedHttpBody(data)) {
+        return JS_ParseJSON(ctx, text, size, "<http-body>");
+    }
+    std::string copy(text, size);
+    return JS_ParseJSON(ctx, copy.c_str(), size, "<http-body>");
+}
+
+// ArrayBuffer free callback for response bodies
+static void js_free_http_body(JSRuntime *rt, void *opaque, void *ptr) {
+    HttpBody *owner = static_cast<HttpBody *>(opaque);
+    owner->engine->forgetHttpBody(owner, static_cast<const uint8_t *>(ptr));
+    releaseGlobalRef(owner->buffer);
+    delete owner;
+}
+
+// Pool of independent QuickJS engines, each owning its own JSRuntime
+// A runtime must only be entered by one thread at a time, so engines are
+// leased out exclusively; different engines run concurrently on any thread.
+// The default engine comes on top of the pooled ones and is only leased by
+// handle, so its globals are never seen or reset by anonymous leases.
+class QuickJSEnginePool {
+public:
+    static constexpr int DEFAULT_ENGINE = 0;  // Engine used by the legacy single-engine API
+    static constexpr int FIRST_POOLED_ENGINE = 1;
+    static constexpr int MAX_ENGINES = 16;    // Pooled engines, besides the default one
+
+    bool initialize(int poolSize, bool useSlabAllocator) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!engines.empty()) {
+            LOGI("QuickJS engine pool already initialized with %zu engines", engines.size());
+            return true;
+        }
+
+        int size = FIRST_POOLED_ENGINE + std::max(1, std::min(poolSize, MAX_ENGINES));
+        LOGI("Initializing QuickJS engine pool with %d engines and the default one%s", size - FIRST_POOLED_ENGINE,
+             useSlabAllocator ? " on slab allocators" : "");
+
+        for (int i = 0; i < size; i++) {
+            std::unique_ptr<QuickJSEngine> engine(new QuickJSEngine(i, useSlabAllocator));
+            if (!engine->initialize()) {
+                LOGE("Failed to initialize pooled engine %d", i);
+                cleanupLocked();
+                return false;
+            }
+            engines.push_back(std::move(engine));
+            busy.push_back(false);
+        }
+        idleCollector.start(g_jvm, [this](int handle) {
+            collectIdle(handle);
+        });
+        return true;
+    }
+
+    void cleanup() {
+        // Before waiting on leases, since the collector takes them too
+        idleCollector.stop();
+
+        std::unique_lock<std::mutex> lock(mutex);
+
+        // Wait for in-flight executions to hand their engines back
+        available.wait(lock, [this] {
+            return std::none_of(busy.begin(), busy.end(), [](bool b) { return b; });
+        });
+        cleanupLocked();
+    }
+
+    // Lease any free pooled engine, blocking until one becomes available, and
+    // restore it if it is hibernated; the default engine is never handed out
+    // Returns the engine handle, or -1 if the pool is not initialized
+    int acquire() {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        for (;;) {
+            if (engines.empty()) {
+                return -1;
+            }
+            int count = static_cast<int>(engines.size());
+            for (int handle = FIRST_POOLED_ENGINE; handle < count; handle++) {
+                if (!busy[handle]) {
+                    busy[handle] = true;
+                    QuickJSEngine *engine = engines[handle].get();
+                    engine->resetExecutionLimits();
+                    // Leased now, and engines only go away once every lease ends
+                    lock.unlock();
+                    engine->restore();
+                    return handle;
+                }
+            }
+            available.wait(lock);
+        }
+    }
+
+    // Lease a specific engine, blocking until it becomes available
+    // A hibernated engine is restored unless restore is false
+    bool acquire(int handle, bool restore = true) {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        for (;;) {
+            if (handle < 0 || handle >= static_cast<int>(engines.size())) {
+                return false;
+            }
+            if (!busy[handle]) {
+                busy[handle] = true;
+                QuickJSEngine *engine = engines[handle].get();
+                engine->resetExecutionLimits();
+                if (restore) {
+                    lock.unlock();
+                    engine->restore();
+                }
+                return true;
+            }
+            available.wait(lock);
+        }
+    }
+
+    // Lease a specific engine only if it is free right now; hibernated engines stay so
+    bool tryAcquire(int handle) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (handle < 0 || handle >= static_cast<int>(engines.size()) || busy[handle]) {
+            return false;
+        }
+        busy[handle] = true;
+        engines[handle]->resetExecutionLimits();
+        return true;
+    }
+
+    void release(int handle) {
+        // Still leased here, so the runtime can be walked safely
+        bool collect = false;
+        if (QuickJSEngine *engine = get(handle)) {
+            engine->releaseReturnedBuffers();
+            engine->trimIfRequested();
+            engine->sampleMemoryIfDue();
+            engine->resetExecutionLimits();
+            if (engine->runtime) {
+                engine->getCounters().foldRuntime(engine->runtime);
+            }
+            collect = g_idleGcDelayMs.load(std::memory_order_relaxed) > 0 &&
+                      (engine->garbageEstimate() >= IDLE_GC_MIN_GARBAGE || engine->wantsSpareRealm());
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (handle < 0 || handle >= static_cast<int>(busy.size()) || !busy[handle]) {
+                LOGE("Releasing engine %d that is not leased", handle);
+                return;
+            }
+            busy[handle] = false;
+        }
+        available.notify_all();
+        if (collect) {
+            idleCollector.schedule(handle, g_idleGcDelayMs.load(std::memory_order_relaxed));
+        }
+    }
+
+    // Returns the engine for a handle the caller currently holds a lease on
+    QuickJSEngine *get(int handle) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (handle < 0 || handle >= static_cast<int>(engines.size()) || !busy[handle]) {
+            return nullptr;
+        }
+        return engines[handle].get();
+    }
+
+    int size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return static_cast<int>(engines.size());
+    }
+
+    // Visit one engine without leasing it; fn may only touch thread-safe state
+    // Returns false if there is no such engine
+    template <typename Fn>
+    bool visit(int handle, Fn fn) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (handle < 0 || handle >= static_cast<int>(engines.size())) {
+            return false;
+        }
+        fn(engines[handle].get());
+        return true;
+    }
+
+    // Visit every engine without leasing it; fn may only touch thread-safe state
+    template <typename Fn>
+    void inspect(Fn fn) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &engine : engines) {
+            fn(engine.get());
+        }
+    }
+
+    bool isInitialized() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return !engines.empty() &&
+               std::all_of(engines.begin(), engines.end(), [](const std::unique_ptr<QuickJSEngine> &e) {
+                   return e->isInitialized() || e->isHibernated();
+               });
+    }
+
+private:
+    // Runs on the collector thread once the engine has been idle for the delay
+    // Collections in the allocation path remain as the fallback for engines
+    // that are never idle long enough, as does building a realm on demand
+    void collectIdle(int handle) {
+        if (!tryAcquire(handle)) {
+            return;  // Leased again; rescheduled as that lease ends
+        }
+        if (QuickJSEngine *engine = get(handle)) {
+            if (engine->garbageEstimate() >= IDLE_GC_MIN_GARBAGE) {
+                engine->collectGarbage();
+            }
+            engine->prepareSpareRealm();
+        }
+        release(handle);
+    }
+
+    void cleanupLocked() {
+        for (auto &engine : engines) {
+            engine->cleanup();
+        }
+        engines.clear();
+        busy.clear();
+    }
+
+    std::mutex mutex;
+    std::condition_variable available;
+    std::vector<std::unique_ptr<QuickJSEngine>> engines;
+    std::vector<bool> busy;
+    IdleCollector idleCollector;
+};
+
+// Scoped lease on a pooled engine
+class EngineLease {
+public:
+    // Lease the given engine, waiting for it if another thread holds it
+    explicit EngineLease(QuickJSEnginePool &pool, int handle, bool restore = true) : pool(pool), handle(-1) {
+        if (pool.acquire(handle, restore)) {
+            this->handle = handle;
+        }
+    }
+
+    ~EngineLease() {
+        if (handle >= 0) {
+            pool.release(handle);
+        }
+    }
+
+    EngineLease(const EngineLease &) = delete;
+    EngineLease &operator=(const EngineLease &) = delete;
+
+    QuickJSEngine *engine() const {
+        return handle >= 0 ? pool.get(handle) : nullptr;
+    }
+
+private:
+    QuickJSEnginePool &pool;
+    int handle;
+};
+
+static QuickJSEnginePool g_enginePool;
+
+// Lease every pooled engine in turn, waiting for busy ones
+// Hibernated engines are not restored; fn must cope with their missing context
+template <typename Fn>
+static void forEachEngine(QuickJSEnginePool &pool, Fn fn) {
+    int count = pool.size();
+    for (int i = 0; i < count; i++) {
+        EngineLease lease(pool, i, false);
+        if (QuickJSEngine *engine = lease.engine()) {
+            fn(engine);
+        }
+    }
+}
+
+// Native thread running worker scripts on an engine of its own
+// The thread runs one script at a time and is reused once it ends; the
+// engine keeps its runtime across scripts, with a fresh context for each.
+// A job counter tells the scripts apart, so a late message or terminate() for
+// an ended script never reaches the next one.
+class WorkerThread {
+public:
+    WorkerThread(int id, bool useSlabAllocator)
+        : engine(id, useSlabAllocator, false, true), ready(false), failed(false), stopping(false),
+          job(0), pending(false), running(false), accepting(false), parent(nullptr), workerId(0) {
+    }
+
+    ~WorkerThread() {
+        stop();
+    }
+
+    WorkerThread(const WorkerThread &) = delete;
+    WorkerThread &operator=(const WorkerThread &) = delete;
+
+    // Start the thread; returns once its engine is initialized, or false if that failed
+    bool start() {
+        thread = std::thread(&WorkerThread::run, this);
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return ready || failed; });
+        return ready;
+    }
+
+    // Stop and join the thread, cancelling a running script
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            if (running) {
+                engine.cancel(job);
+            }
+        }
+        changed.notify_all();
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    // Hand the thread a worker script of parent if it is idle
+    // Stores the job to address the script by
+    bool tryAssign(const std::string &script, QuickJSEngine *parent, uint32_t workerId, uint64_t *assigned) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!ready || stopping || running || !engine.isInitialized()) {
+                return false;
+            }
+            engine.resetExecutionLimits(false);
+            job = engine.setExecutionTimeout(0);
+            source = script;
+            this->parent = parent;
+            this->workerId = workerId;
+            pending = true;
+            running = true;
+            accepting = true;
+            *assigned = job;
+        }
+        changed.notify_all();
+        return true;
+    }
+
+    // Queue a message for the script of job; dropped if that script has ended
+    void post(uint64_t job, std::unique_ptr<WorkerMessage> message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (job == this->job && accepting) {
+            engine.postWorkerEvent(0, WORKER_MESSAGE, std::move(message));
+        }
+    }
+
+    // Stop the script of job and wait until it has ended
+    void terminate(uint64_t job) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (job != this->job) {
+            return;
+        }
+        engine.cancel(job);
+        changed.wait(lock, [this, job] { return job != this->job || !running; });
+    }
+
+private:
+    void run() {
+        bool initialized = engine.initialize();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready = initialized;
+            failed = !initialized;
+        }
+        changed.notify_all();
+        if (!initialized) {
+            return;
+        }
+
+        for (;;) {
+            std::string script;
+            QuickJSEngine *owner;
+            uint32_t id;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this] { return stopping || pending; });
+                if (stopping) {
+                    running = false;
+                    break;
+                }
+                pending = false;
+                script.swap(source);
+                owner = parent;
+                id = workerId;
+            }
+
+            engine.runWorker(script, owner, id);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                accepting = false;
+            }
+            engine.finishWorker();
+            owner->postWorkerEvent(id, WORKER_EXIT, nullptr);
+            {
+                // The parent may go away as soon as this is seen
+                std::lock_guard<std::mutex> lock(mutex);
+                running = false;
+            }
+            changed.notify_all();
+        }
+        changed.notify_all();
+        engine.cleanup();
+    }
+
+    QuickJSEngine engine;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool ready;
+    bool failed;
+    bool stopping;
+
+    // Current script; running until it has ended, accepting messages until
+    // it stops delivering them
+    uint64_t job;
+    bool pending;
+    bool running;
+    bool accepting;
+    std::string source;
+    QuickJSEngine *parent;
+    uint32_t workerId;
+};
+
+// Worker threads shared by every engine, started on demand
+// Threads stay around once started, to run later workers without paying for
+// a thread and a runtime each time.
+class QuickJSWorkerPool {
+public:
+    static constexpr int MAX_WORKERS = 16;
+    // Worker engine ids follow the pooled engines', so logs tell them apart
+    static constexpr int FIRST_WORKER_ID = QuickJSEnginePool::MAX_ENGINES;
+
+    void configure(bool useSlabAllocator) {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->useSlabAllocator = useSlabAllocator;
+    }
+
+    // Start script on an idle thread, or a new one; stores the job to address it by
+    // Returns nullptr when all MAX_WORKERS threads are busy
+    WorkerThread *start(const std::string &script, QuickJSEngine *parent, uint32_t workerId, uint64_t *job) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &thread : threads) {
+            if (thread->tryAssign(script, parent, workerId, job)) {
+                return thread.get();
+            }
+        }
+        if (threads.size() >= MAX_WORKERS) {
+            return nullptr;
+        }
+
+        int id = FIRST_WORKER_ID + static_cast<int>(threads.size());
+        std::unique_ptr<WorkerThread> thread(new WorkerThread(id, useSlabAllocator));
+        if (!thread->start()) {
+            LOGE("Failed to start worker engine %d", id);
+            return nullptr;
+        }
+        threads.push_back(std::move(thread));
+        return threads.back()->tryAssign(script, parent, workerId, job) ? threads.back().get() : nullptr;
+    }
+
+    // Stop every thread; their workers must have been terminated by their parents
+    void cleanup() {
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.clear();
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<std::unique_ptr<WorkerThread>> threads;
+    bool useSlabAllocator = false;
+};
+
+static QuickJSWorkerPool g_workerPool;
+
+JSValue QuickJSEngine::startWorker(JSContext *ctx, JSValueConst newTarget, const std::string &source) {
+    JSValue proto = JS_GetPropertyStr(ctx, newTarget, "prototype");
+    if (JS_IsException(proto)) {
+        return proto;
+    }
+    JSValue object = JS_NewObjectProtoClass(ctx, proto, g_workerClassId);
+    JS_FreeValue(ctx, proto);
+    if (JS_IsException(object)) {
+        return object;
+    }
+
+    uint32_t workerId = nextWorkerId++;
+    uint64_t job;
+    WorkerThread *thread = g_workerPool.start(source, this, workerId, &job);
+    if (!thread) {
+        JS_FreeValue(ctx, object);
+        return JS_ThrowRangeError(ctx, "Too many workers (at most %d)", QuickJSWorkerPool::MAX_WORKERS);
+    }
+    JS_SetOpaque(object, reinterpret_cast<void *>(static_cast<uintptr_t>(workerId)));
+    workers[workerId] = WorkerEntry{JS_DupValue(ctx, object), thread, job};
+    return object;
+}
+
+JSValue QuickJSEngine::postToWorker(JSContext *ctx, uint32_t workerId, JSValueConst value, JSValueConst transfer) {
+    auto it = workers.find(workerId);
+    if (it == workers.end()) {
+        return JS_UNDEFINED;  // Ended or terminated
+    }
+    std::unique_ptr<WorkerMessage> message(new WorkerMessage());
+    if (!message->write(ctx, this, value, transfer)) {
+        return JS_EXCEPTION;
+    }
+    buffersAway.fetch_add(message->transfersFrom(this), std::memory_order_relaxed);
+    it->second.thread->post(it->second.job, std::move(message));
+    return JS_UNDEFINED;
+}
+
+void QuickJSEngine::terminateWorker(uint32_t workerId) {
+    auto it = workers.find(workerId);
+    if (it == workers.end()) {
+        return;
+    }
+    WorkerEntry entry = it->second;
+    workers.erase(it);
+    entry.thread->terminate(entry.job);
+    JS_FreeValue(context, entry.object);
+}
+
+void QuickJSEngine::terminateWorkers() {
+    while (!workers.empty()) {
+        terminateWorker(workers.begin()->first);
+    }
+}
+
+// Worker id of a Worker object, or 0 with an exception pending
+static uint32_t getWorkerId(JSContext *ctx, JSValueConst this_val) {
+    return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(JS_GetOpaque2(ctx, this_val, g_workerClassId)));
+}
+
+// new Worker(source): run the script source on a worker thread
+static JSValue js_worker_ctor(JSContext *ctx, JSValueConst new_target, int argc, JSValueConst *argv) {
+    QuickJSEngine *engine = static_cast<QuickJSEngine *>(JS_GetContextOpaque(ctx));
+    if (!engine) {
+        return JS_ThrowInternalError(ctx, "Workers not available");
+    }
+    const char *source = argc > 0 ? JS_ToCString(ctx, argv[0]) : nullptr;
+    if (!source) {
+        return argc > 0 ? JS_EXCEPTION : JS_ThrowTypeError(ctx, "Worker source must be a string");
+    }
+    std::string script(source);
+    JS_FreeCString(ctx, source);
+    return engine->startWorker(ctx, new_target, script);
+}
+
+// worker.postMessage(value, transfer)
+static JSValue js_worker_post_message(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    QuickJSEngine *engine = static_cast<QuickJSEngine *>(JS_GetContextOpaque(ctx));
+    uint32_t workerId = getWorkerId(ctx, this_val);
+    if (!workerId) {
+        return JS_EXCEPTION;
+    }
+    return engine->postToWorker(ctx, workerId, argc > 0 ? argv[0] : JS_UNDEFINED,
+                                argc > 1 ? argv[1] : JS_UNDEFINED);
+}
+
+// worker.terminate()
+static JSValue js_worker_terminate(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    QuickJSEngine *engine = static_cast<QuickJSEngine *>(JS_GetContextOpaque(ctx));
+    uint32_t workerId = getWorkerId(ctx, this_val);
+    if (!workerId) {
+        return JS_EXCEPTION;
+    }
+    engine->terminateWorker(workerId);
+    return JS_UNDEFINED;
+}
+
+// postMessage(value, transfer) in a worker script
+static JSValue js_worker_scope_post_message(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    QuickJSEngine *engine = static_cast<QuickJSEngine *>(JS_GetContextOpaque(ctx));
+    return engine->postToParent(ctx, argc > 0 ? argv[0] : JS_UNDEFINED, argc > 1 ? argv[1] : JS_UNDEFINED);
+}
+
+// close() in a worker script
+static JSValue js_worker_scope_close(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    QuickJSEngine *engine = static_cast<QuickJSEngine *>(JS_GetContextOpaque(ctx));
+    engine->closeWorker();
+    return JS_UNDEFINED;
+}
+
+// Open bytecode bundles, addressed from Kotlin by handle
+// Executions hold a shared reference, so closing a bundle never unmaps it
+// underneath a running deserialization.
+static std::mutex g_bundlesMutex;
+static std::map<jlong, std::shared_ptr<BytecodeBundle>> g_bundles;
+static jlong g_nextBundleHandle = 1;
+
+static jlong registerBundle(BytecodeBundle *bundle) {
+    if (!bundle) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(g_bundlesMutex);
+    jlong handle = g_nextBundleHandle++;
+    g_bundles[handle] = std::shared_ptr<BytecodeBundle>(bundle);
+    return handle;
+}
+
+static std::shared_ptr<BytecodeBundle> findBundle(jlong handle) {
+    std::lock_guard<std::mutex> lock(g_bundlesMutex);
+    auto it = g_bundles.find(handle);
+    return it != g_bundles.end() ? it->second : nullptr;
+}
+
+// Bundles that imports are resolved against, searched in the order added
+// Guarded by g_bundlesMutex
+static std::vector<std::pair<jlong, std::shared_ptr<BytecodeBundle>>> g_moduleBundles;
+
+// Read a script or module of a bundle in ctx, through the atom table of the
+// bundle that ctx's engine keeps; contexts without an engine read it each time
+static JSValue readBundleEntry(JSContext *ctx, jlong bundleHandle, const std::shared_ptr<BytecodeBundle> &bundle,
+                               const uint8_t *bytecodeData, size_t bytecodeLength) {
+    QuickJSEngine *engine = static_cast<QuickJSEngine *>(JS_GetContextOpaque(ctx));
+    JSAtomTable *atoms = nullptr;
+    bool ownAtoms = false;
+    const uint8_t *atomData;
+    size_t atomLength;
+    if (engine) {
+        if (!engine->bundleAtomTable(ctx, bundleHandle, bundle, &atoms)) {
+            return JS_EXCEPTION;
+        }
+    } else if (bundle->atomTable(&atomData, &atomLength)) {
+        atoms = JS_ReadAtomTable(ctx, atomData, atomLength);
+        if (!atoms) {
+            return JS_EXCEPTION;
+        }
+        ownAtoms = true;
+    }
+    
+    JSValue value = atoms
+        ? JS_ReadObjectWithAtomTable(ctx, bytecodeData, bytecodeLength, JS_READ_OBJ_BYTECODE, atoms)
+        : JS_ReadObject(ctx, bytecodeData, bytecodeLength, JS_READ_OBJ_BYTECODE);
+    if (ownAtoms) {
+        JS_FreeAtomTable(JS_GetRuntime(ctx), atoms);
+    }
+    return value;
+}
+
+// Module loader of every runtime: modules are read from the module bundles the
+// first time a context imports them, and the context keeps them from then on
+// Specifiers are normalized the QuickJS way, relative ones against the
+// importing module's id, so bundled modules can import each other.
+static JSModuleDef *loadBundledModule(JSContext *ctx, const char *moduleName, void *opaque) {
+    std::shared_ptr<BytecodeBundle> bundle;
+    jlong bundleHandle = 0;
+    const uint8_t *bytecodeData = nullptr;
+    size_t bytecodeLength = 0;
+    {
+        std::lock_guard<std::mutex> lock(g_bundlesMutex);
+        for (auto &entry : g_moduleBundles) {
+            if (entry.second->find(moduleName, &bytecodeData, &bytecodeLength)) {
+                bundleHandle = entry.first;
+                bundle = entry.second;
+                break;
+            }
+        }
+    }
+    if (!bundle) {
+        JS_ThrowReferenceError(ctx, "Module not found: %s", moduleName);
+        return nullptr;
+    }
+    
+    TraceSection trace("QuickJS loadModule");
+    JSValue module = readBundleEntry(ctx, bundleHandle, bundle, bytecodeData, bytecodeLength);
+    if (JS_IsException(module)) {
+        return nullptr;
+    }
+    if (JS_VALUE_GET_TAG(module) != JS_TAG_MODULE) {
+        JS_FreeValue(ctx, module);
+        JS_ThrowTypeError(ctx, "Bundle entry is a script, not a module: %s", moduleName);
+        return nullptr;
+    }
+    // The context holds the module once read, so the value's reference is dropped
+    JSModuleDef *def = static_cast<JSModuleDef *>(JS_VALUE_GET_PTR(module));
+    JS_FreeValue(ctx, module);
+    return def;
+}
+
+// Compile source to serialized bytecode in the given engine's context
+// Returns a buffer owned by the engine's context (release with js_free), or nullptr
+// source must be NUL terminated at sourceLength, as JS_Eval() requires
+// With atoms, the bytecode's atoms are added to that table instead of being written
+static uint8_t *compileToBytecode(QuickJSEngine *engine, const char *source, size_t sourceLength,
+                                  const char *filename, size_t *bytecodeSize, bool module = false,
+                                  JSAtomTable *atoms = nullptr) {
+    JSContext *context = engine->getContext();
+    if (!context) {
+        LOGE("Failed to get QuickJS context");
+        return nullptr;
+    }
+    JS_UpdateStackTop(JS_GetRuntime(context));
+    TraceSection trace("QuickJS compileToBytecode");
+    
+    // Modules are named by filename, which imports of them must normalize to.
+    // They are compiled unresolved, as what they import may not be bundled
+    // yet, in a context of their own so the engine's never holds them.
+    int flags = JS_EVAL_FLAG_COMPILE_ONLY;
+    if (module) {
+        context = JS_NewContext(JS_GetRuntime(context));
+        if (!context) {
+            LOGE("Failed to create module compilation context");
+            return nullptr;
+        }
+        flags |= JS_EVAL_TYPE_MODULE | JS_EVAL_FLAG_NO_RESOLVE;
+    }
+    
+    // Compile script to bytecode using QuickJS API
+    JSValue compiledObj = JS_Eval(context, source, sourceLength, filename, flags);
+    
+    uint8_t *bytecodeData = nullptr;
+    if (JS_IsException(compiledObj)) {
+        // Handle compilation error
+        JSValue exception = JS_GetException(context);
+        const char *errorStr = JS_ToCString(context, exception);
+        LOGE("Bytecode compilation failed: %s", errorStr ? errorStr : "Unknown error");
+        if (errorStr) JS_FreeCString(context, errorStr);
+        JS_FreeValue(context, exception);
+    } else {
+        // Serialize compiled object to bytecode
+        bytecodeData = atoms
+            ? JS_WriteObjectWithAtomTable(context, bytecodeSize, compiledObj, JS_WRITE_OBJ_BYTECODE, atoms)
+            : JS_WriteObject(context, bytecodeSize, compiledObj, JS_WRITE_OBJ_BYTECODE);
+        if (!bytecodeData) {
+            LOGE("Failed to serialize bytecode");
+        }
+    }
+    JS_FreeValue(context, compiledObj);
+    
+    if (module) {
+        // The buffer belongs to the runtime, so the engine's context can free it
+        JS_FreeContext(context);
+    }
+    return bytecodeData;
+}
+
+// Compile a script to a Java byte array of bytecode in the given engine's context
+static jbyteArray compileScriptToBytecode(JNIEnv *env, QuickJSEngine *engine, jstring script) {
+    if (!engine || !engine->isInitialized()) {
+        LOGE("QuickJS not initialized for compilation");
+        return nullptr;
+    }
+    
+    const char *scriptStr = env->GetStringUTFChars(script, nullptr);
+    if (!scriptStr) {
+        LOGE("Failed to get script string");
+        return nullptr;
+    }
+    
+    LOGV("Compiling JavaScript to real QuickJS bytecode");
+    
+    size_t bytecodeSize;
+    uint8_t *bytecodeData = compileToBytecode(engine, scriptStr, strlen(scriptStr), "<bytecode>", &bytecodeSize);
+    
+    env->ReleaseStringUTFChars(script, scriptStr);
+    
+    if (!bytecodeData) {
+        return nullptr;
+    }
+    
+    // Create Java byte array
+    jbyteArray result = env->NewByteArray(bytecodeSize);
+    if (result) {
+        env->SetByteArrayRegion(result, 0, bytecodeSize, 
+            reinterpret_cast<const jbyte*>(bytecodeData));
+        LOGV("Real bytecode created: %zu bytes", bytecodeSize);
+    } else {
+        LOGE("Failed to create Java byte array");
+    }
+    
+    // Free the bytecode data
+    js_free(engine->getContext(), bytecodeData);
+    
+    return result;
+}
+
+// Execute serialized bytecode in the given engine's context, read as an entry
+// of bundle if one is given
+// The buffer is only read during deserialization and is not retained
+static jstring executeBytecodeBuffer(JNIEnv *env, QuickJSEngine *engine,
+                                     const uint8_t *bytecodeData, size_t bytecodeLength,
+                                     const std::shared_ptr<BytecodeBundle> &bundle = nullptr,
+                                     jlong bundleHandle = 0) {
+    if (!engine || !engine->isInitialized()) {
+        LOGE("QuickJS not initialized for bytecode execution");
+        return env->NewStringUTF("Error: QuickJS not initialized");
+    }
+    
+    LOGV("Executing real QuickJS bytecode");
+    
+    JSContext *context = engine->getContext();
+    if (!context) {
+        LOGE("Failed to get QuickJS context");
+        return env->NewStringUTF("Error: Failed to get QuickJS context");
+    }
+    JS_UpdateStackTop(JS_GetRuntime(context));
+    TraceSection trace("QuickJS executeBytecode");
+    
+    // Deserialize bytecode to JSValue
+    JSValue compiledObj;
+    {
+        PhaseTimer timer(engine->getCounters(), ExecutionCounters::COMPILE_NS);
+        compiledObj = bundle
+            ? readBundleEntry(context, bundleHandle, bundle, bytecodeData, bytecodeLength)
+            : JS_ReadObject(context, bytecodeData, bytecodeLength, JS_READ_OBJ_BYTECODE);
+    }
+    
+    if (JS_IsException(compiledObj)) {
+        JSValue exception = JS_GetException(context);
+        const char *errorStr = JS_ToCString(context, exception);
+        LOGE("Bytecode deserialization failed: %s", errorStr ? errorStr : "Unknown error");
+        std::string error = "Error: Bytecode deserialization failed";
+        if (errorStr) {
+            error += ": ";
+            error += errorStr;
+            JS_FreeCString(context, errorStr);
+        }
+        JS_FreeValue(context, exception);
+        JS_FreeValue(context, compiledObj);
+        return env->NewStringUTF(error.c_str());
+    }
+    
+    // Modules are bundled unresolved; loading what they import may throw
+    if (JS_VALUE_GET_TAG(compiledObj) == JS_TAG_MODULE && JS_ResolveModule(context, compiledObj) < 0) {
+        JS_FreeValue(context, compiledObj);
+        return env->NewStringUTF(engine->describeException("Error: Module resolution failed: ").c_str());
+    }
+    
+    // Execute the bytecode function
+    JSValue result = engine->evalFunction(compiledObj);
+    
+    if (JS_IsException(result) && engine->isInterrupted()) {
+        return env->NewStringUTF(engine->describeException("").c_str());
+    }
+    if (JS_IsException(result)) {
+        // Handle execution error
+        JSValue exception = JS_GetException(context);
+        const char *errorStr = JS_ToCString(context, exception);
+        LOGE("Bytecode execution failed: %s", errorStr ? errorStr : "Unknown error");
+        std::string error = "Error: Bytecode execution failed";
+        if (errorStr) {
+            error += ": ";
+            error += errorStr;
+            JS_FreeCString(context, errorStr);
+        }
+        JS_FreeValue(context, exception);
+        JS_FreeValue(context, result);
+        return env->NewStringUTF(error.c_str());
+    }
+    
+    // Wait for promises if needed (same as regular execution)
+    result = engine->awaitResult(result);
+    
+    if (JS_IsException(result) && engine->isInterrupted()) {
+        return env->NewStringUTF(engine->describeException("").c_str());
+    }
+    // Check if awaiting resulted in an exception (promise rejection)
+    if (JS_IsException(result)) {
+        JSValue exception = JS_GetException(context);
+        const char *errorStr = JS_ToCString(context, exception);
+        LOGE("Bytecode promise rejection: %s", errorStr ? errorStr : "Unknown error");
+        std::string error = "Promise Rejection: ";
+        if (errorStr) {
+            error += errorStr;
+            JS_FreeCString(context, errorStr);
+        } else {
+            error += "Unknown error";
+        }
+        JS_FreeValue(context, exception);
+        JS_FreeValue(context, result);
+        return env->NewStringUTF(error.c_str());
+    }
+    
+    // Convert result to string
+    const char *resultStr = JS_ToCString(context, result);
+    std::string resultString;
+    if (resultStr) {
+        resultString = resultStr;
+        JS_FreeCString(context, resultStr);
+    } else {
+        resultString = "undefined";
+    }
+    
+    JS_FreeValue(context, result);
+    
+    LOGV("Bytecode execution result: %s", resultString.c_str());
+    return env->NewStringUTF(resultString.c_str());
+}
+
+// Execute bytecode from a Java byte array in the given engine's context
+static jstring executeBytecodeOnEngine(JNIEnv *env, QuickJSEngine *engine, jbyteArray bytecode) {
+    if (!engine || !engine->isInitialized()) {
+        LOGE("QuickJS not initialized for bytecode execution");
+        return env->NewStringUTF("Error: QuickJS not initialized");
+    }
+    
+    if (!bytecode) {
+        LOGE("Null bytecode provided");
+        return env->NewStringUTF("Error: Null bytecode");
+    }
+    
+    jsize bytecodeLength = env->GetArrayLength(bytecode);
+    if (bytecodeLength <= 0) {
+        LOGE("Empty bytecode provided");
+        return env->NewStringUTF("Error: Empty bytecode");
+    }
+    
+    // Get bytecode data
+    jbyte* bytecodeData = env->GetByteArrayElements(bytecode, nullptr);
+    if (!bytecodeData) {
+        LOGE("Failed to get bytecode data");
+        return env->NewStringUTF("Error: Failed to get bytecode data");
+    }
+    
+    jstring result = executeBytecodeBuffer(env, engine,
+        reinterpret_cast<const uint8_t*>(bytecodeData), bytecodeLength);
+    env->ReleaseByteArrayElements(bytecode, bytecodeData, JNI_ABORT);
+    return result;
+}
+
+// Execute a script from a bytecode bundle straight out of its mapping
+static jstring executeBundleScriptOnEngine(JNIEnv *env, QuickJSEngine *engine,
+                                           jlong bundleHandle, jstring scriptId) {
+    std::shared_ptr<BytecodeBundle> bundle = findBundle(bundleHandle);
+    if (!bundle) {
+        return env->NewStringUTF("Error: Invalid bytecode bundle");
+    }
+    
+    const char *idStr = env->GetStringUTFChars(scriptId, nullptr);
+    std::string id(idStr ? idStr : "");
+    if (idStr) env->ReleaseStringUTFChars(scriptId, idStr);
+    
+    const uint8_t *bytecodeData;
+    size_t bytecodeLength;
+    if (!bundle->find(id, &bytecodeData, &bytecodeLength)) {
+        LOGE("Script not found in bundle: %s", id.c_str());
+        return env->NewStringUTF(("Error: Script not found in bundle: " + id).c_str());
+    }
+    return executeBytecodeBuffer(env, engine, bytecodeData, bytecodeLength, bundle, bundleHandle);
+}
+
+// Execute a script in the given engine's context
+static jstring executeScriptOnEngine(JNIEnv *env, QuickJSEngine *engine, jstring script) {
+    if (!engine) {
+        return env->NewStringUTF("Error: QuickJS not initialized");
+    }
+    
+    const char* scriptStr = env->GetStringUTFChars(script, nullptr);
+    std::string result = engine->executeScript(std::string(scriptStr));
+    env->ReleaseStringUTFChars(script, scriptStr);
+    
+    return env->NewStringUTF(result.c_str());
+}
+
+// Async script executions, driven by the shared event loop while their promise is pending
+// The execution owns its engine lease until the result is delivered
+struct AsyncExecution {
+    int handle;
+    jlong callbackId;
+    JSValue promise;
+};
+
+static EventLoop g_eventLoop;
+
+// Hand an async execution result to Kotlin
+static void deliverScriptResult(JNIEnv *env, jlong callbackId, const std::string &result) {
+    if (!g_quickjsBridgeInstance || !g_scriptResultMethod) {
+        LOGE("Dropping result of async execution %lld: no callback", static_cast<long long>(callbackId));
+        return;
+    }
+    
+    jstring jResult = env->NewStringUTF(result.c_str());
+    env->CallVoidMethod(g_quickjsBridgeInstance, g_scriptResultMethod, callbackId, jResult);
+    env->DeleteLocalRef(jResult);
+    
+    if (env->ExceptionCheck()) {
+        LOGE("Async execution callback %lld threw", static_cast<long long>(callbackId));
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+    }
+}
+
+// Return the engine to the pool, then deliver the settled result
+static void finishAsyncExecution(JNIEnv *env, QuickJSEngine *engine, int handle,
+                                 jlong callbackId, JSValue result) {
+    std::string resultString = engine->describeResult(result);
+    g_enginePool.release(handle);
+    deliverScriptResult(env, callbackId, resultString);
+}
+
+// Event loop callback: an engine with a pending async execution has work to do
+static int onAsyncExecutionEvent(int fd, int events, void *data) {
+    AsyncExecution *execution = static_cast<AsyncExecution *>(data);
+    QuickJSEngine *engine = g_enginePool.get(execution->handle);
+    if (!engine) {
+        LOGE("Async execution lost its engine %d", execution->handle);
+        delete execution;
+        return 0;
+    }
+    
+    JS_UpdateStackTop(engine->runtime);
+    engine->drainWakeFds();
+    
+    JSValue result;
+    if (!engine->advanceResult(execution->promise, &result)) {
+        return 1;  // Still pending, keep watching
+    }
+    
+    // Unregister before giving up the lease: the next lessee may watch this fd again
+    g_eventLoop.removeFd(fd);
+    
+    JNIEnv *env = nullptr;
+    if (g_jvm && g_jvm->GetEnv((void**)&env, JNI_VERSION_1_6) == JNI_OK) {
+        finishAsyncExecution(env, engine, execution->handle, execution->callbackId, result);
+    } else {
+        LOGE("Event loop thread is not attached to the JVM");
+        JS_FreeValue(engine->getContext(), result);
+        g_enginePool.release(execution->handle);
+    }
+    delete execution;
+    return 1;
+}
+
+// Copy an encoded result, or several back to back, into a Java byte array
+static jbyteArray newEncodedArray(JNIEnv *env, const std::vector<uint8_t> &encoded) {
+    jbyteArray result = env->NewByteArray(static_cast<jsize>(encoded.size()));
+    if (result) {
+        env->SetByteArrayRegion(result, 0, static_cast<jsize>(encoded.size()),
+                                reinterpret_cast<const jbyte*>(encoded.data()));
+    }
+    return result;
+}
+
+// Execute a script in the given engine's context and return the encoded result
+static jbyteArray executeScriptEncodedOnEngine(JNIEnv *env, QuickJSEngine *engine, jstring script) {
+    std::vector<uint8_t> encoded;
+    if (!engine) {
+        ValueCodec::encodeHostError("Engine not leased", encoded);
+    } else {
+        const char *scriptStr = env->GetStringUTFChars(script, nullptr);
+        encoded = engine->executeScriptEncoded(std::string(scriptStr));
+        env->ReleaseStringUTFChars(script, scriptStr);
+    }
+    return newEncodedArray(env, encoded);
+}
+
+// Execute scripts one after another in the given engine's context
+// Returns the encoded results back to back, in script order
+static jbyteArray executeBatchEncodedOnEngine(JNIEnv *env, QuickJSEngine *engine, jobjectArray scripts) {
+    jsize count = env->GetArrayLength(scripts);
+    std::vector<uint8_t> encoded;
+    if (!engine) {
+        for (jsize i = 0; i < count; i++) {
+            ValueCodec::encodeHostError("Engine not leased", encoded);
+        }
+        return newEncodedArray(env, encoded);
+    }
+    
+    std::vector<std::string> sources;
+    sources.reserve(count);
+    for (jsize i = 0; i < count; i++) {
+        jstring script = static_cast<jstring>(env->GetObjectArrayElement(scripts, i));
+        const char *scriptStr = env->GetStringUTFChars(script, nullptr);
+        sources.emplace_back(scriptStr ? scriptStr : "");
+        if (scriptStr) env->ReleaseStringUTFChars(script, scriptStr);
+        env->DeleteLocalRef(script);
+    }
+    return newEncodedArray(env, engine->executeBatchEncoded(sources));
+}
+
+// Scheduler of script jobs that leave the choice of engine to native code
+// Every pooled engine has a thread and a queue per priority lane; the default
+// engine has neither, so jobs never touch its globals. A job is
+// queued on the engine that last ran the same source, whose script cache most
+// likely still holds it compiled, unless that engine is backed up; a thread
+// out of work of its own steals from the longest queue, taking the job that
+// would have waited there longest. Every thread runs user jobs before
+// background ones.
+class QuickJSJobScheduler {
+public:
+    enum Lane { LANE_USER = 0, LANE_BACKGROUND = 1, LANE_COUNT };
+
+    // Jobs an engine may have beyond the least loaded one and still get the
+    // sources it ran last
+    static constexpr size_t AFFINITY_SLACK = 2;
+    // Sources whose engine is remembered; forgotten all at once past this
+    static constexpr size_t AFFINITY_CAPACITY = 1024;
+
+    // Start a thread per engine, from handle firstEngine up to engineCount
+    void start(JavaVM *vm, int firstEngine, int engineCount) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!workers.empty()) {
+            return;
+        }
+        stopping = false;
+        for (int handle = firstEngine; handle < engineCount; handle++) {
+            workers.emplace_back(new Worker());
+            workers.back()->handle = handle;
+        }
+        for (size_t i = 0; i < workers.size(); i++) {
+            workers[i]->thread = std::thread(&QuickJSJobScheduler::run, this, vm, static_cast<int>(i));
+        }
+    }
+
+    // Stop and join every thread, cancelling running jobs
+    // Queued jobs are dropped with an error result
+    void stop(JNIEnv *env) {
+        std::vector<std::unique_ptr<Job>> dropped;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            for (auto &worker : workers) {
+                for (auto &lane : worker->lanes) {
+                    for (auto &job : lane) {
+                        dropped.push_back(std::move(job));
+                    }
+                    lane.clear();
+                }
+                if (worker->engine) {
+                    worker->engine->cancel(worker->serial);
+                }
+                worker->idle = false;
+                worker->wakeup.notify_one();
+            }
+        }
+        for (auto &worker : workers) {
+            worker->thread.join();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            workers.clear();
+            affinity.clear();
+        }
+        for (auto &job : dropped) {
+            deliverScriptResult(env, job->callbackId, "Error: Job scheduler stopped");
+        }
+    }
+
+    // Queue a script; its result is passed to onScriptResult() from the thread
+    // that runs it
+    // Returns the id to cancel the job by, or 0 if the scheduler is not running
+    uint64_t submit(const std::string &source, Lane lane, int64_t timeoutMs, jlong callbackId) {
+        std::unique_ptr<Job> job(new Job{0, ScriptCache::hashSource(source), source, timeoutMs,
+                                         callbackId, false});
+        std::lock_guard<std::mutex> lock(mutex);
+        if (workers.empty() || stopping) {
+            return 0;
+        }
+        job->id = ++lastJobId;
+        int target = pickEngine(job->key);
+        uint64_t id = job->id;
+        workers[target]->lanes[lane].push_back(std::move(job));
+        wakeFor(target);
+        return id;
+    }
+
+    // Drop a queued job, delivering an error result for it, or stop it if running
+    // Returns false for jobs that have finished
+    bool cancel(JNIEnv *env, uint64_t id) {
+        std::unique_ptr<Job> dropped;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto &worker : workers) {
+                if (worker->running && worker->running->id == id) {
+                    worker->running->cancelled = true;
+                    if (worker->engine) {
+                        worker->engine->cancel(worker->serial);
+                    }
+                    return true;
+                }
+                for (auto &lane : worker->lanes) {
+                    auto it = std::find_if(lane.begin(), lane.end(),
+                                           [id](const std::unique_ptr<Job> &job) { return job->id == id; });
+                    if (it != lane.end()) {
+                        dropped = std::move(*it);
+                        lane.erase(it);
+                        break;
+                    }
+                }
+                if (dropped) {
+                    break;
+                }
+            }
+        }
+        if (!dropped) {
+            return false;
+        }
+        deliverScriptResult(env, dropped->callbackId, "Error: Execution cancelled");
+        return true;
+    }
+
+private:
+    struct Job {
+        uint64_t id;
+        uint64_t key;           // ScriptCache::hashSource() of source
+        std::string source;
+        int64_t timeoutMs;
+        jlong callbackId;
+        bool cancelled;
+    };
+
+    // State of one engine's thread, guarded by the scheduler mutex
+    // Workers are indexed from 0; handle is the pool handle of their engine
+    struct Worker {
+        int handle = -1;
+        std::deque<std::unique_ptr<Job>> lanes[LANE_COUNT];
+        std::thread thread;
+        std::condition_variable wakeup;
+        bool idle = false;              // Waiting; cleared by whoever wakes it
+        Job *running = nullptr;
+        QuickJSEngine *engine = nullptr;  // Leased for running, once its limits are set
+        uint64_t serial = 0;
+    };
+
+    size_t load(int index) const {
+        const Worker &worker = *workers[index];
+        return worker.lanes[LANE_USER].size() + worker.lanes[LANE_BACKGROUND].size() +
+               (worker.running ? 1 : 0);
+    }
+
+    // Index of the worker to queue the job of key on
+    int pickEngine(uint64_t key) const {
+        int count = static_cast<int>(workers.size());
+        int least = 0;
+        for (int i = 1; i < count; i++) {
+            if (load(i) < load(least)) {
+                least = i;
+            }
+        }
+        auto it = affinity.find(key);
+        if (it != affinity.end() && load(it->second) <= load(least) + AFFINITY_SLACK) {
+            return it->second;
+        }
+        return least;
+    }
+
+    // Wake the thread a job was queued for, or any idle one to steal it
+    void wakeFor(int target) {
+        Worker *worker = workers[target].get();
+        if (!worker->idle) {
+            worker = nullptr;
+            for (auto &other : workers) {
+                if (other->idle) {
+                    worker = other.get();
+                    break;
+                }
+            }
+        }
+        if (worker) {
+            worker->idle = false;
+            worker->wakeup.notify_one();
+        }
+    }
+
+    // Next job for the thread of worker index: its own oldest job, else the
+    // newest of the longest other queue, user lane first
+    std::unique_ptr<Job> take(int index) {
+        std::unique_ptr<Job> job;
+        for (int lane = 0; lane < LANE_COUNT; lane++) {
+            auto &own = workers[index]->lanes[lane];
+            if (!own.empty()) {
+                job = std::move(own.front());
+                own.pop_front();
+                return job;
+            }
+            std::deque<std::unique_ptr<Job>> *victim = nullptr;
+            for (auto &other : workers) {
+                auto &queue = other->lanes[lane];
+                if (!queue.empty() && (!victim || queue.size() > victim->size())) {
+                    victim = &queue;
+                }
+            }
+            if (victim) {
+                job = std::move(victim->back());
+                victim->pop_back();
+                return job;
+            }
+        }
+        return job;
+    }
+
+    void run(JavaVM *vm, int index) {
+        Worker &self = *workers[index];
+        // Results are delivered to Kotlin, and scripts may issue HTTP requests
+        JNIEnv *env = nullptr;
+        if (vm && vm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+            LOGE("Job scheduler thread %d failed to attach to the JVM", self.handle);
+            env = nullptr;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            std::unique_ptr<Job> job = take(index);
+            if (!job) {
+                self.idle = true;
+                self.wakeup.wait(lock, [&self] { return !self.idle; });
+                continue;
+            }
+            self.running = job.get();
+            lock.unlock();
+
+            std::string result = execute(self, *job);
+            if (env) {
+                deliverScriptResult(env, job->callbackId, result);
+            }
+
+            lock.lock();
+            self.running = nullptr;
+            if (affinity.size() >= AFFINITY_CAPACITY) {
+                affinity.clear();
+            }
+            affinity[job->key] = index;
+        }
+        lock.unlock();
+
+        if (env) {
+            vm->DetachCurrentThread();
+        }
+    }
+
+    // Run job on the engine of self, waiting for it if leased elsewhere
+    std::string execute(Worker &self, Job &job) {
+        EngineLease lease(g_enginePool, self.handle);
+        QuickJSEngine *engine = lease.engine();
+        if (!engine) {
+            return "Error: QuickJS not initialized";
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            self.serial = engine->setExecutionTimeout(job.timeoutMs);
+            self.engine = engine;
+            if (job.cancelled || stopping) {
+                engine->cancel(self.serial);
+            }
+        }
+        std::string result = engine->executeScript(job.source);
+        {
+            // The lease ends with this scope, and with it what serial cancels
+            std::lock_guard<std::mutex> lock(mutex);
+            self.engine = nullptr;
+        }
+        return result;
+    }
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::unordered_map<uint64_t, int> affinity;  // Source key to the worker that last ran it
+    uint64_t lastJobId = 0;
+    bool stopping = false;
+};
+
+static QuickJSJobScheduler g_jobScheduler;
+
+extern "C" {
+
+// Initialize the QuickJS engine pool
+JNIEXPORT jboolean JNICALL
+Java_com_quickjs_android_QuickJSBridge_initializeQuickJS(JNIEnv *env, jobject thiz, jint poolSize,
+                                                         jboolean slabAllocator) {
+    LOGI("JNI: Initializing QuickJS engine pool with HTTP polyfills");
+    
+    // Store JavaVM reference for HTTP requests
+    if (!g_jvm) {
+        env->GetJavaVM(&g_jvm);
+    }
+    
+    // Initialize HTTP polyfill references
+    initializeHttpPolyfill(env, thiz);
+    
+    jclass bridgeClass = env->GetObjectClass(thiz);
+    g_scriptResultMethod = env->GetMethodID(bridgeClass, "onScriptResult", "(JLjava/lang/String;)V");
+    if (!g_scriptResultMethod) {
+        LOGE("Failed to find onScriptResult method");
+    }
+    env->DeleteLocalRef(bridgeClass);
+    
+    if (!g_eventLoop.start(g_jvm)) {
+        LOGE("Failed to start event loop; async executions will wait inline");
+    }
+    
+    g_workerPool.configure(slabAllocator == JNI_TRUE);
+    if (!g_enginePool.initialize(poolSize, slabAllocator == JNI_TRUE)) {
+        return JNI_FALSE;
+    }
+    g_jobScheduler.start(g_jvm, QuickJSEnginePool::FIRST_POOLED_ENGINE, g_enginePool.size());
+    return JNI_TRUE;
+}
+
+// Execute JavaScript code in the default QuickJS engine
+JNIEXPORT jstring JNICALL
+Java_com_quickjs_android_QuickJSBridge_executeScript(JNIEnv *env, jobject thiz, jstring script) {
+    EngineLease lease(g_enginePool, QuickJSEnginePool::DEFAULT_ENGINE);
+    return executeScriptOnEngine(env, lease.engine(), script);
+}
+
+// Execute JavaScript code in the default engine, returning a ValueCodec-encoded result
+JNIEXPORT jbyteArray JNICALL
+Java_com_quickjs_android_QuickJSBridge_executeScriptEncoded(JNIEnv *env, jobject thiz, jstring script) {
+    EngineLease lease(g_enginePool, QuickJSEnginePool::DEFAULT_ENGINE);
+    return executeScriptEncodedOnEngine(env, lease.engine(), script);
+}
+
+// Cleanup all pooled QuickJS engines
+JNIEXPORT void JNICALL
+Java_com_quickjs_android_QuickJSBridge_cleanupQuickJS(JNIEnv *env, jobject thiz) {
+    LOGI("JNI: Cleaning up QuickJS engine pool");
+    // Scheduler threads lease engines, so they go first
+    g_jobScheduler.stop(env);
+    // Waits for async executions to settle, which needs the event loop running
+    g_enginePool.cleanup();
+    g_eventLoop.stop();
+    // Engines terminate their workers as they go, so every thread is idle by now
+    g_workerPool.cleanup();
+}
+
+// Check if QuickJS is initialized
+JNIEXPORT jboolean JNICALL
+Java_com_quickjs_android_QuickJSBridge_isInitialized(JNIEnv *env, jobject thiz) {
+    return g_enginePool.isInitialized() ? JNI_TRUE : JNI_FALSE;
+}
+
+// Reset context JNI function
+JNIEXPORT jboolean JNICALL
+Java_com_quickjs_android_QuickJSBridge_resetContext(JNIEnv *env, jobject thiz) {
+    EngineLease lease(g_enginePool, QuickJSEnginePool::DEFAULT_ENGINE);
+    QuickJSEngine *engine = lease.engine();
+    return engine && engine->resetContext() ? JNI_TRUE : JNI_FALSE;
+}
+
+// Compile JavaScript to bytecode JNI function
+JNIEXPORT jbyteArray JNICALL
+Java_com_quickjs_android_QuickJSBridge_compileScript(JNIEnv *env, jobject thiz, jstring script) {
+    EngineLease lease(g_enginePool, QuickJSEnginePool::DEFAULT_ENGINE);
+    return compileScriptToBytecode(env, lease.engine(), script);
+}
+
+// Execute bytecode JNI function
+JNIEXPORT jstring JNICALL
+Java_com_quickjs_android_QuickJSBridge_executeBytecode(JNIEnv *env, jobject thiz, jbyteArray bytecode) {
+    EngineLease lease(g_enginePool, QuickJSEnginePool::DEFAULT_ENGINE);
+    return executeBytecodeOnEngine(env, lease.engine(), bytecode);
+}
+
+// Lease any free pooled engine, blocking until one is available
+JNIEXPORT jint JNICALL
+Java_com_quickjs_android_QuickJSBridge_acquireEngine(JNIEnv *env, jobject thiz) {
+    return g_enginePool.acquire();
+}
+
+// Return a leased engine to the pool
+JNIEXPORT void JNICALL
+Java_com_quickjs_android_QuickJSBridge_releaseEngine(JNIEnv *env, jobject thiz, jint handle) {
+    g_enginePool.release(handle);
+}
+
+// Number of engines in the pool
+JNIEXPORT jint JNICALL
+Java_com_quickjs_android_QuickJSBridge_getEnginePoolSize(JNIEnv *env, jobject thiz) {
+    return g_enginePool.size();
+}
+
+// Execute JavaScript code in a leased engine
+JNIEXPORT jstring JNICALL
+Java_com_quickjs_android_QuickJSBridge_executeScriptOnEngine(JNIEnv *env, jobject thiz, jint handle, jstring script) {
+    QuickJSEngine *engine = g_enginePool.get(handle);
+    if (!engine) {
+        return env->NewStringUTF("Error: Engine not leased");
+    }
+    return executeScriptOnEngine(env, engine, script);
+}
+
+// Execute JavaScript code in a realm of a leased engine, see QuickJSEngine::executeInRealm()
+JNIEXPORT jstring JNICALL
+Java_com_quickjs_android_QuickJSBridge_executeInRealmOnEngine(JNIEnv *env, jobject thiz, jint handle, jstring script,
+                                                             jint features) {
+    QuickJSEngine *engine = g_enginePool.get(handle);
+    if (!engine) {
+        return env->NewStringUTF("Error: Engine not leased");
+    }
+    const char* scriptStr = env->GetStringUTFChars(script, nullptr);
+    std::string result = engine->executeInRealm(std::string(scriptStr), features);
+    env->ReleaseStringUTFChars(script, scriptStr);
+    return env->NewStringUTF(result.c_str());
+}
+
+// Execute JavaScript code in a throwaway arena context of a leased engine
+JNIEXPORT jstring JNICALL
+Java_com_quickjs_android_QuickJSBridge_executeThrowawayOnEngine(JNIEnv *env, jobject thiz, jint handle, jstring script) {
+    QuickJSEngine *engine = g_enginePool.get(handle);
+    if (!engine) {
+        return env->NewStringUTF("Error: Engine not leased");
+    }
+    const char* scriptStr = env->GetStringUTFChars(script, nullptr);
+    std::string result = engine->executeThrowaway(std::string(scriptStr));
+    env->ReleaseStringUTFChars(script, scriptStr);
+    return env->NewStringUTF(result.c_str());
+}
+
+// Run bytecode in a leased engine the way executeThrowawayOnEngine() runs a script
+JNIEXPORT jstring JNICALL
+Java_com_quickjs_android_QuickJSBridge_executeThrowawayBytecodeOnEngine(JNIEnv *env, jobject thiz, jint handle,
+                                                                       jbyteArray bytecode) {
+    QuickJSEngine *engine = g_enginePool.get(handle);
+    if (!engine) {
+        return env->NewStringUTF("Error: Engine not leased");
+    }
+    jsize length = bytecode ? env->GetArrayLength(bytecode) : 0;
+    if (length <= 0) {
+        return env->NewStringUTF("Error: Empty bytecode");
+    }
+    jbyte *data = env->GetByteArrayElements(bytecode, nullptr);
+    if (!data) {
+        return env->NewStringUTF("Error: Failed to get bytecode data");
+    }
+    std::string result = engine->executeThrowawayBytecode(reinterpret_cast<const uint8_t *>(data), length);
+    env->ReleaseByteArrayElements(bytecode, data, JNI_ABORT);
+    return env->NewStringUTF(result.c_str());
+}
+
+// Bytes [offset, offset + length) of a direct ByteBuffer, or nullptr if that
+// range is not inside it; *terminated is whether a NUL byte follows the range
+static const char *directBufferSource(JNIEnv *env, jobject buffer, jint offset, jint length, bool *terminated) {
+    const char *data = buffer ? static_cast<const char *>(env->GetDirectBufferAddress(buffer)) : nullptr;
+    jlong capacity = buffer ? env->GetDirectBufferCapacity(buffer) : -1;
+    if (!data || offset < 0 || length < 0 || static_cast<jlong>(offset) + length > capacity) {
+        return nullptr;
+    }
+    *terminated = static_cast<jlong>(offset) + length < capacity && data[offset + length] == '\0';
+    return data + offset;
+}
+
+// Compile UTF-8 source held in a direct ByteBuffer to bytecode in a leased engine
+// The buffer holds length bytes followed by a NUL, so it is parsed where it
+// lies instead of going through a Java string; returns nullptr if it does not compile
+JNIEXPORT jbyteArray JNICALL
+Java_com_quickjs_android_QuickJSBridge_compileScriptBufferOnEngine(JNIEnv *env, jobject thiz, jint handle,
+                                                                  jobject source, jint length, jstring filename) {
+    QuickJSEngine *engine = g_enginePool.get(handle);
+    if (!engine || !engine->isInitialized()) {
+        LOGE("QuickJS not initialized for compilation");
+        return nullptr;
+    }
+    bool terminated = false;
+    const char *sourceData = directBufferSource(env, source, 0, length, &terminated);
+    if (!sourceData || !terminated) {
+        LOGE("Script buffer is not a NUL terminated direct buffer");
+        return nullptr;
+    }
+    
+    const char *filenameStr = env->GetStringUTFChars(filename, nullptr);
+    size_t bytecodeSize;
+    uint8_t *bytecodeData = compileToBytecode(engine, sourceData, length, filenameStr ? filenameStr : "<remote>",
+                                              &bytecodeSize);
+    if (filenameStr) env->ReleaseStringUTFChars(filename, filenameStr);
+    if (!bytecodeData) {
+        return nullptr;
+    }
+    
+    jbyteArray result = env->NewByteArray(static_cast<jsize>(bytecodeSize));
+    if (result) {
+        env->SetByteArrayRegion(result, 0, static_cast<jsize>(bytecodeSize),
+                                reinterpret_cast<const jbyte*>(bytecodeData));
+    }
+    js_free(engine->getContext(), bytecodeData);
+    return result;
+}
+
+// Run length bytes of UTF-8 source at offset in a direct ByteBuffer in a leased
+// engine, in its context or a throwaway one
+// Parsed in place when a NUL byte follows them, else after one copy that adds it
+static jstring executeBufferOnEngine(JNIEnv *env, jint handle, jobject source, jint offset, jint length,
+                                     jstring filename, bool throwaway) {
+    QuickJSEngine *engine = g_enginePool.get(handle);
+    if (!engine) {
+        return env->NewStringUTF("Error: Engine not leased");
+    }
+    bool terminated = false;
+    const char *sourceData = directBufferSource(env, source, offset, length, &terminated);
+    if (!sourceData) {
+        return env->NewStringUTF("Error: Script buffer is not a direct buffer holding the given range");
+    }
+    std::vector<char> copy;
+    if (!terminated) {
+        copy.reserve(static_cast<size_t>(length) + 1);
+        copy.assign(sourceData, sourceData + length);
+        copy.push_back('\0');
+        sourceData = copy.data();
+    }
+    
+    const char *filenameStr = env->GetStringUTFChars(filename, nullptr);
+    const char *name = filenameStr ? filenameStr : "<input>";
+    std::string result = throwaway ? engine->executeThrowawaySource(sourceData, length, name)
+                                   : engine->executeSource(sourceData, length, name);
+    if (filenameStr) env->ReleaseStringUTFChars(filename, filenameStr);
+    return env->NewStringUTF(result.c_str());
+}
+
+// Execute length bytes of UTF-8 source at offset in a direct ByteBuffer in a leased engine
+JNIEXPORT jstring JNICALL
+Java_com_quickjs_android_QuickJSBridge_executeScriptBufferOnEngine(JNIEnv *env, jobject thiz, jint handle,
+                                                                  jobject source, jint offset, jint length,
+                                                                  jstring filename) {
+    return executeBufferOnEngine(env, handle, source, offset, length, filename, false);
+}
+
+// Run a source buffer in a throwaway arena context of a leased engine, the way
+// executeThrowawayOnEngine() runs a script
+JNIEXPORT jstring JNICALL
+Java_com_quickjs_android_QuickJSBridge_executeThrowawayBufferOnEngine(JNIEnv *env, jobject thiz, jint handle,
+                                                                     jobject source, jint offset, jint length,
+                                                                     jstring filename) {
+    return executeBufferOnEngine(env, handle, source, offset, length, filename, true);
+}
+
+// Execute length bytes of UTF-8 source at offset in fd in a leased engine
+// The range is mapped and parsed in place; fd may be closed afterwards
+JNIEXPORT jstring JNICALL
+Java_com_quickjs_android_QuickJSBridge_executeScriptFdOnEngine(JNIEnv *env, jobject thiz, jint handle, jint fd,
+                                                              jlong offset, jlong length, jstring filename) {
+    QuickJSEngine *engine = g_enginePool.get(handle);
+    if (!engine) {
+        return env->NewStringUTF("Error: Engine not leased");
+    }
+    std::unique_ptr<MappedSource> source(MappedSource::map(fd, offset, length));
+    if (!source) {
+        return env->NewStringUTF("Error: Failed to map script file");
+    }
+    
+    const char *filenameStr = env->GetStringUTFChars(filename, nullptr);
+    std::string result = engine->executeSource(source->data(), source->size(), filenameStr ? filenameStr : "<input>");
+    if (filenameStr) env->ReleaseStringUTFChars(filename, filenameStr);
+    return env->NewStringUTF(result.c_str());
+}
+
+// Execute JavaScript code in a leased engine, returning a ValueCodec-encoded result
+JNIEXPORT jbyteArray JNICALL
+Java_com_quickjs_android_QuickJSBridge_executeScriptEncodedOnEngine(JNIEnv *env, jobject thiz, jint handle, jstring script) {
+    return executeScriptEncodedOnEngine(env, g_enginePool.get(handle), script);
+}
+
+// Execute many small scripts in a leased engine in one call
+// Returns their ValueCodec-encoded results back to back, in script order
+JNIEXPORT jbyteArray JNICALL
+Java_com_quickjs_android_QuickJSBridge_executeBatchEncodedOnEngine(JNIEnv *env, jobject thiz, jint handle,
+                                                                   jobjectArray scripts) {
+    return executeBatchEncodedOnEngine(env, g_enginePool.get(handle), scripts);
+}
+
+// Call a function count times in a leased engine, once per element of the JSON
+// array argsJson; see QuickJSEngine::invokeBatchEncoded()
+// Returns the ValueCodec-encoded results back to back, in call order
+JNIEXPORT jbyteArray JNICALL
+Java_com_quickjs_android_QuickJSBridge_invokeBatchEncodedOnEngine(JNIEnv *env, jobject thiz, jint handle,
+                                                                  jstring function, jstring argsJson, jint count) {
+    QuickJSEngine *engine = g_enginePool.get(handle);
+    std::vector<uint8_t> encoded;
+    if (!engine) {
+        for (jint i = 0; i < count; i++) {
+            ValueCodec::encodeHostError("Engine not leased", encoded);
+        }
+        return newEncodedArray(env, encoded);
+    }
+    
+    const char *functionStr = env->GetStringUTFChars(function, nullptr);
+    std::string functionSource(functionStr ? functionStr : "");
+    if (functionStr) env->ReleaseStringUTFChars(function, functionStr);
+    const char *argsStr = env->GetStringUTFChars(argsJson, nullptr);
+    std::string args(argsStr ? argsStr : "");
+    if (argsStr) env->ReleaseStringUTFChars(argsJson, argsStr);
+    
+    return newEncodedArray(env, engine->invokeBatchEncoded(functionSource, args, count > 0 ? count : 0));
+}
+
+// Execute bytecode in a leased engine
+JNIEXPORT jstring JNICALL
+Java_com_quickjs_android_QuickJSBridge_executeBytecodeOnEngine(JNIEnv *env, jobject thiz, jint handle, jbyteArray bytecode) {
+    QuickJSEngine *engine = g_enginePool.get(handle);
+    if (!engine) {
+        return env->NewStringUTF("Error: Engine not leased");
+    }
+    return executeBytecodeOnEngine(env, engine, bytecode);
+}
+
+// Start executing JavaScript in a leased engine without waiting for it
+// Takes over the lease: once the script's promise settles the engine is released
+// and the result is passed to onScriptResult(), either from this thread or from
+// the event loop thread
+JNIEXPORT void JNICALL
+Java_com_quickjs_android_QuickJSBridge_executeScriptAsync(JNIEnv *env, jobject thiz, jint handle,
+                                                          jstring script, jlong callbackId) {
+    QuickJSEngine *engine = g_enginePool.get(handle);
+    if (!engine) {
+        deliverScriptResult(env, callbackId, "Error: Engine not leased");
+        return;
+    }
+    if (!engine->isInitialized()) {
+        g_enginePool.release(handle);
+        deliverScriptResult(env, callbackId, "Error: QuickJS not initialized");
+        return;
+    }
+    
+    const char *scriptStr = env->GetStringUTFChars(script, nullptr);
+    std::string source(scriptStr ? scriptStr : "");
+    if (scriptStr) env->ReleaseStringUTFChars(script, scriptStr);
+    
+    JSValue value = engine->evaluateScript(source);
+    if (JS_IsException(value)) {
+        std::string error = engine->describeException("JavaScript Error: ");
+        g_enginePool.release(handle);
+        deliverScriptResult(env, callbackId, error);
+        return;
+    }
+    
+    JSValue result;
+    if (!engine->advanceResult(value, &result)) {
+        // The event loop thread owns the engine once its fd is registered
+        AsyncExecution *execution = new AsyncExecution{handle, callbackId, value};
+        if (g_eventLoop.addFd(engine->getPollFd(), onAsyncExecutionEvent, execution)) {
+            return;
+        }
+        delete execution;
+        LOGE("Event loop unavailable, waiting for async execution on the calling thread");
+        result = engine->awaitResult(value);
+    }
+    finishAsyncExecution(env, engine, handle, callbackId, result);
+}
+
+// Queue JavaScript code on the job scheduler; lane is a QuickJSJobScheduler::Lane
+// The result is passed to onScriptResult() from a scheduler thread
+// Returns the id cancelJob() takes, or 0 if the scheduler is not running
+JNIEXPORT jlong JNICALL
+Java_com_quickjs_android_QuickJSBridge_submitJob(JNIEnv *env, jobject thiz, jstring script, jint lane,
+                                                 jlong timeoutMs, jlong callbackId) {
+    if (lane < 0 || lane >= QuickJSJobScheduler::LANE_COUNT) {
+        return 0;
+    }
+    const char *scriptStr = env->GetStringUTFChars(script, nullptr);
+    std::string source(scriptStr ? scriptStr : "");
+    if (scriptStr) env->ReleaseStringUTFChars(script, scriptStr);
+    
+    return static_cast<jlong>(g_jobScheduler.submit(source, static_cast<QuickJSJobScheduler::Lane>(lane),
+                                                    timeoutMs, callbackId));
+}
+
+// Cancel a scheduler job: a queued one is dropped with an error result, a
+// running one stopped like cancelExecution()
+JNIEXPORT jboolean JNICALL
+Java_com_quickjs_android_QuickJSBridge_cancelJob(JNIEnv *env, jobject thiz, jlong jobId) {
+    return g_jobScheduler.cancel(env, static_cast<uint64_t>(jobId)) ? JNI_TRUE : JNI_FALSE;
 }
 
-// Execute JavaScript code in QuickJS
-JNIEXPORT jstring JNICALL
-Java_com_quickjs_android_QuickJSBridge_executeScript(JNIEnv *env, jobject thiz, jstring script) {
-    if (g_quickjsEngine == nullptr) {
-        return env->NewStringUTF("Error: QuickJS not initialized");
+// Reset the context of a leased engine
+JNIEXPORT jboolean JNICALL
+Java_com_quickjs_android_QuickJSBridge_resetEngineContext(JNIEnv *env, jobject thiz, jint handle) {
+    QuickJSEngine *engine = g_enginePool.get(handle);
+    return engine && engine->resetContext() ? JNI_TRUE : JNI_FALSE;
+}
+
+// Deliver the response of an async HTTP request to the engine that issued it
+// metadata is the response envelope without its body; body is a direct ByteBuffer
+// holding bodyLength bytes, wrapped into JS without copying
+JNIEXPORT void JNICALL
+Java_com_quickjs_android_QuickJSBridge_completeHttpRequest(JNIEnv *env, jobject thiz, jint engineId,
+                                                           jint requestId, jstring metadata,
+                                                           jobject body, jint bodyLength) {
+    const char *metadataStr = env->GetStringUTFChars(metadata, nullptr);
+    std::string metadataJson(metadataStr ? metadataStr : "");
+    if (metadataStr) env->ReleaseStringUTFChars(metadata, metadataStr);
+    
+    uint8_t *bodyData = static_cast<uint8_t *>(env->GetDirectBufferAddress(body));
+    jlong capacity = env->GetDirectBufferCapacity(body);
+    if (!bodyData || bodyLength < 0 || bodyLength > capacity) {
+        LOGE("Dropping HTTP response %d: body is not a direct buffer of %d bytes", requestId, bodyLength);
+        metadataJson = "{\"status\":0,\"statusText\":\"Invalid response body\",\"ok\":false,\"headers\":{}}";
+        bodyData = nullptr;
+        bodyLength = 0;
+        capacity = 0;
     }
+    bool terminated = bodyLength < capacity && bodyData[bodyLength] == 0;
     
-    const char* scriptStr = env->GetStringUTFChars(script, nullptr);
-    std::string result = g_quickjsEngine->executeScript(std::string(scriptStr));
-    env->ReleaseStringUTFChars(script, scriptStr);
+    // An empty ArrayBuffer still needs a valid pointer
+    static uint8_t emptyBody[1] = {0};
+    jobject bodyRef = bodyData ? env->NewGlobalRef(body) : nullptr;
+    if (!bodyData) {
+        bodyData = emptyBody;
+        terminated = false;
+    }
     
-    return env->NewStringUTF(result.c_str());
+    bool delivered = g_enginePool.visit(engineId, [&](QuickJSEngine *engine) {
+        engine->postHttpCompletion(static_cast<uint32_t>(requestId), std::move(metadataJson), bodyRef,
+                                   bodyData, static_cast<size_t>(bodyLength), terminated);
+    });
+    if (!delivered) {
+        LOGE("Dropping HTTP response for unknown engine %d", engineId);
+        env->DeleteGlobalRef(bodyRef);
+    }
 }
 
-// Cleanup QuickJS Engine
+// Respond to Android memory pressure: every pooled engine collects garbage and
+// returns free slab chunks, and at TRIM_CACHES also drops its compiled scripts.
+// Never blocks on running scripts; busy engines trim as their lease ends.
 JNIEXPORT void JNICALL
-Java_com_quickjs_android_QuickJSBridge_cleanupQuickJS(JNIEnv *env, jobject thiz) {
-    LOGI("JNI: Cleaning up QuickJS Engine");
-    
-    if (g_quickjsEngine != nullptr) {
-        g_quickjsEngine->cleanup();
-        delete g_quickjsEngine;
-        g_quickjsEngine = nullptr;
+Java_com_quickjs_android_QuickJSBridge_trimMemory(JNIEnv *env, jobject thiz, jint level) {
+    if (level <= QuickJSEngine::TRIM_NONE) {
+        return;
     }
+    QuickJSEngine::TrimLevel trimLevel = level >= QuickJSEngine::TRIM_CACHES ? QuickJSEngine::TRIM_CACHES
+                                                                              : QuickJSEngine::TRIM_GC;
+    g_enginePool.inspect([trimLevel](QuickJSEngine *engine) {
+        engine->requestTrim(trimLevel);
+    });
+    int count = g_enginePool.size();
+    for (int i = 0; i < count; i++) {
+        if (g_enginePool.tryAcquire(i)) {
+            g_enginePool.release(i);  // Applies the trim
+        }
+    }
+#ifdef M_PURGE
+    // Hand pages freed by the collections back to the system
+    mallopt(M_PURGE, 0);
+#endif
 }
 
-// Check if QuickJS is initialized
+// Hibernate an idle engine: save the globals its scripts defined, free its
+// runtime and hand the pages back; the next lease restores it
+// Returns false if the engine is busy, has async work pending or holds globals
+// that would not come back as they are; force drops those instead
 JNIEXPORT jboolean JNICALL
-Java_com_quickjs_android_QuickJSBridge_isInitialized(JNIEnv *env, jobject thiz) {
-    return (g_quickjsEngine != nullptr && g_quickjsEngine->isInitialized()) ? JNI_TRUE : JNI_FALSE;
+Java_com_quickjs_android_QuickJSBridge_hibernateEngine(JNIEnv *env, jobject thiz, jint handle, jboolean force) {
+    if (!g_enginePool.tryAcquire(handle)) {
+        return JNI_FALSE;
+    }
+    QuickJSEngine *engine = g_enginePool.get(handle);
+    bool hibernated = engine && engine->hibernate(force == JNI_TRUE);
+    g_enginePool.release(handle);
+#ifdef M_PURGE
+    if (hibernated) {
+        mallopt(M_PURGE, 0);
+    }
+#endif
+    return hibernated ? JNI_TRUE : JNI_FALSE;
 }
 
-// Reset context JNI function
+// Hibernate every pooled engine that is idle right now and can be saved as it
+// is; returns how many are hibernated. The default engine is left running.
+JNIEXPORT jint JNICALL
+Java_com_quickjs_android_QuickJSBridge_hibernateIdleEngines(JNIEnv *env, jobject thiz) {
+    int hibernated = 0;
+    int count = g_enginePool.size();
+    for (int i = QuickJSEnginePool::FIRST_POOLED_ENGINE; i < count; i++) {
+        if (g_enginePool.tryAcquire(i)) {
+            QuickJSEngine *engine = g_enginePool.get(i);
+            if (engine && engine->hibernate()) {
+                hibernated++;
+            }
+            g_enginePool.release(i);
+        }
+    }
+#ifdef M_PURGE
+    if (hibernated > 0) {
+        mallopt(M_PURGE, 0);
+    }
+#endif
+    return hibernated;
+}
+
+// Restore a hibernated engine ahead of use, waiting for its lease if it is busy
+// Returns false if the engine does not exist or could not be rebuilt
 JNIEXPORT jboolean JNICALL
-Java_com_quickjs_android_QuickJSBridge_resetContext(JNIEnv *env, jobject thiz) {
-    return g_quickjsEngine ? g_quickjsEngine->resetContext() : false;
+Java_com_quickjs_android_QuickJSBridge_restoreEngine(JNIEnv *env, jobject thiz, jint handle) {
+    EngineLease lease(g_enginePool, handle);
+    QuickJSEngine *engine = lease.engine();
+    return engine && engine->isInitialized() ? JNI_TRUE : JNI_FALSE;
 }
 
-// Compile JavaScript to bytecode JNI function
-JNIEXPORT jbyteArray JNICALL
-Java_com_quickjs_android_QuickJSBridge_compileScript(JNIEnv *env, jobject thiz, jstring script) {
-    if (!g_quickjsEngine || !g_quickjsEngine->isInitialized()) {
-        LOGE("QuickJS not initialized for compilation");
-        return nullptr;
+// Set how long an engine with garbage must stay idle before it is collected
+// off the request path; 0 disables idle collection
+JNIEXPORT void JNICALL
+Java_com_quickjs_android_QuickJSBridge_configureIdleGc(JNIEnv *env, jobject thiz, jlong delayMs) {
+    g_idleGcDelayMs.store(delayMs > 0 ? delayMs : 0, std::memory_order_relaxed);
+}
+
+// Set the compiled-script cache budget of every pooled engine
+JNIEXPORT void JNICALL
+Java_com_quickjs_android_QuickJSBridge_configureScriptCache(JNIEnv *env, jobject thiz, jlong budgetBytes) {
+    size_t budget = budgetBytes > 0 ? static_cast<size_t>(budgetBytes) : 0;
+    forEachEngine(g_enginePool, [budget](QuickJSEngine *engine) {
+        engine->getScriptCache().setBudget(engine->getContext(), budget);
+    });
+}
+
+// Expose receiver.methodName to JavaScript as a global function of every
+// pooled engine, and of every context set up from now on
+// signature is in HostFunctions' notation, e.g. "ID)S"; waits for busy engines,
+// so it must not be called from within a host function
+JNIEXPORT jboolean JNICALL
+Java_com_quickjs_android_QuickJSBridge_addHostFunction(JNIEnv *env, jobject thiz, jstring name, jobject receiver,
+                                                       jstring methodName, jstring signature) {
+    const char *nameStr = env->GetStringUTFChars(name, nullptr);
+    const char *methodStr = env->GetStringUTFChars(methodName, nullptr);
+    const char *signatureStr = env->GetStringUTFChars(signature, nullptr);
+    int index = -1;
+    if (nameStr && methodStr && signatureStr) {
+        index = HostFunctions::add(env, nameStr, receiver, methodStr, signatureStr);
     }
-    
-    const char *scriptStr = env->GetStringUTFChars(script, nullptr);
-    if (!scriptStr) {
-        LOGE("Failed to get script string");
-        return nullptr;
+    if (nameStr) env->ReleaseStringUTFChars(name, nameStr);
+    if (methodStr) env->ReleaseStringUTFChars(methodName, methodStr);
+    if (signatureStr) env->ReleaseStringUTFChars(signature, signatureStr);
+    if (index < 0) {
+        return JNI_FALSE;
     }
     
-    LOGI("Compiling JavaScript to real QuickJS bytecode");
+    forEachEngine(g_enginePool, [index](QuickJSEngine *engine) {
+        engine->installHostFunction(index);
+    });
+    return JNI_TRUE;
+}
+
+// Compiled-script cache counters summed over all pooled engines
+// Layout: [hits, misses, entries, bytes, budget]
+JNIEXPORT jlongArray JNICALL
+Java_com_quickjs_android_QuickJSBridge_getScriptCacheStats(JNIEnv *env, jobject thiz) {
+    jlong stats[5] = {0, 0, 0, 0, 0};
+    g_enginePool.inspect([&stats](QuickJSEngine *engine) {
+        ScriptCache &cache = engine->getScriptCache();
+        stats[0] += static_cast<jlong>(cache.getHits());
+        stats[1] += static_cast<jlong>(cache.getMisses());
+        stats[2] += static_cast<jlong>(cache.getEntryCount());
+        stats[3] += static_cast<jlong>(cache.getBytes());
+        stats[4] += static_cast<jlong>(cache.getBudget());
+    });
     
-    JSContext *context = g_quickjsEngine->getContext();
-    if (!context) {
-        LOGE("Failed to get QuickJS context");
-        env->ReleaseStringUTFChars(script, scriptStr);
+    jlongArray result = env->NewLongArray(5);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, 5, stats);
+    }
+    return result;
+}
+
+// Execution counters of an engine the caller holds the lease on, up to now
+// Layout: the ExecutionCounters fields in declaration order
+JNIEXPORT jlongArray JNICALL
+Java_com_quickjs_android_QuickJSBridge_getExecutionCountersOnEngine(JNIEnv *env, jobject thiz, jint handle) {
+    QuickJSEngine *engine = g_enginePool.get(handle);
+    if (!engine || !engine->isInitialized()) {
         return nullptr;
     }
+    jlong counters[ExecutionCounters::FIELD_COUNT];
+    engine->readCounters(counters);
     
-    // Compile script to bytecode using QuickJS API
-    JSValue compiledObj = JS_Eval(context, scriptStr, strlen(scriptStr), 
-                                  "<bytecode>", JS_EVAL_FLAG_COMPILE_ONLY);
-    
-    env->ReleaseStringUTFChars(script, scriptStr);
-    
-    if (JS_IsException(compiledObj)) {
-        // Handle compilation error
-        JSValue exception = JS_GetException(context);
-        const char *errorStr = JS_ToCString(context, exception);
-        LOGE("Bytecode compilation failed: %s", errorStr ? errorStr : "Unknown error");
-        if (errorStr) JS_FreeCString(context, errorStr);
-        JS_FreeValue(context, exception);
-        JS_FreeValue(context, compiledObj);
+    jlongArray result = env->NewLongArray(ExecutionCounters::FIELD_COUNT);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, ExecutionCounters::FIELD_COUNT, counters);
+    }
+    return result;
+}
+
+// Execution counters of one engine as of its last lease, without leasing it
+// Layout: as for getExecutionCountersOnEngine
+JNIEXPORT jlongArray JNICALL
+Java_com_quickjs_android_QuickJSBridge_getExecutionTotals(JNIEnv *env, jobject thiz, jint handle) {
+    jlong counters[ExecutionCounters::FIELD_COUNT];
+    if (!g_enginePool.visit(handle, [&counters](QuickJSEngine *engine) {
+            engine->getCounters().read(counters);
+        })) {
         return nullptr;
     }
     
-    // Serialize compiled object to bytecode
-    size_t bytecodeSize;
-    uint8_t *bytecodeData = JS_WriteObject(context, &bytecodeSize, compiledObj, 
-                                          JS_WRITE_OBJ_BYTECODE);
-    
-    JS_FreeValue(context, compiledObj);
+    jlongArray result = env->NewLongArray(ExecutionCounters::FIELD_COUNT);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, ExecutionCounters::FIELD_COUNT, counters);
+    }
+    return result;
+}
+
+// Full JSMemoryUsage of one engine, waiting for its lease if it is busy
+// A hibernated engine is left so and reports no usage
+// Layout: the JSMemoryUsage fields in declaration order
+JNIEXPORT jlongArray JNICALL
+Java_com_quickjs_android_QuickJSBridge_getMemoryUsage(JNIEnv *env, jobject thiz, jint handle) {
+    JSMemoryUsage usage = JSMemoryUsage();
+    {
+        EngineLease lease(g_enginePool, handle, false);
+        QuickJSEngine *engine = lease.engine();
+        if (!engine || (!engine->isHibernated() && !engine->sampleMemoryUsage(&usage))) {
+            return nullptr;
+        }
+    }
     
-    if (!bytecodeData) {
-        LOGE("Failed to serialize bytecode");
+    jlongArray result = env->NewLongArray(MEMORY_USAGE_FIELDS);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, MEMORY_USAGE_FIELDS, reinterpret_cast<const jlong *>(&usage));
+    }
+    return result;
+}
+
+// High-water marks of one engine's memory samples, without leasing it
+// Layout: [samples, JSMemoryUsage fields...]
+JNIEXPORT jlongArray JNICALL
+Java_com_quickjs_android_QuickJSBridge_getMemoryPeaks(JNIEnv *env, jobject thiz, jint handle) {
+    JSMemoryUsage peak;
+    jlong samples = 0;
+    if (!g_enginePool.visit(handle, [&](QuickJSEngine *engine) {
+            samples = static_cast<jlong>(engine->getMemoryPeak(&peak));
+        })) {
         return nullptr;
     }
     
-    // Create Java byte array
-    jbyteArray result = env->NewByteArray(bytecodeSize);
+    jlongArray result = env->NewLongArray(1 + MEMORY_USAGE_FIELDS);
     if (result) {
-        env->SetByteArrayRegion(result, 0, bytecodeSize, 
-            reinterpret_cast<const jbyte*>(bytecodeData));
-        LOGI("Real bytecode created: %zu bytes", bytecodeSize);
-    } else {
-        LOGE("Failed to create Java byte array");
+        env->SetLongArrayRegion(result, 0, 1, &samples);
+        env->SetLongArrayRegion(result, 1, MEMORY_USAGE_FIELDS, reinterpret_cast<const jlong *>(&peak));
     }
-    
-    // Free the bytecode data
-    js_free(context, bytecodeData);
-    
     return result;
 }
 
-// Execute bytecode JNI function
-JNIEXPORT jstring JNICALL
-Java_com_quickjs_android_QuickJSBridge_executeBytecode(JNIEnv *env, jobject thiz, jbyteArray bytecode) {
-    if (!g_quickjsEngine || !g_quickjsEngine->isInitialized()) {
-        LOGE("QuickJS not initialized for bytecode execution");
-        return env->NewStringUTF("Error: QuickJS not initialized");
+// Clear the memory high-water marks of every engine
+JNIEXPORT void JNICALL
+Java_com_quickjs_android_QuickJSBridge_resetMemoryPeaks(JNIEnv *env, jobject thiz) {
+    g_enginePool.inspect([](QuickJSEngine *engine) {
+        engine->resetMemoryPeak();
+    });
+}
+
+// Sample engines at most every intervalMs as their leases end; 0 stops sampling
+JNIEXPORT void JNICALL
+Java_com_quickjs_android_QuickJSBridge_configureMemorySampling(JNIEnv *env, jobject thiz, jlong intervalMs) {
+    g_memorySampleIntervalMs.store(intervalMs > 0 ? intervalMs : 0, std::memory_order_relaxed);
+}
+
+// Start sampling the JS stack of an engine every intervalUs, even while it runs
+JNIEXPORT jboolean JNICALL
+Java_com_quickjs_android_QuickJSBridge_startProfiler(JNIEnv *env, jobject thiz, jint handle, jint intervalUs) {
+    return g_enginePool.visit(handle, [intervalUs](QuickJSEngine *engine) {
+        engine->getProfiler().start(intervalUs);
+    }) ? JNI_TRUE : JNI_FALSE;
+}
+
+// Stop profiling an engine; returns the profile in pprof format, or null if none was active
+JNIEXPORT jbyteArray JNICALL
+Java_com_quickjs_android_QuickJSBridge_stopProfiler(JNIEnv *env, jobject thiz, jint handle) {
+    std::vector<uint8_t> profile;
+    g_enginePool.visit(handle, [&profile](QuickJSEngine *engine) {
+        profile = engine->getProfiler().stop();
+    });
+    if (profile.empty()) {
+        return nullptr;
     }
     
-    if (!bytecode) {
-        LOGE("Null bytecode provided");
-        return env->NewStringUTF("Error: Null bytecode");
+    jbyteArray result = env->NewByteArray(profile.size());
+    if (result) {
+        env->SetByteArrayRegion(result, 0, profile.size(), reinterpret_cast<const jbyte *>(profile.data()));
     }
-    
-    jsize bytecodeLength = env->GetArrayLength(bytecode);
-    if (bytecodeLength <= 0) {
-        LOGE("Empty bytecode provided");
-        return env->NewStringUTF("Error: Empty bytecode");
+    return result;
+}
+
+// Run microbench.js cases in a leased engine; returns the JSON report
+// The engine's context is left dirty and should be reset afterwards
+JNIEXPORT jstring JNICALL
+Java_com_quickjs_android_QuickJSBridge_runMicrobenchOnEngine(JNIEnv *env, jobject thiz, jint handle,
+                                                             jstring source, jobjectArray filters) {
+    QuickJSEngine *engine = g_enginePool.get(handle);
+    if (!engine || !engine->isInitialized()) {
+        return env->NewStringUTF("{\"error\":\"Engine not leased\"}");
     }
     
-    // Get bytecode data
-    jbyte* bytecodeData = env->GetByteArrayElements(bytecode, nullptr);
-    if (!bytecodeData) {
-        LOGE("Failed to get bytecode data");
-        return env->NewStringUTF("Error: Failed to get bytecode data");
+    std::vector<std::string> filterList;
+    jsize count = filters ? env->GetArrayLength(filters) : 0;
+    for (jsize i = 0; i < count; i++) {
+        jstring filter = static_cast<jstring>(env->GetObjectArrayElement(filters, i));
+        const char *filterStr = env->GetStringUTFChars(filter, nullptr);
+        filterList.emplace_back(filterStr);
+        env->ReleaseStringUTFChars(filter, filterStr);
+        env->DeleteLocalRef(filter);
     }
     
-    LOGI("Executing real QuickJS bytecode");
+    const char *sourceStr = env->GetStringUTFChars(source, nullptr);
+    std::string sourceString(sourceStr);
+    env->ReleaseStringUTFChars(source, sourceStr);
     
-    JSContext *context = g_quickjsEngine->getContext();
-    if (!context) {
-        LOGE("Failed to get QuickJS context");
-        env->ReleaseByteArrayElements(bytecode, bytecodeData, JNI_ABORT);
-        return env->NewStringUTF("Error: Failed to get QuickJS context");
+    std::string report = MicrobenchRunner::run(engine->getContext(), sourceString, filterList);
+    return env->NewStringUTF(report.c_str());
+}
+
+// Compile scripts on the default engine and write them to a bytecode bundle
+// Entries from firstModule on are compiled as ES modules, named by their id
+// strip takes JS_STRIP_* flags for the compilation; every atom of the scripts
+// is written once, to the bundle's atom table
+JNIEXPORT jboolean JNICALL
+Java_com_quickjs_android_QuickJSBridge_writeBytecodeBundle(JNIEnv *env, jobject thiz, jstring path,
+                                                           jobjectArray ids, jobjectArray scripts,
+                                                           jint firstModule, jint strip) {
+    jsize count = env->GetArrayLength(ids);
+    if (count != env->GetArrayLength(scripts)) {
+        LOGE("Bundle ids and scripts differ in length");
+        return JNI_FALSE;
     }
     
-    // Deserialize bytecode to JSValue
-    JSValue compiledObj = JS_ReadObject(context, 
-                                       reinterpret_cast<const uint8_t*>(bytecodeData), 
-                                       bytecodeLength, 
-                                       JS_READ_OBJ_BYTECODE);
-    
-    env->ReleaseByteArrayElements(bytecode, bytecodeData, JNI_ABORT);
-    
-    if (JS_IsException(compiledObj)) {
-        JSValue exception = JS_GetException(context);
-        const char *errorStr = JS_ToCString(context, exception);
-        LOGE("Bytecode deserialization failed: %s", errorStr ? errorStr : "Unknown error");
-        std::string error = "Error: Bytecode deserialization failed";
-        if (errorStr) {
-            error += ": ";
-            error += errorStr;
-            JS_FreeCString(context, errorStr);
-        }
-        JS_FreeValue(context, exception);
-        JS_FreeValue(context, compiledObj);
-        return env->NewStringUTF(error.c_str());
+    EngineLease lease(g_enginePool, QuickJSEnginePool::DEFAULT_ENGINE);
+    QuickJSEngine *engine = lease.engine();
+    if (!engine || !engine->isInitialized()) {
+        LOGE("QuickJS not initialized for bundle compilation");
+        return JNI_FALSE;
     }
     
-    // Execute the bytecode function
-    JSValue result = JS_EvalFunction(context, compiledObj);
+    JSContext *context = engine->getContext();
+    JSAtomTable *atoms = JS_NewAtomTable(context);
+    if (!atoms) {
+        LOGE("Failed to create bundle atom table");
+        return JNI_FALSE;
+    }
+    int previousStrip = JS_GetStripInfo(engine->runtime);
+    JS_SetStripInfo(engine->runtime, strip);
     
-    if (JS_IsException(result)) {
-        // Handle execution error
-        JSValue exception = JS_GetException(context);
-        const char *errorStr = JS_ToCString(context, exception);
-        LOGE("Bytecode execution failed: %s", errorStr ? errorStr : "Unknown error");
-        std::string error = "Error: Bytecode execution failed";
-        if (errorStr) {
-            error += ": ";
-            error += errorStr;
-            JS_FreeCString(context, errorStr);
+    std::vector<BytecodeBundle::Script> bundleScripts;
+    for (jsize i = 0; i < count; i++) {
+        jstring jId = static_cast<jstring>(env->GetObjectArrayElement(ids, i));
+        jstring jScript = static_cast<jstring>(env->GetObjectArrayElement(scripts, i));
+        const char *idStr = env->GetStringUTFChars(jId, nullptr);
+        const char *scriptStr = env->GetStringUTFChars(jScript, nullptr);
+        
+        BytecodeBundle::Script script;
+        if (idStr && scriptStr) {
+            script.id = idStr;
+            size_t bytecodeSize;
+            uint8_t *bytecodeData = compileToBytecode(engine, scriptStr, strlen(scriptStr), idStr, &bytecodeSize,
+                                                      i >= firstModule, atoms);
+            if (bytecodeData) {
+                script.bytecode.assign(bytecodeData, bytecodeData + bytecodeSize);
+                js_free(engine->getContext(), bytecodeData);
+            }
         }
-        JS_FreeValue(context, exception);
-        JS_FreeValue(context, result);
-        return env->NewStringUTF(error.c_str());
+        
+        if (idStr) env->ReleaseStringUTFChars(jId, idStr);
+        if (scriptStr) env->ReleaseStringUTFChars(jScript, scriptStr);
+        env->DeleteLocalRef(jId);
+        env->DeleteLocalRef(jScript);
+        
+        if (script.bytecode.empty()) {
+            LOGE("Failed to compile bundle script: %s", script.id.c_str());
+            break;
+        }
+        bundleScripts.push_back(std::move(script));
     }
+    JS_SetStripInfo(engine->runtime, previousStrip);
     
-    // Wait for promises if needed (same as regular execution)
-    result = js_std_await(context, result);
+    std::vector<uint8_t> atomTable;
+    size_t atomTableSize;
+    uint8_t *atomTableData = JS_WriteAtomTable(context, &atomTableSize, atoms);
+    if (atomTableData) {
+        atomTable.assign(atomTableData, atomTableData + atomTableSize);
+        js_free(context, atomTableData);
+    }
+    JS_FreeAtomTable(engine->runtime, atoms);
+    if (bundleScripts.size() != static_cast<size_t>(count) || atomTable.empty()) {
+        return JNI_FALSE;
+    }
     
-    // Check if awaiting resulted in an exception (promise rejection)
-    if (JS_IsException(result)) {
-        JSValue exception = JS_GetException(context);
-        const char *errorStr = JS_ToCString(context, exception);
-        LOGE("Bytecode promise rejection: %s", errorStr ? errorStr : "Unknown error");
-        std::string error = "Promise Rejection: ";
-        if (errorStr) {
-            error += errorStr;
-            JS_FreeCString(context, errorStr);
-        } else {
-            error += "Unknown error";
+    const char *pathStr = env->GetStringUTFChars(path, nullptr);
+    bool written = BytecodeBundle::write(pathStr, std::move(bundleScripts), atomTable);
+    env->ReleaseStringUTFChars(path, pathStr);
+    return written ? JNI_TRUE : JNI_FALSE;
+}
+
+// Map a bytecode bundle file; returns a bundle handle or 0 on failure
+JNIEXPORT jlong JNICALL
+Java_com_quickjs_android_QuickJSBridge_openBytecodeBundle(JNIEnv *env, jobject thiz, jstring path) {
+    const char *pathStr = env->GetStringUTFChars(path, nullptr);
+    jlong handle = registerBundle(BytecodeBundle::openFile(pathStr));
+    env->ReleaseStringUTFChars(path, pathStr);
+    return handle;
+}
+
+// Map a bytecode bundle from a file descriptor range (e.g. an uncompressed asset)
+JNIEXPORT jlong JNICALL
+Java_com_quickjs_android_QuickJSBridge_openBytecodeBundleFd(JNIEnv *env, jobject thiz,
+                                                            jint fd, jlong offset, jlong length) {
+    return registerBundle(BytecodeBundle::openFd(fd, offset, length));
+}
+
+// Resolve imports against the modules of a bytecode bundle, after those of
+// bundles added before it
+JNIEXPORT jboolean JNICALL
+Java_com_quickjs_android_QuickJSBridge_addModuleBundle(JNIEnv *env, jobject thiz, jlong bundleHandle) {
+    std::lock_guard<std::mutex> lock(g_bundlesMutex);
+    auto it = g_bundles.find(bundleHandle);
+    if (it == g_bundles.end()) {
+        return JNI_FALSE;
+    }
+    for (auto &entry : g_moduleBundles) {
+        if (entry.first == bundleHandle) {
+            return JNI_TRUE;
         }
-        JS_FreeValue(context, exception);
-        JS_FreeValue(context, result);
-        return env->NewStringUTF(error.c_str());
     }
-    
-    // Convert result to string
-    const char *resultStr = JS_ToCString(context, result);
-    std::string resultString;
-    if (resultStr) {
-        resultString = resultStr;
-        JS_FreeCString(context, resultStr);
-    } else {
-        resultString = "undefined";
+    g_moduleBundles.emplace_back(bundleHandle, it->second);
+    return JNI_TRUE;
+}
+
+// Unmap a bytecode bundle once no execution is reading from it
+// Modules already imported stay loaded in their contexts
+JNIEXPORT void JNICALL
+Java_com_quickjs_android_QuickJSBridge_closeBytecodeBundle(JNIEnv *env, jobject thiz, jlong bundleHandle) {
+    std::lock_guard<std::mutex> lock(g_bundlesMutex);
+    g_bundles.erase(bundleHandle);
+    g_moduleBundles.erase(std::remove_if(g_moduleBundles.begin(), g_moduleBundles.end(),
+                                         [bundleHandle](const std::pair<jlong, std::shared_ptr<BytecodeBundle>> &entry) {
+                                             return entry.first == bundleHandle;
+                                         }),
+                          g_moduleBundles.end());
+}
+
+// List the script ids in a bytecode bundle
+JNIEXPORT jobjectArray JNICALL
+Java_com_quickjs_android_QuickJSBridge_getBundleScriptIds(JNIEnv *env, jobject thiz, jlong bundleHandle) {
+    std::shared_ptr<BytecodeBundle> bundle = findBundle(bundleHandle);
+    if (!bundle) {
+        return nullptr;
     }
     
-    JS_FreeValue(context, result);
-    
-    LOGI("Bytecode execution result: %s", resultString.c_str());
-    return env->NewStringUTF(resultString.c_str());
+    std::vector<std::string> ids = bundle->scriptIds();
+    jobjectArray result = env->NewObjectArray(ids.size(), env->FindClass("java/lang/String"), nullptr);
+    if (!result) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < ids.size(); i++) {
+        jstring id = env->NewStringUTF(ids[i].c_str());
+        env->SetObjectArrayElement(result, i, id);
+        env->DeleteLocalRef(id);
+    }
+    return result;
+}
+
+// Execute a bundled script in the default engine
+JNIEXPORT jstring JNICALL
+Java_com_quickjs_android_QuickJSBridge_executeBundleScript(JNIEnv *env, jobject thiz,
+                                                           jlong bundleHandle, jstring scriptId) {
+    EngineLease lease(g_enginePool, QuickJSEnginePool::DEFAULT_ENGINE);
+    return executeBundleScriptOnEngine(env, lease.engine(), bundleHandle, scriptId);
+}
+
+// Execute a bundled script in a leased engine
+JNIEXPORT jstring JNICALL
+Java_com_quickjs_android_QuickJSBridge_executeBundleScriptOnEngine(JNIEnv *env, jobject thiz, jint handle,
+                                                                   jlong bundleHandle, jstring scriptId) {
+    QuickJSEngine *engine = g_enginePool.get(handle);
+    if (!engine) {
+        return env->NewStringUTF("Error: Engine not leased");
+    }
+    return executeBundleScriptOnEngine(env, engine, bundleHandle, scriptId);
+}
+
+// Drop console records below level (ConsoleLog::Level) in every engine
+JNIEXPORT void JNICALL
+Java_com_quickjs_android_QuickJSBridge_configureConsoleLevel(JNIEnv *env, jobject thiz, jint level) {
+    g_consoleLog.setMinLevel(level);
+}
+
+// Toggle per-call native tracing of scripts and results
+JNIEXPORT void JNICALL
+Java_com_quickjs_android_QuickJSBridge_configureVerboseLogging(JNIEnv *env, jobject thiz, jboolean enabled) {
+    g_verboseLogging.store(enabled == JNI_TRUE, std::memory_order_relaxed);
+}
+
+// Timeout of every execution, unless overridden for a lease; 0 disables it
+JNIEXPORT void JNICALL
+Java_com_quickjs_android_QuickJSBridge_configureExecutionTimeout(JNIEnv *env, jobject thiz, jlong timeoutMs) {
+    g_defaultExecutionTimeoutMs.store(timeoutMs > 0 ? timeoutMs : 0, std::memory_order_relaxed);
+}
+
+// Override the execution timeout of a leased engine until the lease ends; 0 keeps the default
+// Returns the key that cancelExecution() takes, or -1 if the engine is not leased
+JNIEXPORT jlong JNICALL
+Java_com_quickjs_android_QuickJSBridge_setExecutionTimeout(JNIEnv *env, jobject thiz, jint handle, jlong timeoutMs) {
+    QuickJSEngine *engine = g_enginePool.get(handle);
+    if (!engine) {
+        return -1;
+    }
+    return static_cast<jlong>(engine->setExecutionTimeout(timeoutMs));
+}
+
+// Cancel the execution running under the lease identified by key, from any thread
+// Returns false if that lease has already ended
+JNIEXPORT jboolean JNICALL
+Java_com_quickjs_android_QuickJSBridge_cancelExecution(JNIEnv *env, jobject thiz, jint handle, jlong key) {
+    bool cancelled = false;
+    g_enginePool.visit(handle, [&](QuickJSEngine *engine) {
+        cancelled = engine->cancel(static_cast<uint64_t>(key));
+    });
+    return cancelled ? JNI_TRUE : JNI_FALSE;
+}
+
+// Toggle ATrace sections around engine and bridge phases
+JNIEXPORT void JNICALL
+Java_com_quickjs_android_QuickJSBridge_configureTracing(JNIEnv *env, jobject thiz, jboolean enabled) {
+    g_tracingEnabled.store(enabled == JNI_TRUE, std::memory_order_relaxed);
+}
+
+// Drain console records into caller-owned arrays; returns the number drained
+// meta holds three longs per record: level << 32 | engine id, timestamp in
+// ms and message length; text holds each message at index * MESSAGE_CAPACITY
+JNIEXPORT jint JNICALL
+Java_com_quickjs_android_QuickJSBridge_drainConsoleLog(JNIEnv *env, jobject thiz,
+                                                       jlongArray meta, jbyteArray text) {
+    size_t max = std::min(static_cast<size_t>(env->GetArrayLength(meta)) / 3,
+                          static_cast<size_t>(env->GetArrayLength(text)) / ConsoleLog::MESSAGE_CAPACITY);
+    static const size_t BATCH = 32;
+    ConsoleLog::Record records[BATCH];
+    size_t total = 0;
+    while (total < max) {
+        size_t count = g_consoleLog.drain(records, std::min(BATCH, max - total));
+        for (size_t i = 0; i < count; i++) {
+            const ConsoleLog::Record &record = records[i];
+            jlong fields[3] = {
+                static_cast<jlong>(record.level) << 32 | static_cast<uint32_t>(record.engineId),
+                record.timestampMs,
+                record.length,
+            };
+            env->SetLongArrayRegion(meta, (total + i) * 3, 3, fields);
+            env->SetByteArrayRegion(text, (total + i) * ConsoleLog::MESSAGE_CAPACITY, record.length,
+                                    reinterpret_cast<const jbyte *>(record.message));
+        }
+        total += count;
+        if (count < BATCH) {
+            break;
+        }
+    }
+    return static_cast<jint>(total);
+}
+
+// Console records dropped because the ring was full
+JNIEXPORT jlong JNICALL
+Java_com_quickjs_android_QuickJSBridge_getConsoleDroppedCount(JNIEnv *env, jobject thiz) {
+    return static_cast<jlong>(g_consoleLog.droppedCount());
 }
 
 // HTTP request JNI function
@@ -817,4 +5167,4 @@ Java_com_quickjs_android_QuickJSBridge_nativeHttpRequest(JNIEnv *env, jobject th
     return env->NewStringUTF("{}");
 }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,220 @@
+#include "sampling_profiler.h"
+
+#include <algorithm>
+
+namespace {
+
+// Minimal protobuf writer for profile.proto
+class ProtoWriter {
+public:
+    void varint(uint64_t v) {
+        while (v >= 0x80) {
+            out.push_back(static_cast<uint8_t>(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(v));
+    }
+
+    void intField(int field, uint64_t v) {
+        varint(static_cast<uint64_t>(field) << 3);
+        varint(v);
+    }
+
+    void bytesField(int field, const void *data, size_t length) {
+        varint(static_cast<uint64_t>(field) << 3 | 2);
+        varint(length);
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        out.insert(out.end(), p, p + length);
+    }
+
+    void messageField(int field, const ProtoWriter &message) {
+        bytesField(field, message.out.data(), message.out.size());
+    }
+
+    void packedField(int field, const std::vector<uint64_t> &values) {
+        ProtoWriter packed;
+        for (uint64_t v : values) {
+            packed.varint(v);
+        }
+        messageField(field, packed);
+    }
+
+    std::vector<uint8_t> out;
+};
+
+// profile.proto field numbers
+enum {
+    PROFILE_SAMPLE_TYPE = 1,
+    PROFILE_SAMPLE = 2,
+    PROFILE_LOCATION = 4,
+    PROFILE_FUNCTION = 5,
+    PROFILE_STRING_TABLE = 6,
+    PROFILE_TIME_NANOS = 9,
+    PROFILE_DURATION_NANOS = 10,
+    PROFILE_PERIOD_TYPE = 11,
+    PROFILE_PERIOD = 12,
+    VALUE_TYPE_TYPE = 1,
+    VALUE_TYPE_UNIT = 2,
+    SAMPLE_LOCATION_ID = 1,
+    SAMPLE_VALUE = 2,
+    LOCATION_ID = 1,
+    LOCATION_LINE = 4,
+    LINE_FUNCTION_ID = 1,
+    LINE_LINE = 2,
+    FUNCTION_ID = 1,
+    FUNCTION_NAME = 2,
+    FUNCTION_SYSTEM_NAME = 3,
+    FUNCTION_FILENAME = 4,
+};
+
+} // namespace
+
+SamplingProfiler::SamplingProfiler() : active(false), interval(0), startTimeNs(0) {
+    clear();
+}
+
+void SamplingProfiler::start(int64_t intervalUs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    clear();
+    interval = std::chrono::microseconds(std::max<int64_t>(intervalUs, 1));
+    startTime = Clock::now();
+    nextSample = startTime + interval;
+    startTimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    active.store(true, std::memory_order_relaxed);
+}
+
+std::vector<uint8_t> SamplingProfiler::stop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!active.load(std::memory_order_relaxed)) {
+        return std::vector<uint8_t>();
+    }
+    active.store(false, std::memory_order_relaxed);
+    int64_t durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - startTime).count();
+    std::vector<uint8_t> profile = serialize(durationNs);
+    clear();
+    return profile;
+}
+
+void SamplingProfiler::sample(JSContext *ctx) {
+    if (!isActive()) {
+        return;
+    }
+    Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!active.load(std::memory_order_relaxed) || now < nextSample) {
+        return;
+    }
+    // Polls can be further apart than the interval; skip the missed ones
+    // rather than crediting this stack with time it may not have used
+    nextSample = now + interval;
+
+    currentStack.clear();
+    JS_VisitStackFrames(ctx, visitFrame, this, MAX_FRAMES);
+    if (!currentStack.empty()) {
+        stacks[currentStack]++;
+    }
+}
+
+void SamplingProfiler::visitFrame(void *opaque, const char *functionName, const char *filename, int line) {
+    SamplingProfiler *profiler = static_cast<SamplingProfiler *>(opaque);
+    profiler->currentStack.push_back(profiler->locationId(functionName, filename, line));
+}
+
+uint64_t SamplingProfiler::internString(const std::string &s) {
+    auto it = stringIds.find(s);
+    if (it != stringIds.end()) {
+        return it->second;
+    }
+    uint64_t id = strings.size();
+    strings.push_back(s);
+    stringIds.emplace(s, id);
+    return id;
+}
+
+uint64_t SamplingProfiler::locationId(const char *functionName, const char *filename, int line) {
+    uint64_t name = internString(functionName[0] ? functionName : "<anonymous>");
+    uint64_t file = internString(filename);
+
+    auto function = functionIds.find(std::make_pair(name, file));
+    uint64_t functionId;
+    if (function != functionIds.end()) {
+        functionId = function->second;
+    } else {
+        functions.push_back(Function{name, file});
+        functionId = functions.size();
+        functionIds.emplace(std::make_pair(name, file), functionId);
+    }
+
+    auto location = locationIds.find(std::make_pair(functionId, line));
+    if (location != locationIds.end()) {
+        return location->second;
+    }
+    locations.push_back(Location{functionId, line});
+    uint64_t id = locations.size();
+    locationIds.emplace(std::make_pair(functionId, line), id);
+    return id;
+}
+
+std::vector<uint8_t> SamplingProfiler::serialize(int64_t durationNs) {
+    int64_t periodNs = std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count();
+    ProtoWriter profile;
+
+    ProtoWriter samplesType;
+    samplesType.intField(VALUE_TYPE_TYPE, internString("samples"));
+    samplesType.intField(VALUE_TYPE_UNIT, internString("count"));
+    profile.messageField(PROFILE_SAMPLE_TYPE, samplesType);
+    ProtoWriter timeType;
+    timeType.intField(VALUE_TYPE_TYPE, internString("cpu"));
+    timeType.intField(VALUE_TYPE_UNIT, internString("nanoseconds"));
+    profile.messageField(PROFILE_SAMPLE_TYPE, timeType);
+
+    for (const auto &stack : stacks) {
+        ProtoWriter sample;
+        sample.packedField(SAMPLE_LOCATION_ID, stack.first);
+        sample.packedField(SAMPLE_VALUE, {static_cast<uint64_t>(stack.second),
+                                          static_cast<uint64_t>(stack.second * periodNs)});
+        profile.messageField(PROFILE_SAMPLE, sample);
+    }
+
+    for (size_t i = 0; i < locations.size(); i++) {
+        ProtoWriter line;
+        line.intField(LINE_FUNCTION_ID, locations[i].function);
+        line.intField(LINE_LINE, static_cast<uint64_t>(locations[i].line));
+        ProtoWriter location;
+        location.intField(LOCATION_ID, i + 1);
+        location.messageField(LOCATION_LINE, line);
+        profile.messageField(PROFILE_LOCATION, location);
+    }
+
+    for (size_t i = 0; i < functions.size(); i++) {
+        ProtoWriter function;
+        function.intField(FUNCTION_ID, i + 1);
+        function.intField(FUNCTION_NAME, functions[i].name);
+        function.intField(FUNCTION_SYSTEM_NAME, functions[i].name);
+        function.intField(FUNCTION_FILENAME, functions[i].filename);
+        profile.messageField(PROFILE_FUNCTION, function);
+    }
+
+    profile.intField(PROFILE_TIME_NANOS, static_cast<uint64_t>(startTimeNs));
+    profile.intField(PROFILE_DURATION_NANOS, static_cast<uint64_t>(durationNs));
+    profile.messageField(PROFILE_PERIOD_TYPE, timeType);
+    profile.intField(PROFILE_PERIOD, static_cast<uint64_t>(periodNs));
+
+    // Written last: interning above may have added strings
+    for (const std::string &s : strings) {
+        profile.bytesField(PROFILE_STRING_TABLE, s.data(), s.length());
+    }
+    return profile.out;
+}
+
+void SamplingProfiler::clear() {
+    strings.assign(1, std::string());
+    stringIds.clear();
+    stringIds.emplace(std::string(), 0);
+    functions.clear();
+    functionIds.clear();
+    locations.clear();
+    locationIds.clear();
+    stacks.clear();
+}
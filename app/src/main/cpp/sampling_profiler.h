@@ -0,0 +1,84 @@
+#ifndef QUICKJS_ANDROID_SAMPLING_PROFILER_H
+#define QUICKJS_ANDROID_SAMPLING_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+#include "quickjs/quickjs.h"
+}
+
+// Sampling profiler of the JS stack of one engine
+//
+// The engine's interrupt handler, which the interpreter polls every few
+// thousand calls and backward branches, calls sample(); while a profile is
+// active it records the stack (function, file, line) once per interval.
+// Samples are aggregated by stack and serialized as an uncompressed pprof
+// profile.proto, readable by `go tool pprof` and other pprof viewers.
+//
+// start() and stop() may be called from any thread while the engine runs.
+class SamplingProfiler {
+public:
+    static constexpr int MAX_FRAMES = 64;
+
+    SamplingProfiler();
+
+    // Begin a new profile sampled every intervalUs, discarding any previous one
+    void start(int64_t intervalUs);
+
+    // End the profile and return it in pprof format; empty if none was active
+    std::vector<uint8_t> stop();
+
+    bool isActive() const {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    // Record the current stack of ctx if the interval has elapsed
+    // Only called on the engine's thread, from its interrupt handler
+    void sample(JSContext *ctx);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    static void visitFrame(void *opaque, const char *functionName, const char *filename, int line);
+
+    uint64_t internString(const std::string &s);
+    uint64_t locationId(const char *functionName, const char *filename, int line);
+    std::vector<uint8_t> serialize(int64_t durationNs);
+    void clear();
+
+    std::mutex mutex;
+    std::atomic<bool> active;
+    Clock::duration interval;
+    Clock::time_point nextSample;
+    Clock::time_point startTime;
+    int64_t startTimeNs;  // Wall clock, for the profile's time_nanos
+
+    // pprof tables; ids are 1-based indexes, string 0 is ""
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint64_t> stringIds;
+    struct Function {
+        uint64_t name;      // String ids
+        uint64_t filename;
+    };
+    std::vector<Function> functions;
+    std::map<std::pair<uint64_t, uint64_t>, uint64_t> functionIds;
+    struct Location {
+        uint64_t function;
+        int line;
+    };
+    std::vector<Location> locations;
+    std::map<std::pair<uint64_t, int>, uint64_t> locationIds;
+
+    // Sample counts by stack of location ids, innermost first
+    std::map<std::vector<uint64_t>, int64_t> stacks;
+    std::vector<uint64_t> currentStack;
+};
+
+#endif // QUICKJS_ANDROID_SAMPLING_PROFILER_H
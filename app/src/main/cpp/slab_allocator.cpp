@@ -0,0 +1,317 @@
+#include "slab_allocator.h"
+
+#include <malloc.h>
+#include <mutex>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+
+#include "logging.h"
+
+// Chunks live in one reserved range; pages are only committed for chunks in use
+// 32-bit processes get a smaller range, and allocations beyond it fall back to malloc
+static const size_t REGION_SIZE = sizeof(void *) == 8 ? 256 * 1024 * 1024 : 64 * 1024 * 1024;
+
+// Charged per malloc'd block, as js_def_malloc does
+static const size_t MALLOC_OVERHEAD = 8;
+
+// Header at the start of every chunk, followed by its blocks
+struct SlabAllocator::Chunk {
+    Chunk *prev;      // Links in the owner's partial list of the chunk's class
+    Chunk *next;
+    void *freeList;   // Freed blocks, linked through their first word
+    uint32_t blockSize;
+    uint32_t sizeClass;
+    uint32_t bump;    // Offset of the first block never handed out
+    uint32_t live;
+    uint32_t index;   // Position in the owner's chunks
+    bool inPartial;
+};
+
+const uint32_t SlabAllocator::CLASS_SIZES[CLASS_COUNT] = {
+    16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256,
+};
+
+const JSMallocFunctions SlabAllocator::MALLOC_FUNCTIONS = {
+    SlabAllocator::jsMalloc,
+    SlabAllocator::jsFree,
+    SlabAllocator::jsRealloc,
+    SlabAllocator::jsMallocUsableSize,
+};
+
+namespace {
+
+// Blocks start 16-byte aligned, like malloc on 64-bit targets
+const uint32_t HEADER_SIZE = 64;
+
+// Reserved address range shared by every allocator in the process
+// g_regionBase and g_regionEnd are written once, before the first allocator
+// exists, so the lock-free range checks never race with them
+uintptr_t g_regionBase = 0;
+uintptr_t g_regionEnd = 0;
+std::once_flag g_regionOnce;
+std::mutex g_regionMutex;
+uintptr_t g_regionNext = 0;
+std::vector<void *> g_freeChunks;
+
+void reserveRegion() {
+    // Over-reserve by a chunk so the range can be aligned to CHUNK_SIZE
+    size_t length = REGION_SIZE + SlabAllocator::CHUNK_SIZE;
+    void *p = mmap(nullptr, length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+        LOGE("Failed to reserve slab region, small allocations will use malloc");
+        return;
+    }
+    uintptr_t base = (reinterpret_cast<uintptr_t>(p) + SlabAllocator::CHUNK_SIZE - 1) &
+                     ~(static_cast<uintptr_t>(SlabAllocator::CHUNK_SIZE) - 1);
+    g_regionBase = base;
+    g_regionEnd = base + REGION_SIZE;
+    g_regionNext = base;
+}
+
+// Returns a zeroed, writable chunk, or nullptr once the region is used up
+void *acquireChunk() {
+    std::lock_guard<std::mutex> lock(g_regionMutex);
+    if (!g_freeChunks.empty()) {
+        void *chunk = g_freeChunks.back();
+        g_freeChunks.pop_back();
+        return chunk;
+    }
+    if (g_regionNext >= g_regionEnd) {
+        return nullptr;
+    }
+    void *chunk = reinterpret_cast<void *>(g_regionNext);
+    if (mprotect(chunk, SlabAllocator::CHUNK_SIZE, PROT_READ | PROT_WRITE) != 0) {
+        return nullptr;
+    }
+    g_regionNext += SlabAllocator::CHUNK_SIZE;
+    return chunk;
+}
+
+// Give a chunk's pages back to the system; the range stays reserved for reuse
+void releaseChunk(void *chunk) {
+    madvise(chunk, SlabAllocator::CHUNK_SIZE, MADV_DONTNEED);
+    std::lock_guard<std::mutex> lock(g_regionMutex);
+    g_freeChunks.push_back(chunk);
+}
+
+} // namespace
+
+SlabAllocator::SlabAllocator(bool arena) : partial(), arena(arena) {
+    std::call_once(g_regionOnce, reserveRegion);
+}
+
+SlabAllocator::~SlabAllocator() {
+    for (Chunk *chunk : chunks) {
+        releaseChunk(chunk);
+    }
+    for (void *block : largeBlocks) {
+        free(block);
+    }
+}
+
+int SlabAllocator::sizeClass(size_t size) {
+    // Index by 16-byte granule: sizes up to 128 map one to one, larger ones by 32 bytes
+    static const int8_t CLASS_OF_GRANULE[MAX_SMALL_SIZE / 16 + 1] = {
+        0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+    };
+    if (size > MAX_SMALL_SIZE) {
+        return -1;
+    }
+    return CLASS_OF_GRANULE[(size + 15) / 16];
+}
+
+SlabAllocator::Chunk *SlabAllocator::chunkOf(const void *ptr) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+    if (address < g_regionBase || address >= g_regionEnd) {
+        return nullptr;
+    }
+    return reinterpret_cast<Chunk *>(address & ~(static_cast<uintptr_t>(CHUNK_SIZE) - 1));
+}
+
+void *SlabAllocator::allocateSmall(int sizeClass) {
+    Chunk *chunk = partial[sizeClass];
+    if (!chunk) {
+        chunk = static_cast<Chunk *>(acquireChunk());
+        if (!chunk) {
+            return nullptr;
+        }
+        chunk->prev = nullptr;
+        chunk->next = nullptr;
+        chunk->freeList = nullptr;
+        chunk->blockSize = CLASS_SIZES[sizeClass];
+        chunk->sizeClass = sizeClass;
+        chunk->bump = HEADER_SIZE;
+        chunk->live = 0;
+        chunk->index = static_cast<uint32_t>(chunks.size());
+        chunk->inPartial = true;
+        chunks.push_back(chunk);
+        partial[sizeClass] = chunk;
+    }
+
+    void *block;
+    if (chunk->freeList) {
+        block = chunk->freeList;
+        chunk->freeList = *static_cast<void **>(block);
+    } else {
+        block = reinterpret_cast<uint8_t *>(chunk) + chunk->bump;
+        chunk->bump += chunk->blockSize;
+    }
+    chunk->live++;
+
+    if (!chunk->freeList && chunk->bump + chunk->blockSize > CHUNK_SIZE) {
+        // Full: drop it from the partial list until a block is freed
+        partial[sizeClass] = chunk->next;
+        if (chunk->next) {
+            chunk->next->prev = nullptr;
+        }
+        chunk->next = nullptr;
+        chunk->inPartial = false;
+    }
+    return block;
+}
+
+void SlabAllocator::freeSmall(Chunk *chunk, void *ptr) {
+    *static_cast<void **>(ptr) = chunk->freeList;
+    chunk->freeList = ptr;
+    chunk->live--;
+
+    Chunk *&head = partial[chunk->sizeClass];
+    if (!chunk->inPartial) {
+        chunk->prev = nullptr;
+        chunk->next = head;
+        if (head) {
+            head->prev = chunk;
+        }
+        head = chunk;
+        chunk->inPartial = true;
+    }
+
+    // Release empty chunks, except the last one of a class to avoid churn
+    if (chunk->live == 0 && (chunk->prev || chunk->next)) {
+        releaseEmpty(chunk);
+    }
+}
+
+// Unlink an empty chunk from its partial list and give it back to the pool
+void SlabAllocator::releaseEmpty(Chunk *chunk) {
+    if (chunk->prev) {
+        chunk->prev->next = chunk->next;
+    } else {
+        partial[chunk->sizeClass] = chunk->next;
+    }
+    if (chunk->next) {
+        chunk->next->prev = chunk->prev;
+    }
+    Chunk *last = chunks.back();
+    last->index = chunk->index;
+    chunks[chunk->index] = last;
+    chunks.pop_back();
+    releaseChunk(chunk);
+}
+
+void SlabAllocator::trim() {
+    for (int c = 0; c < CLASS_COUNT; c++) {
+        Chunk *chunk = partial[c];
+        if (chunk && chunk->live == 0) {
+            releaseEmpty(chunk);
+        }
+    }
+}
+
+void *SlabAllocator::jsMalloc(JSMallocState *s, size_t size) {
+    SlabAllocator *self = static_cast<SlabAllocator *>(s->opaque);
+    int c = sizeClass(size);
+    if (c >= 0) {
+        size_t usable = CLASS_SIZES[c];
+        if (s->malloc_size + usable > s->malloc_limit) {
+            return nullptr;
+        }
+        void *ptr = self->allocateSmall(c);
+        if (ptr) {
+            s->malloc_count++;
+            s->malloc_size += usable;
+            return ptr;
+        }
+        // The region is used up; malloc takes over
+    }
+
+    if (s->malloc_size + size > s->malloc_limit) {
+        return nullptr;
+    }
+    void *ptr = malloc(size);
+    if (!ptr) {
+        return nullptr;
+    }
+    if (self->arena) {
+        self->largeBlocks.insert(ptr);
+    }
+    s->malloc_count++;
+    s->malloc_size += malloc_usable_size(ptr) + MALLOC_OVERHEAD;
+    return ptr;
+}
+
+void SlabAllocator::jsFree(JSMallocState *s, void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    s->malloc_count--;
+    if (Chunk *chunk = chunkOf(ptr)) {
+        s->malloc_size -= chunk->blockSize;
+        static_cast<SlabAllocator *>(s->opaque)->freeSmall(chunk, ptr);
+        return;
+    }
+    SlabAllocator *self = static_cast<SlabAllocator *>(s->opaque);
+    if (self->arena) {
+        self->largeBlocks.erase(ptr);
+    }
+    s->malloc_size -= malloc_usable_size(ptr) + MALLOC_OVERHEAD;
+    free(ptr);
+}
+
+void *SlabAllocator::jsRealloc(JSMallocState *s, void *ptr, size_t size) {
+    if (!ptr) {
+        return size ? jsMalloc(s, size) : nullptr;
+    }
+    if (size == 0) {
+        jsFree(s, ptr);
+        return nullptr;
+    }
+
+    if (Chunk *chunk = chunkOf(ptr)) {
+        if (size <= chunk->blockSize) {
+            return ptr;  // Still fits its block
+        }
+        void *grown = jsMalloc(s, size);
+        if (!grown) {
+            return nullptr;
+        }
+        memcpy(grown, ptr, chunk->blockSize);
+        jsFree(s, ptr);
+        return grown;
+    }
+
+    // malloc'd blocks stay with malloc, like js_def_realloc
+    size_t oldSize = malloc_usable_size(ptr);
+    if (s->malloc_size + size - oldSize > s->malloc_limit) {
+        return nullptr;
+    }
+    void *moved = realloc(ptr, size);
+    if (!moved) {
+        return nullptr;
+    }
+    SlabAllocator *self = static_cast<SlabAllocator *>(s->opaque);
+    if (self->arena && moved != ptr) {
+        self->largeBlocks.erase(ptr);
+        self->largeBlocks.insert(moved);
+    }
+    s->malloc_size += malloc_usable_size(moved) - oldSize;
+    return moved;
+}
+
+size_t SlabAllocator::jsMallocUsableSize(const void *ptr) {
+    if (Chunk *chunk = chunkOf(ptr)) {
+        return chunk->blockSize;
+    }
+    return malloc_usable_size(const_cast<void *>(ptr));
+}
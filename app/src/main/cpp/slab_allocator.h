@@ -0,0 +1,78 @@
+#ifndef QUICKJS_ANDROID_SLAB_ALLOCATOR_H
+#define QUICKJS_ANDROID_SLAB_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+extern "C" {
+#include "quickjs/quickjs.h"
+}
+
+// Size-class slab allocator for one JSRuntime, installed with JS_NewRuntime2
+//
+// Allocations up to MAX_SMALL_SIZE come from 64 KiB chunks, each dedicated
+// to one size class and carved from a single address range reserved for the
+// process, so any pointer is classified by a range check; larger ones fall
+// back to malloc. Chunks that become empty are returned to the process-wide
+// pool with their pages released, which keeps context resets from inflating
+// RSS. Accounting matches js_def_malloc, so JS_SetMemoryLimit and the GC
+// threshold see the same sizes.
+//
+// A runtime is only entered by the thread leasing it, so the allocator takes
+// no locks on the allocation path; only chunk acquisition and release do.
+//
+// In arena mode malloc'd blocks are tracked as well, so destroying the
+// allocator releases the whole heap of a runtime that is thrown away
+// rather than freed with JS_FreeRuntime.
+class SlabAllocator {
+public:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+    static constexpr size_t MAX_SMALL_SIZE = 256;
+
+    // Passed to JS_NewRuntime2 along with the allocator as opaque
+    static const JSMallocFunctions MALLOC_FUNCTIONS;
+
+    explicit SlabAllocator(bool arena = false);
+
+    // Returns every chunk to the pool, and in arena mode frees every malloc'd
+    // block; only once the runtime has been freed or abandoned
+    ~SlabAllocator();
+
+    SlabAllocator(const SlabAllocator &) = delete;
+    SlabAllocator &operator=(const SlabAllocator &) = delete;
+
+    // Return the empty chunk each size class keeps to avoid churn
+    void trim();
+
+    // Chunks currently held by this allocator
+    size_t chunkCount() const {
+        return chunks.size();
+    }
+
+private:
+    struct Chunk;
+
+    static constexpr int CLASS_COUNT = 12;
+    static const uint32_t CLASS_SIZES[CLASS_COUNT];
+
+    static void *jsMalloc(JSMallocState *s, size_t size);
+    static void jsFree(JSMallocState *s, void *ptr);
+    static void *jsRealloc(JSMallocState *s, void *ptr, size_t size);
+    static size_t jsMallocUsableSize(const void *ptr);
+
+    static int sizeClass(size_t size);
+    static Chunk *chunkOf(const void *ptr);
+
+    void *allocateSmall(int sizeClass);
+    void freeSmall(Chunk *chunk, void *ptr);
+    void releaseEmpty(Chunk *chunk);
+
+    Chunk *partial[CLASS_COUNT];  // Chunks with free blocks, per class
+    std::vector<Chunk *> chunks;
+    bool arena;
+    std::unordered_set<void *> largeBlocks;  // Only tracked in arena mode
+};
+
+#endif // QUICKJS_ANDROID_SLAB_ALLOCATOR_H
@@ -0,0 +1,23 @@
+#include "tracing.h"
+
+std::atomic<bool> g_tracingEnabled(false);
+
+namespace {
+
+int beginEngineSection(void *opaque, const char *name) {
+    if (!TraceSection::isTracing()) {
+        return 0;
+    }
+    ATrace_beginSection(name);
+    return 1;
+}
+
+void endEngineSection(void *opaque) {
+    ATrace_endSection();
+}
+
+} // namespace
+
+void TraceSection::install(JSRuntime *rt) {
+    JS_SetTraceFunctions(rt, beginEngineSection, endEngineSection, nullptr);
+}
@@ -0,0 +1,44 @@
+#ifndef QUICKJS_ANDROID_TRACING_H
+#define QUICKJS_ANDROID_TRACING_H
+
+#include <android/trace.h>
+#include <atomic>
+
+extern "C" {
+#include "quickjs/quickjs.h"
+}
+
+// ATrace sections around engine and bridge phases, shown in systrace/Perfetto
+// Off unless enabled from Kotlin, and then only emitted while a trace is
+// being recorded; a disabled section costs one relaxed load.
+extern std::atomic<bool> g_tracingEnabled;
+
+class TraceSection {
+public:
+    explicit TraceSection(const char *name) : active(isTracing()) {
+        if (active) {
+            ATrace_beginSection(name);
+        }
+    }
+
+    ~TraceSection() {
+        if (active) {
+            ATrace_endSection();
+        }
+    }
+
+    TraceSection(const TraceSection &) = delete;
+    TraceSection &operator=(const TraceSection &) = delete;
+
+    static bool isTracing() {
+        return g_tracingEnabled.load(std::memory_order_relaxed) && ATrace_isEnabled();
+    }
+
+    // Route the engine's own phases (GC, bytecode reading) to ATrace
+    static void install(JSRuntime *rt);
+
+private:
+    bool active;
+};
+
+#endif // QUICKJS_ANDROID_TRACING_H
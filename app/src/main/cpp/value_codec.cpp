@@ -0,0 +1,255 @@
+#include "value_codec.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Deeper results are reported as errors rather than exhausting the native stack
+const size_t MAX_DEPTH = 256;
+
+void appendVarint(std::vector<uint8_t> &out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+void appendInt32(std::vector<uint8_t> &out, int32_t v) {
+    out.push_back(ValueCodec::TAG_INT32);
+    appendVarint(out, (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31));
+}
+
+void appendFloat64(std::vector<uint8_t> &out, double d) {
+    out.push_back(ValueCodec::TAG_FLOAT64);
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(&d);  // Android targets are little endian
+    out.insert(out.end(), p, p + sizeof(d));
+}
+
+void appendBytes(std::vector<uint8_t> &out, const void *data, size_t length) {
+    appendVarint(out, length);
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    out.insert(out.end(), p, p + length);
+}
+
+void appendString(std::vector<uint8_t> &out, const std::string &s) {
+    appendBytes(out, s.data(), s.length());
+}
+
+// Append a value's string conversion as a STRING payload
+bool appendJSString(JSContext *ctx, std::vector<uint8_t> &out, JSValueConst value) {
+    size_t length;
+    const char *str = JS_ToCStringLen(ctx, &length, value);
+    if (!str) {
+        return false;
+    }
+    appendBytes(out, str, length);
+    JS_FreeCString(ctx, str);
+    return true;
+}
+
+// String conversion of a property for error records; empty if missing or failing
+std::string errorProperty(JSContext *ctx, JSValueConst error, const char *name) {
+    std::string result;
+    JSValue value = JS_GetPropertyStr(ctx, error, name);
+    const char *str = JS_IsUndefined(value) ? nullptr : JS_ToCString(ctx, value);
+    if (str) {
+        result = str;
+        JS_FreeCString(ctx, str);
+    } else if (!JS_IsUndefined(value)) {
+        JS_FreeValue(ctx, JS_GetException(ctx));
+    }
+    JS_FreeValue(ctx, value);
+    return result;
+}
+
+} // namespace
+
+bool ValueCodec::encodeValue(JSContext *ctx, JSValueConst value, std::vector<uint8_t> &out) {
+    Path path;
+    return encode(ctx, value, out, path);
+}
+
+void ValueCodec::encodeException(JSContext *ctx, ErrorKind kind, std::vector<uint8_t> &out) {
+    JSValue exception = JS_GetException(ctx);
+
+    std::string name;
+    std::string message;
+    std::string stack;
+    if (JS_IsError(ctx, exception)) {
+        name = errorProperty(ctx, exception, "name");
+        message = errorProperty(ctx, exception, "message");
+        stack = errorProperty(ctx, exception, "stack");
+    } else {
+        // Thrown non-Error values are reported by their string conversion
+        const char *str = JS_ToCString(ctx, exception);
+        if (str) {
+            message = str;
+            JS_FreeCString(ctx, str);
+        } else {
+            JS_FreeValue(ctx, JS_GetException(ctx));
+            message = "Unknown error (exception could not be converted to string)";
+        }
+    }
+    JS_FreeValue(ctx, exception);
+
+    out.push_back(TAG_ERROR);
+    out.push_back(kind);
+    appendString(out, name);
+    appendString(out, message);
+    appendString(out, stack);
+}
+
+void ValueCodec::encodeHostError(const std::string &message, std::vector<uint8_t> &out) {
+    encodeError(ERROR_HOST, message, out);
+}
+
+void ValueCodec::encodeError(ErrorKind kind, const std::string &message, std::vector<uint8_t> &out) {
+    out.push_back(TAG_ERROR);
+    out.push_back(kind);
+    appendString(out, "Error");
+    appendString(out, message);
+    appendString(out, "");
+}
+
+bool ValueCodec::encode(JSContext *ctx, JSValueConst value, std::vector<uint8_t> &out, Path &path) {
+    switch (JS_VALUE_GET_NORM_TAG(value)) {
+    case JS_TAG_INT:
+        appendInt32(out, JS_VALUE_GET_INT(value));
+        return true;
+    case JS_TAG_FLOAT64: {
+        double d = JS_VALUE_GET_FLOAT64(value);
+        // Integral doubles take the compact form; -0 must stay a double
+        if (d >= INT32_MIN && d <= INT32_MAX && d == std::floor(d) && !(d == 0 && std::signbit(d))) {
+            appendInt32(out, static_cast<int32_t>(d));
+        } else {
+            appendFloat64(out, d);
+        }
+        return true;
+    }
+    case JS_TAG_BOOL:
+        out.push_back(JS_VALUE_GET_BOOL(value) ? TAG_TRUE : TAG_FALSE);
+        return true;
+    case JS_TAG_NULL:
+        out.push_back(TAG_NULL);
+        return true;
+    case JS_TAG_STRING:
+        out.push_back(TAG_STRING);
+        return appendJSString(ctx, out, value);
+    case JS_TAG_BIG_INT:
+    case JS_TAG_SHORT_BIG_INT:
+        out.push_back(TAG_BIGINT);
+        return appendJSString(ctx, out, value);
+    case JS_TAG_OBJECT:
+    {
+        if (JS_IsFunction(ctx, value)) {
+            out.push_back(TAG_UNDEFINED);
+            return true;
+        }
+        const void *object = JS_VALUE_GET_PTR(value);
+        if (std::find(path.begin(), path.end(), object) != path.end()) {
+            JS_ThrowTypeError(ctx, "Cannot encode a cyclic result");
+            return false;
+        }
+        if (path.size() >= MAX_DEPTH) {
+            JS_ThrowRangeError(ctx, "Result is nested too deeply");
+            return false;
+        }
+        path.push_back(object);
+        bool ok = encodeObject(ctx, value, out, path);
+        path.pop_back();
+        return ok;
+    }
+    default:
+        // undefined, symbols and internal tags
+        out.push_back(TAG_UNDEFINED);
+        return true;
+    }
+}
+
+bool ValueCodec::encodeObject(JSContext *ctx, JSValueConst value, std::vector<uint8_t> &out, Path &path) {
+    // Binary data is copied out in one piece
+    if (JS_IsArrayBuffer(value)) {
+        size_t size;
+        uint8_t *data = JS_GetArrayBuffer(ctx, &size, value);
+        if (!data) {
+            return false;
+        }
+        out.push_back(TAG_BYTES);
+        appendBytes(out, data, size);
+        return true;
+    }
+    if (JS_GetTypedArrayType(value) >= 0) {
+        size_t offset, length;
+        JSValue buffer = JS_GetTypedArrayBuffer(ctx, value, &offset, &length, nullptr);
+        if (JS_IsException(buffer)) {
+            return false;
+        }
+        size_t size;
+        uint8_t *data = JS_GetArrayBuffer(ctx, &size, buffer);
+        JS_FreeValue(ctx, buffer);
+        if (!data) {
+            return false;
+        }
+        out.push_back(TAG_BYTES);
+        appendBytes(out, data + offset, length);
+        return true;
+    }
+
+    int isArray = JS_IsArray(ctx, value);
+    if (isArray < 0) {
+        return false;
+    }
+    if (isArray) {
+        return encodeArray(ctx, value, out, path);
+    }
+
+    JSPropertyEnum *properties;
+    uint32_t count;
+    if (JS_GetOwnPropertyNames(ctx, &properties, &count, value, JS_GPN_STRING_MASK | JS_GPN_ENUM_ONLY) < 0) {
+        return false;
+    }
+
+    bool ok = true;
+    out.push_back(TAG_OBJECT);
+    appendVarint(out, count);
+    for (uint32_t i = 0; i < count && ok; i++) {
+        JSValue key = JS_AtomToString(ctx, properties[i].atom);
+        JSValue property = JS_IsException(key) ? JS_EXCEPTION : JS_GetProperty(ctx, value, properties[i].atom);
+        ok = !JS_IsException(property) && appendJSString(ctx, out, key) && encode(ctx, property, out, path);
+        JS_FreeValue(ctx, key);
+        JS_FreeValue(ctx, property);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        JS_FreeAtom(ctx, properties[i].atom);
+    }
+    js_free(ctx, properties);
+    return ok;
+}
+
+bool ValueCodec::encodeArray(JSContext *ctx, JSValueConst value, std::vector<uint8_t> &out, Path &path) {
+    JSValue lengthValue = JS_GetPropertyStr(ctx, value, "length");
+    uint32_t length;
+    int err = JS_ToUint32(ctx, &length, lengthValue);
+    JS_FreeValue(ctx, lengthValue);
+    if (err) {
+        return false;
+    }
+
+    out.push_back(TAG_ARRAY);
+    appendVarint(out, length);
+    for (uint32_t i = 0; i < length; i++) {
+        JSValue element = JS_GetPropertyUint32(ctx, value, i);
+        if (JS_IsException(element)) {
+            return false;
+        }
+        bool ok = encode(ctx, element, out, path);
+        JS_FreeValue(ctx, element);
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
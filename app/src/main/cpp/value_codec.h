@@ -0,0 +1,72 @@
+#ifndef QUICKJS_ANDROID_VALUE_CODEC_H
+#define QUICKJS_ANDROID_VALUE_CODEC_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "quickjs/quickjs.h"
+}
+
+// Compact binary encoding of JS results handed to Kotlin, decoded by JsValueCodec.kt
+//
+// A result is one value, or a single error record:
+//   value     tag byte, followed by
+//               INT32    zigzag varint
+//               FLOAT64  8 bytes
+//               STRING   varint byte length, UTF-8 bytes
+//               BIGINT   decimal digits as a STRING payload
+//               BYTES    varint length, raw bytes (ArrayBuffer and typed array views)
+//               ARRAY    varint count, values
+//               OBJECT   varint count, (STRING payload key, value) pairs
+//   error     ERROR tag, kind byte, name, message and stack as STRING payloads
+//
+// Functions and symbols encode as UNDEFINED. Objects encode their own
+// enumerable string-keyed properties, like JSON.stringify.
+class ValueCodec {
+public:
+    enum Tag : uint8_t {
+        TAG_UNDEFINED = 0,
+        TAG_NULL = 1,
+        TAG_FALSE = 2,
+        TAG_TRUE = 3,
+        TAG_INT32 = 4,
+        TAG_FLOAT64 = 5,
+        TAG_STRING = 6,
+        TAG_BIGINT = 7,
+        TAG_BYTES = 8,
+        TAG_ARRAY = 9,
+        TAG_OBJECT = 10,
+        TAG_ERROR = 11,
+    };
+
+    enum ErrorKind : uint8_t {
+        ERROR_SCRIPT = 0,     // Thrown while evaluating the script
+        ERROR_REJECTION = 1,  // The script's promise was rejected
+        ERROR_HOST = 2,       // Raised by the bridge, not by JavaScript
+        ERROR_TIMEOUT = 3,    // Stopped when the execution timeout elapsed
+        ERROR_CANCELLED = 4,  // Stopped by a cancel from another thread
+    };
+
+    // Encode a value; on failure returns false with an exception pending in ctx
+    static bool encodeValue(JSContext *ctx, JSValueConst value, std::vector<uint8_t> &out);
+
+    // Take the pending exception of ctx and encode it as an error record
+    static void encodeException(JSContext *ctx, ErrorKind kind, std::vector<uint8_t> &out);
+
+    static void encodeHostError(const std::string &message, std::vector<uint8_t> &out);
+
+    // Encode an error record of the given kind that did not come from a JS exception
+    static void encodeError(ErrorKind kind, const std::string &message, std::vector<uint8_t> &out);
+
+private:
+    // Objects currently being encoded, outermost first
+    typedef std::vector<const void *> Path;
+
+    static bool encode(JSContext *ctx, JSValueConst value, std::vector<uint8_t> &out, Path &path);
+    static bool encodeObject(JSContext *ctx, JSValueConst value, std::vector<uint8_t> &out, Path &path);
+    static bool encodeArray(JSContext *ctx, JSValueConst value, std::vector<uint8_t> &out, Path &path);
+};
+
+#endif // QUICKJS_ANDROID_VALUE_CODEC_H
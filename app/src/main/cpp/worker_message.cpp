@@ -0,0 +1,201 @@
+#include "worker_message.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+const int WRITE_FLAGS = JS_WRITE_OBJ_SAB | JS_WRITE_OBJ_REFERENCE;
+const int READ_FLAGS = JS_READ_OBJ_SAB | JS_READ_OBJ_REFERENCE;
+
+// Header in front of every SharedArrayBuffer block; keeps the data 16-byte aligned
+struct alignas(16) SharedHeader {
+    std::atomic<int> refCount;
+};
+
+SharedHeader *headerOf(void *ptr) {
+    return reinterpret_cast<SharedHeader *>(static_cast<uint8_t *>(ptr) - sizeof(SharedHeader));
+}
+
+// ArrayBuffer free callback for storage received from another runtime
+void freeTransferred(JSRuntime *rt, void *opaque, void *ptr) {
+    TransferredBuffer *buffer = static_cast<TransferredBuffer *>(opaque);
+    buffer->home->returnBuffer(buffer);
+}
+
+// Collect the ArrayBuffers of a transfer list, checking each can be detached
+bool collectTransfers(JSContext *ctx, JSValueConst transfer, std::vector<JSValue> &buffers) {
+    if (JS_IsUndefined(transfer)) {
+        return true;
+    }
+    int isArray = JS_IsArray(ctx, transfer);
+    if (isArray <= 0) {
+        if (isArray == 0) {
+            JS_ThrowTypeError(ctx, "Transfer list must be an array");
+        }
+        return false;
+    }
+    JSValue lengthValue = JS_GetPropertyStr(ctx, transfer, "length");
+    uint32_t length;
+    if (JS_ToUint32(ctx, &length, lengthValue)) {
+        JS_FreeValue(ctx, lengthValue);
+        return false;
+    }
+    JS_FreeValue(ctx, lengthValue);
+
+    for (uint32_t i = 0; i < length; i++) {
+        JSValue buffer = JS_GetPropertyUint32(ctx, transfer, i);
+        if (JS_IsException(buffer)) {
+            return false;
+        }
+        buffers.push_back(buffer);
+        if (!JS_IsArrayBuffer(buffer)) {
+            JS_ThrowTypeError(ctx, "Only ArrayBuffers can be transferred");
+            return false;
+        }
+        size_t size;
+        if (!JS_GetArrayBuffer(ctx, &size, buffer)) {
+            return false;  // Detached
+        }
+        for (uint32_t j = 0; j < i; j++) {
+            if (JS_VALUE_GET_PTR(buffers[j]) == JS_VALUE_GET_PTR(buffer)) {
+                JS_ThrowTypeError(ctx, "ArrayBuffer is listed twice in the transfer list");
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+const JSSharedArrayBufferFunctions SharedBuffers::FUNCTIONS = {
+    SharedBuffers::allocate,
+    SharedBuffers::release,
+    SharedBuffers::retain,
+    nullptr,
+};
+
+void *SharedBuffers::allocate(void *opaque, size_t size) {
+    void *block = malloc(sizeof(SharedHeader) + size);
+    if (!block) {
+        return nullptr;
+    }
+    SharedHeader *header = new (block) SharedHeader;
+    header->refCount.store(1, std::memory_order_relaxed);
+    return header + 1;
+}
+
+void SharedBuffers::release(void *opaque, void *ptr) {
+    SharedHeader *header = headerOf(ptr);
+    if (header->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        header->~SharedHeader();
+        free(header);
+    }
+}
+
+void SharedBuffers::retain(void *opaque, void *ptr) {
+    headerOf(ptr)->refCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void TransferredBuffer::free() {
+    if (freeFunc) {
+        freeFunc(runtime, opaque, data);
+    }
+}
+
+WorkerMessage::~WorkerMessage() {
+    for (uint8_t *buffer : sharedBuffers) {
+        SharedBuffers::release(nullptr, buffer);
+    }
+    // Never delivered; the storage still goes back to be freed at home
+    for (TransferredBuffer *buffer : transfers) {
+        buffer->home->returnBuffer(buffer);
+    }
+}
+
+bool WorkerMessage::write(JSContext *ctx, BufferHome *home, JSValueConst value, JSValueConst transfer) {
+    std::vector<JSValue> buffers;
+    bool ok = collectTransfers(ctx, transfer, buffers);
+
+    size_t size = 0;
+    uint8_t **sabTab = nullptr;
+    size_t sabCount = 0;
+    uint8_t *bytes = nullptr;
+    if (ok) {
+        bytes = JS_WriteObject3(ctx, &size, value, WRITE_FLAGS, &sabTab, &sabCount,
+                                buffers.data(), static_cast<int>(buffers.size()));
+        ok = bytes != nullptr;
+    }
+    if (ok) {
+        // The sender's allocator may not be usable from the receiving thread
+        data.assign(bytes, bytes + size);
+        for (size_t i = 0; i < sabCount; i++) {
+            SharedBuffers::retain(nullptr, sabTab[i]);
+            sharedBuffers.push_back(sabTab[i]);
+        }
+
+        // Serialized without error, so every listed buffer can be detached
+        JSRuntime *rt = JS_GetRuntime(ctx);
+        for (JSValue buffer : buffers) {
+            TransferredBuffer moved = {home, rt, nullptr, 0, nullptr, nullptr};
+            moved.data = JS_TransferArrayBuffer(ctx, buffer, &moved.length, &moved.freeFunc, &moved.opaque);
+            if (moved.freeFunc == freeTransferred) {
+                // Received from elsewhere; its home stays the same
+                transfers.push_back(static_cast<TransferredBuffer *>(moved.opaque));
+            } else {
+                transfers.push_back(new TransferredBuffer(moved));
+            }
+        }
+    }
+    js_free(ctx, bytes);
+    js_free(ctx, sabTab);
+    for (JSValue buffer : buffers) {
+        JS_FreeValue(ctx, buffer);
+    }
+    return ok;
+}
+
+size_t WorkerMessage::transfersFrom(const BufferHome *home) const {
+    return std::count_if(transfers.begin(), transfers.end(),
+                         [home](const TransferredBuffer *buffer) { return buffer->home == home; });
+}
+
+JSValue WorkerMessage::read(JSContext *ctx) {
+    JSRuntime *rt = JS_GetRuntime(ctx);
+    std::vector<JSValue> buffers;
+    JSValue result = JS_UNDEFINED;
+    for (TransferredBuffer *&buffer : transfers) {
+        JSValue object;
+        if (buffer->runtime == rt) {
+            // Back home: the buffer is freed as it was before it left
+            object = JS_NewArrayBuffer(ctx, buffer->data, buffer->length,
+                                       buffer->freeFunc, buffer->opaque, false);
+            if (!JS_IsException(object)) {
+                delete buffer;
+            }
+        } else {
+            object = JS_NewArrayBuffer(ctx, buffer->data, buffer->length,
+                                       freeTransferred, buffer, false);
+        }
+        if (JS_IsException(object)) {
+            result = JS_EXCEPTION;
+            break;
+        }
+        buffer = nullptr;  // Owned by object now
+        buffers.push_back(object);
+    }
+    transfers.erase(std::remove(transfers.begin(), transfers.end(), nullptr), transfers.end());
+
+    if (!JS_IsException(result)) {
+        result = JS_ReadObject2(ctx, data.data(), data.size(), READ_FLAGS,
+                                buffers.data(), static_cast<int>(buffers.size()));
+    }
+    for (JSValue buffer : buffers) {
+        JS_FreeValue(ctx, buffer);
+    }
+    data.clear();
+    return result;
+}
@@ -0,0 +1,86 @@
+#ifndef QUICKJS_ANDROID_WORKER_MESSAGE_H
+#define QUICKJS_ANDROID_WORKER_MESSAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+extern "C" {
+#include "quickjs/quickjs.h"
+}
+
+// Process-wide storage of SharedArrayBuffers, installed in every runtime that
+// can exchange messages with workers
+//
+// Blocks are malloc'd with an atomic reference count, so each runtime a
+// SharedArrayBuffer is posted to maps the same bytes, and Atomics operate on
+// them across threads. The memory is not charged to any runtime's limit.
+class SharedBuffers {
+public:
+    static const JSSharedArrayBufferFunctions FUNCTIONS;
+
+    static void *allocate(void *opaque, size_t size);
+    static void release(void *opaque, void *ptr);
+    static void retain(void *opaque, void *ptr);
+};
+
+struct TransferredBuffer;
+
+// Runtime whose allocator owns the storage of transferred ArrayBuffers
+// Storage is only ever freed by its home runtime, on the thread running it,
+// so a buffer can move between runtimes without being copied.
+class BufferHome {
+public:
+    // Queue buffer to be freed by its home; callable from any thread
+    virtual void returnBuffer(TransferredBuffer *buffer) = 0;
+
+protected:
+    ~BufferHome() = default;
+};
+
+// Storage of an ArrayBuffer detached by postMessage(), with what frees it
+struct TransferredBuffer {
+    BufferHome *home;
+    JSRuntime *runtime;                    // Runtime of home
+    uint8_t *data;
+    size_t length;
+    JSFreeArrayBufferDataFunc *freeFunc;   // As set on the original ArrayBuffer
+    void *opaque;
+
+    // Release the storage; requires the thread running runtime
+    void free();
+};
+
+// A value posted between an engine and one of its workers
+//
+// The value is serialized with JS_WriteObject3(), which copies plain data
+// and keeps object identity. SharedArrayBuffers are referenced, and the
+// ArrayBuffers of the transfer list are detached in the sender and move
+// to the receiver by pointer.
+class WorkerMessage {
+public:
+    WorkerMessage() = default;
+    ~WorkerMessage();
+
+    WorkerMessage(const WorkerMessage &) = delete;
+    WorkerMessage &operator=(const WorkerMessage &) = delete;
+
+    // Serialize value, detaching the ArrayBuffers listed in transfer (an
+    // array, or undefined); home receives them back once freed elsewhere
+    // On failure returns false with an exception pending and nothing detached
+    bool write(JSContext *ctx, BufferHome *home, JSValueConst value, JSValueConst transfer);
+
+    // Recreate the value in ctx, handing it the transferred buffers
+    // Can only be read once
+    JSValue read(JSContext *ctx);
+
+    // Number of transferred buffers whose storage belongs to home
+    size_t transfersFrom(const BufferHome *home) const;
+
+private:
+    std::vector<uint8_t> data;
+    std::vector<uint8_t *> sharedBuffers;         // One reference each
+    std::vector<TransferredBuffer *> transfers;   // In transfer list order
+};
+
+#endif // QUICKJS_ANDROID_WORKER_MESSAGE_H
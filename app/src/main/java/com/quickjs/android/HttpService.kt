@@ -1,27 +1,89 @@
 package com.quickjs.android
 
 import android.util.Log
+import okhttp3.Cache
+import okhttp3.ConnectionPool
+import okhttp3.Headers
 import okhttp3.MediaType.Companion.toMediaType
 import okhttp3.OkHttpClient
 import okhttp3.Request
 import okhttp3.RequestBody.Companion.toRequestBody
 import okhttp3.Response
+import okhttp3.ResponseBody
+import java.io.File
+import java.nio.ByteBuffer
+import java.util.concurrent.CompletableFuture
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.ExecutionException
+import java.util.concurrent.Semaphore
 import java.util.concurrent.TimeUnit
 
 /**
  * HTTP service for making network requests from JavaScript
  * Provides HTTP functionality for fetch() and XMLHttpRequest polyfills
+ * @param cacheDirectory Where to keep a response cache that follows Cache-Control; null for none
+ *                       Services on the same directory share one cache, sized by the first
  */
-class HttpService {
+class HttpService(
+    cacheDirectory: File? = null,
+    cacheSize: Long = DEFAULT_CACHE_SIZE
+) {
     private val TAG = "HttpService"
-    
-    // OkHttp client with reasonable timeouts
+
+    companion object {
+        const val DEFAULT_CACHE_SIZE = 4L * 1024 * 1024
+
+        // Requests to one host at a time, as browsers allow; more wait for a permit
+        private const val MAX_REQUESTS_PER_HOST = 6
+
+        // Kept open between requests; HTTP/2 connections carry every request to their host
+        private val connectionPool = ConnectionPool(8, 5, TimeUnit.MINUTES)
+
+        // Response caches by directory; OkHttp allows only one Cache per directory in a process
+        private val caches = ConcurrentHashMap<String, Cache>()
+
+        // The Cache of directory, made with maxSize by the first service to use it
+        private fun sharedCache(directory: File, maxSize: Long): Cache =
+            caches.computeIfAbsent(directory.canonicalPath) { Cache(directory, maxSize) }
+    }
+
+    /**
+     * A response read to the end
+     * body holds bodyLength bytes followed by a NUL byte, so native code can parse it in place
+     */
+    class BufferedResponse(
+        val code: Int,
+        val message: String,
+        val headers: Headers,
+        val body: ByteBuffer,
+        val bodyLength: Int
+    ) {
+        // Same response with a body of its own, for another requester to own
+        internal fun copy(): BufferedResponse {
+            val source = body.duplicate()
+            source.clear()
+            val copy = ByteBuffer.allocateDirect(source.capacity())
+            copy.put(source)
+            copy.position(bodyLength)
+            return BufferedResponse(code, message, headers, copy, bodyLength)
+        }
+    }
+
+    // OkHttp client with reasonable timeouts, sharing connections with every other HttpService
     private val client = OkHttpClient.Builder()
         .connectTimeout(15, TimeUnit.SECONDS)
         .readTimeout(30, TimeUnit.SECONDS)
         .writeTimeout(30, TimeUnit.SECONDS)
+        .connectionPool(connectionPool)
+        .apply { cacheDirectory?.let { cache(sharedCache(it, cacheSize)) } }
         .build()
 
+    // Permits per host and port for exchange()
+    private val hostPermits = ConcurrentHashMap<String, Semaphore>()
+
+    // Identical requests in flight, keyed by coalescingKey(); waiters get copies of the response
+    private val inFlight = HashMap<String, MutableList<CompletableFuture<BufferedResponse>>>()
+
     /**
      * Make an HTTP request
      * @param url The URL to request
@@ -41,52 +103,7 @@ class HttpService {
         Log.d(TAG, "Making $method request to: $url")
         
         try {
-            // Create request builder
-            val requestBuilder = Request.Builder()
-                .url(url)
-            
-            // Add headers
-            headers.forEach { (name, value) ->
-                requestBuilder.addHeader(name, value)
-            }
-            
-            // Set method and body
-            when (method.uppercase()) {
-                "GET" -> requestBuilder.get()
-                "POST" -> {
-                    val requestBody = body?.toRequestBody("application/json".toMediaType())
-                        ?: "".toRequestBody("text/plain".toMediaType())
-                    requestBuilder.post(requestBody)
-                }
-                "PUT" -> {
-                    val requestBody = body?.toRequestBody("application/json".toMediaType())
-                        ?: "".toRequestBody("text/plain".toMediaType())
-                    requestBuilder.put(requestBody)
-                }
-                "DELETE" -> requestBuilder.delete()
-                "PATCH" -> {
-                    val requestBody = body?.toRequestBody("application/json".toMediaType())
-                        ?: "".toRequestBody("text/plain".toMediaType())
-                    requestBuilder.patch(requestBody)
-                }
-                "HEAD" -> requestBuilder.head()
-                else -> requestBuilder.get() // Default to GET for unknown methods
-            }
-            
-            // Create client with custom timeout if needed
-            val requestClient = if (timeoutMs != 30000) {
-                client.newBuilder()
-                    .connectTimeout(timeoutMs.toLong(), TimeUnit.MILLISECONDS)
-                    .readTimeout(timeoutMs.toLong(), TimeUnit.MILLISECONDS)
-                    .writeTimeout(timeoutMs.toLong(), TimeUnit.MILLISECONDS)
-                    .build()
-            } else {
-                client
-            }
-            
-            // Execute request
-            val request = requestBuilder.build()
-            val response = requestClient.newCall(request).execute()
+            val response = clientFor(timeoutMs).newCall(buildRequest(url, method, headers, body)).execute()
             
             Log.d(TAG, "Request completed: ${response.code} ${response.message}")
             return response
@@ -97,6 +114,180 @@ class HttpService {
         }
     }
 
+    /**
+     * Make an HTTP request and read its whole response
+     * Identical GET and HEAD requests already in flight are joined instead of being sent
+     * again, and at most MAX_REQUESTS_PER_HOST run at once against any one host
+     * Parameters are as for makeRequest()
+     * @throws Exception What makeRequest() throws, also to the requests that joined
+     */
+    fun exchange(
+        url: String,
+        method: String = "GET",
+        headers: Map<String, String> = emptyMap(),
+        body: String? = null,
+        timeoutMs: Int = 30000
+    ): BufferedResponse {
+        val key = coalescingKey(url, method, headers, body, timeoutMs)
+            ?: return exchangeOnce(url, method, headers, body, timeoutMs)
+        
+        val joined = synchronized(inFlight) {
+            inFlight[key]?.let { waiters ->
+                CompletableFuture<BufferedResponse>().also { waiters.add(it) }
+            } ?: run {
+                inFlight[key] = mutableListOf()
+                null
+            }
+        }
+        if (joined != null) {
+            Log.d(TAG, "Joined request in flight: $method $url")
+            try {
+                return joined.get()
+            } catch (e: ExecutionException) {
+                throw e.cause ?: e
+            }
+        }
+        
+        val response = try {
+            exchangeOnce(url, method, headers, body, timeoutMs)
+        } catch (e: Throwable) {
+            synchronized(inFlight) { inFlight.remove(key) }?.forEach { it.completeExceptionally(e) }
+            throw e
+        }
+        // Copied before returning, while nothing can be writing to the body yet
+        synchronized(inFlight) { inFlight.remove(key) }?.forEach { it.complete(response.copy()) }
+        return response
+    }
+
+    private fun exchangeOnce(
+        url: String,
+        method: String,
+        headers: Map<String, String>,
+        body: String?,
+        timeoutMs: Int
+    ): BufferedResponse {
+        val request = buildRequest(url, method, headers, body)
+        val permits = hostPermits.computeIfAbsent("${request.url.host}:${request.url.port}") {
+            Semaphore(MAX_REQUESTS_PER_HOST)
+        }
+        permits.acquire()
+        try {
+            clientFor(timeoutMs).newCall(request).execute().use { response ->
+                Log.d(TAG, "Request completed: ${response.code} ${response.message}" +
+                    if (response.networkResponse == null) " (cached)" else "")
+                val (buffer, length) = readBodyDirect(response.body)
+                return BufferedResponse(response.code, response.message, response.headers, buffer, length)
+            }
+        } catch (e: Exception) {
+            Log.e(TAG, "HTTP request failed: $url", e)
+            throw e
+        } finally {
+            permits.release()
+        }
+    }
+
+    // Requests that may share one response; header names are sorted, so their order does not
+    // matter, and every header is part of the key since Vary is not known before the response
+    private fun coalescingKey(
+        url: String,
+        method: String,
+        headers: Map<String, String>,
+        body: String?,
+        timeoutMs: Int
+    ): String? {
+        val verb = method.uppercase()
+        if ((verb != "GET" && verb != "HEAD") || body != null) {
+            return null
+        }
+        return buildString {
+            append(verb).append(' ').append(url).append(' ').append(timeoutMs)
+            headers.entries
+                .map { (name, value) -> name.lowercase() to value }
+                .sortedWith(compareBy({ it.first }, { it.second }))
+                .forEach { (name, value) -> append('\n').append(name).append(':').append(value) }
+        }
+    }
+
+    private fun buildRequest(url: String, method: String, headers: Map<String, String>, body: String?): Request {
+        // Create request builder
+        val requestBuilder = Request.Builder()
+            .url(url)
+        
+        // Add headers
+        headers.forEach { (name, value) ->
+            requestBuilder.addHeader(name, value)
+        }
+        
+        // Set method and body
+        when (method.uppercase()) {
+            "GET" -> requestBuilder.get()
+            "POST" -> {
+                val requestBody = body?.toRequestBody("application/json".toMediaType())
+                    ?: "".toRequestBody("text/plain".toMediaType())
+                requestBuilder.post(requestBody)
+            }
+            "PUT" -> {
+                val requestBody = body?.toRequestBody("application/json".toMediaType())
+                    ?: "".toRequestBody("text/plain".toMediaType())
+                requestBuilder.put(requestBody)
+            }
+            "DELETE" -> requestBuilder.delete()
+            "PATCH" -> {
+                val requestBody = body?.toRequestBody("application/json".toMediaType())
+                    ?: "".toRequestBody("text/plain".toMediaType())
+                requestBuilder.patch(requestBody)
+            }
+            "HEAD" -> requestBuilder.head()
+            else -> requestBuilder.get() // Default to GET for unknown methods
+        }
+        return requestBuilder.build()
+    }
+
+    // Client with custom timeouts if needed; derived clients share the connection pool and cache
+    private fun clientFor(timeoutMs: Int): OkHttpClient {
+        return if (timeoutMs != 30000) {
+            client.newBuilder()
+                .connectTimeout(timeoutMs.toLong(), TimeUnit.MILLISECONDS)
+                .readTimeout(timeoutMs.toLong(), TimeUnit.MILLISECONDS)
+                .writeTimeout(timeoutMs.toLong(), TimeUnit.MILLISECONDS)
+                .build()
+        } else {
+            client
+        }
+    }
+
+    /**
+     * Read a response body into a direct buffer, leaving a NUL byte after the content
+     * @return The buffer and the number of content bytes
+     */
+    private fun readBodyDirect(body: ResponseBody?): Pair<ByteBuffer, Int> {
+        val contentLength = body?.contentLength() ?: 0L
+        val initialCapacity = if (contentLength in 0L until Int.MAX_VALUE.toLong()) contentLength.toInt() + 1 else 16 * 1024
+        var buffer = ByteBuffer.allocateDirect(initialCapacity)
+        
+        body?.source()?.let { source ->
+            while (true) {
+                if (buffer.position() == buffer.capacity() - 1) {
+                    // Unknown or understated content length: grow, keeping the bytes read so far
+                    val grown = ByteBuffer.allocateDirect(buffer.capacity() * 2)
+                    buffer.flip()
+                    grown.put(buffer)
+                    buffer = grown
+                }
+                // Reserve the last byte for the terminator
+                buffer.limit(buffer.capacity() - 1)
+                if (source.read(buffer) < 0) {
+                    break
+                }
+            }
+        }
+        
+        val length = buffer.position()
+        buffer.limit(buffer.capacity())
+        buffer.put(length, 0.toByte())
+        return Pair(buffer, length)
+    }
+
     /**
      * Make a simple GET request
      * @param url The URL to request
@@ -0,0 +1,38 @@
+package com.quickjs.android
+
+/**
+ * Cancels a JavaScript execution from any thread
+ * Pass the token to an execution and call cancel(); a running script stops at its next
+ * interrupt check or wakeup, and one that has not started yet fails as soon as it starts.
+ * The execution then fails with "Error: Execution cancelled", or JsResult.ErrorKind.CANCELLED.
+ */
+class JsCancellationToken {
+    private var canceller: (() -> Unit)? = null
+
+    @Volatile
+    var isCancelled = false
+        private set
+
+    fun cancel() {
+        synchronized(this) {
+            isCancelled = true
+            canceller?.invoke()
+        }
+    }
+
+    // Bound by the bridge while an execution holds an engine; canceller must not block
+    internal fun attach(canceller: () -> Unit) {
+        synchronized(this) {
+            this.canceller = canceller
+            if (isCancelled) {
+                canceller()
+            }
+        }
+    }
+
+    internal fun detach() {
+        synchronized(this) {
+            canceller = null
+        }
+    }
+}
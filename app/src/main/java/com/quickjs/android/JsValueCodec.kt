@@ -0,0 +1,129 @@
+package com.quickjs.android
+
+import java.math.BigInteger
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * Result of a typed JavaScript execution
+ * Values arrive as Kotlin objects, and errors come through their own channel instead of
+ * being folded into the result string
+ */
+sealed class JsResult {
+    data class Success(val value: Any?) : JsResult()
+
+    data class Failure(
+        val kind: ErrorKind,
+        val name: String,
+        val message: String,
+        val stack: String
+    ) : JsResult()
+
+    enum class ErrorKind {
+        SCRIPT,     // Thrown while evaluating the script
+        REJECTION,  // The script's promise was rejected
+        HOST,       // Raised by the bridge, e.g. an unencodable result
+        TIMEOUT,    // Stopped when the execution timeout elapsed
+        CANCELLED   // Stopped through a JsCancellationToken
+    }
+}
+
+/**
+ * JavaScript undefined; JavaScript null is represented by Kotlin null
+ */
+object JsUndefined {
+    override fun toString() = "undefined"
+}
+
+/**
+ * Decoder for the native ValueCodec encoding (see value_codec.h)
+ * Numbers become Int or Double, BigInts BigInteger, ArrayBuffers and typed arrays ByteArray,
+ * arrays List<Any?> and objects Map<String, Any?> in property order
+ */
+internal object JsValueCodec {
+    private const val TAG_UNDEFINED = 0
+    private const val TAG_NULL = 1
+    private const val TAG_FALSE = 2
+    private const val TAG_TRUE = 3
+    private const val TAG_INT32 = 4
+    private const val TAG_FLOAT64 = 5
+    private const val TAG_STRING = 6
+    private const val TAG_BIGINT = 7
+    private const val TAG_BYTES = 8
+    private const val TAG_ARRAY = 9
+    private const val TAG_OBJECT = 10
+    private const val TAG_ERROR = 11
+
+    fun decode(bytes: ByteArray): JsResult {
+        return readResult(ByteBuffer.wrap(bytes).order(ByteOrder.LITTLE_ENDIAN))
+    }
+
+    // Results of a batch, encoded back to back
+    fun decodeAll(bytes: ByteArray, count: Int): List<JsResult> {
+        val buffer = ByteBuffer.wrap(bytes).order(ByteOrder.LITTLE_ENDIAN)
+        return List(count) { readResult(buffer) }
+    }
+
+    private fun readResult(buffer: ByteBuffer): JsResult {
+        if (buffer.hasRemaining() && buffer.get(buffer.position()).toInt() == TAG_ERROR) {
+            buffer.get()
+            val kind = JsResult.ErrorKind.values().getOrElse(buffer.get().toInt()) { JsResult.ErrorKind.HOST }
+            return JsResult.Failure(kind, readString(buffer), readString(buffer), readString(buffer))
+        }
+        return JsResult.Success(readValue(buffer))
+    }
+
+    private fun readValue(buffer: ByteBuffer): Any? {
+        return when (val tag = buffer.get().toInt()) {
+            TAG_UNDEFINED -> JsUndefined
+            TAG_NULL -> null
+            TAG_FALSE -> false
+            TAG_TRUE -> true
+            TAG_INT32 -> {
+                val zigzag = readVarint(buffer).toInt()
+                (zigzag ushr 1) xor -(zigzag and 1)
+            }
+            TAG_FLOAT64 -> buffer.double
+            TAG_STRING -> readString(buffer)
+            TAG_BIGINT -> BigInteger(readString(buffer))
+            TAG_BYTES -> readBytes(buffer)
+            TAG_ARRAY -> List(readVarint(buffer).toInt()) { readValue(buffer) }
+            TAG_OBJECT -> {
+                val count = readVarint(buffer).toInt()
+                LinkedHashMap<String, Any?>(count).apply {
+                    repeat(count) {
+                        val key = readString(buffer)
+                        put(key, readValue(buffer))
+                    }
+                }
+            }
+            else -> throw IllegalArgumentException("Unknown value tag $tag")
+        }
+    }
+
+    private fun readVarint(buffer: ByteBuffer): Long {
+        var result = 0L
+        var shift = 0
+        while (true) {
+            val b = buffer.get().toInt() and 0xff
+            result = result or ((b and 0x7f).toLong() shl shift)
+            if (b < 0x80) {
+                return result
+            }
+            shift += 7
+        }
+    }
+
+    private fun readBytes(buffer: ByteBuffer): ByteArray {
+        val bytes = ByteArray(readVarint(buffer).toInt())
+        buffer.get(bytes)
+        return bytes
+    }
+
+    private fun readString(buffer: ByteBuffer): String {
+        val length = readVarint(buffer).toInt()
+        val string = String(buffer.array(), buffer.position(), length, Charsets.UTF_8)
+        buffer.position(buffer.position() + length)
+        return string
+    }
+}
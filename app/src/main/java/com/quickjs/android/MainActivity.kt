@@ -44,6 +44,13 @@ class MainActivity : ComponentActivity() {
         }
     }
     
+    override fun onTrimMemory(level: Int) {
+        super.onTrimMemory(level)
+        if (::quickJSBridge.isInitialized) {
+            quickJSBridge.onTrimMemory(level)
+        }
+    }
+    
     override fun onDestroy() {
         super.onDestroy()
         if (::quickJSBridge.isInitialized) {
@@ -6,6 +6,8 @@ import kotlinx.coroutines.withContext
 import java.io.IOException
 import java.net.HttpURLConnection
 import java.net.URL
+import java.nio.ByteBuffer
+import java.nio.channels.Channels
 
 /**
  * Network service for downloading JavaScript code from remote URLs
@@ -16,6 +18,25 @@ class NetworkService {
         private const val TAG = "NetworkService"
         private const val TIMEOUT_MS = 30000 // 30 seconds
         private const val MAX_CONTENT_LENGTH = 10 * 1024 * 1024 // 10MB limit
+        private const val INITIAL_BODY_CAPACITY = 64 * 1024 // For responses without Content-Length
+    }
+
+    /**
+     * Outcome of downloadScript()
+     */
+    sealed class ScriptDownload {
+        // length bytes of UTF-8 source followed by a NUL, in a direct buffer native code parses in place
+        class Body(
+            val source: ByteBuffer,
+            val length: Int,
+            val etag: String?,
+            val lastModified: String?
+        ) : ScriptDownload()
+
+        // The copy the validators came from is still current
+        object NotModified : ScriptDownload()
+
+        object Failed : ScriptDownload()
     }
     
     /**
@@ -60,6 +81,92 @@ class NetworkService {
         }
     }
     
+    /**
+     * Download a script, revalidating a cached copy when its validators are given
+     * The body is read straight into a direct buffer, without decoding it to a String
+     * @param etag ETag of the cached copy, sent as If-None-Match
+     * @param lastModified Last-Modified of the cached copy, sent as If-Modified-Since
+     */
+    suspend fun downloadScript(
+        url: String,
+        etag: String? = null,
+        lastModified: String? = null
+    ): ScriptDownload = withContext(Dispatchers.IO) {
+        try {
+            Log.i(TAG, "Downloading script from: $url")
+
+            val connection = URL(url).openConnection() as HttpURLConnection
+            connection.apply {
+                requestMethod = "GET"
+                connectTimeout = TIMEOUT_MS
+                readTimeout = TIMEOUT_MS
+                setRequestProperty("User-Agent", "QuickJS-Android/1.0")
+                setRequestProperty("Accept", "application/javascript, text/javascript, */*")
+                etag?.let { setRequestProperty("If-None-Match", it) }
+                lastModified?.let { setRequestProperty("If-Modified-Since", it) }
+            }
+
+            val responseCode = connection.responseCode
+            Log.i(TAG, "Response code: $responseCode")
+
+            when (responseCode) {
+                HttpURLConnection.HTTP_NOT_MODIFIED -> ScriptDownload.NotModified
+                HttpURLConnection.HTTP_OK -> {
+                    val source = readBody(connection) ?: return@withContext ScriptDownload.Failed
+                    val length = source.position()
+                    Log.i(TAG, "Downloaded $length bytes")
+                    source.put(0.toByte())
+                    ScriptDownload.Body(
+                        source,
+                        length,
+                        connection.getHeaderField("ETag"),
+                        connection.getHeaderField("Last-Modified")
+                    )
+                }
+                else -> {
+                    Log.e(TAG, "HTTP error: $responseCode - ${connection.responseMessage}")
+                    ScriptDownload.Failed
+                }
+            }
+        } catch (e: IOException) {
+            Log.e(TAG, "Network error downloading from $url", e)
+            ScriptDownload.Failed
+        } catch (e: Exception) {
+            Log.e(TAG, "Unexpected error downloading from $url", e)
+            ScriptDownload.Failed
+        }
+    }
+
+    // Read a response body into a direct buffer, leaving room for a NUL after it
+    private fun readBody(connection: HttpURLConnection): ByteBuffer? {
+        val contentLength = connection.contentLength
+        if (contentLength > MAX_CONTENT_LENGTH) {
+            Log.e(TAG, "Content too large: $contentLength bytes (max: $MAX_CONTENT_LENGTH)")
+            return null
+        }
+
+        var buffer = ByteBuffer.allocateDirect(if (contentLength >= 0) contentLength + 1 else INITIAL_BODY_CAPACITY)
+        Channels.newChannel(connection.inputStream).use { channel ->
+            while (true) {
+                if (!buffer.hasRemaining()) {
+                    // No Content-Length, or more than it announced; growth stops one byte
+                    // past the limit, so an oversized body is caught as soon as it is
+                    if (buffer.capacity() > MAX_CONTENT_LENGTH) {
+                        Log.e(TAG, "Content too large: more than $MAX_CONTENT_LENGTH bytes")
+                        return null
+                    }
+                    val grown = ByteBuffer.allocateDirect(minOf(buffer.capacity() * 2, MAX_CONTENT_LENGTH + 1))
+                    buffer.flip()
+                    grown.put(buffer)
+                    buffer = grown
+                }
+                if (channel.read(buffer) < 0) {
+                    return buffer
+                }
+            }
+        }
+    }
+
     /**
      * Check if a URL is reachable
      */
@@ -1,24 +1,59 @@
 package com.quickjs.android
 
+import android.content.ComponentCallbacks2
 import android.util.Log
 import kotlinx.coroutines.CoroutineScope
 import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.SupervisorJob
 import kotlinx.coroutines.launch
 import kotlinx.coroutines.runBlocking
 import kotlinx.coroutines.withContext
 import kotlinx.coroutines.withTimeout
+import org.json.JSONArray
+import org.json.JSONException
 import org.json.JSONObject
+import java.nio.ByteBuffer
+import java.util.concurrent.CancellationException
+import java.util.concurrent.CompletableFuture
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.atomic.AtomicLong
 
 /**
  * Bridge class for QuickJS JavaScript engine integration
  * Provides methods to initialize QuickJS, execute JavaScript code, and manage resources
  * QuickJS is a lightweight, fast JavaScript engine with ES2023 support
  */
-class QuickJSBridge(private val context: android.content.Context) {
+class QuickJSBridge(
+    private val context: android.content.Context,
+    private val requestedPoolSize: Int = DEFAULT_ENGINE_POOL_SIZE,
+    // Size-class slab allocation for small engine objects instead of system malloc
+    private val useSlabAllocator: Boolean = true,
+    // Bytes of script HTTP responses cached on disk as Cache-Control allows; 0 disables the cache
+    httpCacheSize: Long = HttpService.DEFAULT_CACHE_SIZE
+) {
 
     companion object {
         private const val TAG = "QuickJSBridge"
 
+        // One engine per core, capped to keep per-runtime memory bounded
+        val DEFAULT_ENGINE_POOL_SIZE = Runtime.getRuntime().availableProcessors().coerceIn(1, 8)
+
+        // Bytes reserved per console message, ConsoleLog::MESSAGE_CAPACITY
+        private const val CONSOLE_MESSAGE_CAPACITY = 480
+
+        // Longest script accepted by validateScript()
+        private const val MAX_SCRIPT_LENGTH = 10_000
+
+        // Remote scripts are untrusted, so a runaway one must not hold an engine forever
+        private const val REMOTE_SCRIPT_TIMEOUT_MS = 30_000L
+
+        // Prefix of the result of bytecode the engine cannot read, see QuickJSEngine::executeBytecode()
+        private const val BYTECODE_REJECTED = "Error: Bytecode deserialization failed"
+
+        // QuickJSEngine::TrimLevel values, see onTrimMemory()
+        private const val TRIM_GC = 1
+        private const val TRIM_CACHES = 2
+
         // Load the native library
         init {
             try {
@@ -32,11 +67,31 @@ class QuickJSBridge(private val context: android.content.Context) {
 
     // Network service for remote JavaScript loading
     private val networkService = NetworkService()
-    private val httpService = HttpService()
+
+    // Bytecode of remote scripts, reused for as long as the server says they are unchanged
+    private val remoteScriptCache = RemoteScriptCache(java.io.File(context.cacheDir, "remote_bytecode"))
+    private val httpService = HttpService(
+        if (httpCacheSize > 0) java.io.File(context.cacheDir, "http_responses") else null,
+        httpCacheSize
+    )
+    
+    // Runs async HTTP requests issued by scripts; requests are never cancelled so
+    // every engine waiting on a response is guaranteed a completion
+    private val httpScope = CoroutineScope(SupervisorJob() + Dispatchers.IO)
+    
+    // Leases engines for async executions; acquiring blocks while every engine is busy
+    private val executionScope = CoroutineScope(SupervisorJob() + Dispatchers.IO)
+    
+    // Callbacks of async executions still in flight, keyed by callback id
+    private val scriptCallbacks = ConcurrentHashMap<Long, (String) -> Unit>()
+    private val nextCallbackId = AtomicLong(1)
     
     // Execution history for remote scripts
     private val executionHistory = mutableListOf<RemoteExecutionResult>()
     
+    // Metrics of the innermost measure() running on each thread, added to by withEngine()
+    private val activeMeasurement = ThreadLocal<ExecutionMetrics?>()
+    
     /**
      * Data class representing the result of remote JavaScript execution
      */
@@ -60,6 +115,192 @@ class QuickJSBridge(private val context: android.content.Context) {
         val error: String? = null
     )
 
+    /**
+     * Compiled-script cache counters, summed over all pooled engines
+     */
+    data class ScriptCacheStats(
+        val hits: Long,
+        val misses: Long,
+        val entries: Long,
+        val bytes: Long,
+        val budgetBytes: Long
+    ) {
+        val hitRate: Double
+            get() = if (hits + misses == 0L) 0.0 else hits.toDouble() / (hits + misses)
+    }
+
+    /**
+     * Memory breakdown of one engine's runtime, the fields of QuickJS's JSMemoryUsage
+     * Sizes are in bytes; mallocLimit is -1 when unlimited
+     */
+    data class MemoryUsage(
+        val mallocSize: Long,
+        val mallocLimit: Long,
+        val memoryUsedSize: Long,
+        val mallocCount: Long,
+        val memoryUsedCount: Long,
+        val atomCount: Long,
+        val atomSize: Long,
+        val stringCount: Long,
+        val stringSize: Long,
+        val objectCount: Long,
+        val objectSize: Long,
+        val propertyCount: Long,
+        val propertySize: Long,
+        val shapeCount: Long,
+        val shapeSize: Long,
+        val functionCount: Long,
+        val functionSize: Long,
+        val bytecodeSize: Long,
+        val pc2lineCount: Long,
+        val pc2lineSize: Long,
+        val cFunctionCount: Long,
+        val arrayCount: Long,
+        val fastArrayCount: Long,
+        val fastArrayElements: Long,
+        val binaryObjectCount: Long,
+        val binaryObjectSize: Long
+    ) {
+        companion object {
+            // Fields in JSMemoryUsage declaration order, starting at offset
+            internal fun fromArray(a: LongArray, offset: Int = 0): MemoryUsage {
+                fun f(i: Int) = a[offset + i]
+                return MemoryUsage(
+                    f(0), f(1), f(2), f(3), f(4), f(5), f(6), f(7), f(8), f(9), f(10), f(11), f(12),
+                    f(13), f(14), f(15), f(16), f(17), f(18), f(19), f(20), f(21), f(22), f(23), f(24), f(25)
+                )
+            }
+        }
+    }
+
+    /**
+     * Per-field high-water marks of an engine's memory samples
+     * Each field peaks independently, so peak values need not come from the same sample
+     */
+    data class MemoryPeaks(
+        val engineId: Int,
+        val samples: Long,
+        val peak: MemoryUsage
+    )
+
+    /**
+     * Work done by executions, matching ExecutionCounters in execution_counters.h
+     * Timed phases nest: execute and await time include the HTTP callouts made meanwhile.
+     * Allocations count every allocation and reallocation of the runtime, garbage
+     * collections whatever triggered them.
+     */
+    data class ExecutionMetrics(
+        val compileNanos: Long = 0,   // Parsing, compiling and reading bytecode
+        val executeNanos: Long = 0,   // Running scripts and calls up to their first result
+        val awaitNanos: Long = 0,     // Jobs, timers and completions until results settle
+        val httpNanos: Long = 0,      // Inside native calls out to the HTTP service
+        val jobsRun: Long = 0,        // Promise jobs
+        val httpRequests: Long = 0,
+        val allocations: Long = 0,
+        val allocatedBytes: Long = 0,
+        val gcRuns: Long = 0
+    ) {
+        operator fun plus(other: ExecutionMetrics) = combine(other, Long::plus)
+
+        operator fun minus(other: ExecutionMetrics) = combine(other, Long::minus)
+
+        private fun combine(other: ExecutionMetrics, op: (Long, Long) -> Long) = ExecutionMetrics(
+            op(compileNanos, other.compileNanos),
+            op(executeNanos, other.executeNanos),
+            op(awaitNanos, other.awaitNanos),
+            op(httpNanos, other.httpNanos),
+            op(jobsRun, other.jobsRun),
+            op(httpRequests, other.httpRequests),
+            op(allocations, other.allocations),
+            op(allocatedBytes, other.allocatedBytes),
+            op(gcRuns, other.gcRuns)
+        )
+
+        companion object {
+            // Fields in ExecutionCounters::Field order
+            internal fun fromArray(a: LongArray) =
+                ExecutionMetrics(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8])
+        }
+    }
+
+    /**
+     * What a block passed to measure() returned, and the work its executions did
+     */
+    data class Measured<T>(
+        val value: T,
+        val metrics: ExecutionMetrics
+    )
+
+    /**
+     * Console levels, matching ConsoleLog::Level in console_log.h
+     */
+    enum class ConsoleLevel {
+        DEBUG,  // console.debug
+        INFO,   // console.log and console.info
+        WARN,
+        ERROR,
+        OFF
+    }
+
+    /**
+     * Priority lanes of the native job scheduler, matching QuickJSJobScheduler::Lane
+     */
+    enum class JobPriority {
+        USER,       // Someone is waiting for the result
+        BACKGROUND  // Prefetching and other work that only runs when no USER job is queued
+    }
+
+    /**
+     * What a realm of runInRealm() offers scripts beyond the core language, matching
+     * RealmFeature in quickjs_integration.cpp; JSON, Map, Set and Promise are always there
+     */
+    enum class RealmFeature(internal val bit: Int) {
+        CONSOLE(1 shl 0),
+        TIMERS(1 shl 1),       // setTimeout(), setInterval() and performance.now()
+        FETCH(1 shl 2),        // fetch() and XMLHttpRequest; implies the typed arrays
+        DATE(1 shl 3),
+        REGEXP(1 shl 4),
+        PROXY(1 shl 5),
+        TYPED_ARRAYS(1 shl 6), // ArrayBuffer, typed arrays, DataView and Atomics
+        WEAK_REFS(1 shl 7);    // WeakRef and FinalizationRegistry
+
+        companion object {
+            val ALL: Set<RealmFeature> = values().toSet()
+        }
+    }
+
+    /**
+     * Parameter and result types of host functions, matching HostFunctions::Type
+     * Kotlin declares them as Int, Double, Boolean, String? and ByteBuffer? (or Unit)
+     */
+    enum class HostType(internal val code: Char) {
+        INT('I'),
+        DOUBLE('D'),
+        BOOLEAN('Z'),
+        STRING('S'),       // JS null and undefined pass as null
+        BYTE_BUFFER('B'),  // A parameter is a direct view of an ArrayBuffer or typed array, valid during the call
+        VOID('V')          // Results only
+    }
+
+    /**
+     * Debug info left out of bundled bytecode, matching JS_STRIP_* in quickjs.h
+     */
+    enum class BytecodeStrip(internal val flags: Int) {
+        NONE(0),
+        SOURCE(1 shl 0),  // Function.prototype.toString() no longer has the source
+        DEBUG(1 shl 1)    // Also line numbers and unused variable names; implies SOURCE
+    }
+
+    /**
+     * A console.* call recorded by any engine
+     */
+    data class ConsoleMessage(
+        val level: ConsoleLevel,
+        val engineId: Int,
+        val timestampMs: Long,
+        val message: String
+    )
+
     /**
      * Callback interface for remote JavaScript execution
      */
@@ -70,8 +311,9 @@ class QuickJSBridge(private val context: android.content.Context) {
     }
 
     // Native method declarations
-    private external fun initializeQuickJS(): Boolean
+    private external fun initializeQuickJS(poolSize: Int, slabAllocator: Boolean): Boolean
     private external fun executeScript(script: String): String
+    private external fun executeScriptEncoded(script: String): ByteArray?
     private external fun cleanupQuickJS()
     private external fun isInitialized(): Boolean
     private external fun resetContext(): Boolean
@@ -80,10 +322,89 @@ class QuickJSBridge(private val context: android.content.Context) {
     private external fun compileScript(script: String): ByteArray?
     private external fun executeBytecode(bytecode: ByteArray): String
     
+    // Engine pool methods
+    private external fun acquireEngine(): Int
+    private external fun releaseEngine(handle: Int)
+    private external fun getEnginePoolSize(): Int
+    private external fun executeScriptOnEngine(handle: Int, script: String): String
+    private external fun executeThrowawayOnEngine(handle: Int, script: String): String
+    private external fun executeInRealmOnEngine(handle: Int, script: String, features: Int): String
+    private external fun executeScriptBufferOnEngine(handle: Int, source: ByteBuffer, offset: Int, length: Int, filename: String): String
+    private external fun executeScriptFdOnEngine(handle: Int, fd: Int, offset: Long, length: Long, filename: String): String
+    private external fun executeThrowawayBytecodeOnEngine(handle: Int, bytecode: ByteArray): String
+    private external fun executeThrowawayBufferOnEngine(handle: Int, source: ByteBuffer, offset: Int, length: Int, filename: String): String
+    private external fun compileScriptBufferOnEngine(handle: Int, source: ByteBuffer, length: Int, filename: String): ByteArray?
+    private external fun executeBytecodeOnEngine(handle: Int, bytecode: ByteArray): String
+    private external fun resetEngineContext(handle: Int): Boolean
+    private external fun executeScriptAsync(handle: Int, script: String, callbackId: Long)
+    private external fun submitJob(script: String, lane: Int, timeoutMs: Long, callbackId: Long): Long
+    private external fun cancelJob(jobId: Long): Boolean
+    private external fun executeScriptEncodedOnEngine(handle: Int, script: String): ByteArray?
+    private external fun executeBatchEncodedOnEngine(handle: Int, scripts: Array<String>): ByteArray?
+    private external fun invokeBatchEncodedOnEngine(handle: Int, function: String, argsJson: String, count: Int): ByteArray?
+    private external fun setExecutionTimeout(handle: Int, timeoutMs: Long): Long
+    private external fun cancelExecution(handle: Int, key: Long): Boolean
+    private external fun configureExecutionTimeout(timeoutMs: Long)
+    private external fun runMicrobenchOnEngine(handle: Int, source: String, filters: Array<String>): String
+    
+    // Compiled-script cache methods
+    private external fun configureScriptCache(budgetBytes: Long)
+    private external fun getScriptCacheStats(): LongArray?
+    
+    // Host function methods
+    private external fun addHostFunction(name: String, receiver: Any, methodName: String, signature: String): Boolean
+    
+    // Bytecode bundle methods
+    private external fun writeBytecodeBundle(
+        path: String,
+        ids: Array<String>,
+        scripts: Array<String>,
+        firstModule: Int,
+        strip: Int
+    ): Boolean
+    private external fun openBytecodeBundle(path: String): Long
+    private external fun openBytecodeBundleFd(fd: Int, offset: Long, length: Long): Long
+    private external fun closeBytecodeBundle(bundleHandle: Long)
+    private external fun addModuleBundle(bundleHandle: Long): Boolean
+    private external fun getBundleScriptIds(bundleHandle: Long): Array<String>?
+    private external fun executeBundleScript(bundleHandle: Long, scriptId: String): String
+    private external fun executeBundleScriptOnEngine(handle: Int, bundleHandle: Long, scriptId: String): String
+    
+    // Memory statistics native methods
+    private external fun getMemoryUsage(handle: Int): LongArray?
+    private external fun getMemoryPeaks(handle: Int): LongArray?
+    private external fun getExecutionCountersOnEngine(handle: Int): LongArray?
+    private external fun getExecutionTotals(handle: Int): LongArray?
+    private external fun resetMemoryPeaks()
+    private external fun configureMemorySampling(intervalMs: Long)
+    private external fun trimMemory(level: Int)
+    private external fun hibernateEngine(handle: Int, force: Boolean): Boolean
+    private external fun hibernateIdleEngines(): Int
+    private external fun restoreEngine(handle: Int): Boolean
+    private external fun configureIdleGc(delayMs: Long)
+    
+    // Profiler native methods
+    private external fun startProfiler(handle: Int, intervalUs: Int): Boolean
+    private external fun stopProfiler(handle: Int): ByteArray?
+    
+    // Console native methods
+    private external fun configureConsoleLevel(level: Int)
+    private external fun configureVerboseLogging(enabled: Boolean)
+    private external fun configureTracing(enabled: Boolean)
+    private external fun drainConsoleLog(meta: LongArray, text: ByteArray): Int
+    private external fun getConsoleDroppedCount(): Long
+    
     // HTTP polyfill native methods
     private external fun nativeHttpRequest(url: String, optionsJson: String): String
+    private external fun completeHttpRequest(
+        engineId: Int, requestId: Int, metadata: String, body: ByteBuffer, bodyLength: Int
+    )
 
     private var initialized = false
+    
+    // Logs every script and result on the Kotlin side as well; see setVerboseLogging()
+    @Volatile
+    private var verboseLogging = false
 
     /**
      * Initialize the QuickJS JavaScript engine
@@ -98,7 +419,7 @@ class QuickJSBridge(private val context: android.content.Context) {
         }
 
         try {
-            initialized = initializeQuickJS()
+            initialized = initializeQuickJS(requestedPoolSize, useSlabAllocator)
             Log.i(TAG, "QuickJS Bridge initialization: ${if (initialized) "SUCCESS" else "FAILED"}")
 
             if (!initialized) {
@@ -120,41 +441,26 @@ class QuickJSBridge(private val context: android.content.Context) {
     /**
      * Execute JavaScript code in QuickJS engine
      * @param jsCode The JavaScript code to execute
-     * @param isolatedExecution Whether to execute in an isolated context to avoid variable conflicts
+     * @param isolatedExecution Whether to execute in a realm of its own, see runInRealm(),
+     *                          as the body of a function so the script can return its result
      * @return The result of the JavaScript execution as a string
      */
     fun runJavaScript(jsCode: String, isolatedExecution: Boolean = false): String {
-        if (!initialized) {
-            val error = "❌ QuickJS Bridge not initialized. Call initialize() first."
-            Log.e(TAG, error)
-            return error
-        }
+        validateScript(jsCode)?.let { return it }
 
-        if (jsCode.isBlank()) {
-            val error = "❌ JavaScript code cannot be empty"
-            Log.e(TAG, error)
-            return error
+        if (verboseLogging) {
+            Log.v(TAG, "Executing JavaScript in QuickJS: $jsCode")
         }
 
-        if (jsCode.length > 10000) {
-            val error = "❌ JavaScript code too long (max 10,000 characters)"
-            Log.e(TAG, error)
-            return error
+        if (isolatedExecution) {
+            return runInRealm("(function() { \n$jsCode\n })();")
         }
 
-        Log.i(TAG, "Executing JavaScript in QuickJS: $jsCode")
-
         try {
-            // Wrap in IIFE if isolated execution is requested
-            val finalCode = if (isolatedExecution) {
-                // For isolated execution, wrap in IIFE
-                "(function() { \n$jsCode\n })();"
-            } else {
-                jsCode
+            val result = executeScript(jsCode)
+            if (verboseLogging) {
+                Log.v(TAG, "QuickJS result: $result")
             }
-            
-            val result = executeScript(finalCode)
-            Log.i(TAG, "QuickJS result: $result")
 
             if (result.startsWith("Error:") || result.startsWith("JavaScript Error:")) {
                 Log.w(TAG, "JavaScript execution returned error: $result")
@@ -172,6 +478,562 @@ class QuickJSBridge(private val context: android.content.Context) {
         }
     }
 
+    /**
+     * Execute independent JavaScript code on any free pooled engine
+     * Safe to call concurrently from multiple threads; each call runs on its own runtime,
+     * so globals are not shared with runJavaScript() or with other pooled calls
+     * @param jsCode The JavaScript code to execute
+     * @param resetAfter Whether to reset the engine's context after execution
+     * @param timeoutMs Stop the script after this long, including time spent awaiting;
+     *                  0 uses the default from setDefaultExecutionTimeout()
+     * @param cancellation Token to stop the script from another thread
+     * @return The result of the JavaScript execution as a string
+     */
+    fun runPooledJavaScript(
+        jsCode: String,
+        resetAfter: Boolean = false,
+        timeoutMs: Long = 0,
+        cancellation: JsCancellationToken? = null
+    ): String {
+        validateScript(jsCode)?.let { return it }
+
+        return runSource {
+            withEngine(timeoutMs, cancellation) { handle ->
+                val result = executeScriptOnEngine(handle, jsCode)
+                if (resetAfter) {
+                    resetEngineContext(handle)
+                }
+                result
+            }
+        }
+    }
+
+    /**
+     * Execute a one-off script on any free pooled engine, in a fresh context of its own
+     * The script's whole heap is thrown away in one piece afterwards instead of being freed
+     * object by object, which is cheaper than runPooledJavaScript() with resetAfter for
+     * scripts that build large object graphs; the engine's own globals are never seen or kept
+     * @param jsCode The JavaScript code to execute
+     * @param timeoutMs Stop the script after this long, including time spent awaiting;
+     *                  0 uses the default from setDefaultExecutionTimeout()
+     * @param cancellation Token to stop the script from another thread
+     * @return The result of the JavaScript execution as a string
+     */
+    fun runThrowawayJavaScript(
+        jsCode: String,
+        timeoutMs: Long = 0,
+        cancellation: JsCancellationToken? = null
+    ): String {
+        validateScript(jsCode)?.let { return it }
+
+        return runSource {
+            withEngine(timeoutMs, cancellation) { handle -> executeThrowawayOnEngine(handle, jsCode) }
+        }
+    }
+
+    /**
+     * Execute UTF-8 source held in a direct ByteBuffer on any free pooled engine
+     * The bytes from position to limit are parsed where they lie, without going through a
+     * String, so there is no length limit beyond the engine's memory. If the byte after the
+     * limit is not 0, the source is copied once to add that terminator; allocateScriptBuffer()
+     * makes buffers that leave room for it. The buffer's position and limit are not changed.
+     * Like runPooledJavaScript(), globals the script defines stay in the engine it ran on.
+     * @param source A direct buffer of UTF-8 source
+     * @param filename Name of the script in stack traces
+     * @param timeoutMs Stop the script after this long, including time spent awaiting;
+     *                  0 uses the default from setDefaultExecutionTimeout()
+     * @param cancellation Token to stop the script from another thread
+     * @return The result of the JavaScript execution as a string
+     */
+    fun runJavaScriptBuffer(
+        source: ByteBuffer,
+        filename: String = "<input>",
+        timeoutMs: Long = 0,
+        cancellation: JsCancellationToken? = null
+    ): String {
+        validateSource()?.let { return it }
+        if (!source.isDirect) {
+            val error = "❌ Script buffer must be a direct ByteBuffer"
+            Log.e(TAG, error)
+            return error
+        }
+
+        return runSource {
+            withEngine(timeoutMs, cancellation) { handle ->
+                executeScriptBufferOnEngine(handle, source, source.position(), source.remaining(), filename)
+            }
+        }
+    }
+
+    /**
+     * Execute a UTF-8 script file on any free pooled engine, mapping it instead of reading it
+     * See runJavaScriptBuffer(); nothing of the file is copied
+     */
+    fun runJavaScriptFile(
+        file: java.io.File,
+        timeoutMs: Long = 0,
+        cancellation: JsCancellationToken? = null
+    ): String {
+        validateSource()?.let { return it }
+
+        return runSource {
+            android.os.ParcelFileDescriptor.open(file, android.os.ParcelFileDescriptor.MODE_READ_ONLY).use { pfd ->
+                withEngine(timeoutMs, cancellation) { handle ->
+                    executeScriptFdOnEngine(handle, pfd.fd, 0, file.length(), file.name)
+                }
+            }
+        }
+    }
+
+    /**
+     * Execute a UTF-8 script asset on any free pooled engine, mapping it from the APK
+     * The asset must be stored uncompressed (androidResources { noCompress += "js" });
+     * see runJavaScriptBuffer()
+     */
+    fun runJavaScriptAsset(
+        assetName: String,
+        timeoutMs: Long = 0,
+        cancellation: JsCancellationToken? = null
+    ): String {
+        validateSource()?.let { return it }
+
+        return runSource {
+            context.assets.openFd(assetName).use { afd ->
+                withEngine(timeoutMs, cancellation) { handle ->
+                    executeScriptFdOnEngine(handle, afd.parcelFileDescriptor.fd, afd.startOffset, afd.length, assetName)
+                }
+            }
+        }
+    }
+
+    /**
+     * A direct buffer for runJavaScriptBuffer() with room for length bytes of source
+     * Its limit is length, and the byte after it stays 0, so the source is never copied
+     */
+    fun allocateScriptBuffer(length: Int): ByteBuffer {
+        return ByteBuffer.allocateDirect(length + 1).limit(length) as ByteBuffer
+    }
+
+    // The check of validateScript() that applies to sources that are not Strings
+    private fun validateSource(): String? {
+        if (!initialized) {
+            val error = "❌ QuickJS Bridge not initialized. Call initialize() first."
+            Log.e(TAG, error)
+            return error
+        }
+        return null
+    }
+
+    // Run one pooled execution, turning what the bridge throws into an error result
+    private fun runSource(block: () -> String): String {
+        return try {
+            block()
+        } catch (e: UnsatisfiedLinkError) {
+            val error = "❌ Native library error during JavaScript execution"
+            Log.e(TAG, error, e)
+            error
+        } catch (e: Exception) {
+            val error = "❌ Unexpected error during JavaScript execution: ${e.message}"
+            Log.e(TAG, error, e)
+            error
+        }
+    }
+
+    /**
+     * Execute a script in a realm of its own, for untrusted code that must not see the
+     * globals of other scripts or anything of the host it was not given
+     * Like runThrowawayJavaScript(), but the realm holds only the core language and
+     * [features], without the host helpers or Worker. Each engine prepares the next realm
+     * while idle, so an execution rarely waits for one to be built.
+     * @param jsCode The JavaScript code to execute
+     * @param features What the script can use beyond the core language
+     * @param timeoutMs Stop the script after this long, including time spent awaiting;
+     *                  0 uses the default from setDefaultExecutionTimeout()
+     * @param cancellation Token to stop the script from another thread
+     * @return The result of the JavaScript execution as a string
+     */
+    fun runInRealm(
+        jsCode: String,
+        features: Set<RealmFeature> = RealmFeature.ALL,
+        timeoutMs: Long = 0,
+        cancellation: JsCancellationToken? = null
+    ): String {
+        validateScript(jsCode)?.let { return it }
+
+        val bits = features.fold(0) { mask, feature -> mask or feature.bit }
+        return runSource {
+            withEngine(timeoutMs, cancellation) { handle -> executeInRealmOnEngine(handle, jsCode, bits) }
+        }
+    }
+
+    /**
+     * Execute JavaScript code in the default engine and return its result as Kotlin values
+     * Unlike runJavaScript(), results are not flattened to strings and errors are reported
+     * as JsResult.Failure instead of by message prefix
+     * @param jsCode The JavaScript code to execute
+     */
+    fun evaluateJavaScript(jsCode: String): JsResult {
+        return evaluateEncoded(jsCode) { executeScriptEncoded(jsCode) }
+    }
+
+    /**
+     * Typed variant of runPooledJavaScript(); see evaluateJavaScript()
+     * Scripts stopped by their timeout or cancellation fail with ErrorKind.TIMEOUT or CANCELLED
+     */
+    fun evaluatePooledJavaScript(
+        jsCode: String,
+        timeoutMs: Long = 0,
+        cancellation: JsCancellationToken? = null
+    ): JsResult {
+        return evaluateEncoded(jsCode) {
+            withEngine(timeoutMs, cancellation) { handle -> executeScriptEncodedOnEngine(handle, jsCode) }
+        }
+    }
+
+    /**
+     * Evaluate many small scripts on one pooled engine in a single native call
+     * The engine is leased and the bridge crossed once for the whole batch, which matters when
+     * the scripts themselves are tiny. Scripts run in order and see each other's globals.
+     * @param scripts The JavaScript code to execute
+     * @param timeoutMs Stop the batch after this long in total; scripts that did not get to run
+     *                  fail with ErrorKind.TIMEOUT. 0 uses the default from setDefaultExecutionTimeout()
+     * @param cancellation Token to stop the batch from another thread
+     * @return One result per script, in order
+     */
+    fun executeBatch(
+        scripts: List<String>,
+        timeoutMs: Long = 0,
+        cancellation: JsCancellationToken? = null
+    ): List<JsResult> {
+        return evaluateBatch(scripts.size, validateBatch(scripts)) {
+            withEngine(timeoutMs, cancellation) { handle ->
+                executeBatchEncodedOnEngine(handle, scripts.toTypedArray())
+            }
+        }
+    }
+
+    /**
+     * Call one JavaScript function many times on a pooled engine in a single native call
+     * @param function Expression evaluating to the function, e.g. "(a, b) => a + b"; it is
+     *                 evaluated once per batch and its compiled form is cached across batches
+     * @param argsList Arguments of each call, sent as JSON: a List is spread as the arguments,
+     *                 any other value (null, Boolean, Number, String, Map) is the only one
+     * @param timeoutMs Stop the batch after this long in total, see executeBatch()
+     * @param cancellation Token to stop the batch from another thread
+     * @return One result per call, in order
+     */
+    fun invokeBatch(
+        function: String,
+        argsList: List<Any?>,
+        timeoutMs: Long = 0,
+        cancellation: JsCancellationToken? = null
+    ): List<JsResult> {
+        val argsJson: String? = try {
+            JSONArray(argsList).toString()
+        } catch (e: JSONException) {
+            return evaluateBatch(argsList.size, "Batch arguments cannot be sent as JSON: ${e.message}") { null }
+        }
+        // JSONArray.toString() returns null rather than throwing for NaN and infinities
+        if (argsJson == null) {
+            return evaluateBatch(argsList.size, "Batch arguments cannot be sent as JSON") { null }
+        }
+        return evaluateBatch(argsList.size, validateScript(function)) {
+            withEngine(timeoutMs, cancellation) { handle ->
+                invokeBatchEncodedOnEngine(handle, function, argsJson, argsList.size)
+            }
+        }
+    }
+
+    private fun evaluateBatch(count: Int, error: String?, execute: () -> ByteArray?): List<JsResult> {
+        fun hostFailures(message: String) =
+            List(count) { JsResult.Failure(JsResult.ErrorKind.HOST, "Error", message, "") }
+
+        if (count == 0) {
+            return emptyList()
+        }
+        error?.let { return hostFailures(it) }
+
+        return try {
+            val encoded = execute() ?: return hostFailures("Failed to allocate result")
+            JsValueCodec.decodeAll(encoded, count)
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "Native library error during batch execution", e)
+            hostFailures("Native library error during JavaScript execution")
+        } catch (e: Exception) {
+            Log.e(TAG, "Unexpected error during batch execution", e)
+            hostFailures("Unexpected error during JavaScript execution: ${e.message}")
+        }
+    }
+
+    private fun evaluateEncoded(jsCode: String, execute: () -> ByteArray?): JsResult {
+        fun hostFailure(message: String) = JsResult.Failure(JsResult.ErrorKind.HOST, "Error", message, "")
+
+        validateScript(jsCode)?.let { return hostFailure(it) }
+
+        return try {
+            val encoded = execute() ?: return hostFailure("Failed to allocate result")
+            JsValueCodec.decode(encoded)
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "Native library error during JavaScript execution", e)
+            hostFailure("Native library error during JavaScript execution")
+        } catch (e: Exception) {
+            Log.e(TAG, "Unexpected error during JavaScript execution", e)
+            hostFailure("Unexpected error during JavaScript execution: ${e.message}")
+        }
+    }
+
+    /**
+     * Execute independent JavaScript code on any free pooled engine without blocking the caller
+     * While the script's promise is pending no thread is parked on it: the engine waits on the
+     * native event loop, which wakes only for timers and HTTP completions
+     * @param jsCode The JavaScript code to execute
+     * @param timeoutMs Stop the script after this long, see runPooledJavaScript()
+     * @param cancellation Token to stop the script from another thread
+     * @param callback Receives the result as a string, on a background thread
+     */
+    fun runJavaScriptAsync(
+        jsCode: String,
+        timeoutMs: Long = 0,
+        cancellation: JsCancellationToken? = null,
+        callback: (String) -> Unit
+    ) {
+        validateScript(jsCode)?.let {
+            callback(it)
+            return
+        }
+
+        val callbackId = nextCallbackId.getAndIncrement()
+        scriptCallbacks[callbackId] = if (cancellation == null) callback else { result ->
+            cancellation.detach()
+            callback(result)
+        }
+        executionScope.launch {
+            try {
+                val handle = acquireEngine()
+                if (handle < 0) {
+                    onScriptResult(callbackId, "❌ QuickJS engine pool not initialized")
+                    return@launch
+                }
+                applyExecutionLimits(handle, timeoutMs, cancellation)
+                // Native code owns the lease from here and releases it before calling back
+                executeScriptAsync(handle, jsCode, callbackId)
+            } catch (e: UnsatisfiedLinkError) {
+                Log.e(TAG, "Native library error during async JavaScript execution", e)
+                onScriptResult(callbackId, "❌ Native library error during JavaScript execution")
+            }
+        }
+    }
+
+    /**
+     * Queue independent JavaScript code on the native job scheduler
+     * Native code picks the engine, preferring the one that last ran the same source and so
+     * likely has it compiled already; idle engines steal queued jobs from busy ones. USER jobs
+     * run before any BACKGROUND job, and no Kotlin thread is held while a job waits or runs.
+     * @param jsCode The JavaScript code to execute
+     * @param priority Lane to queue the job in
+     * @param timeoutMs Stop the script after this long, see runPooledJavaScript()
+     * @param cancellation Token to stop the script from another thread; cancelling the
+     *                     returned future does the same
+     * @return Future completed with the result as a string, on a background thread
+     */
+    fun submitJavaScript(
+        jsCode: String,
+        priority: JobPriority = JobPriority.USER,
+        timeoutMs: Long = 0,
+        cancellation: JsCancellationToken? = null
+    ): CompletableFuture<String> {
+        val future = CompletableFuture<String>()
+        validateScript(jsCode)?.let {
+            future.complete(it)
+            return future
+        }
+
+        val callbackId = nextCallbackId.getAndIncrement()
+        scriptCallbacks[callbackId] = { result ->
+            cancellation?.detach()
+            future.complete(result)
+        }
+        val jobId = try {
+            submitJob(jsCode, priority.ordinal, timeoutMs, callbackId)
+        } catch (e: UnsatisfiedLinkError) {
+            Log.e(TAG, "Native library error during JavaScript submission", e)
+            0L
+        }
+        if (jobId == 0L) {
+            onScriptResult(callbackId, "❌ QuickJS job scheduler not running")
+            return future
+        }
+
+        // Jobs that have finished are ignored natively, so late cancels are harmless
+        cancellation?.attach { cancelJob(jobId) }
+        future.whenComplete { _, error ->
+            if (error is CancellationException) {
+                cancelJob(jobId)
+            }
+        }
+        return future
+    }
+
+    /**
+     * Deliver the result of an async execution or scheduler job (called by native code)
+     * Runs on the thread that started the script, the native event loop thread or a
+     * scheduler thread
+     */
+    fun onScriptResult(callbackId: Long, result: String) {
+        val callback = scriptCallbacks.remove(callbackId)
+        if (callback == null) {
+            Log.w(TAG, "No callback for async execution $callbackId")
+            return
+        }
+        try {
+            callback(result)
+        } catch (e: Exception) {
+            Log.e(TAG, "Async execution callback failed", e)
+        }
+    }
+
+    /**
+     * Execute bytecode on any free pooled engine
+     */
+    fun executePooledBytecode(bytecode: ByteArray): ExecutionResult {
+        val startTime = System.currentTimeMillis()
+
+        if (!initialized) {
+            return ExecutionResult(
+                success = false,
+                result = "",
+                executionTimeMs = 0,
+                error = "QuickJS not initialized"
+            )
+        }
+
+        return try {
+            val result = withEngine { handle -> executeBytecodeOnEngine(handle, bytecode) }
+            ExecutionResult(
+                success = !result.startsWith("Error:"),
+                result = result,
+                executionTimeMs = System.currentTimeMillis() - startTime
+            )
+        } catch (e: Exception) {
+            ExecutionResult(
+                success = false,
+                result = "",
+                executionTimeMs = System.currentTimeMillis() - startTime,
+                error = e.message
+            )
+        }
+    }
+
+    /**
+     * Lease a free pooled engine for the duration of [block]
+     * Blocks the calling thread until an engine is available
+     */
+    private fun <T> withEngine(
+        timeoutMs: Long = 0,
+        cancellation: JsCancellationToken? = null,
+        block: (handle: Int) -> T
+    ): T {
+        val handle = acquireEngine()
+        check(handle >= 0) { "QuickJS engine pool not initialized" }
+        // Counters are read before and after, so work done while the engine sat idle is left out
+        val before = activeMeasurement.get()?.let { getExecutionCountersOnEngine(handle) }
+        try {
+            applyExecutionLimits(handle, timeoutMs, cancellation)
+            return block(handle)
+        } finally {
+            cancellation?.detach()
+            if (before != null) {
+                getExecutionCountersOnEngine(handle)?.let { after ->
+                    activeMeasurement.set(activeMeasurement.get()?.plus(
+                        ExecutionMetrics.fromArray(after) - ExecutionMetrics.fromArray(before)))
+                }
+            }
+            releaseEngine(handle)
+        }
+    }
+
+    /**
+     * Run [block] and return its value with the work done by the executions it made
+     * Covers every execution on a pooled engine made on this thread, such as
+     * runPooledJavaScript(), executeBatch() and runInRealm(), and nests: an outer
+     * measurement includes the inner ones. Executions handed to other threads, as by
+     * submitJavaScript(), are not covered. The counters cost a few clock reads per
+     * execution, so this can be left on.
+     */
+    fun <T> measure(block: () -> T): Measured<T> {
+        val outer = activeMeasurement.get()
+        activeMeasurement.set(ExecutionMetrics())
+        try {
+            val value = block()
+            return Measured(value, activeMeasurement.get() ?: ExecutionMetrics())
+        } finally {
+            val metrics = activeMeasurement.get() ?: ExecutionMetrics()
+            activeMeasurement.set(outer?.plus(metrics))
+        }
+    }
+
+    // Limit executions for the rest of a lease; late cancels for an ended lease are ignored natively
+    private fun applyExecutionLimits(handle: Int, timeoutMs: Long, cancellation: JsCancellationToken?) {
+        if (timeoutMs <= 0 && cancellation == null) {
+            return
+        }
+        val key = setExecutionTimeout(handle, timeoutMs)
+        cancellation?.attach { cancelExecution(handle, key) }
+    }
+
+    /**
+     * Number of native engines: the default engine of runJavaScript(), id 0, and the
+     * pooled ones after it
+     */
+    val enginePoolSize: Int
+        get() = if (initialized) getEnginePoolSize() else 0
+
+    /**
+     * Validate a script before execution
+     * @return An error message, or null if the script can be executed
+     */
+    private fun validateScript(jsCode: String): String? {
+        if (!initialized) {
+            val error = "❌ QuickJS Bridge not initialized. Call initialize() first."
+            Log.e(TAG, error)
+            return error
+        }
+
+        if (jsCode.isBlank()) {
+            val error = "❌ JavaScript code cannot be empty"
+            Log.e(TAG, error)
+            return error
+        }
+
+        if (jsCode.length > MAX_SCRIPT_LENGTH) {
+            val error = "❌ JavaScript code too long (max 10,000 characters)"
+            Log.e(TAG, error)
+            return error
+        }
+
+        return null
+    }
+
+    /**
+     * Validate the scripts of a batch; unlike validateScript(), blank scripts are allowed
+     * @return An error message for the whole batch, or null if it can be executed
+     */
+    private fun validateBatch(scripts: List<String>): String? {
+        if (!initialized) {
+            val error = "❌ QuickJS Bridge not initialized. Call initialize() first."
+            Log.e(TAG, error)
+            return error
+        }
+
+        if (scripts.any { it.length > MAX_SCRIPT_LENGTH }) {
+            val error = "❌ JavaScript code too long (max 10,000 characters)"
+            Log.e(TAG, error)
+            return error
+        }
+
+        return null
+    }
+
     /**
      * Test various JavaScript operations specific to QuickJS features
      * @return Map of test results showcasing QuickJS capabilities
@@ -206,6 +1068,26 @@ class QuickJSBridge(private val context: android.content.Context) {
         return results
     }
 
+    /**
+     * Run the cases of QuickJS's tests/microbench.js on a pooled engine
+     * @param source The microbench.js source
+     * @param filters microbench.js arguments, e.g. case name prefixes; empty runs every case
+     * @return JSON report with ns/op and engine allocations/op per case, or {"error": ...}
+     */
+    fun runMicrobench(source: String, filters: List<String> = emptyList()): String {
+        if (!initialized) {
+            return "{\"error\":\"QuickJS not initialized\"}"
+        }
+        return withEngine { handle ->
+            try {
+                runMicrobenchOnEngine(handle, source, filters.toTypedArray())
+            } finally {
+                // Drop the benchmark globals before the engine goes back to the pool
+                resetEngineContext(handle)
+            }
+        }
+    }
+
     /**
      * Reset QuickJS context to clear variables and avoid conflicts
      */
@@ -231,19 +1113,270 @@ class QuickJSBridge(private val context: android.content.Context) {
     }
 
     /**
-     * Get memory statistics
+     * Get memory statistics of every pooled engine as a report
      */
     fun getMemoryStats(): String {
         if (!initialized) {
             return "QuickJS not initialized"
         }
-        return "QuickJS Memory Statistics:\n" +
-               "Memory Management: Enabled\n" +
-               "Limit: 64MB\n" +
-               "GC Threshold: 1MB\n" +
-               "Status: Active"
+        val report = StringBuilder("QuickJS Memory Statistics:\n")
+        for (engineId in 0 until enginePoolSize) {
+            val usage = getEngineMemoryUsage(engineId) ?: continue
+            val peak = getEngineMemoryPeaks(engineId)?.peak
+            report.append("Engine $engineId: ${usage.memoryUsedSize / 1024}KB used")
+                .append(" (${usage.mallocSize / 1024}KB malloc, ${usage.mallocCount} blocks),")
+                .append(" limit ${if (usage.mallocLimit < 0) "none" else "${usage.mallocLimit / 1024}KB"}\n")
+                .append("  atoms ${usage.atomCount}, strings ${usage.stringCount} (${usage.stringSize / 1024}KB),")
+                .append(" objects ${usage.objectCount}, shapes ${usage.shapeCount}\n")
+                .append("  functions ${usage.functionCount} (${usage.bytecodeSize / 1024}KB bytecode),")
+                .append(" arrays ${usage.arrayCount} (${usage.fastArrayCount} fast)\n")
+            if (peak != null) {
+                report.append("  peak ${peak.memoryUsedSize / 1024}KB used, ${peak.mallocSize / 1024}KB malloc\n")
+            }
+        }
+        return report.toString()
+    }
+
+    /**
+     * Get the full memory breakdown of one engine
+     * Waits for the engine if it is leased, and records the result as a sample
+     */
+    fun getEngineMemoryUsage(engineId: Int = 0): MemoryUsage? {
+        if (!initialized) {
+            return null
+        }
+        return getMemoryUsage(engineId)?.let { MemoryUsage.fromArray(it) }
+    }
+
+    /**
+     * Get the memory high-water marks of one engine without waiting for it
+     */
+    fun getEngineMemoryPeaks(engineId: Int = 0): MemoryPeaks? {
+        if (!initialized) {
+            return null
+        }
+        val peaks = getMemoryPeaks(engineId) ?: return null
+        return MemoryPeaks(engineId, peaks[0], MemoryUsage.fromArray(peaks, 1))
+    }
+
+    /**
+     * Get the work one engine has done over its lifetime, as of the end of its last lease
+     * Does not wait for the engine; throwaway and realm executions count toward the
+     * engine that ran them
+     */
+    fun getEngineMetrics(engineId: Int = 0): ExecutionMetrics? {
+        if (!initialized) {
+            return null
+        }
+        return getExecutionTotals(engineId)?.let { ExecutionMetrics.fromArray(it) }
+    }
+
+    /**
+     * Sample each engine's memory at most every intervalMs, as executions hand it back
+     * Idle engines are not walked; their usage cannot change until they are leased again
+     */
+    fun startMemorySampling(intervalMs: Long) {
+        if (!initialized) {
+            Log.w(TAG, "Cannot start memory sampling: QuickJS not initialized")
+            return
+        }
+        configureMemorySampling(intervalMs)
+    }
+
+    fun stopMemorySampling() {
+        if (initialized) {
+            configureMemorySampling(0)
+        }
+    }
+
+    /**
+     * Collect garbage of pooled engines once they have been idle for delayMs, on a native
+     * background thread, so executions rarely pay for garbage left by earlier ones
+     * Engines are only collected after executions that grew their heap noticeably; collections
+     * inside executions still happen when the threshold trips. 0 disables; the default is 100ms
+     */
+    fun setIdleGcDelay(delayMs: Long) {
+        configureIdleGc(delayMs)
+    }
+
+    /**
+     * Give memory back when Android asks; call from ComponentCallbacks2.onTrimMemory()
+     * Every engine collects garbage and returns its free slab chunks, and from
+     * TRIM_MEMORY_RUNNING_CRITICAL on also drops its compiled-script cache. Never waits
+     * for running scripts; busy engines trim once their execution finishes.
+     * Once the UI is hidden, idle engines are hibernated as well, see hibernateEngines().
+     */
+    fun onTrimMemory(level: Int) {
+        if (!initialized) {
+            return
+        }
+        if (level >= ComponentCallbacks2.TRIM_MEMORY_UI_HIDDEN) {
+            hibernateEngines()
+        }
+        val trimLevel = when {
+            level >= ComponentCallbacks2.TRIM_MEMORY_RUNNING_CRITICAL -> TRIM_CACHES
+            level >= ComponentCallbacks2.TRIM_MEMORY_RUNNING_MODERATE -> TRIM_GC
+            else -> return
+        }
+        trimMemory(trimLevel)
+    }
+
+    /**
+     * Free the runtime of every idle pooled engine whose globals can be saved as they are
+     * Plain data globals (objects, arrays, strings, numbers, dates, typed arrays) are saved
+     * with their attributes and sharing intact. Engines holding anything else as a global,
+     * such as a function, a class instance, a Map or a top-level let/const binding, or that
+     * changed a built-in such as Array.prototype or console, are left running, as are
+     * engines with timers, requests or workers pending and the default engine of
+     * runJavaScript(). The next execution on a hibernated engine restores it first, at a
+     * fraction of a cold start. Returns the number of engines hibernated.
+     */
+    fun hibernateEngines(): Int {
+        if (!initialized) {
+            return 0
+        }
+        return hibernateIdleEngines()
     }
 
+    /**
+     * Hibernate one engine like hibernateEngines(); false if it is busy, has async work
+     * pending or holds globals that cannot be saved. With force, such globals are dropped
+     * and the engine is hibernated anyway.
+     */
+    fun hibernate(engineId: Int = 0, force: Boolean = false): Boolean {
+        return initialized && hibernateEngine(engineId, force)
+    }
+
+    /**
+     * Restore a hibernated engine ahead of its next execution, e.g. as the app returns
+     * to the foreground; waits if the engine is busy. Running engines are left as they are.
+     */
+    fun wakeEngine(engineId: Int = 0): Boolean {
+        return initialized && restoreEngine(engineId)
+    }
+
+    /**
+     * Clear the memory high-water marks of every engine
+     */
+    fun resetMemoryPeakStatistics() {
+        if (initialized) {
+            resetMemoryPeaks()
+        }
+    }
+
+    /**
+     * Set the per-engine byte budget of the native compiled-script cache
+     * Repeated executions of identical source skip the parser while cached; 0 disables caching
+     */
+    fun setScriptCacheBudget(budgetBytes: Long) {
+        if (!initialized) {
+            Log.w(TAG, "Cannot configure script cache: QuickJS not initialized")
+            return
+        }
+        configureScriptCache(budgetBytes)
+    }
+
+    /**
+     * Get compiled-script cache statistics
+     */
+    fun getScriptCacheStatistics(): ScriptCacheStats? {
+        if (!initialized) {
+            return null
+        }
+        val stats = getScriptCacheStats() ?: return null
+        return ScriptCacheStats(
+            hits = stats[0],
+            misses = stats[1],
+            entries = stats[2],
+            bytes = stats[3],
+            budgetBytes = stats[4]
+        )
+    }
+
+    /**
+     * Start sampling the JS stack of an engine every intervalMicros
+     * Can be started while the engine is running a slow script; engine 0 runs runJavaScript()
+     */
+    fun startProfiling(engineId: Int = 0, intervalMicros: Int = 1000): Boolean {
+        if (!initialized) {
+            Log.w(TAG, "Cannot start profiling: QuickJS not initialized")
+            return false
+        }
+        return startProfiler(engineId, intervalMicros)
+    }
+
+    /**
+     * Stop profiling an engine
+     * @return The profile in pprof format (uncompressed profile.proto, open with
+     *         `go tool pprof`), or null if the engine was not being profiled
+     */
+    fun stopProfiling(engineId: Int = 0): ByteArray? {
+        if (!initialized) {
+            return null
+        }
+        return stopProfiler(engineId)
+    }
+
+    /**
+     * Stop every execution that runs longer than timeoutMs, including time spent awaiting
+     * timers and HTTP responses; 0 (the default) disables the limit
+     * Per-call timeouts of the pooled and async APIs take precedence
+     */
+    fun setDefaultExecutionTimeout(timeoutMs: Long) {
+        configureExecutionTimeout(timeoutMs)
+    }
+
+    /**
+     * Keep console records at level and above; lower levels are skipped before their
+     * arguments are formatted, and OFF disables the console entirely
+     */
+    fun setConsoleLevel(level: ConsoleLevel) {
+        configureConsoleLevel(level.ordinal)
+    }
+
+    /**
+     * Log every executed script and its result, natively and here
+     * Off by default since the per-call logging is costly on hot paths
+     */
+    fun setVerboseLogging(enabled: Boolean) {
+        verboseLogging = enabled
+        configureVerboseLogging(enabled)
+    }
+
+    /**
+     * Emit ATrace sections for compilation, evaluation, GC, awaiting and HTTP callouts
+     * Sections appear in Perfetto and systrace captures that include this app; when off,
+     * or when no trace is being recorded, each section costs a flag check
+     */
+    fun setTracingEnabled(enabled: Boolean) {
+        configureTracing(enabled)
+    }
+
+    /**
+     * Take up to maxMessages console records, oldest first
+     * Records not drained are kept until the native ring fills, after which new ones are
+     * dropped and counted in getConsoleDroppedMessages()
+     */
+    fun drainConsoleMessages(maxMessages: Int = 256): List<ConsoleMessage> {
+        val meta = LongArray(maxMessages * 3)
+        val text = ByteArray(maxMessages * CONSOLE_MESSAGE_CAPACITY)
+        val count = drainConsoleLog(meta, text)
+        return List(count) { i ->
+            val header = meta[i * 3]
+            ConsoleMessage(
+                level = ConsoleLevel.values()[(header ushr 32).toInt()],
+                engineId = header.toInt(),
+                timestampMs = meta[i * 3 + 1],
+                message = String(text, i * CONSOLE_MESSAGE_CAPACITY, meta[i * 3 + 2].toInt(), Charsets.UTF_8)
+            )
+        }
+    }
+
+    /**
+     * Number of console records dropped because they were not drained in time
+     */
+    fun getConsoleDroppedMessages(): Long = getConsoleDroppedCount()
+
     /**
      * Compile JavaScript to bytecode for caching
      */
@@ -299,8 +1432,135 @@ class QuickJSBridge(private val context: android.content.Context) {
         }
     }
 
+    /**
+     * Compile scripts and write them as a memory-mappable bytecode bundle
+     * @param file Destination bundle file
+     * @param scripts Script sources keyed by script id
+     * @param modules ES module sources keyed by module id, e.g. "lib/format.js"; imports of a
+     *                module must normalize to its id, relative ones against the importing module's
+     * @param strip Debug info to leave out; stack traces of stripped code have no line numbers
+     * @return true if every script compiled and the bundle was written
+     */
+    fun createBytecodeBundle(
+        file: java.io.File,
+        scripts: Map<String, String>,
+        modules: Map<String, String> = emptyMap(),
+        strip: BytecodeStrip = BytecodeStrip.NONE
+    ): Boolean {
+        if (!initialized) {
+            Log.e(TAG, "QuickJS not initialized for bundle compilation")
+            return false
+        }
+        return try {
+            writeBytecodeBundle(
+                file.absolutePath,
+                (scripts.keys + modules.keys).toTypedArray(),
+                (scripts.values + modules.values).toTypedArray(),
+                scripts.size,
+                strip.flags
+            )
+        } catch (e: Exception) {
+            Log.e(TAG, "Failed to write bytecode bundle", e)
+            false
+        }
+    }
+
+    /**
+     * Map a bytecode bundle from app storage
+     * @return A bundle handle, or 0 if the bundle could not be opened
+     */
+    fun loadBytecodeBundle(file: java.io.File): Long {
+        return try {
+            openBytecodeBundle(file.absolutePath)
+        } catch (e: Exception) {
+            Log.e(TAG, "Failed to open bytecode bundle: ${file.path}", e)
+            0L
+        }
+    }
+
+    /**
+     * Map a bytecode bundle from an APK asset
+     * The asset must be stored uncompressed (androidResources { noCompress += "qjsb" })
+     * @return A bundle handle, or 0 if the bundle could not be opened
+     */
+    fun loadBytecodeBundleAsset(assetName: String): Long {
+        return try {
+            context.assets.openFd(assetName).use { afd ->
+                openBytecodeBundleFd(afd.parcelFileDescriptor.fd, afd.startOffset, afd.length)
+            }
+        } catch (e: Exception) {
+            Log.e(TAG, "Failed to open bytecode bundle asset: $assetName", e)
+            0L
+        }
+    }
+
+    /**
+     * Resolve imports in every engine against the modules of a loaded bundle
+     * Modules are read from the mapping the first time a context imports them, with import()
+     * from any script or statically from another bundled module, and the context keeps them
+     * until it is reset. Bundles added earlier are searched first.
+     * @return false if the bundle handle is not open
+     */
+    fun useModuleBundle(bundleHandle: Long): Boolean {
+        return addModuleBundle(bundleHandle)
+    }
+
+    /**
+     * Unmap a bytecode bundle, which also stops resolving imports against it
+     */
+    fun releaseBytecodeBundle(bundleHandle: Long) {
+        closeBytecodeBundle(bundleHandle)
+    }
+
+    /**
+     * List the script ids contained in a bytecode bundle
+     */
+    fun listBundleScripts(bundleHandle: Long): List<String> {
+        return getBundleScriptIds(bundleHandle)?.toList() ?: emptyList()
+    }
+
+    /**
+     * Execute a script from a bytecode bundle without copying it through the JVM heap
+     * A module entry runs with its imports resolved against the bundles of useModuleBundle()
+     * @param pooled Run on any free pooled engine instead of the default engine
+     */
+    fun executeBundledScript(bundleHandle: Long, scriptId: String, pooled: Boolean = false): ExecutionResult {
+        val startTime = System.currentTimeMillis()
+
+        if (!initialized) {
+            return ExecutionResult(
+                success = false,
+                result = "",
+                executionTimeMs = 0,
+                error = "QuickJS not initialized"
+            )
+        }
+
+        return try {
+            val result = if (pooled) {
+                withEngine { handle -> executeBundleScriptOnEngine(handle, bundleHandle, scriptId) }
+            } else {
+                executeBundleScript(bundleHandle, scriptId)
+            }
+            ExecutionResult(
+                success = !result.startsWith("Error:"),
+                result = result,
+                executionTimeMs = System.currentTimeMillis() - startTime
+            )
+        } catch (e: Exception) {
+            ExecutionResult(
+                success = false,
+                result = "",
+                executionTimeMs = System.currentTimeMillis() - startTime,
+                error = e.message
+            )
+        }
+    }
+
     /**
      * Execute remote JavaScript from URL
+     * The source is compiled once from the downloaded bytes and the bytecode kept on disk;
+     * later runs revalidate it with the server and skip the download and parse on 304
      */
     fun executeRemoteJavaScript(url: String, callback: RemoteExecutionCallback) {
         CoroutineScope(Dispatchers.IO).launch {
@@ -308,21 +1568,27 @@ class QuickJSBridge(private val context: android.content.Context) {
                 callback.onProgress("🔄 Downloading JavaScript from $url...")
                 
                 val startTime = System.currentTimeMillis()
-                val content = networkService.downloadText(url)
+                val fileName = url.substringAfterLast("/").ifEmpty { "remote_script.js" }
                 
-                if (content.isNullOrEmpty()) {
+                var script = loadRemoteScript(url, fileName, revalidate = true, callback = callback)
+                if (script == null) {
                     callback.onError(url, "Failed to download content")
                     return@launch
                 }
                 
-                callback.onProgress("✅ Downloaded ${content.length} characters. Executing...")
-                
-                val result = withContext(Dispatchers.Main) {
-                    runJavaScript(content)
+                var result = runRemoteScript(script)
+                if (script.cached && result.startsWith(BYTECODE_REJECTED)) {
+                    // Written by an engine with a different bytecode version
+                    remoteScriptCache.remove(url)
+                    script = loadRemoteScript(url, fileName, revalidate = false, callback = callback)
+                    if (script == null) {
+                        callback.onError(url, "Failed to download content")
+                        return@launch
+                    }
+                    result = runRemoteScript(script)
                 }
                 
                 val executionTime = System.currentTimeMillis() - startTime
-                val fileName = url.substringAfterLast("/").ifEmpty { "remote_script.js" }
                 
                 val remoteResult = RemoteExecutionResult(
                     url = url,
@@ -331,7 +1597,7 @@ class QuickJSBridge(private val context: android.content.Context) {
                     success = !result.startsWith("Error:") && !result.startsWith("❌"),
                     result = result,
                     executionTimeMs = executionTime,
-                    contentLength = content.length
+                    contentLength = script.sourceLength
                 )
                 
                 executionHistory.add(0, remoteResult)
@@ -345,6 +1611,74 @@ class QuickJSBridge(private val context: android.content.Context) {
         }
     }
 
+    // A remote script ready to run; source, the downloaded buffer, is set instead of
+    // bytecode when it did not compile
+    private class RemoteScript(
+        val bytecode: ByteArray?,
+        val source: ByteBuffer?,
+        val sourceLength: Int,
+        val cached: Boolean,
+        val fileName: String = "<remote>"
+    )
+
+    // Fetch url, or revalidate its cached bytecode, and compile what was downloaded
+    private suspend fun loadRemoteScript(
+        url: String,
+        fileName: String,
+        revalidate: Boolean,
+        callback: RemoteExecutionCallback
+    ): RemoteScript? {
+        val cached = if (revalidate) remoteScriptCache.get(url) else null
+        val download = networkService.downloadScript(url, cached?.etag, cached?.lastModified)
+        when (download) {
+            is NetworkService.ScriptDownload.NotModified -> {
+                if (cached == null) {
+                    return null
+                }
+                callback.onProgress("✅ Unchanged since last download (${cached.sourceLength} bytes). Executing...")
+                return RemoteScript(cached.bytecode, null, cached.sourceLength, cached = true)
+            }
+            is NetworkService.ScriptDownload.Failed -> return null
+            is NetworkService.ScriptDownload.Body -> {
+                if (download.length == 0) {
+                    return null
+                }
+                callback.onProgress("✅ Downloaded ${download.length} bytes. Compiling...")
+                val bytecode = withEngine { handle ->
+                    compileScriptBufferOnEngine(handle, download.source, download.length, fileName)
+                }
+                if (bytecode == null) {
+                    // Run the source instead, which reports the syntax error, or runs it
+                    // if the bytecode could not be written
+                    return RemoteScript(null, download.source, download.length, cached = false, fileName = fileName)
+                }
+                remoteScriptCache.put(url, download.etag, download.lastModified, download.length, bytecode)
+                callback.onProgress("✅ Compiled ${download.length} bytes. Executing...")
+                return RemoteScript(bytecode, null, download.length, cached = false)
+            }
+        }
+    }
+
+    // On a pooled engine, so a runaway script times out without blocking other work,
+    // and in a throwaway context, since nothing it leaves behind is used again
+    // Source that did not compile is run from the downloaded buffer instead, just as
+    // throwaway and with no length limit, so the result is its syntax error
+    private fun runRemoteScript(script: RemoteScript): String {
+        return try {
+            withEngine(REMOTE_SCRIPT_TIMEOUT_MS) { handle ->
+                if (script.bytecode != null) {
+                    executeThrowawayBytecodeOnEngine(handle, script.bytecode)
+                } else {
+                    executeThrowawayBufferOnEngine(handle, script.source!!, 0, script.sourceLength, script.fileName)
+                }
+            }
+        } catch (e: UnsatisfiedLinkError) {
+            val error = "❌ Native library error during JavaScript execution"
+            Log.e(TAG, error, e)
+            error
+        }
+    }
+
     /**
      * Get execution history
      */
@@ -471,13 +1805,95 @@ class QuickJSBridge(private val context: android.content.Context) {
         }
     }
 
+    /**
+     * Expose a method as a global JavaScript function in every engine
+     * Arguments are converted natively to the declared types and passed through a cached
+     * method ID, without JSON; the method runs on the engine's thread, which is attached to
+     * the JVM as needed. Registering a name again replaces the function in every engine.
+     * Not to be called from within a host function, as it waits for busy engines.
+     * @param name Global name in JavaScript
+     * @param receiver Object whose method is called; kept for the life of the process
+     * @param methodName Method of the receiver's class with exactly the declared types
+     * @param returns Result type; a returned ByteBuffer, which must be direct, is copied
+     *                into an ArrayBuffer from position 0 to its limit
+     * @param parameters Parameter types; missing arguments convert from undefined
+     * @return false if no such method exists or the types are not valid
+     */
+    fun registerHostFunction(
+        name: String,
+        receiver: Any,
+        methodName: String,
+        returns: HostType,
+        vararg parameters: HostType
+    ): Boolean {
+        if (HostType.VOID in parameters) {
+            Log.e(TAG, "Host function $name: VOID is only a result type")
+            return false
+        }
+        val signature = parameters.joinToString("") { it.code.toString() } + ")" + returns.code
+        return try {
+            addHostFunction(name, receiver, methodName, signature)
+        } catch (e: Exception) {
+            Log.e(TAG, "Failed to register host function $name", e)
+            false
+        }
+    }
+
     /**
      * Handle HTTP requests from JavaScript (called by native code)
      * Note: This runs synchronously from the JavaScript execution context
+     * Only synchronous XMLHttpRequest uses this path; fetch() goes through handleHttpRequestAsync
      */
     fun handleHttpRequest(url: String, optionsJson: String): String {
-        Log.i(TAG, "Handling HTTP request: $url")
+        if (verboseLogging) {
+            Log.v(TAG, "Handling HTTP request: $url")
+        }
+        
+        // Use a blocking coroutine to make the HTTP request on a background thread
+        val response = runBlocking(Dispatchers.IO) {
+            performHttpRequest(url, optionsJson)
+        }
         
+        // The sync path keeps the body inside the JSON envelope as text
+        val body = response.body.duplicate()
+        body.position(0)
+        body.limit(response.bodyLength)
+        return response.metadata.put("body", Charsets.UTF_8.decode(body).toString()).toString()
+    }
+
+    /**
+     * Start an HTTP request from JavaScript without blocking the engine (called by native code)
+     * Returns immediately; the response is delivered to the issuing engine through completeHttpRequest,
+     * so concurrent fetch() calls from one script overlap on the network
+     * The body is handed over as a direct buffer that JavaScript wraps as an ArrayBuffer without copying
+     */
+    fun handleHttpRequestAsync(engineId: Int, requestId: Int, url: String, optionsJson: String) {
+        if (verboseLogging) {
+            Log.v(TAG, "Handling async HTTP request: $url")
+        }
+        
+        httpScope.launch {
+            val response = performHttpRequest(url, optionsJson)
+            completeHttpRequest(engineId, requestId, response.metadata.toString(), response.body, response.bodyLength)
+        }
+    }
+
+    /**
+     * HTTP response in the format expected by the polyfills
+     * metadata is the response envelope without its body; body holds bodyLength bytes
+     * followed by a NUL byte, so native code can parse JSON bodies in place
+     */
+    private class HttpResponseData(
+        val metadata: JSONObject,
+        val body: ByteBuffer,
+        val bodyLength: Int
+    )
+
+    /**
+     * Perform an HTTP request
+     * Blocks the calling thread and never throws; failures become status 0 error responses
+     */
+    private fun performHttpRequest(url: String, optionsJson: String): HttpResponseData {
         return try {
             // Parse the options JSON to extract request details
             val options = try {
@@ -501,75 +1917,40 @@ class QuickJSBridge(private val context: android.content.Context) {
                 headers[key] = headersJson.getString(key)
             }
             
-            // Use a blocking coroutine to make the HTTP request on a background thread
-            val result = runBlocking(Dispatchers.IO) {
-                try {
-                    // Make the HTTP request on IO dispatcher
-                    val response = httpService.makeRequest(url, method, headers, body)
-                    
-                    // Extract response details
-                    val statusCode = response.code
-                    val statusText = response.message
-                    val responseHeaders = mutableMapOf<String, String>()
-                    response.headers.forEach { pair ->
-                        responseHeaders[pair.first] = pair.second
-                    }
-                    
-                    // Get response body
-                    val responseBody = response.body?.string() ?: ""
-                    response.close()
-                    
-                    // Return the response in the format expected by the fetch polyfill
-                    // Use JSONObject to properly handle all escaping
-                    val responseJson = JSONObject().apply {
-                        put("status", statusCode)
-                        put("statusText", statusText)
-                        put("ok", statusCode in 200..299)
-                        put("redirected", false)
-                        put("url", url)
-                        put("type", "basic")
-                        put("headers", JSONObject(responseHeaders as Map<*, *>))
-                        put("body", responseBody)  // JSONObject will handle proper escaping
-                    }
-                    
-                    responseJson.toString()
-                    
-                } catch (e: Exception) {
-                    Log.e(TAG, "HTTP request failed: $url", e)
-                    
-                    // Return an error response using JSONObject for proper escaping
-                    val errorMessage = e.message ?: "Unknown error"
-                    val errorBody = JSONObject().apply {
-                        put("error", errorMessage)
-                    }.toString()
-                    
-                    val errorResponseJson = JSONObject().apply {
-                        put("status", 0)
-                        put("statusText", "Network Error")
-                        put("ok", false)
-                        put("redirected", false)
-                        put("url", url)
-                        put("type", "error")
-                        put("headers", JSONObject())
-                        put("body", errorBody)
-                    }
-                    
-                    errorResponseJson.toString()
-                }
+            // Read to the end into native-accessible memory, joining an identical request in flight
+            val response = httpService.exchange(url, method, headers, body)
+            
+            // Extract response details
+            val statusCode = response.code
+            val statusText = response.message
+            val responseHeaders = mutableMapOf<String, String>()
+            response.headers.forEach { pair ->
+                responseHeaders[pair.first] = pair.second
+            }
+            
+            // Use JSONObject to properly handle all escaping
+            val metadata = JSONObject().apply {
+                put("status", statusCode)
+                put("statusText", statusText)
+                put("ok", statusCode in 200..299)
+                put("redirected", false)
+                put("url", url)
+                put("type", "basic")
+                put("headers", JSONObject(responseHeaders as Map<*, *>))
             }
             
-            result
+            HttpResponseData(metadata, response.body, response.bodyLength)
             
         } catch (e: Exception) {
-            Log.e(TAG, "HTTP request wrapper failed: $url", e)
+            Log.e(TAG, "HTTP request failed: $url", e)
             
-            // Return an error response for any wrapper failures using JSONObject
+            // Return an error response using JSONObject for proper escaping
             val errorMessage = e.message ?: "Unknown error"
             val errorBody = JSONObject().apply {
                 put("error", errorMessage)
-            }.toString()
+            }.toString().toByteArray(Charsets.UTF_8)
             
-            val errorResponseJson = JSONObject().apply {
+            val metadata = JSONObject().apply {
                 put("status", 0)
                 put("statusText", "Network Error")
                 put("ok", false)
@@ -577,10 +1958,12 @@ class QuickJSBridge(private val context: android.content.Context) {
                 put("url", url)
                 put("type", "error")
                 put("headers", JSONObject())
-                put("body", errorBody)
             }
             
-            errorResponseJson.toString()
+            val buffer = ByteBuffer.allocateDirect(errorBody.size + 1)
+            buffer.put(errorBody)
+            buffer.put(0.toByte())
+            HttpResponseData(metadata, buffer, errorBody.size)
         }
     }
 
@@ -0,0 +1,123 @@
+package com.quickjs.android
+
+import android.util.Log
+import org.json.JSONObject
+import java.io.File
+import java.io.IOException
+import java.security.MessageDigest
+
+/**
+ * Compiled remote scripts on disk, keyed by URL and revalidated with the ETag and
+ * Last-Modified the server sent with their source
+ * Each entry is a bytecode file and a JSON metadata file beside it. Both are
+ * replaced by renaming, so an interrupted write never leaves a torn entry.
+ */
+internal class RemoteScriptCache(private val directory: File) {
+
+    companion object {
+        private const val TAG = "RemoteScriptCache"
+
+        // Entries kept; the least recently used beyond this are deleted
+        private const val MAX_ENTRIES = 64
+
+        private const val BYTECODE_SUFFIX = ".qjsc"
+        private const val META_SUFFIX = ".meta"
+    }
+
+    class Entry(
+        val etag: String?,
+        val lastModified: String?,
+        val sourceLength: Int,
+        val bytecode: ByteArray
+    )
+
+    @Synchronized
+    fun get(url: String): Entry? {
+        val key = keyOf(url)
+        val bytecodeFile = File(directory, key + BYTECODE_SUFFIX)
+        val metaFile = File(directory, key + META_SUFFIX)
+        if (!bytecodeFile.isFile || !metaFile.isFile) {
+            return null
+        }
+        return try {
+            val meta = JSONObject(metaFile.readText())
+            if (meta.getString("url") != url) {
+                return null
+            }
+            val entry = Entry(
+                meta.optString("etag").ifEmpty { null },
+                meta.optString("lastModified").ifEmpty { null },
+                meta.getInt("sourceLength"),
+                bytecodeFile.readBytes()
+            )
+            bytecodeFile.setLastModified(System.currentTimeMillis())
+            entry
+        } catch (e: Exception) {
+            Log.w(TAG, "Dropping unreadable cache entry for $url", e)
+            deleteEntry(key)
+            null
+        }
+    }
+
+    /**
+     * Store the bytecode compiled from url's source
+     * Responses without validators can never be revalidated, so they are not stored
+     */
+    @Synchronized
+    fun put(url: String, etag: String?, lastModified: String?, sourceLength: Int, bytecode: ByteArray) {
+        if (etag == null && lastModified == null) {
+            return
+        }
+        val key = keyOf(url)
+        val meta = JSONObject()
+            .put("url", url)
+            .put("etag", etag ?: "")
+            .put("lastModified", lastModified ?: "")
+            .put("sourceLength", sourceLength)
+        try {
+            directory.mkdirs()
+            // Bytecode first: new bytecode under old validators only costs a refetch
+            writeAtomically(File(directory, key + BYTECODE_SUFFIX), bytecode)
+            writeAtomically(File(directory, key + META_SUFFIX), meta.toString().toByteArray())
+            trim()
+        } catch (e: Exception) {
+            Log.w(TAG, "Failed to cache bytecode for $url", e)
+            deleteEntry(key)
+        }
+    }
+
+    @Synchronized
+    fun remove(url: String) {
+        deleteEntry(keyOf(url))
+    }
+
+    private fun writeAtomically(file: File, bytes: ByteArray) {
+        val temp = File(directory, file.name + ".tmp")
+        temp.writeBytes(bytes)
+        if (!temp.renameTo(file)) {
+            temp.delete()
+            throw IOException("Cannot rename ${temp.name} to ${file.name}")
+        }
+    }
+
+    private fun trim() {
+        val entries = directory.listFiles { file -> file.name.endsWith(BYTECODE_SUFFIX) } ?: return
+        if (entries.size <= MAX_ENTRIES) {
+            return
+        }
+        entries.sortBy { it.lastModified() }
+        for (file in entries.take(entries.size - MAX_ENTRIES)) {
+            deleteEntry(file.name.removeSuffix(BYTECODE_SUFFIX))
+        }
+    }
+
+    private fun deleteEntry(key: String) {
+        File(directory, key + META_SUFFIX).delete()
+        File(directory, key + BYTECODE_SUFFIX).delete()
+    }
+
+    private fun keyOf(url: String): String {
+        val digest = MessageDigest.getInstance("SHA-256").digest(url.toByteArray())
+        return digest.joinToString("") { "%02x".format(it) }
+    }
+}
@@ -219,4 +219,76 @@ class HttpServiceTest {
         assertEquals("Slow response", response.body?.string())
         response.close()
     }
+
+    @Test
+    fun testIdenticalRequestsInFlightAreCoalesced() {
+        // Slow enough that the second request starts while the first is in flight
+        mockWebServer.enqueue(
+            MockResponse()
+                .setBody("config")
+                .setResponseCode(200)
+                .setHeadersDelay(300, java.util.concurrent.TimeUnit.MILLISECONDS)
+        )
+        mockWebServer.enqueue(MockResponse().setBody("unexpected").setResponseCode(200))
+
+        val url = mockWebServer.url("/config").toString()
+        val results = arrayOfNulls<HttpService.BufferedResponse>(2)
+        val threads = (0 until 2).map { i ->
+            Thread { results[i] = httpService.exchange(url, headers = mapOf("Accept" to "application/json")) }
+        }
+        threads.forEach { it.start(); Thread.sleep(50) }
+        threads.forEach { it.join() }
+
+        assertEquals(1, mockWebServer.requestCount)
+        for (result in results) {
+            val bytes = ByteArray(result!!.bodyLength)
+            result.body.duplicate().apply { position(0) }.get(bytes)
+            assertEquals("config", String(bytes))
+        }
+        // Each requester owns its body
+        assertNotSame(results[0]!!.body, results[1]!!.body)
+    }
+
+    @Test
+    fun testResponseCacheFollowsCacheControl() {
+        val cacheDirectory = kotlin.io.path.createTempDirectory("http_cache").toFile()
+        val cachingService = HttpService(cacheDirectory)
+        try {
+            mockWebServer.enqueue(
+                MockResponse()
+                    .setBody("cached")
+                    .setResponseCode(200)
+                    .setHeader("Cache-Control", "max-age=60")
+            )
+
+            val url = mockWebServer.url("/cacheable").toString()
+            assertEquals(6, cachingService.exchange(url).bodyLength)
+            assertEquals(6, cachingService.exchange(url).bodyLength)
+
+            assertEquals(1, mockWebServer.requestCount)
+        } finally {
+            cacheDirectory.deleteRecursively()
+        }
+    }
+
+    @Test
+    fun testServicesShareCacheOfDirectory() {
+        val cacheDirectory = kotlin.io.path.createTempDirectory("http_cache").toFile()
+        try {
+            mockWebServer.enqueue(
+                MockResponse()
+                    .setBody("shared")
+                    .setResponseCode(200)
+                    .setHeader("Cache-Control", "max-age=60")
+            )
+
+            val url = mockWebServer.url("/shared").toString()
+            assertEquals(6, HttpService(cacheDirectory).exchange(url).bodyLength)
+            assertEquals(6, HttpService(cacheDirectory).exchange(url).bodyLength)
+
+            assertEquals(1, mockWebServer.requestCount)
+        } finally {
+            cacheDirectory.deleteRecursively()
+        }
+    }
 }